@@ -109,6 +109,9 @@ static struct {
 	const char* FullScreen = "FullScreen";
 	const char* MaintainAspect = "MaintainAspect";
 	const char* RenderResolution = "RenderResolution";
+	const char* ResourceCacheBudget = "ResourceCacheBudget";
+	const char* SkipDrawUntilShaderReady = "SkipDrawUntilShaderReady";
+	const char* MergeDraws = "MergeDraws";
 } sect_video_keys;
 
 static const char* section_overlay = "overlay";
@@ -412,6 +415,9 @@ bool Settings::LoadConfig()
 	m_video.bFullScreen = m_si.GetBoolValue(section_video, sect_video_keys.FullScreen, /*Default=*/false);
 	m_video.bMaintainAspect = m_si.GetBoolValue(section_video, sect_video_keys.MaintainAspect, /*Default=*/true);
 	m_video.renderScaleFactor = m_si.GetLongValue(section_video, sect_video_keys.RenderResolution, /*Default=*/1);
+	m_video.resourceCacheBudget = m_si.GetLongValue(section_video, sect_video_keys.ResourceCacheBudget, /*Default=*/512);
+	m_video.bSkipDrawUntilShaderReady = m_si.GetBoolValue(section_video, sect_video_keys.SkipDrawUntilShaderReady, /*Default=*/false);
+	m_video.bMergeDraws = m_si.GetBoolValue(section_video, sect_video_keys.MergeDraws, /*Default=*/true);
 
 	// ==== Video End ===========
 
@@ -615,6 +621,9 @@ bool Settings::Save(std::string file_path)
 	m_si.SetBoolValue(section_video, sect_video_keys.FullScreen, m_video.bFullScreen, nullptr, true);
 	m_si.SetBoolValue(section_video, sect_video_keys.MaintainAspect, m_video.bMaintainAspect, nullptr, true);
 	m_si.SetLongValue(section_video, sect_video_keys.RenderResolution, m_video.renderScaleFactor, nullptr, false, true);
+	m_si.SetLongValue(section_video, sect_video_keys.ResourceCacheBudget, m_video.resourceCacheBudget, nullptr, false, true);
+	m_si.SetBoolValue(section_video, sect_video_keys.SkipDrawUntilShaderReady, m_video.bSkipDrawUntilShaderReady, nullptr, true);
+	m_si.SetBoolValue(section_video, sect_video_keys.MergeDraws, m_video.bMergeDraws, nullptr, true);
 
 	// ==== Video End ===========
 
@@ -121,7 +121,11 @@ public:
 		bool bMaintainAspect;
         bool Reserved3;
 		int  renderScaleFactor = 1;
-		int  Reserved99[9] = { 0 };
+		int  resourceCacheBudget = 512; // In MB, zero disables eviction
+		bool bSkipDrawUntilShaderReady = false;
+		bool bMergeDraws = true;
+		bool Reserved4[2] = { false };
+		int  Reserved99[7] = { 0 };
 	} m_video;
 	static_assert(sizeof(s_video) == 0x98, assert_check_shared_memory(s_video));
 
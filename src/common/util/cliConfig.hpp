@@ -41,6 +41,8 @@ static constexpr char sid[] = "sid";
 static constexpr char system_retail[] = "retail";
 static constexpr char system_devkit[] = "devkit";
 static constexpr char system_chihiro[] = "chihiro";
+static constexpr char nv2a_capture[] = "nv2acapture";
+static constexpr char nv2a_replay[] = "nv2areplay";
 
 bool GenConfig(char** argv, int argc);
 size_t ConfigSize();
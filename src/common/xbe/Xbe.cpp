@@ -32,7 +32,14 @@
 #include "common\util\CxbxUtil.h" // For RoundUp
 #include <filesystem> // filesystem related functions available on C++ 17
 #include <locale> // For ctime
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include "SimpleIni.h"
 #include "devices\LED.h" // For LED::Sequence
 #include "core\kernel\init\CxbxKrnl.h" // For CxbxKrnlPrintUEM
 #include "common\crypto\EmuSha.h" // For the SHA functions
@@ -101,6 +108,7 @@ Xbe::Xbe(const char *x_szFilename, bool bFromGUI)
         printf("Xbe::Xbe: Storing Xbe Path...");
 
         strcpy(m_szPath, x_szFilename);
+        m_FilePath = x_szFilename;
 
 		char * c = strrchr(m_szPath, '\\');
 		if (c != nullptr)
@@ -798,6 +806,90 @@ bool Xbe::CheckSectionIntegrity(uint32_t sectionIndex)
     }
 }
 
+std::vector<bool> Xbe::CheckSectionsIntegrity(const std::string &digestCacheFile)
+{
+	const auto startTime = std::chrono::steady_clock::now();
+	const uint32_t sectionCount = m_Header.dwSections;
+	std::vector<bool> results(sectionCount, false);
+
+	// The cache key covers the file identity and its header, which in turn holds the digest of every section
+	std::string cacheKey, cacheValue;
+	CSimpleIniA digestCache;
+	if (!digestCacheFile.empty()) {
+		std::error_code sizeError, timeError;
+		const auto fileSize = std::filesystem::file_size(m_FilePath, sizeError);
+		const auto lastWrite = std::filesystem::last_write_time(m_FilePath, timeError);
+		if (!sizeError && !timeError) {
+			unsigned char headerDigest[A_SHA_DIGEST_LEN];
+			CalcSHA1Hash(headerDigest, m_SignatureHeader, m_Header.dwSizeofHeaders - (sizeof(m_Header.dwMagic) + sizeof(m_Header.pbDigitalSignature)));
+
+			std::stringstream value;
+			value << std::hex << fileSize << "-" << lastWrite.time_since_epoch().count() << "-";
+			for (unsigned char byte : headerDigest) {
+				value << std::setw(2) << std::setfill('0') << (unsigned)byte;
+			}
+
+			cacheKey = std::filesystem::absolute(m_FilePath, error).string();
+			cacheValue = value.str();
+			digestCache.LoadFile(digestCacheFile.c_str());
+			if (cacheValue == digestCache.GetValue("verified", cacheKey.c_str(), "")) {
+				printf("Xbe::CheckSectionsIntegrity: Skipped, all %u sections were verified before\n", sectionCount);
+				results.assign(sectionCount, true);
+				return results;
+			}
+		}
+	}
+
+	// Spread the sections over a few workers, biggest first so the load evens out
+	std::vector<uint32_t> order(sectionCount);
+	for (uint32_t i = 0; i < sectionCount; i++) {
+		order[i] = i;
+	}
+
+	std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+		return m_SectionHeader[a].dwSizeofRaw > m_SectionHeader[b].dwSizeofRaw;
+	});
+
+	// std::vector<bool> can't be written concurrently, so collect into plain bytes first
+	std::vector<uint8_t> verified(sectionCount, 0);
+	std::atomic<uint32_t> next = 0;
+	auto worker = [&]() {
+		for (uint32_t i = next++; i < sectionCount; i = next++) {
+			verified[order[i]] = CheckSectionIntegrity(order[i]);
+		}
+	};
+
+	const uint32_t workerCount = std::min<uint32_t>(std::max(std::thread::hardware_concurrency(), 1u), sectionCount);
+	std::vector<std::thread> workers;
+	for (uint32_t i = 1; i < workerCount; i++) {
+		workers.emplace_back(worker);
+	}
+
+	worker();
+	for (auto &thread : workers) {
+		thread.join();
+	}
+
+	bool allVerified = true;
+	uint64_t totalSize = 0;
+	for (uint32_t i = 0; i < sectionCount; i++) {
+		results[i] = verified[i] != 0;
+		allVerified &= results[i];
+		totalSize += m_SectionHeader[i].dwSizeofRaw;
+	}
+
+	const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+	printf("Xbe::CheckSectionsIntegrity: Hashed %u sections (%llu bytes) on %u threads in %lld us\n", sectionCount, totalSize, workerCount, (long long)elapsed);
+
+	// Only remember fully verified xbe's, anything else gets checked (and reported) again next time
+	if (allVerified && !cacheKey.empty()) {
+		digestCache.SetValue("verified", cacheKey.c_str(), cacheValue.c_str());
+		digestCache.SaveFile(digestCacheFile.c_str());
+	}
+
+	return results;
+}
+
 // ported from Dxbx's XbeExplorer
 XbeType Xbe::GetXbeType()
 {
@@ -31,6 +31,8 @@
 #include "core/kernel/common/types.h"
 
 #include <cstdio>
+#include <string>
+#include <vector>
 
 
 //#include <windef.h> // For MAX_PATH
@@ -71,6 +73,10 @@ class Xbe : public Error
         // verify the integrity of an xbe section
         bool CheckSectionIntegrity(uint32_t sectionIndex);
 
+        // verify the integrity of all xbe sections in parallel, returning the outcome per section;
+        // when a digest cache file is given, a previously fully verified (and unchanged) xbe is skipped
+        std::vector<bool> CheckSectionsIntegrity(const std::string &digestCacheFile = "");
+
         // import logo bitmap from raw monochrome data
         void ImportLogoBitmap(const uint8_t x_Gray[100*17]);
 
@@ -258,6 +264,9 @@ class Xbe : public Error
         // Xbe original path
         char m_szPath[MAX_PATH];
 
+        // Xbe original file name, including path
+        std::string m_FilePath;
+
         // Xbe ascii title, translated from certificate title
         char m_szAsciiTitle[41];
 
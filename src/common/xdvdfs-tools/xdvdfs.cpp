@@ -101,6 +101,9 @@ BOOL	XDVDFS_UnMount(
 	memset(Session->Read.SectorList, 0, sizeof(xbox::dword_xt) * DISK_BUFFER);
 	memset(Session->Read.LockList, 0, sizeof(xbox::dword_xt) * DISK_BUFFER);
 	Session->Read.WriteIndex = 0;
+	// Forget about indexed directories
+	Session->DirectoryIndex.clear();
+	Session->IndexedDirectories.clear();
 	// Invalidate all open files & search structures
 	Session->Magic++;
 	return TRUE;
@@ -200,6 +203,42 @@ enum_retry:
 	return XDVDFS_NO_ERROR;
 }
 
+// Add all entries of a directory to the session's directory index
+static xbox::dword_xt	XDVDFS_IndexDirectory(
+			PXDVDFS_SESSION	Session,
+			xbox::dword_xt			DirectorySector,
+			xbox::dword_xt			DirectorySize)
+{
+	SEARCH_RECORD	SearchRecord;
+	xbox::dword_xt			ReturnCode, i;
+
+	SearchRecord.Magic = Session->Magic;
+	SearchRecord.SearchStartSector = DirectorySector;
+	SearchRecord.DirectorySize = DirectorySize;
+	SearchRecord.Position = 0;
+	while( (ReturnCode = XDVDFS_EnumFiles(Session, &SearchRecord)) ==
+		XDVDFS_NO_ERROR)
+	{
+		XDVDFS_INDEX_KEY Key = { DirectorySector, (char *)SearchRecord.CurrentFilename };
+		for(i = 0;i < Key.Filename.length();i++)
+			Key.Filename[i] = UPPERCASE((xbox::byte_xt)Key.Filename[i]);
+
+		// Keep the first one on duplicates, like a linear search would
+		Session->DirectoryIndex.try_emplace(std::move(Key), XDVDFS_INDEXED_ENTRY{
+			SearchRecord.CurrentFileStartSector,
+			SearchRecord.CurrentFileSize,
+			SearchRecord.CurrentFileAttributes,
+			SearchRecord.Position,
+			(char *)SearchRecord.CurrentFilename });
+	}
+
+	if (ReturnCode != XDVDFS_NO_MORE_FILES)
+		return ReturnCode;
+
+	Session->IndexedDirectories.insert(DirectorySector);
+	return XDVDFS_NO_ERROR;
+}
+
 xbox::dword_xt	XDVDFS_GetFileInfo(
 			PXDVDFS_SESSION	Session,
 			LPSTR 			Filename,
@@ -228,47 +267,55 @@ xbox::dword_xt	XDVDFS_GetFileInfo(
 			return XDVDFS_FILE_NOT_FOUND;
 
 		// Enter that directory
-		Length = 0;
 		SearchRecord->SearchStartSector = SearchRecord->CurrentFileStartSector;
 		SearchRecord->DirectorySize = SearchRecord->CurrentFileSize;
 		SearchRecord->Position = 0;
-		// Browse the contents of the dir
-		while( (ReturnCode = XDVDFS_EnumFiles(Session, SearchRecord)) ==
-			XDVDFS_NO_ERROR)
+
+		// Dxbx addition : Stop at first file if no further path is given
+		if (*Filename == 0)
+		{
+			ReturnCode = XDVDFS_EnumFiles(Session, SearchRecord);
+			if (ReturnCode == XDVDFS_NO_MORE_FILES)
+				return XDVDFS_FILE_NOT_FOUND;
+
+			return ReturnCode;
+		}
+
+		// Make sure the directory is in the index
+		if (Session->IndexedDirectories.find(SearchRecord->SearchStartSector) == Session->IndexedDirectories.end())
 		{
-			// Dxbx addition : Stop at first file if no further path is given
-			if (*Filename == 0)
-				break;
-
-			// Calculate length of the filename
-			Length = 0;
-			while( (SearchRecord->CurrentFilename[Length])&&
-				(SearchRecord->CurrentFilename[Length] != DIRECTORY_SEPARATOR) )
-					Length++;
-
-			// Match the filename against the one given
-			for(i = 0;i < Length;i++)
-			{
-				if ((Filename[i] == DIRECTORY_SEPARATOR)||
-					(!Filename[i])||
-					(UPPERCASE(Filename[i]) !=
-					UPPERCASE(SearchRecord->CurrentFilename[i])))
-						break;
-			}
-
-			// If it matched, exit
-			if ((i == Length)&&((Filename[i] == 0)
-				||(Filename[i] == DIRECTORY_SEPARATOR)))
-				break;
+			ReturnCode = XDVDFS_IndexDirectory(Session, SearchRecord->SearchStartSector, SearchRecord->DirectorySize);
+			if (ReturnCode != XDVDFS_NO_ERROR)
+				return ReturnCode;
 		}
 
+		// Calculate length of the filename part, and look it up
+		Length = 0;
+		while( (Filename[Length])&&
+			(Filename[Length] != DIRECTORY_SEPARATOR) )
+				Length++;
+
+		XDVDFS_INDEX_KEY Key = { SearchRecord->SearchStartSector, std::string(Filename, Length) };
+		for(i = 0;i < Length;i++)
+			Key.Filename[i] = UPPERCASE((xbox::byte_xt)Key.Filename[i]);
+
+		auto it = Session->DirectoryIndex.find(Key);
 		// If we reached the end of the dir without matching, fail
-		if (ReturnCode == XDVDFS_NO_MORE_FILES)
+		if (it == Session->DirectoryIndex.end())
 			return XDVDFS_FILE_NOT_FOUND;
 
-		// If any other error occured, fail
-		if (ReturnCode != XDVDFS_NO_ERROR)
-			return ReturnCode;
+		// Fill the search record like enumerating up to the entry would have
+		const XDVDFS_INDEXED_ENTRY &Entry = it->second;
+		memcpy(SearchRecord->CurrentFilename, Entry.Filename.c_str(), Entry.Filename.length() + 1);
+		SearchRecord->CurrentFileAttributes = Entry.FileAttributes;
+		SearchRecord->CurrentFileSize = Entry.FileSize;
+		SearchRecord->CurrentFileStartSector = Entry.FileStartSector;
+		SearchRecord->CurrentFileEndSector = SearchRecord->CurrentFileStartSector
+									 + (SearchRecord->CurrentFileSize / SECTOR_SIZE);
+		if (SearchRecord->CurrentFileSize % SECTOR_SIZE)
+			SearchRecord->CurrentFileEndSector++;
+
+		SearchRecord->Position = Entry.NextPosition;
 
 		// Match next part of the given filename
 		Filename += Length;
@@ -397,8 +444,8 @@ xbox::dword_xt	XDVDFS_FileRead(
 			FileRecord->PartialSector = CurrentSector;
 		}
 
-		for(i = 0;i < PartialRead;i++)
-			*Buffer++ = FileRecord->PartialData[Position++];
+		memcpy(Buffer, &FileRecord->PartialData[Position], PartialRead);
+		Buffer += PartialRead;
 
 		Size -= PartialRead;
 		Readed += PartialRead;
@@ -452,8 +499,7 @@ xbox::dword_xt	XDVDFS_FileRead(
 		FileRecord->PartialSector = CurrentSector;
 	}
 
-	for(i = 0;i < PartialRead;i++)
-		*Buffer++ = FileRecord->PartialData[i];
+	memcpy(Buffer, FileRecord->PartialData, PartialRead);
 
 	Readed += PartialRead;
 	FileRecord->CurrentPosition += PartialRead;
@@ -7,6 +7,10 @@
 
 #include "buffered_io.h"
 
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
 using namespace xbox;
 
 CONST char_xt *XDVDFS_Signature = "MICROSOFT*XBOX*MEDIA";
@@ -50,6 +54,31 @@ typedef struct {
 	xbox::byte_xt		Signature2[SIGNATURE_SIZE];
 } XDVDFS_VOLUME_DESCRIPTOR, *PXDVDFS_VOLUME_DESCRIPTOR;
 
+// Directory entry as kept in the session's directory index
+typedef struct {
+	xbox::dword_xt	FileStartSector;	// Already corrected with FileSystemBaseSector
+	xbox::dword_xt	FileSize;
+	xbox::dword_xt	FileAttributes;
+	xbox::dword_xt	NextPosition;		// Position of the next entry in the directory
+	std::string		Filename;
+} XDVDFS_INDEXED_ENTRY;
+
+// Key into the directory index : the directory's start sector and the upper-cased filename
+typedef struct _XDVDFS_INDEX_KEY {
+	xbox::dword_xt	DirectorySector;
+	std::string		Filename;
+
+	bool operator==(const _XDVDFS_INDEX_KEY &rhs) const {
+		return DirectorySector == rhs.DirectorySector && Filename == rhs.Filename;
+	}
+} XDVDFS_INDEX_KEY;
+
+typedef struct _XDVDFS_INDEX_KEY_HASH {
+	std::size_t operator()(const XDVDFS_INDEX_KEY &k) const {
+		return std::hash<std::string>()(k.Filename) ^ (std::size_t)k.DirectorySector;
+	}
+} XDVDFS_INDEX_KEY_HASH;
+
 // XDVDFS session
 typedef struct {
 	// Start sector of current session
@@ -64,6 +93,11 @@ typedef struct {
 	// The dword below is incremented when the filesystem is unmounted
 	// automatically invalidating all open files and search records
 	xbox::dword_xt						Magic;
+
+	// Path lookups go through this index instead of walking each directory, directories
+	// get indexed as a whole the first time they're looked into
+	std::unordered_map<XDVDFS_INDEX_KEY, XDVDFS_INDEXED_ENTRY, XDVDFS_INDEX_KEY_HASH>	DirectoryIndex;
+	std::unordered_set<xbox::dword_xt>	IndexedDirectories;
 } XDVDFS_SESSION, *PXDVDFS_SESSION;
 
 // File Record
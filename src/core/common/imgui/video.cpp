@@ -13,6 +13,12 @@
 
 #include "core/kernel/init/CxbxKrnl.h"
 #include "core/hle/D3D8/XbVertexBuffer.h"
+#include "core/hle/D3D8/Direct3D9/Direct3D9.h"
+#include "core/hle/D3D8/XbPixelShader.h"
+#include "core/hle/D3D8/Direct3D9/VertexShaderSource.h"
+#include "core/hle/D3D8/Direct3D9/TextureConversion.h"
+#include "core/kernel/support/EmuFile.h" // For CxbxDrawFileIoStats
+#include "devices/Xbox.h" // For g_NV2A
 
 const ImColor ImGuiVideo::m_laser_col[4] = {
 		ImColor(ImVec4(1.0f, 0.0f, 0.0f, 1.0f)), // player1: red
@@ -50,6 +56,36 @@ void ImGuiVideo::DrawWidgets(bool is_focus, ImGuiWindowFlags input_handler)
 			if (ImGui::CollapsingHeader("Vertex Buffer Cache", ImGuiTreeNodeFlags_DefaultOpen)) {
 				VertexBufferConverter.DrawCacheStats();
 			}
+			if (ImGui::CollapsingHeader("Index Buffer Cache", ImGuiTreeNodeFlags_DefaultOpen)) {
+				CxbxDrawIndexBufferCacheStats();
+			}
+			if (ImGui::CollapsingHeader("Immediate Mode", ImGuiTreeNodeFlags_DefaultOpen)) {
+				CxbxDrawInlineVertexBufferStats();
+			}
+			if (ImGui::CollapsingHeader("Draw Merging", ImGuiTreeNodeFlags_DefaultOpen)) {
+				CxbxDrawMergedDrawStats();
+			}
+			if (ImGui::CollapsingHeader("Vertex Shader Compiler", ImGuiTreeNodeFlags_DefaultOpen)) {
+				g_VertexShaderSource.DrawCompilerStats();
+			}
+			if (ImGui::CollapsingHeader("Pixel Shader Cache", ImGuiTreeNodeFlags_DefaultOpen)) {
+				DxbxDrawPixelShaderCacheStats();
+			}
+			if (ImGui::CollapsingHeader("Resource Cache", ImGuiTreeNodeFlags_DefaultOpen)) {
+				CxbxDrawResourceCacheStats();
+			}
+			if (ImGui::CollapsingHeader("Host State Changes", ImGuiTreeNodeFlags_DefaultOpen)) {
+				CxbxDrawStateChangeStats();
+			}
+			if (ImGui::CollapsingHeader("Texture Conversion", ImGuiTreeNodeFlags_DefaultOpen)) {
+				g_TextureConverter.DrawConversionStats();
+			}
+			if (ImGui::CollapsingHeader("NV2A", ImGuiTreeNodeFlags_DefaultOpen)) {
+				g_NV2A->DrawStats();
+			}
+			if (ImGui::CollapsingHeader("File I/O", ImGuiTreeNodeFlags_DefaultOpen)) {
+				CxbxDrawFileIoStats();
+			}
 			ImGui::End();
 		}
 	}
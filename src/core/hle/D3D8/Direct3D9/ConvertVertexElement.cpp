@@ -0,0 +1,258 @@
+#define LOG_PREFIX CXBXR_MODULE::VTXB
+
+#include <emmintrin.h> // SSE2
+#include <cstring>
+#include "common\util\CPUID.h"
+#include "core\kernel\init\CxbxKrnl.h" // For LOG_TEST_CASE
+#include "ConvertVertexElement.h"
+
+// Vertex element conversions, from Xbox to host format
+// Only the Xbox types that the host can't consume as-is are handled here;
+// All others are copied over verbatim
+
+inline FLOAT PackedIntToFloat(const int value, const FLOAT PosFactor, const FLOAT NegFactor)
+{
+	if (value >= 0) {
+		return ((FLOAT)value) / PosFactor;
+	}
+	else {
+		return ((FLOAT)value) / NegFactor;
+	}
+}
+
+inline FLOAT NormShortToFloat(const SHORT value)
+{
+	return PackedIntToFloat((int)value, 32767.0f, 32768.0f);
+}
+
+inline FLOAT ByteToFloat(const BYTE value)
+{
+	return ((FLOAT)value) / 255.0f;
+}
+
+union NormPacked3 {
+	int32_t value;
+	struct {
+		int x : 11;
+		int y : 11;
+		int z : 10;
+	};
+};
+
+// Default implementations
+
+static void Copy(uint8_t *pHost, const uint8_t *pXbox, UINT XboxByteSize)
+{
+	memcpy(pHost, pXbox, XboxByteSize);
+}
+
+static void None(uint8_t *pHost, const uint8_t *pXbox, UINT XboxByteSize)
+{
+	// No host element data (but Xbox size can be above zero, when used for X_D3DVSD_MASK_SKIP*
+}
+
+static void NormShort1ToShort2N(uint8_t *pHost, const uint8_t *pXbox, UINT XboxByteSize)
+{
+	((SHORT*)pHost)[0] = ((const SHORT*)pXbox)[0];
+	((SHORT*)pHost)[1] = 0;
+}
+
+static void NormShort3ToShort4N(uint8_t *pHost, const uint8_t *pXbox, UINT XboxByteSize)
+{
+	((SHORT*)pHost)[0] = ((const SHORT*)pXbox)[0];
+	((SHORT*)pHost)[1] = ((const SHORT*)pXbox)[1];
+	((SHORT*)pHost)[2] = ((const SHORT*)pXbox)[2];
+	((SHORT*)pHost)[3] = 32767; // TODO : verify
+}
+
+static void Short1ToShort2(uint8_t *pHost, const uint8_t *pXbox, UINT XboxByteSize)
+{
+	((SHORT*)pHost)[0] = ((const SHORT*)pXbox)[0];
+	((SHORT*)pHost)[1] = 0;
+}
+
+static void Short3ToShort4(uint8_t *pHost, const uint8_t *pXbox, UINT XboxByteSize)
+{
+	((SHORT*)pHost)[0] = ((const SHORT*)pXbox)[0];
+	((SHORT*)pHost)[1] = ((const SHORT*)pXbox)[1];
+	((SHORT*)pHost)[2] = ((const SHORT*)pXbox)[2];
+	((SHORT*)pHost)[3] = 1; // Turok verified (character disappears when this is 32767)
+}
+
+template<int N>
+static void PByteToUByte4N(uint8_t *pHost, const uint8_t *pXbox, UINT XboxByteSize)
+{
+	for (int i = 0; i < 3; i++) {
+		pHost[i] = (i < N) ? pXbox[i] : 0;
+	}
+
+	pHost[3] = (N == 4) ? pXbox[3] : 255; // TODO : Verify
+}
+
+template<int N>
+static void NormShortToFloat_NoSIMD(uint8_t *pHost, const uint8_t *pXbox, UINT XboxByteSize)
+{
+	for (int i = 0; i < N; i++) {
+		((FLOAT*)pHost)[i] = NormShortToFloat(((const SHORT*)pXbox)[i]);
+	}
+}
+
+template<int N>
+static void PByteToFloat_NoSIMD(uint8_t *pHost, const uint8_t *pXbox, UINT XboxByteSize)
+{
+	for (int i = 0; i < N; i++) {
+		((FLOAT*)pHost)[i] = ByteToFloat(pXbox[i]);
+	}
+}
+
+static void NormPacked3ToFloat3_NoSIMD(uint8_t *pHost, const uint8_t *pXbox, UINT XboxByteSize)
+{
+	NormPacked3 Packed;
+	Packed.value = ((const int32_t*)pXbox)[0];
+
+	((FLOAT*)pHost)[0] = PackedIntToFloat(Packed.x, 1023.0f, 1024.f);
+	((FLOAT*)pHost)[1] = PackedIntToFloat(Packed.y, 1023.0f, 1024.f);
+	((FLOAT*)pHost)[2] = PackedIntToFloat(Packed.z, 511.0f, 512.f);
+}
+
+static void Float2HToFloat4_NoSIMD(uint8_t *pHost, const uint8_t *pXbox, UINT XboxByteSize)
+{
+	((FLOAT*)pHost)[0] = ((const FLOAT*)pXbox)[0];
+	((FLOAT*)pHost)[1] = ((const FLOAT*)pXbox)[1];
+	((FLOAT*)pHost)[2] = 0.0f;
+	((FLOAT*)pHost)[3] = ((const FLOAT*)pXbox)[2];
+}
+
+// SSE2 implementations
+// These convert all components of an element at once. Loads and stores are sized
+// exactly to the element, so they never touch memory beyond the vertex buffers.
+// Divisions (instead of multiplications with a reciprocal) keep the results bit-exact.
+
+// Divide signed integers, using PosFactor for positive and NegFactor for negative values
+static inline __m128 PackedIntToFloat_SSE2(__m128i values, __m128 PosFactor, __m128 NegFactor)
+{
+	__m128 negative = _mm_castsi128_ps(_mm_cmplt_epi32(values, _mm_setzero_si128()));
+	__m128 factor = _mm_or_ps(_mm_and_ps(negative, NegFactor), _mm_andnot_ps(negative, PosFactor));
+	return _mm_div_ps(_mm_cvtepi32_ps(values), factor);
+}
+
+template<int N>
+static inline void StoreFloats_SSE2(uint8_t *pHost, __m128 values)
+{
+	if (N == 4) {
+		_mm_storeu_ps((float*)pHost, values);
+	}
+	else {
+		_mm_storel_pi((__m64*)pHost, values);
+		if (N == 3) {
+			_mm_store_ss((float*)pHost + 2, _mm_movehl_ps(values, values));
+		}
+	}
+}
+
+template<int N>
+static void NormShortToFloat_SSE2(uint8_t *pHost, const uint8_t *pXbox, UINT XboxByteSize)
+{
+	__m128i shorts;
+	if (N == 4) {
+		shorts = _mm_loadl_epi64((const __m128i*)pXbox);
+	}
+	else {
+		shorts = _mm_cvtsi32_si128(*(const int32_t*)pXbox);
+		if (N == 3) {
+			shorts = _mm_insert_epi16(shorts, ((const SHORT*)pXbox)[2], 2);
+		}
+	}
+
+	// Sign-extend to 32 bit
+	__m128i ints = _mm_srai_epi32(_mm_unpacklo_epi16(shorts, shorts), 16);
+	StoreFloats_SSE2<N>(pHost, PackedIntToFloat_SSE2(ints, _mm_set1_ps(32767.0f), _mm_set1_ps(32768.0f)));
+}
+
+template<int N>
+static void PByteToFloat_SSE2(uint8_t *pHost, const uint8_t *pXbox, UINT XboxByteSize)
+{
+	int32_t bytes;
+	if (N == 4) {
+		bytes = *(const int32_t*)pXbox;
+	}
+	else {
+		bytes = *(const uint16_t*)pXbox;
+		if (N == 3) {
+			bytes |= pXbox[2] << 16;
+		}
+	}
+
+	// Zero-extend to 32 bit
+	const __m128i zero = _mm_setzero_si128();
+	__m128i ints = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero);
+	StoreFloats_SSE2<N>(pHost, _mm_div_ps(_mm_cvtepi32_ps(ints), _mm_set1_ps(255.0f)));
+}
+
+static void NormPacked3ToFloat3_SSE2(uint8_t *pHost, const uint8_t *pXbox, UINT XboxByteSize)
+{
+	NormPacked3 Packed;
+	Packed.value = ((const int32_t*)pXbox)[0];
+
+	__m128i ints = _mm_setr_epi32(Packed.x, Packed.y, Packed.z, 0);
+	StoreFloats_SSE2<3>(pHost, PackedIntToFloat_SSE2(ints,
+		_mm_setr_ps(1023.0f, 1023.0f, 511.0f, 1.0f),
+		_mm_setr_ps(1024.0f, 1024.0f, 512.0f, 1.0f)));
+}
+
+static void Float2HToFloat4_SSE2(uint8_t *pHost, const uint8_t *pXbox, UINT XboxByteSize)
+{
+	__m128 xy = _mm_loadl_pi(_mm_setzero_ps(), (const __m64*)pXbox);
+	__m128 w = _mm_load_ss((const float*)pXbox + 2);
+	// Compose (x, y, 0.0, w)
+	_mm_storeu_ps((float*)pHost, _mm_shuffle_ps(xy, w, _MM_SHUFFLE(0, 1, 1, 0)));
+}
+
+VertexElementConverter GetVertexElementConverter(UINT XboxType, BYTE HostDataType)
+{
+	static SimdCaps supports;
+	const bool bSSE2 = supports.SSE2();
+
+	switch (XboxType) {
+	case xbox::X_D3DVSDT_NORMSHORT1: // 0x11:
+		if (HostDataType == D3DDECLTYPE_SHORT2N) return NormShort1ToShort2N;
+		return NormShortToFloat_NoSIMD<1>; // A single component gains nothing from SIMD
+	case xbox::X_D3DVSDT_NORMSHORT2: // 0x21:
+		if (HostDataType == D3DDECLTYPE_SHORT2N) return Copy;
+		return bSSE2 ? NormShortToFloat_SSE2<2> : NormShortToFloat_NoSIMD<2>;
+	case xbox::X_D3DVSDT_NORMSHORT3: // 0x31:
+		if (HostDataType == D3DDECLTYPE_SHORT4N) return NormShort3ToShort4N;
+		return bSSE2 ? NormShortToFloat_SSE2<3> : NormShortToFloat_NoSIMD<3>;
+	case xbox::X_D3DVSDT_NORMSHORT4: // 0x41:
+		if (HostDataType == D3DDECLTYPE_SHORT4N) return Copy;
+		return bSSE2 ? NormShortToFloat_SSE2<4> : NormShortToFloat_NoSIMD<4>;
+	case xbox::X_D3DVSDT_NORMPACKED3: // 0x16:
+		return bSSE2 ? NormPacked3ToFloat3_SSE2 : NormPacked3ToFloat3_NoSIMD;
+	case xbox::X_D3DVSDT_SHORT1: // 0x15:
+		return Short1ToShort2;
+	case xbox::X_D3DVSDT_SHORT3: // 0x35:
+		return Short3ToShort4;
+	case xbox::X_D3DVSDT_PBYTE1: // 0x14:
+		if (HostDataType == D3DDECLTYPE_UBYTE4N) return PByteToUByte4N<1>;
+		return PByteToFloat_NoSIMD<1>; // A single component gains nothing from SIMD
+	case xbox::X_D3DVSDT_PBYTE2: // 0x24:
+		if (HostDataType == D3DDECLTYPE_UBYTE4N) return PByteToUByte4N<2>;
+		return bSSE2 ? PByteToFloat_SSE2<2> : PByteToFloat_NoSIMD<2>;
+	case xbox::X_D3DVSDT_PBYTE3: // 0x34:
+		if (HostDataType == D3DDECLTYPE_UBYTE4N) return PByteToUByte4N<3>;
+		return bSSE2 ? PByteToFloat_SSE2<3> : PByteToFloat_NoSIMD<3>;
+	case xbox::X_D3DVSDT_PBYTE4: // 0x44:
+		if (HostDataType == D3DDECLTYPE_UBYTE4N) return Copy;
+		return bSSE2 ? PByteToFloat_SSE2<4> : PByteToFloat_NoSIMD<4>;
+	case xbox::X_D3DVSDT_FLOAT2H: // 0x72:
+		return bSSE2 ? Float2HToFloat4_SSE2 : Float2HToFloat4_NoSIMD;
+	case xbox::X_D3DVSDT_NONE: // 0x02:
+		// Test-case : WWE RAW2
+		// Test-case : PetitCopter
+		LOG_TEST_CASE("X_D3DVSDT_NONE");
+		return None;
+	default:
+		// Generic 'conversion' - just make a copy
+		return Copy;
+	}
+}
@@ -0,0 +1,22 @@
+#ifndef CONVERTVERTEXELEMENT_H
+#define CONVERTVERTEXELEMENT_H
+
+#include "core/hle/D3D8/XbD3D8Types.h"
+
+// Converts a single Xbox vertex element into its host representation
+typedef void(*VertexElementConverter)
+(
+	uint8_t *pHostElement,
+	const uint8_t *pXboxElement,
+	UINT XboxByteSize
+);
+
+// Selects the converter for an Xbox vertex element type and the host type it was declared as.
+// Picks a SIMD implementation when the host CPU supports it; Results are bit-exact with the scalar ones
+extern VertexElementConverter GetVertexElementConverter
+(
+	UINT XboxType,
+	BYTE HostDataType
+);
+
+#endif
@@ -38,6 +38,7 @@
 #include "core\kernel\support\Emu.h"
 #include "core\kernel\support\EmuFS.h"
 #include "core\kernel\support\NativeHandle.h"
+#include "core\kernel\support\WriteTracker.h"
 #include "EmuShared.h"
 #include "..\FixedFunctionState.h"
 #include "core\hle\D3D8\ResourceTracker.h"
@@ -63,6 +64,8 @@
 #include "common\input\InputManager.h"
 #include "common/util/strConverter.hpp" // for utf8_to_utf16
 #include "VertexShaderSource.h"
+#include "TextureConversion.h"
+#include "ShaderCache.h"
 #include "Timer.h"
 
 #include <imgui.h>
@@ -74,8 +77,10 @@
 #include <process.h>
 #include <clocale>
 #include <functional>
+#include <list>
 #include <unordered_map>
 #include <thread>
+#include <atomic>
 
 XboxRenderStateConverter XboxRenderStates;
 XboxTextureStateConverter XboxTextureStates;
@@ -152,6 +157,7 @@ static bool                         g_bHack_DisableHostGPUQueries = false; // TO
 static IDirect3DQuery              *g_pHostQueryWaitForIdle = nullptr;
 static IDirect3DQuery              *g_pHostQueryCallbackEvent = nullptr;
 static int                          g_RenderUpscaleFactor = 1;
+static bool                         g_bSkipDrawPendingVertexShader = false; // Set while the current vertex shader is still being compiled
 
 static std::condition_variable		g_VBConditionVariable;	// Used in BlockUntilVerticalBlank
 static std::mutex					g_VBConditionMutex;		// Used in BlockUntilVerticalBlank
@@ -189,6 +195,9 @@ xbox::X_D3DSWAP g_LastD3DSwap = (xbox::X_D3DSWAP) -1;
 
 
 static constexpr size_t INDEX_BUFFER_CACHE_SIZE = 10000;
+static constexpr size_t INDEX_BUFFER_CACHE_ELASTICITY = 200; // Cache is allowed to grow this much more than maximum before being purged to maximum
+static constexpr UINT INDEX_BUFFER_POOL_MIN_SIZE_CLASS = 8; // Smallest pooled host index buffer holds 2^8 indices
+static constexpr size_t INDEX_BUFFER_POOL_MAX_FREE = 16; // Maximum number of unused host index buffers kept per size class
 
 static void CxbxImGui_RenderD3D9(ImGuiUI* m_imgui, IDirect3DSurface9* renderTarget)
 {
@@ -921,6 +930,10 @@ void *GetDataFromXboxResource(xbox::X_D3DResource *pXboxResource)
 	return (uint8_t*)pData;
 }
 
+// Even while its write watch stays clean, a tracked resource gets hashed at least this often,
+// as a safety net for writes that bypass the write tracker
+static constexpr auto TRACKED_RESOURCE_REHASH_INTERVAL = 1s;
+
 typedef struct _resource_info_t {
 	IDirect3DResource* pHostResource = nullptr;
 	DWORD dwXboxResourceType = 0;
@@ -931,12 +944,29 @@ typedef struct _resource_info_t {
 	std::chrono::time_point<std::chrono::steady_clock> nextHashTime;
 	std::chrono::milliseconds hashLifeTime = 1ms;
     std::chrono::time_point<std::chrono::steady_clock> lastUpdate;
+	std::chrono::time_point<std::chrono::steady_clock> lastHashTime;
+	// Cache eviction bookkeeping (see TrackHostResource) :
+	size_t szHostDataSize = 0; // Estimated host memory held by pHostResource
+	DWORD dwLastUsedSwap = 0; // g_Xbox_SwapData.Swap at the time this resource was last bound
+	bool bEvictable = false; // Set for entries that are linked into g_Cxbx_ResourceCacheUsage
+	std::list<resource_key_t>::iterator usageIterator;
+	CxbxWriteWatch writeWatch = CXBX_INVALID_WRITE_WATCH; // Detects guest writes to pXboxData
 } resource_info_t;
 
 typedef std::unordered_map<resource_key_t, resource_info_t, resource_key_hash> resource_cache_t;
 resource_cache_t g_Cxbx_Cached_Direct3DResources;
 resource_cache_t g_Cxbx_Cached_PaletizedTextures;
 
+// Least-recently used order of all evictable entries in both resource caches (front = most recently used)
+static std::list<resource_key_t> g_Cxbx_ResourceCacheUsage;
+static size_t g_Cxbx_ResourceCacheEvictableBytes = 0; // Sum of szHostDataSize of all evictable entries
+static size_t g_Cxbx_ResourceCachePinnedBytes = 0; // Sum of szHostDataSize of entries that are never evicted
+static ULONG g_Cxbx_ResourceCacheHits = 0;
+static ULONG g_Cxbx_ResourceCacheMisses = 0;
+static ULONG g_Cxbx_ResourceCacheEvictions = 0;
+static ULONG g_Cxbx_ResourceCacheHashedBytes = 0;
+static ULONG g_Cxbx_ResourceCacheModified = 0;
+
 bool IsResourceAPixelContainer(xbox::dword_xt XboxResource_Common)
 {
 	DWORD Type = GetXboxCommonResourceType(XboxResource_Common);
@@ -1001,6 +1031,109 @@ resource_key_t GetHostResourceKey(xbox::X_D3DResource* pXboxResource, int iTextu
 	return key;
 }
 
+static DWORD GetHostResourceUsage(IDirect3DResource* pHostResource)
+{
+	HRESULT hRet = D3DERR_INVALIDCALL;
+	DWORD Usage = 0;
+	switch (pHostResource->GetType()) {
+	case D3DRTYPE_SURFACE: {
+		D3DSURFACE_DESC surfaceDesc;
+		hRet = ((IDirect3DSurface*)pHostResource)->GetDesc(&surfaceDesc);
+		Usage = surfaceDesc.Usage;
+	} break;
+	case D3DRTYPE_TEXTURE: {
+		D3DSURFACE_DESC surfaceDesc;
+		hRet = ((IDirect3DTexture*)pHostResource)->GetLevelDesc(0, &surfaceDesc);
+		Usage = surfaceDesc.Usage;
+	} break;
+	case D3DRTYPE_CUBETEXTURE: {
+		D3DSURFACE_DESC surfaceDesc;
+		hRet = ((IDirect3DCubeTexture*)pHostResource)->GetLevelDesc(0, &surfaceDesc);
+		Usage = surfaceDesc.Usage;
+	} break;
+	case D3DRTYPE_VOLUMETEXTURE: {
+		D3DVOLUME_DESC volumeDesc;
+		hRet = ((IDirect3DVolumeTexture*)pHostResource)->GetLevelDesc(0, &volumeDesc);
+		Usage = volumeDesc.Usage;
+	} break;
+	}
+
+	// Treat unknown resources like render targets, so that they're never evicted
+	return SUCCEEDED(hRet) ? Usage : D3DUSAGE_RENDERTARGET;
+}
+
+static size_t GetHostResourceSizeEstimate(resource_key_t& key, resource_info_t& resourceInfo)
+{
+	// Start from the Xbox size; Host formats mostly match the Xbox ones, except for
+	// paletized textures, which are converted to 32 bit ARGB :
+	size_t size = resourceInfo.szXboxDataSize;
+	if (IsResourceAPixelContainer(key.Common) && IsPaletizedTexture(key.Format)) {
+		size *= 4;
+	}
+
+	// GetXboxResourceSize only measures the top mipmap level, so add a third for the smaller levels
+	if (resourceInfo.pHostResource->GetType() != D3DRTYPE_SURFACE) {
+		if (((IDirect3DBaseTexture*)resourceInfo.pHostResource)->GetLevelCount() > 1) {
+			size += size / 3;
+		}
+	}
+
+	return size;
+}
+
+static void TrackHostResource(resource_key_t& key, resource_info_t& resourceInfo)
+{
+	if (resourceInfo.pHostResource == nullptr) {
+		return;
+	}
+
+	resourceInfo.szHostDataSize = GetHostResourceSizeEstimate(key, resourceInfo);
+	resourceInfo.dwLastUsedSwap = g_Xbox_SwapData.Swap;
+
+	// Track writes to pixel container data (which always resides in contiguous memory),
+	// so that HostResourceRequiresUpdate only needs to hash it after it has been written to
+	if (IsResourceAPixelContainer(key.Common) && IS_PHYSICAL_ADDRESS(resourceInfo.pXboxData)) {
+		resourceInfo.writeWatch = CxbxWriteTrackerWatch(resourceInfo.pXboxData, resourceInfo.szXboxDataSize);
+	}
+
+	// Only textures and surfaces that can be recreated from Xbox memory may be evicted.
+	// Render targets and depth stencils hold contents that exist on the host only.
+	resourceInfo.bEvictable = IsResourceAPixelContainer(key.Common)
+		&& !(GetHostResourceUsage(resourceInfo.pHostResource) & (D3DUSAGE_RENDERTARGET | D3DUSAGE_DEPTHSTENCIL));
+	if (resourceInfo.bEvictable) {
+		g_Cxbx_ResourceCacheUsage.push_front(key);
+		resourceInfo.usageIterator = g_Cxbx_ResourceCacheUsage.begin();
+		g_Cxbx_ResourceCacheEvictableBytes += resourceInfo.szHostDataSize;
+	} else {
+		g_Cxbx_ResourceCachePinnedBytes += resourceInfo.szHostDataSize;
+	}
+}
+
+static void UntrackHostResource(resource_info_t& resourceInfo)
+{
+	CxbxWriteTrackerUnwatch(resourceInfo.writeWatch);
+	resourceInfo.writeWatch = CXBX_INVALID_WRITE_WATCH;
+
+	if (resourceInfo.bEvictable) {
+		g_Cxbx_ResourceCacheUsage.erase(resourceInfo.usageIterator);
+		g_Cxbx_ResourceCacheEvictableBytes -= resourceInfo.szHostDataSize;
+		resourceInfo.bEvictable = false;
+	} else {
+		g_Cxbx_ResourceCachePinnedBytes -= resourceInfo.szHostDataSize;
+	}
+
+	resourceInfo.szHostDataSize = 0;
+}
+
+static void TouchHostResource(resource_info_t& resourceInfo)
+{
+	resourceInfo.dwLastUsedSwap = g_Xbox_SwapData.Swap;
+	if (resourceInfo.bEvictable) {
+		// Move to the front of the usage list
+		g_Cxbx_ResourceCacheUsage.splice(g_Cxbx_ResourceCacheUsage.begin(), g_Cxbx_ResourceCacheUsage, resourceInfo.usageIterator);
+	}
+}
+
 void FreeHostResource(resource_key_t key)
 {
 	// Release the host resource and remove it from the list
@@ -1008,6 +1141,7 @@ void FreeHostResource(resource_key_t key)
 	auto hostResourceIterator = ResourceCache.find(key);
 	if (hostResourceIterator != ResourceCache.end()) {
 		if (hostResourceIterator->second.pHostResource) {
+			UntrackHostResource(hostResourceIterator->second);
 			(hostResourceIterator->second.pHostResource)->Release();
 		}
 
@@ -1019,6 +1153,7 @@ void ClearResourceCache(resource_cache_t& ResourceCache)
 {
 	for (auto& hostResourceIterator : ResourceCache) {
 		if (hostResourceIterator.second.pHostResource) {
+			UntrackHostResource(hostResourceIterator.second);
 			(hostResourceIterator.second.pHostResource)->Release();
 		}
 	}
@@ -1026,15 +1161,58 @@ void ClearResourceCache(resource_cache_t& ResourceCache)
 	ResourceCache.clear();
 }
 
-void PrunePaletizedTexturesCache()
+void PruneResourceCaches()
 {
-	// TODO : Implement a better cache eviction algorithm (like least-recently used, or just at-random)
-	// Poor mans cache eviction policy: just clear it once it overflows
-	if (g_Cxbx_Cached_PaletizedTextures.size() >= 1500) {
-		ClearResourceCache(g_Cxbx_Cached_PaletizedTextures);
+	// A budget of zero (or less) disables eviction
+	if (g_XBVideo.resourceCacheBudget <= 0) {
+		return;
+	}
+
+	const size_t budget = (size_t)g_XBVideo.resourceCacheBudget * ONE_MB;
+	if (g_Cxbx_ResourceCacheEvictableBytes <= budget) {
+		return;
+	}
+
+	// Evict least-recently used entries first, but never those bound during the current frame.
+	// Since binding moves an entry to the front, all entries before the first one used this frame
+	// have been used in this frame as well, so we can stop at the first such entry.
+	while (g_Cxbx_ResourceCacheEvictableBytes > budget && !g_Cxbx_ResourceCacheUsage.empty()) {
+		resource_key_t key = g_Cxbx_ResourceCacheUsage.back();
+		auto& ResourceCache = GetResourceCache(key);
+		auto it = ResourceCache.find(key);
+		assert(it != ResourceCache.end());
+		if (it->second.dwLastUsedSwap == g_Xbox_SwapData.Swap) {
+			break;
+		}
+
+		FreeHostResource(key);
+		g_Cxbx_ResourceCacheEvictions++;
 	}
 }
 
+void CxbxDrawResourceCacheStats()
+{
+	ImGui::Text("Cache Size: %u", g_Cxbx_Cached_Direct3DResources.size() + g_Cxbx_Cached_PaletizedTextures.size());
+	ImGui::Text("Paletized: %u", g_Cxbx_Cached_PaletizedTextures.size());
+	ImGui::Text("Evictable: %u MB", g_Cxbx_ResourceCacheEvictableBytes / ONE_MB);
+	ImGui::Text("Pinned: %u MB", g_Cxbx_ResourceCachePinnedBytes / ONE_MB);
+	ImGui::Text("Budget: %d MB", g_XBVideo.resourceCacheBudget);
+	ImGui::Separator();
+	ImGui::Text("Hits: %u", std::exchange(g_Cxbx_ResourceCacheHits, 0));
+	ImGui::Text("Misses: %u", std::exchange(g_Cxbx_ResourceCacheMisses, 0));
+	ImGui::Text("Evictions: %u", std::exchange(g_Cxbx_ResourceCacheEvictions, 0));
+	ImGui::Separator();
+	ImGui::Text("Hashed: %u KB", std::exchange(g_Cxbx_ResourceCacheHashedBytes, 0) / ONE_KB);
+	ImGui::Text("Modified: %u", std::exchange(g_Cxbx_ResourceCacheModified, 0));
+	ImGui::Text("Write faults: %u", CxbxWriteTrackerGetFaultCount());
+}
+
+void CxbxDrawStateChangeStats()
+{
+	ImGui::Text("Render states: %u", XboxRenderStates.GetAndResetHostStateChanges());
+	ImGui::Text("Texture states: %u", XboxTextureStates.GetAndResetHostStateChanges());
+}
+
 void ForceResourceRehash(xbox::X_D3DResource* pXboxResource)
 {
 	auto key = GetHostResourceKey(pXboxResource); // Note : iTextureStage is unknown here!
@@ -1060,6 +1238,8 @@ IDirect3DResource *GetHostResource(xbox::X_D3DResource *pXboxResource, DWORD D3D
 		return nullptr;
 	}
 
+	TouchHostResource(it->second);
+
 	return it->second.pHostResource;
 }
 
@@ -1129,17 +1309,31 @@ bool HostResourceRequiresUpdate(resource_key_t key, xbox::X_D3DResource* pXboxRe
 		return true;
 	}
 
+	auto now = std::chrono::steady_clock::now();
+
+	// Resources under write tracking only need to be hashed after they've been written to
+	// (an invalid write watch always reports dirty, falling back to periodic hashing)
+	if (!it->second.forceRehash && !CxbxWriteTrackerIsDirty(it->second.writeWatch)
+		&& (now - it->second.lastHashTime) < TRACKED_RESOURCE_REHASH_INTERVAL) {
+		return false;
+	}
+
 	bool modified = false;
 
-	auto now = std::chrono::steady_clock::now();
 	if (now > it->second.nextHashTime || it->second.forceRehash) {
+		// Re-arm before hashing, so that writes that happen during hashing aren't missed
+		CxbxWriteTrackerRearm(it->second.writeWatch);
+
 		uint64_t oldHash = it->second.hash;
 		it->second.hash = ComputeHash(it->second.pXboxData, it->second.szXboxDataSize);
+		it->second.lastHashTime = now;
+		g_Cxbx_ResourceCacheHashedBytes += it->second.szXboxDataSize;
 
 		if (it->second.hash != oldHash) {
 			// The data changed, so reset the hash lifetime
 			it->second.hashLifeTime = 1ms;
             it->second.lastUpdate = now;
+			g_Cxbx_ResourceCacheModified++;
 			modified = true;
 		} else if (it->second.lastUpdate + 1000ms < now) {
 			// The data did not change, so increase the hash lifetime
@@ -1166,15 +1360,18 @@ void SetHostResource(xbox::X_D3DResource* pXboxResource, IDirect3DResource* pHos
 
 	if (resourceInfo.pHostResource) {
 		EmuLog(LOG_LEVEL::WARNING, "SetHostResource: Overwriting an existing host resource");
+		UntrackHostResource(resourceInfo);
 	}
 
 	resourceInfo.pHostResource = pHostResource;
 	resourceInfo.dwXboxResourceType = GetXboxCommonResourceType(pXboxResource);
 	resourceInfo.pXboxData = GetDataFromXboxResource(pXboxResource);
 	resourceInfo.szXboxDataSize = dwSize > 0 ? dwSize : GetXboxResourceSize(pXboxResource);
+	TrackHostResource(key, resourceInfo); // Arms write tracking, so must happen before hashing
 	resourceInfo.hash = ComputeHash(resourceInfo.pXboxData, resourceInfo.szXboxDataSize);
 	resourceInfo.hashLifeTime = 1ms;
 	resourceInfo.lastUpdate = std::chrono::steady_clock::now();
+	resourceInfo.lastHashTime = resourceInfo.lastUpdate;
 	resourceInfo.nextHashTime = resourceInfo.lastUpdate + resourceInfo.hashLifeTime;
 	resourceInfo.forceRehash = false;
 }
@@ -1709,6 +1906,9 @@ void EmuD3DInit()
 		std::cout << "Host D3DCaps : " << g_D3DCaps << "\n";
 		std::cout << "----------------------------------------\n";
 	}
+
+	// Start loading shaders compiled during earlier sessions
+	CxbxShaderCacheInit();
 }
 
 // cleanup Direct3D
@@ -2539,6 +2739,7 @@ static void EmuVerifyResourceIsRegistered(xbox::X_D3DResource *pResource, DWORD
             if (SUCCEEDED(hRet)) {
                 // If this resource is already created as a render target on the host, simply return
                 if (surfaceDesc.Usage & D3DUSAGE_RENDERTARGET) {
+                    g_Cxbx_ResourceCacheHits++;
                     return;
                 }
 
@@ -2579,6 +2780,7 @@ static void EmuVerifyResourceIsRegistered(xbox::X_D3DResource *pResource, DWORD
 		}
 
 		if (!HostResourceRequiresUpdate(key, pResource, dwSize)) {
+			g_Cxbx_ResourceCacheHits++;
 			return;
 		}
 
@@ -2588,6 +2790,7 @@ static void EmuVerifyResourceIsRegistered(xbox::X_D3DResource *pResource, DWORD
 		ResourceCache[key] = newResource;
 	}
 
+	g_Cxbx_ResourceCacheMisses++;
 	CreateHostResource(pResource, D3DUsage, iTextureStage, dwSize);
 }
 
@@ -2665,7 +2868,7 @@ INDEX16* CxbxCreateQuadListToTriangleListIndexData(INDEX16* pXboxQuadIndexData,
 {
 	UINT NrOfTriangleIndices = QuadToTriangleVertexCount(QuadVertexCount);
 	INDEX16* pQuadToTriangleIndexBuffer = (INDEX16*)malloc(NrOfTriangleIndices * sizeof(INDEX16));
-	CxbxConvertQuadListToTriangleListIndices(pXboxQuadIndexData, NrOfTriangleIndices, pQuadToTriangleIndexBuffer);
+	ConvertQuadListToTriangleList(pQuadToTriangleIndexBuffer, pXboxQuadIndexData, QuadVertexCount);
 	return pQuadToTriangleIndexBuffer;
 }
 
@@ -2675,10 +2878,74 @@ void CxbxReleaseQuadListToTriangleListIndexData(void* pHostIndexData)
 	free(pHostIndexData);
 }
 
+// Host index buffers are recycled per size class (a power of two number of indices), instead of being released
+static std::vector<IDirect3DIndexBuffer*> g_IndexBufferPool[32];
+static ULONG g_IndexBufferCacheHits = 0;
+static ULONG g_IndexBufferCacheMisses = 0;
+static ULONG g_IndexBufferCacheEvictions = 0;
+static ULONG g_IndexBufferPoolReuses = 0;
+static ULONG g_IndexBufferPoolCreates = 0;
+
+IDirect3DIndexBuffer* CxbxCreateIndexBuffer(unsigned IndexCount); // Forward declaration
+
+static UINT CxbxGetIndexBufferSizeClass(unsigned IndexCount)
+{
+	UINT SizeClass = INDEX_BUFFER_POOL_MIN_SIZE_CLASS;
+	while ((1u << SizeClass) < IndexCount) {
+		SizeClass++;
+	}
+
+	return SizeClass;
+}
+
+static IDirect3DIndexBuffer* CxbxAcquirePooledIndexBuffer(UINT SizeClass)
+{
+	auto& Pool = g_IndexBufferPool[SizeClass];
+	if (!Pool.empty()) {
+		IDirect3DIndexBuffer* Result = Pool.back();
+		Pool.pop_back();
+		g_IndexBufferPoolReuses++;
+		return Result;
+	}
+
+	g_IndexBufferPoolCreates++;
+	return CxbxCreateIndexBuffer(1u << SizeClass);
+}
+
+static void CxbxReleasePooledIndexBuffer(IDirect3DIndexBuffer* pHostIndexBuffer, UINT SizeClass)
+{
+	auto& Pool = g_IndexBufferPool[SizeClass];
+	if (Pool.size() < INDEX_BUFFER_POOL_MAX_FREE) {
+		Pool.push_back(pHostIndexBuffer);
+	} else {
+		pHostIndexBuffer->Release();
+	}
+}
+
+struct IndexBufferCacheKey {
+	uint32_t XboxIndexData; // Guest address
+	uint32_t XboxIndexCount;
+	uint32_t bConvertQuadListToTriangleList; // Not a bool, to avoid padding bytes being hashed
+
+	bool operator==(const IndexBufferCacheKey& rhs) const {
+		return XboxIndexData == rhs.XboxIndexData
+			&& XboxIndexCount == rhs.XboxIndexCount
+			&& bConvertQuadListToTriangleList == rhs.bConvertQuadListToTriangleList;
+	}
+};
+
+struct IndexBufferCacheKeyHash {
+	std::size_t operator()(const IndexBufferCacheKey& k) const {
+		return static_cast<std::size_t>(ComputeHash(&k, sizeof(k)));
+	}
+};
+
 class ConvertedIndexBuffer {
 public:
+	IndexBufferCacheKey Key = {};
 	uint64_t Hash = 0;
 	DWORD IndexCount = 0;
+	UINT SizeClass = 0;
 	IDirect3DIndexBuffer* pHostIndexBuffer = nullptr;
 	INDEX16 LowIndex = 0;
 	INDEX16 HighIndex = 0;
@@ -2686,12 +2953,24 @@ public:
 	~ConvertedIndexBuffer()
 	{
 		if (pHostIndexBuffer != nullptr) {
-			pHostIndexBuffer->Release();
+			CxbxReleasePooledIndexBuffer(pHostIndexBuffer, SizeClass);
 		}
 	}
 };
 
-	std::unordered_map<uint32_t, ConvertedIndexBuffer> g_IndexBufferCache;
+std::unordered_map<IndexBufferCacheKey, std::list<ConvertedIndexBuffer>::iterator, IndexBufferCacheKeyHash> g_IndexBufferCache; // Stores references to converted index buffers for fast lookup
+std::list<ConvertedIndexBuffer> g_IndexBufferCacheUsageList; // Least recently used is last in the list
+
+void CxbxDrawIndexBufferCacheStats()
+{
+	ImGui::Text("Cache Size: %u", g_IndexBufferCache.size());
+	ImGui::Text("Hits: %u", std::exchange(g_IndexBufferCacheHits, 0));
+	ImGui::Text("Misses: %u", std::exchange(g_IndexBufferCacheMisses, 0));
+	ImGui::Text("Evictions: %u", std::exchange(g_IndexBufferCacheEvictions, 0));
+	ImGui::Separator();
+	ImGui::Text("Pool reuses: %u", std::exchange(g_IndexBufferPoolReuses, 0));
+	ImGui::Text("Pool creates: %u", std::exchange(g_IndexBufferPoolCreates, 0));
+}
 
 void CxbxRemoveIndexBuffer(PWORD pData)
 {
@@ -2731,82 +3010,112 @@ IDirect3DIndexBuffer* CxbxCreateIndexBuffer(unsigned IndexCount)
 	return Result;
 }
 
+// Locks an entire host index buffer for repopulation
+static INDEX16* CxbxLockHostIndexBuffer(IDirect3DIndexBuffer* pHostIndexBuffer)
+{
+	LOG_INIT; // Allows use of DEBUG_D3DRESULT
+
+	INDEX16* pHostIndexBufferData = nullptr;
+	HRESULT hRet = pHostIndexBuffer->Lock(0, /*entire SizeToLock=*/0, (D3DLockData **)&pHostIndexBufferData, D3DLOCK_DISCARD);
+	DEBUG_D3DRESULT(hRet, "pHostIndexBuffer->Lock");
+	if (pHostIndexBufferData == nullptr) {
+		CxbxrKrnlAbort("CxbxUpdateActiveIndexBuffer: Could not lock index buffer!");
+	}
+
+	return pHostIndexBufferData;
+}
+
 ConvertedIndexBuffer& CxbxUpdateActiveIndexBuffer
 (
 	INDEX16* pXboxIndexData,
+	INDEX16* pXboxIndexDataKey, // Guest address to cache under, when pXboxIndexData points to a copy (may be nullptr)
 	unsigned XboxIndexCount,
 	bool bConvertQuadListToTriangleList
 )
 {
 	LOG_INIT; // Allows use of DEBUG_D3DRESULT
 
-	uint32_t LookupKey = (uint32_t)pXboxIndexData;
+	IndexBufferCacheKey LookupKey = { (uint32_t)(pXboxIndexDataKey ? pXboxIndexDataKey : pXboxIndexData), XboxIndexCount, bConvertQuadListToTriangleList };
 	unsigned RequiredIndexCount = XboxIndexCount;
 
 	if (bConvertQuadListToTriangleList) {
 		LOG_TEST_CASE("bConvertQuadListToTriangleList");
 		RequiredIndexCount = QuadToTriangleVertexCount(XboxIndexCount);
-		// For now, indicate the quad-to-triangles case using the otherwise
-		// (due to alignment) always-zero least significant bit :
-		LookupKey |= 1;
 	}
 
-	// Poor-mans eviction policy : when exceeding treshold, clear entire cache :
-	if (g_IndexBufferCache.size() > INDEX_BUFFER_CACHE_SIZE) {
-		g_IndexBufferCache.clear(); // Note : ConvertedIndexBuffer destructor will release any assigned pHostIndexBuffer
+	// Look up the converted index buffer, marking it as most recently used
+	ConvertedIndexBuffer* pCacheEntry;
+	auto it = g_IndexBufferCache.find(LookupKey);
+	if (it != g_IndexBufferCache.end()) {
+		g_IndexBufferCacheUsageList.splice(g_IndexBufferCacheUsageList.begin(), g_IndexBufferCacheUsageList, it->second);
+		pCacheEntry = &*it->second;
+	} else {
+		g_IndexBufferCacheUsageList.push_front({});
+		pCacheEntry = &g_IndexBufferCacheUsageList.front();
+		pCacheEntry->Key = LookupKey;
+		g_IndexBufferCache[LookupKey] = g_IndexBufferCacheUsageList.begin();
+
+		// If the cache has exceeded it's upper bound, discard the oldest entries in the cache
+		// Note : ConvertedIndexBuffer destructor will return any assigned pHostIndexBuffer to the pool
+		if (g_IndexBufferCache.size() > (INDEX_BUFFER_CACHE_SIZE + INDEX_BUFFER_CACHE_ELASTICITY)) {
+			while (g_IndexBufferCache.size() > INDEX_BUFFER_CACHE_SIZE) {
+				g_IndexBufferCache.erase(g_IndexBufferCacheUsageList.back().Key);
+				g_IndexBufferCacheUsageList.pop_back();
+				g_IndexBufferCacheEvictions++;
+			}
+		}
 	}
 
-	// Create a reference to the active buffer
-	ConvertedIndexBuffer& CacheEntry = g_IndexBufferCache[LookupKey];
-
-	// If the current index buffer size is too small, free it, so it'll get re-created
-	bool bNeedRepopulation = CacheEntry.IndexCount < RequiredIndexCount;
-	if (bNeedRepopulation) {
-		if (CacheEntry.pHostIndexBuffer != nullptr)
-			CacheEntry.pHostIndexBuffer->Release();
-
-		CacheEntry = {};
-	}
+	ConvertedIndexBuffer& CacheEntry = *pCacheEntry;
 
-	// If we need to create an index buffer, do so.
+	// If we need to create an index buffer, take one from the pool
+	bool bNeedRepopulation = false;
 	if (CacheEntry.pHostIndexBuffer == nullptr) {
-		CacheEntry.pHostIndexBuffer = CxbxCreateIndexBuffer(RequiredIndexCount);
+		CacheEntry.SizeClass = CxbxGetIndexBufferSizeClass(RequiredIndexCount);
+		CacheEntry.pHostIndexBuffer = CxbxAcquirePooledIndexBuffer(CacheEntry.SizeClass);
 		if (!CacheEntry.pHostIndexBuffer)
 			CxbxrKrnlAbort("CxbxUpdateActiveIndexBuffer: IndexBuffer Create Failed!");
-	}
 
-	// TODO : Speeds this up, perhaps by hashing less often, and/or by
-	// doing two hashes : a small subset regularly, all data less frequently.
-	uint64_t uiHash = ComputeHash(pXboxIndexData, XboxIndexCount * sizeof(INDEX16));
-
-	// If the data needs updating, do so
-	bNeedRepopulation |= (uiHash != CacheEntry.Hash);
-	if (bNeedRepopulation)	{
-		// Update the Index Count and the hash
 		CacheEntry.IndexCount = RequiredIndexCount;
-		CacheEntry.Hash = uiHash;
+		bNeedRepopulation = true;
+	}
 
-		// Update the host index buffer
-		INDEX16* pHostIndexBufferData = nullptr;
-		HRESULT hRet = CacheEntry.pHostIndexBuffer->Lock(0, /*entire SizeToLock=*/0, (D3DLockData **)&pHostIndexBufferData, D3DLOCK_DISCARD);
-		DEBUG_D3DRESULT(hRet, "CacheEntry.pHostIndexBuffer->Lock");
-		if (pHostIndexBufferData == nullptr) {
-			CxbxrKrnlAbort("CxbxUpdateActiveIndexBuffer: Could not lock index buffer!");
-		}
+	// On a cache hit, the stored index range stays valid as long as the index data is unchanged,
+	// so only hash the index data, without walking it for its highest and lowest index
+	INDEX16 LowIndex, HighIndex;
+	uint64_t uiHash;
+	if (!bNeedRepopulation) {
+		uiHash = HashIndexBuffer(pXboxIndexData, XboxIndexCount);
+		bNeedRepopulation = (uiHash != CacheEntry.Hash);
+	}
 
-		// Determine highest and lowest index in use :
-		WalkIndexBuffer(CacheEntry.LowIndex, CacheEntry.HighIndex, pXboxIndexData, XboxIndexCount);
+	if (bNeedRepopulation) {
+		// Determine highest and lowest index in use, hashing the index data in the same pass,
+		// which also copies (or converts) the index data into the locked host index buffer.
+		// Note, that LowIndex and HighIndex won't change due to any quad-to-triangle conversion,
+		// so it's less work to walk over the input instead of the converted index buffer.
+		INDEX16* pHostIndexBufferData = CxbxLockHostIndexBuffer(CacheEntry.pHostIndexBuffer);
 		if (bConvertQuadListToTriangleList) {
-			// Note, that LowIndex and HighIndex won't change due to any quad-to-triangle conversion,
-			// so it's less work to WalkIndexBuffer over the input instead of the converted index buffer.
 			EmuLog(LOG_LEVEL::DEBUG, "CxbxUpdateActiveIndexBuffer: Converting quads to %d triangle indices (D3DFMT_INDEX16)", RequiredIndexCount);
-			CxbxConvertQuadListToTriangleListIndices(pXboxIndexData, RequiredIndexCount, pHostIndexBufferData);
 		} else {
 			EmuLog(LOG_LEVEL::DEBUG, "CxbxUpdateActiveIndexBuffer: Copying %d indices (D3DFMT_INDEX16)", XboxIndexCount);
-			memcpy(pHostIndexBufferData, pXboxIndexData, XboxIndexCount * sizeof(INDEX16));
 		}
 
+		WalkIndexBufferAndHash(LowIndex, HighIndex, uiHash, pXboxIndexData, XboxIndexCount, pHostIndexBufferData, bConvertQuadListToTriangleList);
+	}
+
+	// If the data needed updating, finish doing so
+	if (bNeedRepopulation)	{
+		g_IndexBufferCacheMisses++;
+
+		// Update the hash and index range
+		CacheEntry.Hash = uiHash;
+		CacheEntry.LowIndex = LowIndex;
+		CacheEntry.HighIndex = HighIndex;
+
 		CacheEntry.pHostIndexBuffer->Unlock();
+	} else {
+		g_IndexBufferCacheHits++;
 	}
 
 	// Activate the new native index buffer :
@@ -3392,6 +3701,8 @@ xbox::hresult_xt WINAPI xbox::EMUPATCH(D3DDevice_Reset)
 {
 	LOG_FUNC_ONE_ARG(pPresentationParameters)
 
+	CxbxFlushPendingDraws();
+
 	// Unlike the host version of Reset, The Xbox version does not actually reset the entire device
 	// Instead, it simply re-creates the backbuffer with a new configuration
 
@@ -3518,6 +3829,7 @@ xbox::void_xt WINAPI xbox::EMUPATCH(D3DDevice_EndPush)(dword_xt *pPush)
 	{
         // Note: We don't use the count from BeginPush because that specifies the *maximum* count
         // rather than the count actually in the pushbuffer. 
+		CxbxFlushPendingDraws();
 		EmuExecutePushBufferRaw(g_pXbox_BeginPush_Buffer, (uintptr_t)pPush - (uintptr_t)g_pXbox_BeginPush_Buffer);
 
 		delete[] g_pXbox_BeginPush_Buffer;
@@ -3532,6 +3844,9 @@ xbox::hresult_xt WINAPI xbox::EMUPATCH(D3DDevice_BeginVisibilityTest)()
 {
 	LOG_FUNC();
 
+	// Draws held back before the visibility test must not be counted by it
+	CxbxFlushPendingDraws();
+
 	if (g_bEnableHostQueryVisibilityTest) {
 		// Create a D3D occlusion query to handle "visibility test" with
 		IDirect3DQuery* pHostQueryVisibilityTest = nullptr;
@@ -3587,6 +3902,9 @@ xbox::hresult_xt WINAPI xbox::EMUPATCH(D3DDevice_EndVisibilityTest)
 {
 	LOG_FUNC_ONE_ARG(Index);
 
+	// The visibility test must include the held back draws
+	CxbxFlushPendingDraws();
+
 	if (g_bEnableHostQueryVisibilityTest) {
 		// Check that the dedicated storage for the given Index isn't in use
 		if (g_HostVisibilityTestMap[Index] != nullptr) {
@@ -4348,6 +4666,8 @@ void CxbxImpl_SetViewport(xbox::X_D3DVIEWPORT8* pViewport)
 {
 	LOG_INIT;
 
+	CxbxFlushPendingDraws();
+
 	// Unclear what to do when no viewport is passed
 	// Set the default viewport?
 	// Clamp the current viewport to the current rendertarget?
@@ -4411,6 +4731,7 @@ xbox::void_xt WINAPI xbox::EMUPATCH(D3DDevice_SetShaderConstantMode)
 {
 	LOG_FUNC_ONE_ARG(Mode);
 
+    CxbxFlushPendingDraws();
     g_Xbox_VertexShaderConstantMode = Mode;
 }
 
@@ -4583,6 +4904,7 @@ __declspec(naked) xbox::void_xt WINAPI xbox::EMUPATCH(D3DDevice_SetTexture_4__LT
         call XB_TRMP(D3DDevice_SetTexture_4__LTCG_eax_pTexture)
     }
 
+    CxbxFlushPendingDraws();
     g_pXbox_SetTexture[Stage] = pTexture;
 
     __asm {
@@ -4628,6 +4950,7 @@ __declspec(naked) xbox::void_xt WINAPI xbox::EMUPATCH(D3DDevice_SetTexture_4)
         call XB_TRMP(D3DDevice_SetTexture_4)
     }
 
+    CxbxFlushPendingDraws();
     g_pXbox_SetTexture[Stage] = pTexture;
 
     __asm {
@@ -4653,6 +4976,7 @@ xbox::void_xt WINAPI xbox::EMUPATCH(D3DDevice_SetTexture)
 	// Call the Xbox implementation of this function, to properly handle reference counting for us
 	XB_TRMP(D3DDevice_SetTexture)(Stage, pTexture);
 
+	CxbxFlushPendingDraws();
 	g_pXbox_SetTexture[Stage] = pTexture;
 }
 
@@ -4686,6 +5010,8 @@ xbox::void_xt __fastcall xbox::EMUPATCH(D3DDevice_SwitchTexture)
 	}
 
     if (Stage >= 0) {
+		CxbxFlushPendingDraws();
+
 		// Switch Texture updates the data pointer of an active texture using pushbuffer commands
 		if (g_pXbox_SetTexture[Stage] == xbox::zeroptr) {
 			LOG_TEST_CASE("D3DDevice_SwitchTexture without an active texture");
@@ -4737,7 +5063,10 @@ xbox::void_xt WINAPI xbox::EMUPATCH(D3DDevice_Begin)
     X_D3DPRIMITIVETYPE     PrimitiveType
 )
 {
-	LOG_FUNC_ONE_ARG(PrimitiveType);
+	// Immediate mode is called for each vertex attribute, so skip even the logging setup when it's disabled
+	LOG_CHECK_ENABLED(LOG_LEVEL::DEBUG) {
+		LOG_FUNC_ONE_ARG(PrimitiveType);
+	}
 
 	CxbxImpl_Begin(PrimitiveType);
 }
@@ -4752,11 +5081,13 @@ xbox::void_xt WINAPI xbox::EMUPATCH(D3DDevice_SetVertexData2f)
     float_xt   b
 )
 {
-	LOG_FUNC_BEGIN
-		LOG_FUNC_ARG(Register)
-		LOG_FUNC_ARG(a)
-		LOG_FUNC_ARG(b)
-		LOG_FUNC_END;
+	LOG_CHECK_ENABLED(LOG_LEVEL::DEBUG) {
+		LOG_FUNC_BEGIN
+			LOG_FUNC_ARG(Register)
+			LOG_FUNC_ARG(a)
+			LOG_FUNC_ARG(b)
+			LOG_FUNC_END;
+	}
 
 	CxbxImpl_SetVertexData4f(Register, a, b, 0.0f, 1.0f);
 }
@@ -4774,11 +5105,13 @@ xbox::void_xt WINAPI xbox::EMUPATCH(D3DDevice_SetVertexData2s)
     short_xt b
 )
 {
-	LOG_FUNC_BEGIN
-		LOG_FUNC_ARG(Register)
-		LOG_FUNC_ARG(a)
-		LOG_FUNC_ARG(b)
-		LOG_FUNC_END;
+	LOG_CHECK_ENABLED(LOG_LEVEL::DEBUG) {
+		LOG_FUNC_BEGIN
+			LOG_FUNC_ARG(Register)
+			LOG_FUNC_ARG(a)
+			LOG_FUNC_ARG(b)
+			LOG_FUNC_END;
+	}
 
 	// Test case: Halo
 	// Note : XQEMU verified that the int16_t arguments
@@ -4805,13 +5138,15 @@ static void D3DDevice_SetVertexData4f_16
     xbox::float_xt   d
 )
 {
-	LOG_FUNC_BEGIN
-		LOG_FUNC_ARG(Register)
-		LOG_FUNC_ARG(a)
-		LOG_FUNC_ARG(b)
-		LOG_FUNC_ARG(c)
-		LOG_FUNC_ARG(d)
-		LOG_FUNC_END;
+	LOG_CHECK_ENABLED(LOG_LEVEL::DEBUG) {
+		LOG_FUNC_BEGIN
+			LOG_FUNC_ARG(Register)
+			LOG_FUNC_ARG(a)
+			LOG_FUNC_ARG(b)
+			LOG_FUNC_ARG(c)
+			LOG_FUNC_ARG(d)
+			LOG_FUNC_END;
+	}
 }
 
 // ******************************************************************
@@ -4856,13 +5191,15 @@ xbox::void_xt WINAPI xbox::EMUPATCH(D3DDevice_SetVertexData4f)
     float_xt   d
 )
 {
-	LOG_FUNC_BEGIN
-		LOG_FUNC_ARG(Register)
-		LOG_FUNC_ARG(a)
-		LOG_FUNC_ARG(b)
-		LOG_FUNC_ARG(c)
-		LOG_FUNC_ARG(d)
-		LOG_FUNC_END;
+	LOG_CHECK_ENABLED(LOG_LEVEL::DEBUG) {
+		LOG_FUNC_BEGIN
+			LOG_FUNC_ARG(Register)
+			LOG_FUNC_ARG(a)
+			LOG_FUNC_ARG(b)
+			LOG_FUNC_ARG(c)
+			LOG_FUNC_ARG(d)
+			LOG_FUNC_END;
+	}
 
 	CxbxImpl_SetVertexData4f(Register, a, b, c, d);
 }
@@ -4879,13 +5216,15 @@ xbox::void_xt WINAPI xbox::EMUPATCH(D3DDevice_SetVertexData4ub)
 	byte_xt	d
 )
 {
-	LOG_FUNC_BEGIN
-		LOG_FUNC_ARG(Register)
-		LOG_FUNC_ARG(a)
-		LOG_FUNC_ARG(b)
-		LOG_FUNC_ARG(c)
-		LOG_FUNC_ARG(d)
-		LOG_FUNC_END;
+	LOG_CHECK_ENABLED(LOG_LEVEL::DEBUG) {
+		LOG_FUNC_BEGIN
+			LOG_FUNC_ARG(Register)
+			LOG_FUNC_ARG(a)
+			LOG_FUNC_ARG(b)
+			LOG_FUNC_ARG(c)
+			LOG_FUNC_ARG(d)
+			LOG_FUNC_END;
+	}
 
 	const float fa = a / 255.0f;
 	const float fb = b / 255.0f;
@@ -4907,13 +5246,15 @@ xbox::void_xt WINAPI xbox::EMUPATCH(D3DDevice_SetVertexData4s)
 	short_xt d
 )
 {
-	LOG_FUNC_BEGIN
-		LOG_FUNC_ARG(Register)
-		LOG_FUNC_ARG(a)
-		LOG_FUNC_ARG(b)
-		LOG_FUNC_ARG(c)
-		LOG_FUNC_ARG(d)
-		LOG_FUNC_END;
+	LOG_CHECK_ENABLED(LOG_LEVEL::DEBUG) {
+		LOG_FUNC_BEGIN
+			LOG_FUNC_ARG(Register)
+			LOG_FUNC_ARG(a)
+			LOG_FUNC_ARG(b)
+			LOG_FUNC_ARG(c)
+			LOG_FUNC_ARG(d)
+			LOG_FUNC_END;
+	}
 
 	// Test case: Halo
 	// Note : XQEMU verified that the int16_t arguments
@@ -4936,10 +5277,12 @@ xbox::void_xt WINAPI xbox::EMUPATCH(D3DDevice_SetVertexDataColor)
     D3DCOLOR    Color
 )
 {
-	LOG_FUNC_BEGIN
-		LOG_FUNC_ARG(Register)
-		LOG_FUNC_ARG(Color)
-		LOG_FUNC_END;
+	LOG_CHECK_ENABLED(LOG_LEVEL::DEBUG) {
+		LOG_FUNC_BEGIN
+			LOG_FUNC_ARG(Register)
+			LOG_FUNC_ARG(Color)
+			LOG_FUNC_END;
+	}
 
     const D3DXCOLOR XColor = Color;
 
@@ -4951,7 +5294,9 @@ xbox::void_xt WINAPI xbox::EMUPATCH(D3DDevice_SetVertexDataColor)
 // ******************************************************************
 xbox::void_xt WINAPI xbox::EMUPATCH(D3DDevice_End)()
 {
-	LOG_FUNC();
+	LOG_CHECK_ENABLED(LOG_LEVEL::DEBUG) {
+		LOG_FUNC();
+	}
 
 	CxbxImpl_End();
 }
@@ -4970,6 +5315,7 @@ xbox::void_xt WINAPI xbox::EMUPATCH(D3DDevice_RunPushBuffer)
 		LOG_FUNC_ARG(pFixup)
 		LOG_FUNC_END;
 
+	CxbxFlushPendingDraws();
 	EmuExecutePushBuffer(pPushBuffer, pFixup);    
 }
 
@@ -5078,6 +5424,8 @@ xbox::void_xt WINAPI xbox::EMUPATCH(D3DDevice_CopyRects)
         LOG_FUNC_ARG(pDestPointsArray);
     LOG_FUNC_END;
 
+    CxbxFlushPendingDraws();
+
     // We skip the trampoline to prevent unnecessary work
     // As our surfaces remain on the GPU, calling the trampoline would just
     // result in a memcpy from an empty Xbox surface to another empty Xbox Surface
@@ -5228,6 +5576,8 @@ xbox::dword_xt WINAPI xbox::EMUPATCH(D3DDevice_Swap)
 {
 	LOG_FUNC_ONE_ARG(Flags);
 
+	CxbxFlushPendingDraws();
+
 	// Handle swap flags
 	// We don't maintain a swap chain, and draw everything to backbuffer 0
 	// so just hack around the swap flags for now...
@@ -5611,6 +5961,9 @@ bool IsSupportedFormat(xbox::X_D3DFORMAT X_Format, xbox::X_D3DRESOURCETYPE XboxR
 	return pbSupportedFormats[X_Format];
 }
 
+// Textures with less data than this are converted on the calling thread
+static constexpr DWORD MIN_PARALLEL_TEXTURE_CONVERSION_BYTES = 256 * ONE_KB;
+
 // Was patch: IDirect3DResource8_Register
 void CreateHostResource(xbox::X_D3DResource *pResource, DWORD D3DUsage, int iTextureStage, DWORD dwSize)
 {
@@ -6073,6 +6426,23 @@ void CreateHostResource(xbox::X_D3DResource *pResource, DWORD D3DUsage, int iTex
 			blockSize = X_Format == xbox::X_D3DFMT_DXT1 ? 8 : 16;
 		}
 
+		// In case where there is a palettized texture without a palette attached,
+		// its levels are filled with zeroes (see below)
+		bool missingPalette = bConvertToARGB && X_Format == xbox::X_D3DFMT_P8 && g_pXbox_Palette_Data[iTextureStage] == nullptr;
+		if (missingPalette) {
+			LOG_TEST_CASE("Palettized texture bound without a palette");
+		}
+
+		// All levels and faces stay locked until their conversion jobs are done
+		struct LockedLevel {
+			D3DCUBEMAP_FACES face;
+			unsigned int mipmap_level;
+		};
+		std::vector<LockedLevel> LockedLevels;
+		std::vector<TextureConversionJob> ConversionJobs;
+		DWORD dwConversionBytes = 0;
+		std::atomic_bool bConversionFailed = false;
+
 		for (int face = D3DCUBEMAP_FACE_POSITIVE_X; face <= last_face; face++) {
 			// As we iterate through mipmap levels, we'll adjust the source resource offset
 			DWORD dwMipOffset = 0;
@@ -6152,78 +6522,57 @@ void CreateHostResource(xbox::X_D3DResource *pResource, DWORD D3DUsage, int iTex
 				// Copy texture data to the host resource
 				if (bConvertToARGB) {
 					EmuLog(LOG_LEVEL::DEBUG, "Unsupported texture format, expanding to D3DFMT_A8R8G8B8");
+				}
 
-					// In case where there is a palettized texture without a palette attached,
-					// fill it with zeroes for now. This might not be correct, but it prevents a crash.
-					// Test case: DRIV3R
-					bool missingPalette = X_Format == xbox::X_D3DFMT_P8 && g_pXbox_Palette_Data[iTextureStage] == nullptr;
-					if (missingPalette) {
-						LOG_TEST_CASE("Palettized texture bound without a palette");
-
-						memset(pDst, 0, dwDstRowPitch * pxMipHeight);
-					}
-					else {
-						// Try to convert to ARGB
-						if (!ConvertD3DTextureToARGBBuffer(
-							X_Format,
-							pSrc, pxMipWidth, pxMipHeight, dwMipRowPitch, mip2dSize,
-							pDst, dwDstRowPitch, dwDstSlicePitch,
-							pxMipDepth,//used pxMipDepth here because in 3D mip map the 3rd dimension also shrinked to 1/2 at each mip level.
-							iTextureStage)) {
-							CxbxrKrnlAbort("Unhandled conversion!");
+				// Queue the copy, so that all levels and faces can be converted at once (see below)
+				LockedLevels.push_back({ (D3DCUBEMAP_FACES)face, mipmap_level });
+				ConversionJobs.push_back([=, &bConversionFailed]() mutable {
+					if (bConvertToARGB) {
+						// In case where there is a palettized texture without a palette attached,
+						// fill it with zeroes for now. This might not be correct, but it prevents a crash.
+						// Test case: DRIV3R
+						if (missingPalette) {
+							memset(pDst, 0, dwDstRowPitch * pxMipHeight);
+						}
+						else {
+							// Try to convert to ARGB
+							if (!ConvertD3DTextureToARGBBuffer(
+								X_Format,
+								pSrc, pxMipWidth, pxMipHeight, dwMipRowPitch, mip2dSize,
+								pDst, dwDstRowPitch, dwDstSlicePitch,
+								pxMipDepth,//used pxMipDepth here because in 3D mip map the 3rd dimension also shrinked to 1/2 at each mip level.
+								iTextureStage)) {
+								bConversionFailed = true;
+							}
 						}
 					}
-				}
-				else if (bSwizzled) {
-					// Unswizzle the texture data into the host texture
-					EmuUnswizzleBox(
-						pSrc, pxMipWidth, pxMipHeight, pxMipDepth,
-						dwBPP, 
-						pDst, dwDstRowPitch, dwDstSlicePitch
-					);
-				}
-				else if (bCompressed) {
-					memcpy(pDst, pSrc, mip2dSize);
-				}
-				else {
-					if (dwDstRowPitch == dwMipRowPitch) {
-						// Source and destination layout match - simple copy
+					else if (bSwizzled) {
+						// Unswizzle the texture data into the host texture
+						EmuUnswizzleBox(
+							pSrc, pxMipWidth, pxMipHeight, pxMipDepth,
+							dwBPP,
+							pDst, dwDstRowPitch, dwDstSlicePitch
+						);
+					}
+					else if (bCompressed) {
 						memcpy(pDst, pSrc, mip2dSize);
 					}
 					else {
-						// Copy accounting for different row pitch
-						for (DWORD v = 0; v < pxMipHeight; v++) {
-							memcpy(pDst, pSrc, pxMipWidth * dwBPP);
-							pDst += dwDstRowPitch;
-							pSrc += dwMipRowPitch;
+						if (dwDstRowPitch == dwMipRowPitch) {
+							// Source and destination layout match - simple copy
+							memcpy(pDst, pSrc, mip2dSize);
+						}
+						else {
+							// Copy accounting for different row pitch
+							for (DWORD v = 0; v < pxMipHeight; v++) {
+								memcpy(pDst, pSrc, pxMipWidth * dwBPP);
+								pDst += dwDstRowPitch;
+								pSrc += dwMipRowPitch;
+							}
 						}
 					}
-				}
-
-				// Unlock the host resource
-				switch (XboxResourceType) {
-				case xbox::X_D3DRTYPE_SURFACE:
-					hRet = pNewHostSurface->UnlockRect();
-					break;
-				case xbox::X_D3DRTYPE_VOLUME:
-					hRet = pNewHostVolume->UnlockBox();
-					break;
-				case xbox::X_D3DRTYPE_TEXTURE:
-					hRet = pIntermediateHostTexture->UnlockRect(mipmap_level);
-					break;
-				case xbox::X_D3DRTYPE_VOLUMETEXTURE:
-					hRet = pIntermediateHostVolumeTexture->UnlockBox(mipmap_level);
-					break;
-				case xbox::X_D3DRTYPE_CUBETEXTURE:
-					hRet = pIntermediateHostCubeTexture->UnlockRect((D3DCUBEMAP_FACES)face, mipmap_level);
-					break;
-				default:
-					assert(false);
-				}
-
-				if (hRet != D3D_OK) {
-					EmuLog(LOG_LEVEL::WARNING, "Unlocking host %s failed!", ResourceTypeName);
-				}
+				});
+				dwConversionBytes += mipSlicePitch;
 
 				// Calculate the next mipmap level dimensions
 				dwMipOffset += mipSlicePitch;
@@ -6251,6 +6600,41 @@ void CreateHostResource(xbox::X_D3DResource *pResource, DWORD D3DUsage, int iTex
 			dwCubeFaceOffset += dwSlicePitch;
 		} // for cube faces
 
+		// Unswizzle and/or convert all levels and faces into the locked host resource.
+		// Only large textures are spread over the conversion threads; For small ones,
+		// handing out the work costs more than it saves
+		g_TextureConverter.Run(ConversionJobs, dwConversionBytes >= MIN_PARALLEL_TEXTURE_CONVERSION_BYTES);
+		if (bConversionFailed) {
+			CxbxrKrnlAbort("Unhandled conversion!");
+		}
+
+		for (auto &LockedLevel : LockedLevels) {
+			// Unlock the host resource
+			switch (XboxResourceType) {
+			case xbox::X_D3DRTYPE_SURFACE:
+				hRet = pNewHostSurface->UnlockRect();
+				break;
+			case xbox::X_D3DRTYPE_VOLUME:
+				hRet = pNewHostVolume->UnlockBox();
+				break;
+			case xbox::X_D3DRTYPE_TEXTURE:
+				hRet = pIntermediateHostTexture->UnlockRect(LockedLevel.mipmap_level);
+				break;
+			case xbox::X_D3DRTYPE_VOLUMETEXTURE:
+				hRet = pIntermediateHostVolumeTexture->UnlockBox(LockedLevel.mipmap_level);
+				break;
+			case xbox::X_D3DRTYPE_CUBETEXTURE:
+				hRet = pIntermediateHostCubeTexture->UnlockRect(LockedLevel.face, LockedLevel.mipmap_level);
+				break;
+			default:
+				assert(false);
+			}
+
+			if (hRet != D3D_OK) {
+				EmuLog(LOG_LEVEL::WARNING, "Unlocking host %s failed!", ResourceTypeName);
+			}
+		}
+
 
         // Copy from the intermediate resource to the final host resource
         // This is necessary because CopyRects/StretchRects only works on resources in the DEFAULT pool
@@ -6428,7 +6812,55 @@ void UpdateFixedFunctionShaderLight(int d3dLightIndex, Light* pShaderLight, D3DX
 	pShaderLight->SpotIntensityDivisor = cos(d3dLight->Theta / 2) - cos(d3dLight->Phi / 2);
 }
 
-void UpdateFixedFunctionVertexShaderState()
+// Writes the fixed function state registers that differ from what was last written to the host
+// (or all of them with bUploadAll, when the host registers were overwritten in the meantime)
+void CxbxUpdateDirtyFixedFunctionConstants(bool bUploadAll)
+{
+	const int slotSize = 16;
+	const int fixedFunctionStateSize = (sizeof(FixedFunctionVertexShaderState) + slotSize - 1) / slotSize;
+	// Including a few unchanged registers in a batch is cheaper than an additional call to D3D9
+	const int maxBatchGap = 4;
+
+	static FixedFunctionVertexShaderState ffHostShaderState = {0};
+	auto pState = (const uint8_t*)&ffShaderState;
+	auto pHostState = (uint8_t*)&ffHostShaderState;
+
+	auto writeBatch = [&](int start, int end) {
+		memcpy(&pHostState[start * slotSize], &pState[start * slotSize], (end - start) * slotSize);
+		auto hRet = g_pD3DDevice->SetVertexShaderConstantF(start, (const float*)&pState[start * slotSize], end - start);
+		if (FAILED(hRet)) {
+			CxbxrKrnlAbort("Failed to write fixed-function HLSL state");
+		}
+	};
+
+	// Reduce the number of calls to D3D9 by updating "batches" of changed registers
+	int batchStartIndex = -1; // -1 means we aren't in a batch
+	int batchEndIndex = -1;
+
+	for (int i = 0; i < fixedFunctionStateSize; i++) {
+		if (!bUploadAll && memcmp(&pState[i * slotSize], &pHostState[i * slotSize], slotSize) == 0) {
+			continue;
+		}
+
+		if (batchStartIndex != -1 && i - batchEndIndex > maxBatchGap) {
+			writeBatch(batchStartIndex, batchEndIndex);
+			batchStartIndex = -1;
+		}
+
+		if (batchStartIndex == -1) {
+			batchStartIndex = i; // Start a batch
+		}
+
+		batchEndIndex = i + 1;
+	}
+
+	// Send the final batch
+	if (batchStartIndex != -1) {
+		writeBatch(batchStartIndex, batchEndIndex);
+	}
+}
+
+void UpdateFixedFunctionVertexShaderState(bool bUploadAll)
 {
 	extern xbox::X_VERTEXATTRIBUTEFORMAT* GetXboxVertexAttributeFormat(); // TMP glue
 	using namespace xbox;
@@ -6456,19 +6888,35 @@ void UpdateFixedFunctionVertexShaderState()
 	ffShaderState.Modes.VertexBlend_CalcLastWeight = (float)CalcLastBlendWeight;
 
 	// Transforms
+	// Only the transforms that were set since the previous update need to be redone
 	// Transpose row major to column major for HLSL
-	D3DXMatrixTranspose((D3DXMATRIX*)&ffShaderState.Transforms.Projection, (D3DXMATRIX*)&d3d8TransformState.Transforms[X_D3DTS_PROJECTION]);
-	D3DXMatrixTranspose((D3DXMATRIX*)&ffShaderState.Transforms.View, (D3DXMATRIX*)&d3d8TransformState.Transforms[X_D3DTS_VIEW]);
+	static unsigned PreviousNrBlendMatrices = 0;
+	auto DirtyTransforms = std::exchange(d3d8TransformState.DirtyTransforms, 0);
+	bool ViewChanged = DirtyTransforms & (1 << X_D3DTS_VIEW);
+	if (DirtyTransforms & (1 << X_D3DTS_PROJECTION)) {
+		D3DXMatrixTranspose((D3DXMATRIX*)&ffShaderState.Transforms.Projection, (D3DXMATRIX*)&d3d8TransformState.Transforms[X_D3DTS_PROJECTION]);
+	}
+
+	if (ViewChanged) {
+		D3DXMatrixTranspose((D3DXMATRIX*)&ffShaderState.Transforms.View, (D3DXMATRIX*)&d3d8TransformState.Transforms[X_D3DTS_VIEW]);
+	}
 
 	for (unsigned i = 0; i < 4; i++) { // TODO : Would it help to limit this to just the active texture channels?
-		D3DXMatrixTranspose((D3DXMATRIX*)&ffShaderState.Transforms.Texture[i], (D3DXMATRIX*)&d3d8TransformState.Transforms[X_D3DTS_TEXTURE0 + i]);
+		if (DirtyTransforms & (1 << (X_D3DTS_TEXTURE0 + i))) {
+			D3DXMatrixTranspose((D3DXMATRIX*)&ffShaderState.Transforms.Texture[i], (D3DXMATRIX*)&d3d8TransformState.Transforms[X_D3DTS_TEXTURE0 + i]);
+		}
 	}
 
-	for (unsigned i = 0; i < ffShaderState.Modes.VertexBlend_NrOfMatrices; i++) {
-		D3DXMatrixTranspose((D3DXMATRIX*)&ffShaderState.Transforms.WorldView[i], (D3DXMATRIX*)d3d8TransformState.GetWorldView(i));
-		D3DXMatrixTranspose((D3DXMATRIX*)&ffShaderState.Transforms.WorldViewInverseTranspose[i], (D3DXMATRIX*)d3d8TransformState.GetWorldViewInverseTranspose(i));
+	// World matrices that weren't blended with last time may have been set in the meantime
+	for (unsigned i = 0; i < NrBlendMatrices; i++) {
+		if (ViewChanged || (DirtyTransforms & (1 << (X_D3DTS_WORLD + i))) || i >= PreviousNrBlendMatrices) {
+			D3DXMatrixTranspose((D3DXMATRIX*)&ffShaderState.Transforms.WorldView[i], (D3DXMATRIX*)d3d8TransformState.GetWorldView(i));
+			D3DXMatrixTranspose((D3DXMATRIX*)&ffShaderState.Transforms.WorldViewInverseTranspose[i], (D3DXMATRIX*)d3d8TransformState.GetWorldViewInverseTranspose(i));
+		}
 	}
 
+	PreviousNrBlendMatrices = NrBlendMatrices;
+
 	// Lighting
 	// Point sprites aren't lit - 'each point is always rendered with constant colors.'
 	// https://docs.microsoft.com/en-us/windows/win32/direct3d9/point-sprites
@@ -6578,9 +7026,18 @@ void UpdateFixedFunctionVertexShaderState()
 	}
 
 	// Update lights
-	auto LightAmbient = D3DXVECTOR4(0.f, 0.f, 0.f, 0.f);
-	for (size_t i = 0; i < ffShaderState.Lights.size(); i++) {
-		UpdateFixedFunctionShaderLight(d3d8LightState.EnabledLights[i], &ffShaderState.Lights[i], &LightAmbient);
+	// These are pre-transformed to viewspace, so also redo them when the view changed
+	static auto LightAmbient = D3DXVECTOR4(0.f, 0.f, 0.f, 0.f);
+	static bool PreviousSpecularEnable = false;
+	bool SpecularEnable = XboxRenderStates.GetXboxRenderState(X_D3DRS_SPECULARENABLE) != FALSE;
+	if (d3d8LightState.bLightsDirty || ViewChanged || SpecularEnable != PreviousSpecularEnable) {
+		LightAmbient = D3DXVECTOR4(0.f, 0.f, 0.f, 0.f);
+		for (size_t i = 0; i < ffShaderState.Lights.size(); i++) {
+			UpdateFixedFunctionShaderLight(d3d8LightState.EnabledLights[i], &ffShaderState.Lights[i], &LightAmbient);
+		}
+
+		d3d8LightState.bLightsDirty = false;
+		PreviousSpecularEnable = SpecularEnable;
 	}
 
 	D3DXVECTOR4 Ambient = toVector(XboxRenderStates.GetXboxRenderState(X_D3DRS_AMBIENT));
@@ -6593,13 +7050,7 @@ void UpdateFixedFunctionVertexShaderState()
 	ffShaderState.Modes.NormalizeNormals = (float)XboxRenderStates.GetXboxRenderState(X_D3DRS_NORMALIZENORMALS);
 
 	// Write fixed function state to shader constants
-	const int slotSize = 16;
-	const int fixedFunctionStateSize = (sizeof(FixedFunctionVertexShaderState) + slotSize - 1) / slotSize;
-	auto hRet = g_pD3DDevice->SetVertexShaderConstantF(0, (float*)&ffShaderState, fixedFunctionStateSize);
-
-	if (FAILED(hRet)) {
-		CxbxrKrnlAbort("Failed to write fixed-function HLSL state");
-	}
+	CxbxUpdateDirtyFixedFunctionConstants(bUploadAll);
 }
 
 // ******************************************************************
@@ -6744,6 +7195,8 @@ void CxbxImpl_SetTransform
 {
     LOG_INIT
 
+	CxbxFlushPendingDraws();
+
 	d3d8TransformState.SetTransform(State, pMatrix);
 
 	auto d3d9State = EmuXB2PC_D3DTS(State);
@@ -6876,6 +7329,9 @@ xbox::void_xt WINAPI xbox::EMUPATCH(Lock2DSurface)
 		LOG_FUNC_END;
 
 
+	// Held back draws must still see the surface contents as they are now
+	CxbxFlushPendingDraws();
+
 	// Pass through to the Xbox implementation of this function
 	XB_TRMP(Lock2DSurface)(pPixelContainer, FaceType, Level, pLockedRect, pRect, Flags);
 
@@ -6904,6 +7360,9 @@ xbox::void_xt WINAPI xbox::EMUPATCH(Lock3DSurface)
 		LOG_FUNC_ARG(Flags)
 		LOG_FUNC_END;
 
+	// Held back draws must still see the volume contents as they are now
+	CxbxFlushPendingDraws();
+
 	// Pass through to the Xbox implementation of this function
 	XB_TRMP(Lock3DSurface)(pPixelContainer, Level, pLockedVolume, pBox, Flags);
 
@@ -7326,8 +7785,12 @@ void CxbxDrawIndexed(CxbxDrawContext &DrawContext)
 	assert(DrawContext.pXboxIndexData != nullptr);
 	assert(DrawContext.dwVertexCount > 0); // TODO : If this fails, make responsible callers do an early-exit
 
+	if (g_bSkipDrawPendingVertexShader) {
+		return;
+	}
+
 	bool bConvertQuadListToTriangleList = (DrawContext.XboxPrimitiveType == xbox::X_D3DPT_QUADLIST);
-	ConvertedIndexBuffer& CacheEntry = CxbxUpdateActiveIndexBuffer(DrawContext.pXboxIndexData, DrawContext.dwVertexCount, bConvertQuadListToTriangleList);
+	ConvertedIndexBuffer& CacheEntry = CxbxUpdateActiveIndexBuffer(DrawContext.pXboxIndexData, DrawContext.pXboxIndexDataKey, DrawContext.dwVertexCount, bConvertQuadListToTriangleList);
 	// Note : CxbxUpdateActiveIndexBuffer calls SetIndices
 
 	// Set LowIndex and HighIndex *before* VerticesInBuffer gets derived
@@ -7386,6 +7849,106 @@ void CxbxDrawIndexed(CxbxDrawContext &DrawContext)
 	}
 }
 
+// TODO : Move to own file
+// Drawing function specifically for rendering Xbox draw calls from the active vertex buffers.
+// Called by D3DDevice_DrawVertices (via CxbxFlushMergedDraw)
+void CxbxDrawPrimitive(CxbxDrawContext &DrawContext)
+{
+	LOG_INIT // Allows use of DEBUG_D3DRESULT
+
+	assert(DrawContext.pXboxIndexData == nullptr);
+	assert(DrawContext.pXboxVertexStreamZeroData == xbox::zeroptr);
+
+	if (g_bSkipDrawPendingVertexShader) {
+		return;
+	}
+
+	const UINT StartVertex = DrawContext.dwStartVertex;
+
+	VertexBufferConverter.Apply(&DrawContext);
+	if (DrawContext.XboxPrimitiveType == xbox::X_D3DPT_QUADLIST) {
+		if (StartVertex == 0) {
+			//LOG_TEST_CASE("X_D3DPT_QUADLIST (StartVertex == 0)"); // disabled, hit too often
+			// test-case : ?X-Marbles
+			// test-case XDK Samples : AlphaFog, AntiAlias, BackBufferScale, BeginPush, Cartoon, TrueTypeFont (?maybe PlayField?)
+		} else {
+			LOG_TEST_CASE("X_D3DPT_QUADLIST (StartVertex > 0)");
+			// https://github.com/Cxbx-Reloaded/Cxbx-Reloaded/issues/1156
+			// test-case : All - Star Baseball '03
+			// test-case : Army Men Major Malfunction
+			// test-case : Big Mutha Truckers
+			// test-case : BLiNX: the time sweeper
+			// test-case : Blood Wake
+			// test-case : Call of Duty: Finest Hour
+			// test-case : Flight academy
+			// test-case : FIFA World Cup 2002
+			// test-case : GENMA ONIMUSHA 
+			// test-case : Halo - Combat Evolved
+			// test-case : Harry Potter and the Sorcerer's Stone
+			// test-case : Heroes of the Pacific
+			// test-case : Hummer Badlands
+			// test-case : Knights Of The Temple 2
+			// test-case : LakeMasters Bass fishing
+			// test-case : MetalDungeon
+			// test-case : NFL Fever 2003 Demo - main menu
+			// test-case : Night Caster 2
+			// test-case : Pinball Hall of Fame
+			// test-case : Robotech : Battlecry
+			// test-case : SpiderMan 2
+			// test-case : Splinter Cell Demo
+			// test-case : Stubbs the Zombie
+			// test-case : Tony Hawk's Pro Skater 2X (main menu entries)
+			// test-case : Worms 3D Special Edition
+			// test-case : XDK sample Lensflare (4, for 10 flare-out quads that use a linear texture; rendered incorrectly: https://youtu.be/idwlxHl9nAA?t=439)
+			DrawContext.dwStartVertex = StartVertex; // Breakpoint location for testing.
+		}
+
+		// Draw quadlists using a single 'quad-to-triangle mapping' index buffer :
+		// Assure & activate that special index buffer :
+		CxbxAssureQuadListD3DIndexBuffer(/*NrOfQuadIndices=*/DrawContext.dwVertexCount);
+		// Convert quad vertex count to triangle vertex count :
+		UINT NumVertices = QuadToTriangleVertexCount(DrawContext.dwVertexCount);
+		// Convert quad primitive count to triangle primitive count :
+		UINT primCount = DrawContext.dwHostPrimitiveCount * TRIANGLES_PER_QUAD;
+		// See https://docs.microsoft.com/en-us/windows/win32/direct3d9/rendering-from-vertex-and-index-buffers
+		// for an explanation on the function of the BaseVertexIndex, MinVertexIndex, NumVertices and StartIndex arguments.
+		// Emulate drawing quads by drawing each quad with two indexed triangles :
+		HRESULT hRet = g_pD3DDevice->DrawIndexedPrimitive(
+			/*PrimitiveType=*/D3DPT_TRIANGLELIST,
+			/*BaseVertexIndex=*/0, // Base vertex index has been accounted for in the stream conversion
+			/*MinVertexIndex=*/0,
+			NumVertices,
+			/*startIndex=*/0,
+			primCount
+		);
+		DEBUG_D3DRESULT(hRet, "g_pD3DDevice->DrawIndexedPrimitive(X_D3DPT_QUADLIST)");
+
+		g_dwPrimPerFrame += primCount;
+	}
+	else {
+		// if (StartVertex > 0) LOG_TEST_CASE("StartVertex > 0 (non-quad)"); // Verified test case : XDK Sample (PlayField)
+		HRESULT hRet = g_pD3DDevice->DrawPrimitive(
+			EmuXB2PC_D3DPrimitiveType(DrawContext.XboxPrimitiveType),
+			/*StartVertex=*/0, // Start vertex has been accounted for in the stream conversion
+			DrawContext.dwHostPrimitiveCount
+		);
+		DEBUG_D3DRESULT(hRet, "g_pD3DDevice->DrawPrimitive");
+
+		g_dwPrimPerFrame += DrawContext.dwHostPrimitiveCount;
+		if (DrawContext.XboxPrimitiveType == xbox::X_D3DPT_LINELOOP) {
+			// Close line-loops using a final single line, drawn from the end to the start vertex
+			LOG_TEST_CASE("X_D3DPT_LINELOOP"); // TODO : Text-cases needed
+
+			assert(DrawContext.dwBaseVertexIndex == 0); // if this fails, it needs to be added to LowIndex and HighIndex :
+			INDEX16 LowIndex = 0;
+			INDEX16 HighIndex = (INDEX16)(DrawContext.dwHostPrimitiveCount);
+			// Draw the closing line using a helper function (which will SetIndices)
+			CxbxDrawIndexedClosingLine(LowIndex, HighIndex);
+			// NOTE : We don't restore the previously active index buffer
+		}
+	}
+}
+
 // TODO : Move to own file
 // Drawing function specifically for rendering Xbox draw calls supplying a 'User Pointer'.
 // Called by D3DDevice_DrawVerticesUP, EmuExecutePushBufferRaw and CxbxImpl_End
@@ -7398,6 +7961,10 @@ void CxbxDrawPrimitiveUP(CxbxDrawContext &DrawContext)
 	assert(DrawContext.uiXboxVertexStreamZeroStride > 0);
 	assert(DrawContext.dwBaseVertexIndex == 0); // No IndexBase under Draw*UP
 
+	if (g_bSkipDrawPendingVertexShader) {
+		return;
+	}
+
 	VertexBufferConverter.Apply(&DrawContext);
 	if (DrawContext.XboxPrimitiveType == xbox::X_D3DPT_QUADLIST) {
 		// LOG_TEST_CASE("X_D3DPT_QUADLIST"); // test-case : X-Marbles and XDK Sample PlayField
@@ -7635,12 +8202,14 @@ void CxbxUpdateHostVertexShaderConstants()
 	// Track which constants are currently written
 	// So we can skip updates
 	static bool isXboxConstants = false;
+	static bool isFixedFunctionConstants = false;
 
 	if (g_Xbox_VertexShaderMode == VertexShaderMode::FixedFunction && g_UseFixedFunctionVertexShader) {
 		// Write host FF shader state
-		// TODO dirty tracking like for Xbox constants?
-		UpdateFixedFunctionVertexShaderState();
+		// Only need to overwrite what's changed, unless Xbox constants were written in between
+		UpdateFixedFunctionVertexShaderState(!isFixedFunctionConstants);
 		isXboxConstants = false;
+		isFixedFunctionConstants = true;
 	}
 	else {
 		// Write Xbox constants
@@ -7658,6 +8227,7 @@ void CxbxUpdateHostVertexShaderConstants()
 
 		// We've written the Xbox constants
 		isXboxConstants = true;
+		isFixedFunctionConstants = false;
 
 		// FIXME our viewport constants don't match Xbox values
 		// If we write them to pgraph constants, like we do with constants set by the title,
@@ -7743,16 +8313,21 @@ void CxbxUpdateHostViewport() {
 }
 
 extern void CxbxUpdateHostVertexDeclaration(); // TMP glue
-extern void CxbxUpdateHostVertexShader(); // TMP glue
+extern bool CxbxUpdateHostVertexShader(bool bWaitForShader); // TMP glue
 
 void CxbxUpdateNativeD3DResources()
 {
+	// Held back draws must be drawn with the host state they were recorded with
+	CxbxFlushPendingDraws();
+
 	// Before we start, make sure our resource cache stays limited in size
-	PrunePaletizedTexturesCache(); // TODO : Could we move this to Swap instead?
+	PruneResourceCaches(); // TODO : Could we move this to Swap instead?
 
 	CxbxUpdateHostVertexDeclaration();
 
-	CxbxUpdateHostVertexShader();
+	// Unless configured otherwise, block until the vertex shader is compiled.
+	// Otherwise, draws are skipped (see CxbxDrawIndexed and others) until it's ready
+	g_bSkipDrawPendingVertexShader = !CxbxUpdateHostVertexShader(/*bWaitForShader=*/!g_XBVideo.bSkipDrawUntilShaderReady);
 
 	CxbxUpdateHostVertexShaderConstants();
 
@@ -7978,12 +8553,185 @@ xbox::void_xt WINAPI xbox::EMUPATCH(D3DDevice_SetPixelShader)
 {
 	LOG_FUNC_ONE_ARG(Handle);
 
+	CxbxFlushPendingDraws();
+
 	// Call the Xbox function to make sure D3D structures get set
 	XB_TRMP(D3DDevice_SetPixelShader)(Handle);
 
 	CxbxImpl_SetPixelShader(Handle);
 }
 
+// Draw merging
+// Particle systems and text renderers issue lots of small draws without any state change in
+// between. So instead of drawing right away, a draw is held back, allowing following draws of
+// the same kind to be appended to it. Like Begin/End blocks (see CxbxImpl_End), the host state
+// is applied when a draw is held back, and every patch changing state outside of the render
+// and texture states draws the held back draw first (see CxbxFlushPendingDraws).
+
+enum class MergedDrawType { None, Vertices, VerticesUP, IndexedVertices };
+
+// Keeps indices into merged (and quad-converted) draws within INDEX16 range
+constexpr UINT MAX_MERGED_DRAW_VERTICES = 0xFFFF;
+
+static MergedDrawType g_MergedDraw_Type = MergedDrawType::None;
+static CxbxDrawContext g_MergedDraw_Context = {};
+static std::vector<uint8_t> g_MergedDraw_VertexData; // Titles may overwrite their user pointer data right after a Draw*UP call, so keep a copy
+static std::vector<INDEX16> g_MergedDraw_IndexData; // Likewise for index data, which titles may reuse once DrawIndexedVertices returns
+static ULONG g_MergedDraw_XboxDraws = 0;
+static ULONG g_MergedDraw_MergedDraws = 0;
+static ULONG g_MergedDraw_HostDraws = 0;
+
+bool IsDrawMergingEnabled()
+{
+	return g_XBVideo.bMergeDraws;
+}
+
+// Only lists can be concatenated, as each of their primitives stands on its own
+static bool IsMergeablePrimitiveType(xbox::X_D3DPRIMITIVETYPE PrimitiveType)
+{
+	switch (PrimitiveType) {
+	case xbox::X_D3DPT_POINTLIST:
+	case xbox::X_D3DPT_LINELIST:
+	case xbox::X_D3DPT_TRIANGLELIST:
+	case xbox::X_D3DPT_QUADLIST:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static void CxbxDrawOfType(MergedDrawType Type, CxbxDrawContext &DrawContext)
+{
+	switch (Type) {
+	case MergedDrawType::Vertices:
+		CxbxDrawPrimitive(DrawContext);
+		break;
+	case MergedDrawType::VerticesUP:
+		CxbxDrawPrimitiveUP(DrawContext);
+		break;
+	case MergedDrawType::IndexedVertices:
+		CxbxDrawIndexed(DrawContext);
+		break;
+	}
+
+	g_MergedDraw_HostDraws++;
+}
+
+void CxbxFlushMergedDraw()
+{
+	if (g_MergedDraw_Type == MergedDrawType::None) {
+		return;
+	}
+
+	// Draw a copy, as the draw functions update the context
+	CxbxDrawContext DrawContext = g_MergedDraw_Context;
+	if (g_MergedDraw_Type == MergedDrawType::VerticesUP) {
+		DrawContext.pXboxVertexStreamZeroData = g_MergedDraw_VertexData.data();
+	} else if (g_MergedDraw_Type == MergedDrawType::IndexedVertices) {
+		// Cache the converted indices under the first draw's guest address, not under the copy's
+		DrawContext.pXboxIndexDataKey = DrawContext.pXboxIndexData;
+		DrawContext.pXboxIndexData = g_MergedDraw_IndexData.data();
+	}
+
+	CxbxDrawOfType(std::exchange(g_MergedDraw_Type, MergedDrawType::None), DrawContext);
+}
+
+void CxbxFlushPendingDraws()
+{
+	// Note : At most one of these has anything pending, as holding back a draw flushes the other
+	CxbxFlushInlineVertexBuffer();
+	CxbxFlushMergedDraw();
+}
+
+// Appends a draw to the held back draw, when it directly follows it and no state changed in between
+static bool CxbxTryMergeDraw(MergedDrawType Type, const CxbxDrawContext &DrawContext)
+{
+	CxbxDrawContext &Pending = g_MergedDraw_Context;
+	if (g_MergedDraw_Type != Type
+		|| Pending.XboxPrimitiveType != DrawContext.XboxPrimitiveType
+		|| !IsMergeablePrimitiveType(DrawContext.XboxPrimitiveType)
+		|| Pending.dwVertexCount + DrawContext.dwVertexCount > MAX_MERGED_DRAW_VERTICES) {
+		return false;
+	}
+
+	switch (Type) {
+	case MergedDrawType::Vertices:
+		// Must continue where the held back draw ends in the same vertex buffers
+		if (DrawContext.dwStartVertex != Pending.dwStartVertex + Pending.dwVertexCount)
+			return false;
+		break;
+	case MergedDrawType::VerticesUP:
+		if (DrawContext.uiXboxVertexStreamZeroStride != Pending.uiXboxVertexStreamZeroStride)
+			return false;
+		break;
+	case MergedDrawType::IndexedVertices:
+		// Indices are appended to the copy, so only the vertices they refer to must be the same
+		if (DrawContext.dwBaseVertexIndex != Pending.dwBaseVertexIndex)
+			return false;
+		break;
+	}
+
+	// Note : The render and texture states are compared last, as that's the most work
+	if (XboxRenderStates.HasPendingChanges() || XboxTextureStates.HasPendingChanges()) {
+		return false;
+	}
+
+	if (Type == MergedDrawType::VerticesUP) {
+		const uint8_t* pVertexData = (const uint8_t*)DrawContext.pXboxVertexStreamZeroData;
+		g_MergedDraw_VertexData.insert(g_MergedDraw_VertexData.end(), pVertexData, pVertexData + DrawContext.dwVertexCount * DrawContext.uiXboxVertexStreamZeroStride);
+	} else if (Type == MergedDrawType::IndexedVertices) {
+		g_MergedDraw_IndexData.insert(g_MergedDraw_IndexData.end(), DrawContext.pXboxIndexData, DrawContext.pXboxIndexData + DrawContext.dwVertexCount);
+	}
+
+	Pending.dwVertexCount += DrawContext.dwVertexCount;
+	g_MergedDraw_MergedDraws++;
+	return true;
+}
+
+// Draws, or holds back the draw so that following draws can be merged into it
+static void CxbxSubmitDraw(MergedDrawType Type, const CxbxDrawContext &DrawContext)
+{
+	g_MergedDraw_XboxDraws++;
+	if (!IsDrawMergingEnabled()) {
+		// Nothing is ever held back, so draw straight from the title's data
+		CxbxUpdateNativeD3DResources();
+		CxbxDrawContext HostDrawContext = DrawContext;
+		CxbxDrawOfType(Type, HostDrawContext);
+		return;
+	}
+
+	if (CxbxTryMergeDraw(Type, DrawContext)) {
+		return;
+	}
+
+	// Draws what was held back, then applies the host state for this draw
+	CxbxUpdateNativeD3DResources();
+
+	g_MergedDraw_Type = Type;
+	g_MergedDraw_Context = DrawContext;
+	if (Type == MergedDrawType::VerticesUP) {
+		const uint8_t* pVertexData = (const uint8_t*)DrawContext.pXboxVertexStreamZeroData;
+		g_MergedDraw_VertexData.assign(pVertexData, pVertexData + DrawContext.dwVertexCount * DrawContext.uiXboxVertexStreamZeroStride);
+	} else if (Type == MergedDrawType::IndexedVertices) {
+		g_MergedDraw_IndexData.assign(DrawContext.pXboxIndexData, DrawContext.pXboxIndexData + DrawContext.dwVertexCount);
+	}
+}
+
+void CxbxDrawMergedDrawStats()
+{
+	const ULONG xboxDraws = std::exchange(g_MergedDraw_XboxDraws, 0);
+	const ULONG hostDraws = std::exchange(g_MergedDraw_HostDraws, 0);
+
+	if (!IsDrawMergingEnabled()) {
+		ImGui::Text("Disabled");
+	}
+
+	ImGui::Text("Xbox draws: %u", xboxDraws);
+	ImGui::Text("Merged draws: %u", std::exchange(g_MergedDraw_MergedDraws, 0));
+	ImGui::Text("Host draws: %u", hostDraws);
+	ImGui::Text("Merge ratio: %.2f", hostDraws ? (float)xboxDraws / hostDraws : 0.0f);
+}
+
 // ******************************************************************
 // * patch: D3DDevice_DrawVertices_4
 // LTCG specific D3DDevice_DrawVertices function...
@@ -8036,96 +8784,13 @@ xbox::void_xt WINAPI xbox::EMUPATCH(D3DDevice_DrawVertices)
 
 	// TODO : Call unpatched CDevice_SetStateVB(0);
 
-	CxbxUpdateNativeD3DResources();
-
-		CxbxDrawContext DrawContext = {};
-
-		DrawContext.XboxPrimitiveType = PrimitiveType;
-		DrawContext.dwVertexCount = VertexCount;
-		DrawContext.dwStartVertex = StartVertex;
-
-		VertexBufferConverter.Apply(&DrawContext);
-		if (DrawContext.XboxPrimitiveType == X_D3DPT_QUADLIST) {
-			if (StartVertex == 0) {
-				//LOG_TEST_CASE("X_D3DPT_QUADLIST (StartVertex == 0)"); // disabled, hit too often
-				// test-case : ?X-Marbles
-				// test-case XDK Samples : AlphaFog, AntiAlias, BackBufferScale, BeginPush, Cartoon, TrueTypeFont (?maybe PlayField?)
-			} else {
-				LOG_TEST_CASE("X_D3DPT_QUADLIST (StartVertex > 0)");
-				// https://github.com/Cxbx-Reloaded/Cxbx-Reloaded/issues/1156
-				// test-case : All - Star Baseball '03
-				// test-case : Army Men Major Malfunction
-				// test-case : Big Mutha Truckers
-				// test-case : BLiNX: the time sweeper
-				// test-case : Blood Wake
-				// test-case : Call of Duty: Finest Hour
-				// test-case : Flight academy
-				// test-case : FIFA World Cup 2002
-				// test-case : GENMA ONIMUSHA 
-				// test-case : Halo - Combat Evolved
-				// test-case : Harry Potter and the Sorcerer's Stone
-				// test-case : Heroes of the Pacific
-				// test-case : Hummer Badlands
-				// test-case : Knights Of The Temple 2
-				// test-case : LakeMasters Bass fishing
-				// test-case : MetalDungeon
-				// test-case : NFL Fever 2003 Demo - main menu
-				// test-case : Night Caster 2
-				// test-case : Pinball Hall of Fame
-				// test-case : Robotech : Battlecry
-				// test-case : SpiderMan 2
-				// test-case : Splinter Cell Demo
-				// test-case : Stubbs the Zombie
-				// test-case : Tony Hawk's Pro Skater 2X (main menu entries)
-				// test-case : Worms 3D Special Edition
-				// test-case : XDK sample Lensflare (4, for 10 flare-out quads that use a linear texture; rendered incorrectly: https://youtu.be/idwlxHl9nAA?t=439)
-				DrawContext.dwStartVertex = StartVertex; // Breakpoint location for testing.
-			}
+	CxbxDrawContext DrawContext = {};
 
-			// Draw quadlists using a single 'quad-to-triangle mapping' index buffer :
-			// Assure & activate that special index buffer :
-			CxbxAssureQuadListD3DIndexBuffer(/*NrOfQuadIndices=*/DrawContext.dwVertexCount);
-			// Convert quad vertex count to triangle vertex count :
-			UINT NumVertices = QuadToTriangleVertexCount(DrawContext.dwVertexCount);
-			// Convert quad primitive count to triangle primitive count :
-			UINT primCount = DrawContext.dwHostPrimitiveCount * TRIANGLES_PER_QUAD;
-			// See https://docs.microsoft.com/en-us/windows/win32/direct3d9/rendering-from-vertex-and-index-buffers
-			// for an explanation on the function of the BaseVertexIndex, MinVertexIndex, NumVertices and StartIndex arguments.
-			// Emulate drawing quads by drawing each quad with two indexed triangles :
-			HRESULT hRet = g_pD3DDevice->DrawIndexedPrimitive(
-				/*PrimitiveType=*/D3DPT_TRIANGLELIST,
-				/*BaseVertexIndex=*/0, // Base vertex index has been accounted for in the stream conversion
-				/*MinVertexIndex=*/0,
-				NumVertices,
-				/*startIndex=*/0,
-				primCount
-			);
-			DEBUG_D3DRESULT(hRet, "g_pD3DDevice->DrawIndexedPrimitive(X_D3DPT_QUADLIST)");
+	DrawContext.XboxPrimitiveType = PrimitiveType;
+	DrawContext.dwVertexCount = VertexCount;
+	DrawContext.dwStartVertex = StartVertex;
 
-			g_dwPrimPerFrame += primCount;
-		}
-		else {
-			// if (StartVertex > 0) LOG_TEST_CASE("StartVertex > 0 (non-quad)"); // Verified test case : XDK Sample (PlayField)
-			HRESULT hRet = g_pD3DDevice->DrawPrimitive(
-				EmuXB2PC_D3DPrimitiveType(DrawContext.XboxPrimitiveType),
-				/*StartVertex=*/0, // Start vertex has been accounted for in the stream conversion
-				DrawContext.dwHostPrimitiveCount
-			);
-			DEBUG_D3DRESULT(hRet, "g_pD3DDevice->DrawPrimitive");
-
-			g_dwPrimPerFrame += DrawContext.dwHostPrimitiveCount;
-			if (DrawContext.XboxPrimitiveType == X_D3DPT_LINELOOP) {
-				// Close line-loops using a final single line, drawn from the end to the start vertex
-				LOG_TEST_CASE("X_D3DPT_LINELOOP"); // TODO : Text-cases needed
-
-				assert(DrawContext.dwBaseVertexIndex == 0); // if this fails, it needs to be added to LowIndex and HighIndex :
-				INDEX16 LowIndex = 0;
-				INDEX16 HighIndex = (INDEX16)(DrawContext.dwHostPrimitiveCount);
-				// Draw the closing line using a helper function (which will SetIndices)
-				CxbxDrawIndexedClosingLine(LowIndex, HighIndex);
-				// NOTE : We don't restore the previously active index buffer
-			}
-		}
+	CxbxSubmitDraw(MergedDrawType::Vertices, DrawContext);
 
 	CxbxHandleXboxCallbacks();
 }
@@ -8155,8 +8820,6 @@ xbox::void_xt WINAPI xbox::EMUPATCH(D3DDevice_DrawVerticesUP)
 
 	// TODO : Call unpatched CDevice_SetStateUP();
 
-	CxbxUpdateNativeD3DResources();
-
 	CxbxDrawContext DrawContext = {};
 
 	DrawContext.XboxPrimitiveType = PrimitiveType;
@@ -8164,7 +8827,7 @@ xbox::void_xt WINAPI xbox::EMUPATCH(D3DDevice_DrawVerticesUP)
 	DrawContext.pXboxVertexStreamZeroData = pVertexStreamZeroData;
 	DrawContext.uiXboxVertexStreamZeroStride = VertexStreamZeroStride;
 
-	CxbxDrawPrimitiveUP(DrawContext);
+	CxbxSubmitDraw(MergedDrawType::VerticesUP, DrawContext);
 
 	CxbxHandleXboxCallbacks();
 }
@@ -8220,8 +8883,6 @@ xbox::void_xt WINAPI xbox::EMUPATCH(D3DDevice_DrawIndexedVertices)
 
 	// TODO : Call unpatched CDevice_SetStateVB(g_Xbox_BaseVertexIndex);
 
-	CxbxUpdateNativeD3DResources();
-
 	CxbxDrawContext DrawContext = {};
 
 	DrawContext.XboxPrimitiveType = PrimitiveType;
@@ -8231,7 +8892,7 @@ xbox::void_xt WINAPI xbox::EMUPATCH(D3DDevice_DrawIndexedVertices)
 
 	// Test case JSRF draws all geometry through this function (only sparks are drawn via another method)
 	// using X_D3DPT_TRIANGLELIST and X_D3DPT_TRIANGLESTRIP PrimitiveType
-	CxbxDrawIndexed(DrawContext);
+	CxbxSubmitDraw(MergedDrawType::IndexedVertices, DrawContext);
 
 	CxbxHandleXboxCallbacks();
 }
@@ -8264,76 +8925,80 @@ xbox::void_xt WINAPI xbox::EMUPATCH(D3DDevice_DrawIndexedVerticesUP)
 	// TODO : Call unpatched CDevice_SetStateUP();
 
 	CxbxUpdateNativeD3DResources();
+	if (g_bSkipDrawPendingVertexShader) {
+		CxbxHandleXboxCallbacks();
+		return;
+	}
+
+	CxbxDrawContext DrawContext = {};
+	INDEX16* pXboxIndexData = (INDEX16*)pIndexData;
 
-		CxbxDrawContext DrawContext = {};
-		INDEX16* pXboxIndexData = (INDEX16*)pIndexData;
+	DrawContext.XboxPrimitiveType = PrimitiveType;
+	DrawContext.dwVertexCount = VertexCount;
+	DrawContext.pXboxIndexData = pXboxIndexData; // Used to derive VerticesInBuffer
+	// Note : D3DDevice_DrawIndexedVerticesUP does NOT use g_Xbox_BaseVertexIndex, so keep DrawContext.dwBaseVertexIndex at 0!
+	DrawContext.pXboxVertexStreamZeroData = pVertexStreamZeroData;
+	DrawContext.uiXboxVertexStreamZeroStride = VertexStreamZeroStride;
 
-		DrawContext.XboxPrimitiveType = PrimitiveType;
-		DrawContext.dwVertexCount = VertexCount;
-		DrawContext.pXboxIndexData = pXboxIndexData; // Used to derive VerticesInBuffer
-		// Note : D3DDevice_DrawIndexedVerticesUP does NOT use g_Xbox_BaseVertexIndex, so keep DrawContext.dwBaseVertexIndex at 0!
-		DrawContext.pXboxVertexStreamZeroData = pVertexStreamZeroData;
-		DrawContext.uiXboxVertexStreamZeroStride = VertexStreamZeroStride;
+	// Determine LowIndex and HighIndex *before* VerticesInBuffer gets derived
+	WalkIndexBuffer(DrawContext.LowIndex, DrawContext.HighIndex, pXboxIndexData, VertexCount);
 
-		// Determine LowIndex and HighIndex *before* VerticesInBuffer gets derived
-		WalkIndexBuffer(DrawContext.LowIndex, DrawContext.HighIndex, pXboxIndexData, VertexCount);
+	VertexBufferConverter.Apply(&DrawContext);
 
-		VertexBufferConverter.Apply(&DrawContext);
+	INDEX16* pHostIndexData;
+	UINT PrimitiveCount = DrawContext.dwHostPrimitiveCount;
 
-		INDEX16* pHostIndexData;
-		UINT PrimitiveCount = DrawContext.dwHostPrimitiveCount;
+	bool bConvertQuadListToTriangleList = (DrawContext.XboxPrimitiveType == X_D3DPT_QUADLIST);
+	if (bConvertQuadListToTriangleList) {
+		LOG_TEST_CASE("X_D3DPT_QUADLIST");
+		// Test-case : Buffy: The Vampire Slayer
+		// Test-case : XDK samples : FastLoad, BackBufferScale, DisplacementMap, Donuts3D, VolumeLight, PersistDisplay, PolynomialTextureMaps, SwapCallback, Tiling, VolumeFog, DebugKeyboard, Gamepad
+		// Convert draw arguments from quads to triangles :
+		pHostIndexData = CxbxCreateQuadListToTriangleListIndexData(pXboxIndexData, VertexCount);
+		PrimitiveCount *= TRIANGLES_PER_QUAD;
+		// Note, that LowIndex and HighIndex won't change due to this quad-to-triangle conversion,
+		// so it's less work to WalkIndexBuffer over the input instead of the converted index buffer.
+	} else {
+		// LOG_TEST_CASE("DrawIndexedPrimitiveUP"); // Test-case : Burnout, Namco Museum 50th Anniversary
+		pHostIndexData = pXboxIndexData;
+	}
 
-		bool bConvertQuadListToTriangleList = (DrawContext.XboxPrimitiveType == X_D3DPT_QUADLIST);
-		if (bConvertQuadListToTriangleList) {
-			LOG_TEST_CASE("X_D3DPT_QUADLIST");
-			// Test-case : Buffy: The Vampire Slayer
-			// Test-case : XDK samples : FastLoad, BackBufferScale, DisplacementMap, Donuts3D, VolumeLight, PersistDisplay, PolynomialTextureMaps, SwapCallback, Tiling, VolumeFog, DebugKeyboard, Gamepad
-			// Convert draw arguments from quads to triangles :
-			pHostIndexData = CxbxCreateQuadListToTriangleListIndexData(pXboxIndexData, VertexCount);
-			PrimitiveCount *= TRIANGLES_PER_QUAD;
-			// Note, that LowIndex and HighIndex won't change due to this quad-to-triangle conversion,
-			// so it's less work to WalkIndexBuffer over the input instead of the converted index buffer.
-		} else {
-			// LOG_TEST_CASE("DrawIndexedPrimitiveUP"); // Test-case : Burnout, Namco Museum 50th Anniversary
-			pHostIndexData = pXboxIndexData;
+	HRESULT hRet = g_pD3DDevice->DrawIndexedPrimitiveUP(
+		/*PrimitiveType=*/EmuXB2PC_D3DPrimitiveType(DrawContext.XboxPrimitiveType),
+		/*MinVertexIndex=*/DrawContext.LowIndex,
+		/*NumVertexIndices=*/(DrawContext.HighIndex - DrawContext.LowIndex) + 1,
+		PrimitiveCount,
+		pHostIndexData,
+		/*IndexDataFormat=*/D3DFMT_INDEX16,
+		DrawContext.pHostVertexStreamZeroData,
+		DrawContext.uiHostVertexStreamZeroStride
+	);
+	DEBUG_D3DRESULT(hRet, "g_pD3DDevice->DrawIndexedPrimitiveUP");
+
+	if (bConvertQuadListToTriangleList) {
+		CxbxReleaseQuadListToTriangleListIndexData(pHostIndexData);
+	}
+
+	g_dwPrimPerFrame += PrimitiveCount;
+	if (DrawContext.XboxPrimitiveType == X_D3DPT_LINELOOP) {
+		// Close line-loops using a final single line, drawn from the end to the start vertex
+		LOG_TEST_CASE("X_D3DPT_LINELOOP"); // TODO : Which titles reach this test-case?
+		// Read the end and start index from the supplied index data
+		INDEX16 LowIndex = pXboxIndexData[0];
+		INDEX16 HighIndex = pXboxIndexData[DrawContext.dwHostPrimitiveCount];
+		// If needed, swap so highest index is higher than lowest (duh)
+		if (HighIndex < LowIndex) {
+			std::swap(HighIndex, LowIndex);
 		}
 
-		HRESULT hRet = g_pD3DDevice->DrawIndexedPrimitiveUP(
-			/*PrimitiveType=*/EmuXB2PC_D3DPrimitiveType(DrawContext.XboxPrimitiveType),
-			/*MinVertexIndex=*/DrawContext.LowIndex,
-			/*NumVertexIndices=*/(DrawContext.HighIndex - DrawContext.LowIndex) + 1,
-			PrimitiveCount,
-			pHostIndexData,
-			/*IndexDataFormat=*/D3DFMT_INDEX16,
+		// Close line-loops using a final single line, drawn from the end to the start vertex :
+		CxbxDrawIndexedClosingLineUP(
+			LowIndex,
+			HighIndex,
 			DrawContext.pHostVertexStreamZeroData,
 			DrawContext.uiHostVertexStreamZeroStride
 		);
-		DEBUG_D3DRESULT(hRet, "g_pD3DDevice->DrawIndexedPrimitiveUP");
-
-		if (bConvertQuadListToTriangleList) {
-			CxbxReleaseQuadListToTriangleListIndexData(pHostIndexData);
-		}
-
-		g_dwPrimPerFrame += PrimitiveCount;
-		if (DrawContext.XboxPrimitiveType == X_D3DPT_LINELOOP) {
-			// Close line-loops using a final single line, drawn from the end to the start vertex
-			LOG_TEST_CASE("X_D3DPT_LINELOOP"); // TODO : Which titles reach this test-case?
-			// Read the end and start index from the supplied index data
-			INDEX16 LowIndex = pXboxIndexData[0];
-			INDEX16 HighIndex = pXboxIndexData[DrawContext.dwHostPrimitiveCount];
-			// If needed, swap so highest index is higher than lowest (duh)
-			if (HighIndex < LowIndex) {
-				std::swap(HighIndex, LowIndex);
-			}
-
-			// Close line-loops using a final single line, drawn from the end to the start vertex :
-			CxbxDrawIndexedClosingLineUP(
-				LowIndex,
-				HighIndex,
-				DrawContext.pHostVertexStreamZeroData,
-				DrawContext.uiHostVertexStreamZeroStride
-			);
-		}
+	}
 
 	CxbxHandleXboxCallbacks();
 }
@@ -8352,9 +9017,11 @@ xbox::hresult_xt WINAPI xbox::EMUPATCH(D3DDevice_SetLight)
 		LOG_FUNC_ARG(pLight)
 		LOG_FUNC_END;
 
+	CxbxFlushPendingDraws();
+
 	XB_TRMP(D3DDevice_SetLight)(Index, pLight);
 
-	d3d8LightState.Lights[Index] = *pLight;
+	d3d8LightState.SetLight(Index, pLight);
 
     HRESULT hRet = g_pD3DDevice->SetLight(Index, pLight);
 	DEBUG_D3DRESULT(hRet, "g_pD3DDevice->SetLight");    
@@ -8372,6 +9039,8 @@ xbox::void_xt WINAPI xbox::EMUPATCH(D3DDevice_SetMaterial)
 {
 	LOG_FUNC_ONE_ARG(pMaterial);
 
+	CxbxFlushPendingDraws();
+
 	ffShaderState.Materials[0].Ambient = toVector(pMaterial->Ambient);
 	ffShaderState.Materials[0].Diffuse = toVector(pMaterial->Diffuse);
 	ffShaderState.Materials[0].Specular = toVector(pMaterial->Specular);
@@ -8396,6 +9065,8 @@ xbox::hresult_xt WINAPI xbox::EMUPATCH(D3DDevice_LightEnable)
 		LOG_FUNC_ARG(bEnable)
 		LOG_FUNC_END;
 
+	CxbxFlushPendingDraws();
+
 	XB_TRMP(D3DDevice_LightEnable)(Index, bEnable);
 
 	d3d8LightState.EnableLight(Index, bEnable);
@@ -8418,6 +9089,8 @@ static void CxbxImpl_SetRenderTarget
 {
 	LOG_INIT;
 
+	CxbxFlushPendingDraws();
+
 	IDirect3DSurface *pHostRenderTarget = nullptr;
 	IDirect3DSurface *pHostDepthStencil = nullptr;
 	// In Xbox titles, CreateDevice calls SetRenderTarget for the back buffer
@@ -8596,6 +9269,8 @@ static void CxbxImpl_SetPalette
     xbox::X_D3DPalette *pPalette
 )
 {
+	CxbxFlushPendingDraws();
+
 	if (Stage >= xbox::X_D3DTS_STAGECOUNT) {
 		LOG_TEST_CASE("Stage out of bounds");
 	} else {
@@ -8993,6 +9668,9 @@ xbox::dword_xt WINAPI xbox::EMUPATCH(D3DDevice_InsertFence)()
 {
 	LOG_FUNC();
 
+	// Fences must follow all earlier draws
+	CxbxFlushPendingDraws();
+
     // TODO: Actually implement this
     dword_xt dwRet = 0x8000BEEF;
 
@@ -9027,6 +9705,8 @@ xbox::void_xt WINAPI xbox::EMUPATCH(D3DDevice_BlockOnFence)
 {
 	LOG_FUNC_ONE_ARG(Fence);
 
+	CxbxFlushPendingDraws();
+
     // TODO: Implement
 	LOG_UNIMPLEMENTED();
 }
@@ -9041,6 +9721,9 @@ xbox::void_xt WINAPI xbox::EMUPATCH(D3DResource_BlockUntilNotBusy)
 {
 	LOG_FUNC_ONE_ARG(pThis);
 
+	// Held back draws may still read from this resource
+	CxbxFlushPendingDraws();
+
     // TODO: Implement
 	LOG_UNIMPLEMENTED();
 }
@@ -9078,6 +9761,8 @@ xbox::void_xt WINAPI xbox::EMUPATCH(D3DDevice_InsertCallback)
 		LOG_FUNC_ARG(Context)
 		LOG_FUNC_END;
 
+	// Callbacks must follow all earlier draws
+	CxbxFlushPendingDraws();
 	CxbxImpl_InsertCallback(Type, pCallback, Context);
 
 	LOG_INCOMPLETE();
@@ -9100,6 +9785,9 @@ xbox::hresult_xt WINAPI xbox::EMUPATCH(D3DDevice_DrawRectPatch)
 		LOG_FUNC_END;
 
 	CxbxUpdateNativeD3DResources();
+	if (g_bSkipDrawPendingVertexShader) {
+		return D3D_OK;
+	}
 
 	HRESULT hRet = g_pD3DDevice->DrawRectPatch( Handle, pNumSegs, pRectPatchInfo );
 	DEBUG_D3DRESULT(hRet, "g_pD3DDevice->DrawRectPatch");
@@ -9124,6 +9812,9 @@ xbox::hresult_xt WINAPI xbox::EMUPATCH(D3DDevice_DrawTriPatch)
 		LOG_FUNC_END;
 
 	CxbxUpdateNativeD3DResources();
+	if (g_bSkipDrawPendingVertexShader) {
+		return D3D_OK;
+	}
 
 	HRESULT hRet = g_pD3DDevice->DrawTriPatch(Handle, pNumSegs, pTriPatchInfo);
 	DEBUG_D3DRESULT(hRet, "g_pD3DDevice->DrawTriPatch");
@@ -63,6 +63,28 @@ extern uint8_t *ConvertD3DTextureToARGB(
 
 void CxbxUpdateNativeD3DResources();
 
+// Returns whether draws (and Begin/End blocks) may be held back for merging, as configured by MergeDraws
+bool IsDrawMergingEnabled();
+
+// Draws everything that was held back for merging with following draws.
+// Must be called before state is changed outside of render and texture states
+void CxbxFlushPendingDraws();
+
+// Draws the held back D3DDevice_Draw* call, leaving held back Begin/End blocks pending
+void CxbxFlushMergedDraw();
+
+// Render the draw merging statistics in the ImGui overlay
+void CxbxDrawMergedDrawStats();
+
+// Render the host resource cache statistics in the ImGui overlay
+void CxbxDrawResourceCacheStats();
+
+// Render the index buffer cache statistics in the ImGui overlay
+void CxbxDrawIndexBufferCacheStats();
+
+// Render the number of render and texture states forwarded to the host in the ImGui overlay
+void CxbxDrawStateChangeStats();
+
 void CxbxImpl_SetRenderTarget(xbox::X_D3DSurface* pRenderTarget, xbox::X_D3DSurface* pNewZStencil);
 void CxbxImpl_SetViewport(xbox::X_D3DVIEWPORT8* pViewport);
 
@@ -31,6 +31,9 @@
 #include "Logging.h"
 #include "core/hle/D3D8/Direct3D9/Direct3D9.h" // For g_pD3DDevice
 #include "core/hle/D3D8/XbConvert.h"
+#include <algorithm>
+#include <bit>
+#include <utility>
 
 void SetXboxMultiSampleType(xbox::X_D3DMULTISAMPLE_TYPE value);
 
@@ -129,6 +132,7 @@ void XboxRenderStateConverter::BuildRenderStateMappingTable()
         auto RenderStateInfo = GetDxbxRenderStateInfo(RenderState);
         if (IsRenderStateAvailableInCurrentXboxD3D8Lib(RenderStateInfo)) {
             XboxRenderStateOffsets[RenderState] = XboxIndex;
+            XboxRenderStates[XboxIndex] = RenderState;
             EmuLog(LOG_LEVEL::INFO, "%s = %d", RenderStateInfo.S, XboxIndex);
             XboxIndex++;
             continue;
@@ -136,30 +140,38 @@ void XboxRenderStateConverter::BuildRenderStateMappingTable()
 
         EmuLog(LOG_LEVEL::INFO, "%s Not Present", RenderStateInfo.S);
     }
+
+    XboxRenderStateCount = XboxIndex;
 }
 
 void XboxRenderStateConverter::SetDirty()
 {
-    PreviousRenderStateValues.fill(-1);
+    DirtyXboxRenderStates.fill(UINT32_MAX);
 }
 
-void* XboxRenderStateConverter::GetPixelShaderRenderStatePointer()
+void XboxRenderStateConverter::MarkDirty(uint32_t State)
 {
-    return &D3D__RenderState[xbox::X_D3DRS_PS_FIRST];
+    int XboxIndex = XboxRenderStateOffsets[State];
+    if (XboxIndex < 0) {
+        return;
+    }
+
+    DirtyXboxRenderStates[XboxIndex / 32] |= 1u << (XboxIndex % 32);
 }
 
-bool XboxRenderStateConverter::XboxRenderStateExists(uint32_t State)
+uint32_t XboxRenderStateConverter::GetAndResetHostStateChanges()
 {
-    if (XboxRenderStateOffsets[State] >= 0) {
-        return true;
-    }
+    return std::exchange(HostStateChanges, 0);
+}
 
-    return false;
+void* XboxRenderStateConverter::GetPixelShaderRenderStatePointer()
+{
+    return &D3D__RenderState[xbox::X_D3DRS_PS_FIRST];
 }
 
-bool XboxRenderStateConverter::XboxRenderStateValueChanged(uint32_t State)
+bool XboxRenderStateConverter::XboxRenderStateExists(uint32_t State)
 {
-    if (XboxRenderStateExists(State) && GetXboxRenderState(State) != PreviousRenderStateValues[State]) {
+    if (XboxRenderStateOffsets[State] >= 0) {
         return true;
     }
 
@@ -174,6 +186,7 @@ void XboxRenderStateConverter::SetXboxRenderState(uint32_t State, uint32_t Value
     }
 
     D3D__RenderState[XboxRenderStateOffsets[State]] = Value;
+    MarkDirty(State);
 }
 
 uint32_t XboxRenderStateConverter::GetXboxRenderState(uint32_t State)
@@ -198,14 +211,11 @@ float XboxRenderStateConverter::GetXboxRenderStateAsFloat(uint32_t State)
 
 void XboxRenderStateConverter::StoreInitialValues()
 {
-    for (unsigned int RenderState = xbox::X_D3DRS_FIRST; RenderState <= xbox::X_D3DRS_LAST; RenderState++) {
-        // Skip Render States that don't exist within this XDK
-        if (!XboxRenderStateExists(RenderState)) {
-            continue;
-        }
-
-        PreviousRenderStateValues[RenderState] = GetXboxRenderState(RenderState);
+    for (unsigned int XboxIndex = 0; XboxIndex < XboxRenderStateCount; XboxIndex++) {
+        PreviousXboxRenderStateValues[XboxIndex] = D3D__RenderState[XboxIndex];
     }
+
+    DirtyXboxRenderStates.fill(0);
 }
 
 void XboxRenderStateConverter::SetWireFrameMode(int wireframe)
@@ -214,32 +224,61 @@ void XboxRenderStateConverter::SetWireFrameMode(int wireframe)
 
     // Wireframe mode changed, so we must force the Fill Mode renderstate to dirty
     // At next call to Apply, the desired WireFrame mode will be set
-    PreviousRenderStateValues[xbox::X_D3DRS_FILLMODE] = -1;
+    MarkDirty(xbox::X_D3DRS_FILLMODE);
+}
+
+// Marks all render states that were written since they were last applied as dirty.
+// Compares 32 render states at a time against the values that were applied last
+void XboxRenderStateConverter::CollectChangedRenderStates()
+{
+    for (unsigned int XboxIndex = 0; XboxIndex < XboxRenderStateCount; XboxIndex += 32) {
+        unsigned int Count = std::min(XboxRenderStateCount - XboxIndex, 32u);
+        DirtyXboxRenderStates[XboxIndex / 32] |= DiffXboxStates(&D3D__RenderState[XboxIndex], &PreviousXboxRenderStateValues[XboxIndex], Count);
+    }
+}
+
+bool XboxRenderStateConverter::HasPendingChanges()
+{
+    CollectChangedRenderStates();
+    return std::any_of(DirtyXboxRenderStates.begin(), DirtyXboxRenderStates.end(), [](uint32_t DirtyMask) { return DirtyMask != 0; });
 }
 
 void XboxRenderStateConverter::Apply()
 {
-    // Iterate through each RenderState and set the associated host render state
-    // We start counting at X_D3DRS_SIMPLE_FIRST, to skip the pixel shader renderstates handled elsewhere
-    for (unsigned int RenderState = xbox::X_D3DRS_SIMPLE_FIRST; RenderState <= xbox::X_D3DRS_LAST; RenderState++) {
-        // Skip any renderstate that does not exist in the current XDK, or have not changed since the previous update call
-        // Also skip PSTextureModes, which is a special case used by Pixel Shaders
-        if (!XboxRenderStateExists(RenderState) || !XboxRenderStateValueChanged(RenderState) || RenderState == xbox::X_D3DRS_PSTEXTUREMODES) {
-            continue;
-        }
+    CollectChangedRenderStates();
+
+    // Visit each dirty RenderState (in increasing order) and set the associated host render state
+    for (unsigned int Word = 0; Word < DirtyXboxRenderStates.size(); Word++) {
+        uint32_t DirtyMask = std::exchange(DirtyXboxRenderStates[Word], 0);
+        while (DirtyMask) {
+            unsigned int XboxIndex = (Word * 32) + std::countr_zero(DirtyMask);
+            DirtyMask &= DirtyMask - 1;
+
+            // Skip bits beyond the render states that exist in the current XDK (set by SetDirty)
+            if (XboxIndex >= XboxRenderStateCount) {
+                break;
+            }
 
-        auto Value = GetXboxRenderState(RenderState);
-        EmuLog(LOG_LEVEL::DEBUG, "XboxRenderStateConverter::Apply(%s, %X)\n", GetDxbxRenderStateInfo(RenderState).S, Value);
+            auto Value = D3D__RenderState[XboxIndex];
+            PreviousXboxRenderStateValues[XboxIndex] = Value;
 
-        if (RenderState <= xbox::X_D3DRS_SIMPLE_LAST) {
-            ApplySimpleRenderState(RenderState, Value);
-        } else if (RenderState <= xbox::X_D3DRS_DEFERRED_LAST) {
-            ApplyDeferredRenderState(RenderState, Value);
-        } else if (RenderState <= xbox::X_D3DRS_COMPLEX_LAST) {
-            ApplyComplexRenderState(RenderState, Value);
-        }
+            // Skip the pixel shader renderstates handled elsewhere (all before X_D3DRS_SIMPLE_FIRST)
+            // Also skip PSTextureModes, which is a special case used by Pixel Shaders
+            uint32_t RenderState = XboxRenderStates[XboxIndex];
+            if (RenderState < xbox::X_D3DRS_SIMPLE_FIRST || RenderState == xbox::X_D3DRS_PSTEXTUREMODES) {
+                continue;
+            }
+
+            EmuLog(LOG_LEVEL::DEBUG, "XboxRenderStateConverter::Apply(%s, %X)\n", GetDxbxRenderStateInfo(RenderState).S, Value);
 
-        PreviousRenderStateValues[RenderState] = Value;
+            if (RenderState <= xbox::X_D3DRS_SIMPLE_LAST) {
+                ApplySimpleRenderState(RenderState, Value);
+            } else if (RenderState <= xbox::X_D3DRS_DEFERRED_LAST) {
+                ApplyDeferredRenderState(RenderState, Value);
+            } else if (RenderState <= xbox::X_D3DRS_COMPLEX_LAST) {
+                ApplyComplexRenderState(RenderState, Value);
+            }
+        }
     }
 }
 
@@ -310,6 +349,7 @@ void XboxRenderStateConverter::ApplySimpleRenderState(uint32_t State, uint32_t V
     }
 
     g_pD3DDevice->SetRenderState((D3DRENDERSTATETYPE)(RenderStateInfo.PC), Value);
+    HostStateChanges++;
 }
 
 void XboxRenderStateConverter::ApplyDeferredRenderState(uint32_t State, uint32_t Value)
@@ -398,6 +438,7 @@ void XboxRenderStateConverter::ApplyDeferredRenderState(uint32_t State, uint32_t
     }
 
     g_pD3DDevice->SetRenderState(RenderStateInfo.PC, Value);
+    HostStateChanges++;
 }
 
 void XboxRenderStateConverter::ApplyComplexRenderState(uint32_t State, uint32_t Value)
@@ -470,4 +511,5 @@ void XboxRenderStateConverter::ApplyComplexRenderState(uint32_t State, uint32_t
     }
 
     g_pD3DDevice->SetRenderState(RenderStateInfo.PC, Value);
+    HostStateChanges++;
 }
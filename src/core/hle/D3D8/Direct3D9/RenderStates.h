@@ -27,12 +27,33 @@
 
 #include <cstdint>
 #include <array>
+#include <emmintrin.h> // SSE2
 #include "EmuShared.h"
 #include "core\kernel\init\CxbxKrnl.h"
 #include "core\kernel\support\Emu.h"
 #include "core\hle\Intercept.hpp"
 #include "core\hle\D3D8\XbD3D8Types.h"
 
+// Compares up to 32 consecutive state values against their shadow copies,
+// and returns a mask with a bit set for each value that differs
+inline uint32_t DiffXboxStates(const uint32_t* pValues, const uint32_t* pShadowValues, unsigned Count)
+{
+    uint32_t DiffMask = 0;
+    unsigned i = 0;
+    for (; i + 4 <= Count; i += 4) {
+        __m128i Equal = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)&pValues[i]), _mm_loadu_si128((const __m128i*)&pShadowValues[i]));
+        DiffMask |= (uint32_t)(~_mm_movemask_ps(_mm_castsi128_ps(Equal)) & 0xF) << i;
+    }
+
+    for (; i < Count; i++) {
+        if (pValues[i] != pShadowValues[i]) {
+            DiffMask |= 1u << i;
+        }
+    }
+
+    return DiffMask;
+}
+
 class XboxRenderStateConverter
 {
 public:
@@ -47,13 +68,18 @@ public:
     void SetDirty();
     uint32_t GetXboxRenderState(uint32_t State);
     float GetXboxRenderStateAsFloat(uint32_t State);
+    // Returns (and resets) the number of render states forwarded to the host
+    uint32_t GetAndResetHostStateChanges();
+    // Returns whether any render state changed since the last Apply
+    bool HasPendingChanges();
 private:
     void VerifyAndFixDeferredRenderStateOffset();
     void DeriveRenderStateOffsetFromDeferredRenderStateOffset();
     void StoreInitialValues();
     void BuildRenderStateMappingTable();
 
-    bool XboxRenderStateValueChanged(uint32_t State);
+    void MarkDirty(uint32_t State);
+    void CollectChangedRenderStates();
 
     void ApplySimpleRenderState(uint32_t State, uint32_t Value);
     void ApplyDeferredRenderState(uint32_t State, uint32_t Value);
@@ -61,7 +87,16 @@ private:
 
     uint32_t* D3D__RenderState = nullptr;
     int WireFrameMode = 0;
-    // NOTE: RenderStates are 32bit values, but using a 64bit value allows the upper bits to be used as a 'force dirty' flag
-    std::array<uint64_t, xbox::X_D3DRS_LAST + 1> PreviousRenderStateValues;
+    uint32_t HostStateChanges = 0;
+    // Number of render states present in the current XDK
+    unsigned XboxRenderStateCount = 0;
+    // The values last applied to the host, in the order of the current XDK
+    std::array<uint32_t, xbox::X_D3DRS_LAST + 1> PreviousXboxRenderStateValues;
+    // One bit for each render state (in the order of the current XDK) that must be applied.
+    // Set by the setters, and by comparing against the previous values, since the Xbox D3D code
+    // also writes render states directly
+    std::array<uint32_t, (xbox::X_D3DRS_LAST + 32) / 32> DirtyXboxRenderStates = {};
     std::array<int, xbox::X_D3DRS_LAST + 1>  XboxRenderStateOffsets;
+    // Reverse mapping of the above (from the index within the current XDK to the Cxbx Render State)
+    std::array<uint32_t, xbox::X_D3DRS_LAST + 1>  XboxRenderStates;
 };
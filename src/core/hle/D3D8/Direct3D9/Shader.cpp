@@ -29,6 +29,7 @@
 
 #include <d3dcompiler.h>
 #include "Shader.h"
+#include "ShaderCache.h"
 #include "core\kernel\init\CxbxKrnl.h" // LOG_TEST_CASE
 #include "core\kernel\support\Emu.h" // EmuLog
 //#include <sstream>
@@ -59,6 +60,28 @@ extern HRESULT EmuCompileShader
 	ID3DBlob* pErrorsCompatibility = nullptr;
 	HRESULT             hRet = 0;
 
+	// Reuse bytecode compiled during earlier sessions, keyed on the source with all includes expanded
+	bool bCacheable = false;
+	uint64_t cacheKey = 0;
+	ID3DBlob* pPreprocessed = nullptr;
+	hRet = D3DPreprocess(
+		hlsl_str.c_str(),
+		hlsl_str.length(),
+		pSourceName,
+		nullptr, // pDefines
+		D3D_COMPILE_STANDARD_FILE_INCLUDE, // pInclude
+		&pPreprocessed, // out
+		nullptr // ppErrorMsgs out (D3DCompile reports these)
+	);
+	if (SUCCEEDED(hRet)) {
+		bCacheable = true;
+		cacheKey = CxbxShaderCacheKey(pPreprocessed, shader_profile);
+		pPreprocessed->Release();
+		if (CxbxShaderCacheLoad(cacheKey, ppHostShader)) {
+			return S_OK;
+		}
+	}
+
 	EmuLog(LOG_LEVEL::DEBUG, "--- HLSL conversion ---");
 	EmuLog(LOG_LEVEL::DEBUG, DebugPrependLineNumbers(hlsl_str).c_str());
 	EmuLog(LOG_LEVEL::DEBUG, "-----------------------");
@@ -104,6 +127,10 @@ extern HRESULT EmuCompileShader
 		}
 	}
 
+	if (SUCCEEDED(hRet) && bCacheable) {
+		CxbxShaderCacheStore(cacheKey, *ppHostShader);
+	}
+
 	// Determine the log level
 	auto hlslErrorLogLevel = FAILED(hRet) ? LOG_LEVEL::ERROR2 : LOG_LEVEL::DEBUG;
 	if (pErrors) {
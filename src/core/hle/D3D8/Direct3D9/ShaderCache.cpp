@@ -0,0 +1,292 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+// ******************************************************************
+// *
+// *  This file is part of the Cxbx project.
+// *
+// *  Cxbx and Cxbe are free software; you can redistribute them
+// *  and/or modify them under the terms of the GNU General Public
+// *  License as published by the Free Software Foundation; either
+// *  version 2 of the license, or (at your option) any later version.
+// *
+// *  This program is distributed in the hope that it will be useful,
+// *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+// *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// *  GNU General Public License for more details.
+// *
+// *  You should have recieved a copy of the GNU General Public License
+// *  along with this program; see the file COPYING.
+// *  If not, write to the Free Software Foundation, Inc.,
+// *  59 Temple Place - Suite 330, Bostom, MA 02111-1307, USA.
+// *
+// *  All rights reserved
+// *
+// ******************************************************************
+
+#define LOG_PREFIX CXBXR_MODULE::D3D8
+
+#include <future>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "ShaderCache.h"
+#include "Cxbx.h" // For CxbxSetThreadName
+#include "CxbxVersion.h" // For GetGitVersionStr
+#include "EmuShared.h" // For g_EmuShared
+#include "core\kernel\init\CxbxKrnl.h" // For g_pCertificate
+#include "core\kernel\support\Emu.h" // EmuLog
+#include "xxhash.h"
+
+// Pack layout : A ShaderCachePackHeader, followed by any number of records,
+// each being a ShaderCacheRecordHeader directly followed by Size bytes of bytecode.
+// Records are only ever appended; A truncated last record is discarded on load.
+constexpr uint32_t SHADER_CACHE_MAGIC = 0x43535843; // "CXSC"
+constexpr uint32_t SHADER_CACHE_FORMAT_VERSION = 1;
+
+#pragma pack(push, 1)
+struct ShaderCachePackHeader {
+	uint32_t Magic;
+	uint32_t FormatVersion;
+	char BuildVersion[GitVersionMaxLength]; // Shaders are only reused by the exact same build
+};
+
+struct ShaderCacheRecordHeader {
+	uint64_t Key;
+	uint32_t Size;
+};
+#pragma pack(pop)
+
+struct ShaderCacheEntry {
+	const uint8_t* pData; // Points either into the mapped view, or into g_ShaderCacheAppendedData
+	uint32_t Size;
+};
+
+static HANDLE g_hShaderCacheFile = INVALID_HANDLE_VALUE;
+static HANDLE g_hShaderCacheMapping = NULL;
+static const uint8_t* g_pShaderCacheView = nullptr;
+static std::unordered_map<uint64_t, ShaderCacheEntry> g_ShaderCacheIndex;
+static std::list<std::vector<uint8_t>> g_ShaderCacheAppendedData;
+static std::shared_future<void> g_ShaderCacheReady;
+static std::mutex g_ShaderCacheMtx;
+
+static void InitPackHeader(ShaderCachePackHeader& Header)
+{
+	memset(&Header, 0, sizeof(Header));
+	Header.Magic = SHADER_CACHE_MAGIC;
+	Header.FormatVersion = SHADER_CACHE_FORMAT_VERSION;
+	strncpy(Header.BuildVersion, GetGitVersionStr(), sizeof(Header.BuildVersion) - 1);
+}
+
+static bool ResetPack()
+{
+	ShaderCachePackHeader Header;
+	InitPackHeader(Header);
+
+	DWORD BytesWritten;
+	SetFilePointer(g_hShaderCacheFile, 0, nullptr, FILE_BEGIN);
+	return SetEndOfFile(g_hShaderCacheFile)
+		&& WriteFile(g_hShaderCacheFile, &Header, sizeof(Header), &BytesWritten, nullptr)
+		&& (BytesWritten == sizeof(Header));
+}
+
+static void UnmapPack()
+{
+	if (g_pShaderCacheView != nullptr) {
+		UnmapViewOfFile(g_pShaderCacheView);
+		g_pShaderCacheView = nullptr;
+	}
+
+	if (g_hShaderCacheMapping != NULL) {
+		CloseHandle(g_hShaderCacheMapping);
+		g_hShaderCacheMapping = NULL;
+	}
+}
+
+// Maps the pack and indexes all complete records; Returns the size covered by those (zero for unusable packs)
+static DWORD MapAndIndexPack(DWORD FileSize, std::unordered_map<uint64_t, ShaderCacheEntry>& Index)
+{
+	Index.clear();
+
+	if (FileSize < sizeof(ShaderCachePackHeader)) {
+		return 0;
+	}
+
+	g_hShaderCacheMapping = CreateFileMappingA(g_hShaderCacheFile, nullptr, PAGE_READONLY, 0, FileSize, nullptr);
+	if (g_hShaderCacheMapping == NULL) {
+		return 0;
+	}
+
+	g_pShaderCacheView = (const uint8_t*)MapViewOfFile(g_hShaderCacheMapping, FILE_MAP_READ, 0, 0, FileSize);
+	if (g_pShaderCacheView == nullptr) {
+		return 0;
+	}
+
+	ShaderCachePackHeader Expected;
+	InitPackHeader(Expected);
+	if (memcmp(g_pShaderCacheView, &Expected, sizeof(Expected)) != 0) {
+		return 0;
+	}
+
+	// Only the record headers are touched here, so the bytecode itself is paged in lazily
+	DWORD Offset = sizeof(ShaderCachePackHeader);
+	while (Offset + sizeof(ShaderCacheRecordHeader) <= FileSize) {
+		const ShaderCacheRecordHeader* pRecord = (const ShaderCacheRecordHeader*)(g_pShaderCacheView + Offset);
+		if (pRecord->Size > FileSize - Offset - sizeof(ShaderCacheRecordHeader)) {
+			break;
+		}
+
+		Offset += sizeof(ShaderCacheRecordHeader);
+		Index[pRecord->Key] = { g_pShaderCacheView + Offset, pRecord->Size };
+		Offset += pRecord->Size;
+	}
+
+	return Offset;
+}
+
+// Opens and indexes the pack, and positions the file at the end of the last complete record
+// Note : Only the index is shared with CxbxShaderCacheLoad before g_ShaderCacheReady is set, so the
+// file is read without holding the lock, after which the index is published in one go
+static void OpenPack(const std::string& PackPath)
+{
+	std::unordered_map<uint64_t, ShaderCacheEntry> Index;
+
+	g_hShaderCacheFile = CreateFileA(PackPath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (g_hShaderCacheFile == INVALID_HANDLE_VALUE) {
+		EmuLog(LOG_LEVEL::WARNING, "Could not open shader cache %s", PackPath.c_str());
+		return;
+	}
+
+	DWORD FileSize = GetFileSize(g_hShaderCacheFile, nullptr);
+	DWORD ValidSize = MapAndIndexPack(FileSize, Index);
+	if (ValidSize != 0 && ValidSize < FileSize) {
+		// Drop the truncated last record (which can only be done while the file isn't mapped)
+		UnmapPack();
+		SetFilePointer(g_hShaderCacheFile, ValidSize, nullptr, FILE_BEGIN);
+		SetEndOfFile(g_hShaderCacheFile);
+		ValidSize = MapAndIndexPack(ValidSize, Index);
+	}
+
+	if (ValidSize == 0) {
+		// Empty, outdated or damaged pack; Start over
+		UnmapPack();
+		if (!ResetPack()) {
+			EmuLog(LOG_LEVEL::WARNING, "Could not reset shader cache %s", PackPath.c_str());
+			CloseHandle(g_hShaderCacheFile);
+			g_hShaderCacheFile = INVALID_HANDLE_VALUE;
+		}
+
+		return;
+	}
+
+	// New records are appended after the last complete one
+	SetFilePointer(g_hShaderCacheFile, ValidSize, nullptr, FILE_BEGIN);
+
+	EmuLog(LOG_LEVEL::INFO, "Loaded %u shaders from shader cache %s", Index.size(), PackPath.c_str());
+
+	std::lock_guard<std::mutex> lck(g_ShaderCacheMtx);
+	g_ShaderCacheIndex = std::move(Index);
+}
+
+static void PrewarmPack()
+{
+	// Read one byte per page, so that the first use of a cached shader doesn't have to wait for the disk
+	// Note : This runs without holding the lock; The view stays mapped until the process exits
+	std::vector<ShaderCacheEntry> Entries;
+	{
+		std::lock_guard<std::mutex> lck(g_ShaderCacheMtx);
+		Entries.reserve(g_ShaderCacheIndex.size());
+		for (auto& it : g_ShaderCacheIndex) {
+			Entries.push_back(it.second);
+		}
+	}
+
+	volatile uint8_t Sink = 0;
+	for (const auto& Entry : Entries) {
+		for (uint32_t Offset = 0; Offset < Entry.Size; Offset += 4096) {
+			Sink += Entry.pData[Offset];
+		}
+	}
+}
+
+void CxbxShaderCacheInit()
+{
+	if (g_pCertificate == nullptr) {
+		return;
+	}
+
+	char dataLocation[xbox::max_path];
+	g_EmuShared->GetDataLocation(dataLocation);
+	std::string cacheDir = std::string(dataLocation) + "\\ShaderCache";
+	CreateDirectoryA(cacheDir.c_str(), nullptr);
+
+	char titleId[9];
+	sprintf(titleId, "%08X", g_pCertificate->dwTitleId);
+	std::string packPath = cacheDir + "\\" + titleId + ".bin";
+
+	g_ShaderCacheReady = std::async(std::launch::async, [packPath]() {
+		CxbxSetThreadName("Cxbx Shader Cache");
+		OpenPack(packPath);
+		PrewarmPack();
+	}).share();
+}
+
+uint64_t CxbxShaderCacheKey(ID3DBlob* pPreprocessedSource, const char* shader_profile)
+{
+	// Note : ComputeHash could select CRC32C, which is too narrow to key a persistent cache with, so use XXH3 directly
+	return XXH3_64bits_withSeed(pPreprocessedSource->GetBufferPointer(), pPreprocessedSource->GetBufferSize(), XXH3_64bits(shader_profile, strlen(shader_profile)));
+}
+
+bool CxbxShaderCacheLoad(uint64_t key, ID3DBlob** ppHostShader)
+{
+	if (!g_ShaderCacheReady.valid()) {
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lck(g_ShaderCacheMtx);
+
+	auto it = g_ShaderCacheIndex.find(key);
+	if (it == g_ShaderCacheIndex.end()) {
+		return false;
+	}
+
+	if (FAILED(D3DCreateBlob(it->second.Size, ppHostShader))) {
+		return false;
+	}
+
+	memcpy((*ppHostShader)->GetBufferPointer(), it->second.pData, it->second.Size);
+	return true;
+}
+
+void CxbxShaderCacheStore(uint64_t key, ID3DBlob* pHostShader)
+{
+	if (!g_ShaderCacheReady.valid() || pHostShader == nullptr) {
+		return;
+	}
+
+	// Make sure the pack was opened (and indexed) before appending to it
+	g_ShaderCacheReady.wait();
+
+	std::lock_guard<std::mutex> lck(g_ShaderCacheMtx);
+
+	if (g_hShaderCacheFile == INVALID_HANDLE_VALUE || g_ShaderCacheIndex.count(key)) {
+		return;
+	}
+
+	const uint8_t* pData = (const uint8_t*)pHostShader->GetBufferPointer();
+	ShaderCacheRecordHeader Record = { key, (uint32_t)pHostShader->GetBufferSize() };
+
+	// Write the header and bytecode in one go, to avoid leaving a partial record behind
+	std::vector<uint8_t> Buffer(sizeof(Record) + Record.Size);
+	memcpy(Buffer.data(), &Record, sizeof(Record));
+	memcpy(Buffer.data() + sizeof(Record), pData, Record.Size);
+
+	DWORD BytesWritten;
+	if (!WriteFile(g_hShaderCacheFile, Buffer.data(), (DWORD)Buffer.size(), &BytesWritten, nullptr) || BytesWritten != Buffer.size()) {
+		EmuLog(LOG_LEVEL::WARNING, "Could not write to the shader cache");
+	}
+
+	// Appended records lie beyond the mapped view, so keep a copy for this session
+	g_ShaderCacheAppendedData.emplace_back(pData, pData + Record.Size);
+	g_ShaderCacheIndex[key] = { g_ShaderCacheAppendedData.back().data(), Record.Size };
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint> // uint64_t
+#include <d3dcompiler.h> // ID3DBlob
+
+// Persistent cache of compiled host shader bytecode, stored in one pack file per title.
+// The pack is invalidated as a whole when the emulator build (and thus the shader translators) changes.
+
+// Opens the pack of the running title and indexes (and pre-warms) it on a background thread
+extern void CxbxShaderCacheInit();
+
+// Returns a key identifying the given HLSL source and shader profile. The source must be preprocessed
+// (see D3DPreprocess), so that changes to included files result in a different key too
+extern uint64_t CxbxShaderCacheKey(ID3DBlob* pPreprocessedSource, const char* shader_profile);
+
+// Returns true (and a newly created blob) when bytecode for the given key was cached
+extern bool CxbxShaderCacheLoad(uint64_t key, ID3DBlob** ppHostShader);
+
+// Appends the given bytecode to the pack
+extern void CxbxShaderCacheStore(uint64_t key, ID3DBlob* pHostShader);
@@ -0,0 +1,91 @@
+#define LOG_PREFIX CXBXR_MODULE::D3DCVT
+
+#include "TextureConversion.h"
+#include "WorkerPool.h"
+
+#include <atomic>
+#include <memory>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <utility>
+#include <imgui.h>
+
+TextureConverter g_TextureConverter;
+
+// The jobs of a single Run, taken one by one by whichever thread gets to them first.
+// Shared with the worker pool, as a worker may only get around to it after the batch is done
+struct TextureConversionBatch {
+	std::vector<TextureConversionJob>* pJobs;
+	size_t jobCount;
+	std::atomic<size_t> nextJob = 0;
+	std::mutex batchMutex;
+	std::condition_variable jobsDone;
+	size_t doneJobs = 0;
+};
+
+static void RunBatchJobs(TextureConversionBatch& batch)
+{
+	size_t i;
+	while ((i = batch.nextJob++) < batch.jobCount) {
+		(*batch.pJobs)[i]();
+
+		std::lock_guard<std::mutex> lck(batch.batchMutex);
+		if (++batch.doneJobs == batch.jobCount) {
+			batch.jobsDone.notify_all();
+		}
+	}
+}
+
+void TextureConverter::Run(std::vector<TextureConversionJob>& jobs, bool bParallel)
+{
+	auto startTime = std::chrono::steady_clock::now();
+
+	if (bParallel && jobs.size() > 1) {
+		auto batch = std::make_shared<TextureConversionBatch>();
+		batch->pJobs = &jobs;
+		batch->jobCount = jobs.size();
+
+		// Texture conversions block the draw that needs them, so they go before any speculative work
+		for (size_t i = 1; i < jobs.size(); i++) {
+			g_WorkerPool.Submit([batch] { RunBatchJobs(*batch); }, WorkerPriority::High);
+		}
+
+		// Help out, instead of idling until the workers are done
+		RunBatchJobs(*batch);
+		std::unique_lock<std::mutex> lck(batch->batchMutex);
+		batch->jobsDone.wait(lck, [&batch] { return batch->doneJobs == batch->jobCount; });
+	}
+	else {
+		for (auto& job : jobs) {
+			job();
+		}
+	}
+
+	double convertMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+	std::lock_guard<std::mutex> lck(statsMutex);
+	convertedTextures++;
+	convertedJobs += (unsigned)jobs.size();
+	if (bParallel && jobs.size() > 1) {
+		parallelTextures++;
+	}
+
+	totalConvertMs += convertMs;
+	maxConvertMs = std::max(maxConvertMs, convertMs);
+}
+
+void TextureConverter::DrawConversionStats()
+{
+	std::lock_guard<std::mutex> lck(statsMutex);
+
+	ImGui::Text("Threads: %u", g_WorkerPool.GetWorkerCount());
+	ImGui::Separator();
+	unsigned converted = std::exchange(convertedTextures, 0);
+	double averageConvertMs = converted ? std::exchange(totalConvertMs, 0) / converted : 0;
+	ImGui::Text("Converted: %u", converted);
+	ImGui::Text("Parallel: %u", std::exchange(parallelTextures, 0));
+	ImGui::Text("Levels/faces: %u", std::exchange(convertedJobs, 0));
+	ImGui::Text("Convert avg: %.2f ms", averageConvertMs);
+	ImGui::Text("Convert max: %.2f ms", std::exchange(maxConvertMs, 0));
+}
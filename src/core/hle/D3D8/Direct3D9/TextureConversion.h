@@ -0,0 +1,37 @@
+#ifndef TEXTURECONVERSION_H
+#define TEXTURECONVERSION_H
+
+#include <vector>
+#include <functional>
+#include <mutex>
+
+// A single unit of texture conversion work, like unswizzling and/or converting one
+// mip level of one cube face. Jobs must not call into the host D3D device
+typedef std::function<void()> TextureConversionJob;
+
+// Runs texture conversion jobs, spreading them over the shared worker pool.
+// Doesn't depend on the D3D device, so it can be driven headless
+class TextureConverter {
+
+public:
+	// Runs all jobs and returns once they are done. When bParallel is set, the jobs are
+	// spread over the worker threads (the calling thread helps out), otherwise they run in order
+	void Run(std::vector<TextureConversionJob>& jobs, bool bParallel);
+
+	void DrawConversionStats();
+
+private:
+	// Guards the statistics below
+	std::mutex statsMutex;
+
+	// Statistics
+	unsigned convertedTextures = 0;
+	unsigned parallelTextures = 0;
+	unsigned convertedJobs = 0;
+	double totalConvertMs = 0;
+	double maxConvertMs = 0;
+};
+
+extern TextureConverter g_TextureConverter;
+
+#endif
@@ -36,6 +36,9 @@
 #include "core/hle/D3D8/XbVertexShader.h" // For g_UseFixedFunctionVertexShader, g_Xbox_VertexShaderMode and VertexShaderMode::FixedFunction
 #include "core/hle/D3D8/Direct3D9/Direct3D9.h" // For g_pD3DDevice
 #include <optional>
+#include <algorithm>
+#include <bit>
+#include <utility>
 
 typedef struct {
     const char* S;          // String representation.
@@ -120,6 +123,35 @@ void XboxTextureStateConverter::BuildTextureStateMappingTable()
         EmuLog(LOG_LEVEL::INFO, "%s = %d", CxbxTextureStateInfo[State].S, index);
         XboxTextureStateOffsets[index] = State;
     }
+
+    for (int State = xbox::X_D3DTSS_FIRST; State <= xbox::X_D3DTSS_LAST; State++) {
+        XboxTextureStates[XboxTextureStateOffsets[State]] = State;
+    }
+}
+
+uint32_t XboxTextureStateConverter::GetAndResetHostStateChanges()
+{
+    return std::exchange(HostStateChanges, 0);
+}
+
+// Marks all texture states that were written since they were last set as dirty.
+// Compares all states of a stage at once against the values that were set last
+void XboxTextureStateConverter::CollectChangedTextureStates()
+{
+    for (int XboxStage = 0; XboxStage < xbox::X_D3DTS_STAGECOUNT; XboxStage++) {
+        uint32_t ChangedOffsets = DiffXboxStates(&D3D__TextureState[XboxStage * xbox::X_D3DTS_STAGESIZE], PreviousXboxTextureStates[XboxStage], xbox::X_D3DTSS_LAST + 1);
+        while (ChangedOffsets) {
+            int Offset = std::countr_zero(ChangedOffsets);
+            ChangedOffsets &= ChangedOffsets - 1;
+            DirtyTextureStates[XboxStage] |= 1u << XboxTextureStates[Offset];
+        }
+    }
+}
+
+bool XboxTextureStateConverter::HasPendingChanges()
+{
+    CollectChangedTextureStates();
+    return std::any_of(std::begin(DirtyTextureStates), std::end(DirtyTextureStates), [](uint32_t DirtyMask) { return DirtyMask != 0; });
 }
 
 DWORD XboxTextureStateConverter::GetHostTextureOpValue(DWORD Value)
@@ -173,20 +205,28 @@ void XboxTextureStateConverter::Apply()
         pointSpriteOverride = true;
     }
 
+    CollectChangedTextureStates();
+
     for (int XboxStage = 0; XboxStage < xbox::X_D3DTS_STAGECOUNT; XboxStage++) {
         // If point sprites are enabled, we need to overwrite our existing state 0 with State 3 also
         DWORD HostStage = (pointSpriteOverride && XboxStage == 3) ? 0 : XboxStage;
 
-        for (int State = xbox::X_D3DTSS_FIRST; State <= xbox::X_D3DTSS_LAST; State++) {
+        // Visit only the states that changed since they were last set
+        uint32_t DirtyMask = std::exchange(DirtyTextureStates[XboxStage], 0);
+        while (DirtyMask) {
+            int State = std::countr_zero(DirtyMask);
+            DirtyMask &= DirtyMask - 1;
+            if (State > xbox::X_D3DTSS_LAST) {
+                break;
+            }
+
             // Read the value of the current stage/state from the Xbox data structure
             DWORD XboxValue = Get(XboxStage, State);
             DWORD PcValue = XboxValue;
 
-            // If the state hasn't changed, skip setting it
-            auto lastState = &PreviousStates[XboxStage][State];
-            if (*lastState == XboxValue) {
-                continue;
-            }
+            // Record the state as set (states without a PC counterpart are skipped below)
+            int Offset = XboxTextureStateOffsets[State];
+            PreviousXboxTextureStates[XboxStage][Offset] = D3D__TextureState[(XboxStage * xbox::X_D3DTS_STAGESIZE) + Offset];
 
             switch (State) {
                 // These types map 1:1 but have some unsupported values
@@ -306,8 +346,7 @@ void XboxTextureStateConverter::Apply()
                 g_pD3DDevice->SetTextureStageState(HostStage, (D3DTEXTURESTAGESTATETYPE)CxbxTextureStateInfo[State].PC, PcValue);
             }
 
-            // Record we set a state
-            lastState->emplace(XboxValue);
+            HostStateChanges++;
         }
 
         // Make sure we only do this once
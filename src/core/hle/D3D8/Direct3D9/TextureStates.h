@@ -40,16 +40,27 @@ public:
     bool Init(XboxRenderStateConverter* state);
     void Apply();
     uint32_t Get(int textureStage, DWORD xboxState);
+    // Returns (and resets) the number of texture and sampler states forwarded to the host
+    uint32_t GetAndResetHostStateChanges();
+    // Returns whether any texture state changed since the last Apply
+    bool HasPendingChanges();
 
 private:
     void BuildTextureStateMappingTable();
+    void CollectChangedTextureStates();
     DWORD GetHostTextureOpValue(DWORD XboxTextureOp);
 
     // Pointer to Xbox texture states
     // Note mappings may change between XDK versions
     uint32_t* D3D__TextureState = nullptr;
     std::array<int, xbox::X_D3DTSS_LAST + 1> XboxTextureStateOffsets;
+    // Reverse mapping of the above (from the offset within the current XDK to the Cxbx Texture State)
+    std::array<int, xbox::X_D3DTSS_LAST + 1> XboxTextureStates;
     XboxRenderStateConverter* pXboxRenderStates;
-    // Holds the last state that was set, so we don't set it again
-    std::optional<DWORD> PreviousStates[xbox::X_D3DTS_STAGECOUNT][xbox::X_D3DTSS_LAST + 1] = {};
+    uint32_t HostStateChanges = 0;
+    // Holds the last (raw) state values that were set, so we don't set them again
+    uint32_t PreviousXboxTextureStates[xbox::X_D3DTS_STAGECOUNT][xbox::X_D3DTS_STAGESIZE] = {};
+    // One bit per Cxbx Texture State for each stage, marking the states that must be set.
+    // All states are set on the first Apply
+    uint32_t DirtyTextureStates[xbox::X_D3DTS_STAGECOUNT] = { UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX };
 };
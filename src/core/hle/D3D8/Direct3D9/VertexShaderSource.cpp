@@ -1,28 +1,20 @@
 #define LOG_PREFIX CXBXR_MODULE::VSHCACHE
 
 #include "VertexShaderSource.h"
+#include "WorkerPool.h"
 
 #include "core/kernel/init/CxbxKrnl.h"
 #include "util/hasher.h"
 #include "core/kernel/support/Emu.h"
+#include "Cxbx.h"
+
+#include <algorithm>
+#include <imgui.h>
 
 VertexShaderSource g_VertexShaderSource = VertexShaderSource();
 // FIXME : This should really be released and created in step with the D3D device lifecycle rather than being a thing on its own
 // (And the ResetD3DDevice method should be removed)
 
-ID3DBlob* AsyncCreateVertexShader(IntermediateVertexShader intermediateShader, ShaderKey key) {
-	ID3DBlob* pCompiledShader;
-
-	auto hRet = EmuCompileVertexShader(
-		&intermediateShader,
-		&pCompiledShader
-	);
-
-	EmuLog(LOG_LEVEL::DEBUG, "Finished compiling shader %llx", key);
-
-	return pCompiledShader;
-}
-
 // Find a shader
 // Return true if the shader was found
  bool VertexShaderSource::_FindShader(ShaderKey key, LazyVertexShader** ppLazyShader) {
@@ -37,39 +29,79 @@ ID3DBlob* AsyncCreateVertexShader(IntermediateVertexShader intermediateShader, S
 	return true;
 }
 
- // Create a new shader
- // If the shader was already created, just increase its reference count
-ShaderKey VertexShaderSource::CreateShader(const xbox::dword_xt* pXboxFunction, DWORD *pXboxFunctionSize) {
-	IntermediateVertexShader intermediateShader;
+// Called with cacheMutex held. A job boosted from Prewarm to Draw priority gets queued
+// twice; whichever entry a worker thread picks up first compiles it
+void VertexShaderSource::_QueueJob(const std::shared_ptr<CompileJob>& job)
+{
+	WorkerPriority priority = (job->priority == ShaderCompilePriority::Draw) ? WorkerPriority::High : WorkerPriority::Low;
+	g_WorkerPool.Submit([this, job] { _CompileJob(job); }, priority);
+}
 
-	*pXboxFunctionSize = GetVshFunctionSize(pXboxFunction);
+// Runs on a worker thread
+void VertexShaderSource::_CompileJob(const std::shared_ptr<CompileJob>& job)
+{
+	{
+		std::lock_guard<std::mutex> lck(cacheMutex);
 
-	ShaderKey key = ComputeHash((void*)pXboxFunction, *pXboxFunctionSize);
+		// Skip stale entries of boosted jobs that already got picked up
+		if (job->state != CompileJob::State::Queued) {
+			return;
+		}
 
-	// Check if we need to create the shader
-	auto it = cache.find(key);
-	if (it != cache.end()) {
-		EmuLog(LOG_LEVEL::DEBUG, "Vertex shader %llx has been created already", key);
-		// Increment reference count
-		it->second.referenceCount++;
-		EmuLog(LOG_LEVEL::DEBUG, "Incremented ref count for shader %llx (%d)", key, it->second.referenceCount);
-		return key;
+		job->state = CompileJob::State::Running;
+		queuedJobs--;
+		runningJobs++;
 	}
 
+	auto compileStart = std::chrono::steady_clock::now();
+
+	ID3DBlob* pCompiledShader = nullptr;
+	EmuCompileVertexShader(&job->intermediateShader, &pCompiledShader);
+
+	auto compileEnd = std::chrono::steady_clock::now();
+	double compileMs = std::chrono::duration<double, std::milli>(compileEnd - compileStart).count();
+	double latencyMs = std::chrono::duration<double, std::milli>(compileEnd - job->queueTime).count();
+
+	EmuLog(LOG_LEVEL::DEBUG, "Finished compiling shader %llx (%.2f ms)", job->key, compileMs);
+
+	{
+		std::lock_guard<std::mutex> lck(cacheMutex);
+		job->pCompiledShader = pCompiledShader;
+		job->state = CompileJob::State::Done;
+		// The intermediate shader is no longer needed
+		job->intermediateShader = IntermediateVertexShader();
+		runningJobs--;
+
+		compiledShaders++;
+		totalCompileMs += compileMs;
+		maxCompileMs = std::max(maxCompileMs, compileMs);
+		totalLatencyMs += latencyMs;
+	}
+
+	jobDone.notify_all();
+}
+
+// Called with cacheMutex held
+VertexShaderSource::LazyVertexShader* VertexShaderSource::_InsertShader(const xbox::dword_xt* pXboxFunction, DWORD xboxFunctionSize, ShaderKey key, ShaderCompilePriority priority)
+{
+	auto job = std::make_shared<CompileJob>();
+	job->key = key;
+	job->priority = priority;
+
 	// Parse into intermediate format
-	EmuParseVshFunction((DWORD*)pXboxFunction, &intermediateShader);
+	EmuParseVshFunction((DWORD*)pXboxFunction, &job->intermediateShader);
 
 	// We're going to create a new shader
-	auto newShader = LazyVertexShader();
-	newShader.referenceCount = 1;
+	auto& newShader = cache[key];
 
-	if (!intermediateShader.Instructions.empty())
+	if (!job->intermediateShader.Instructions.empty())
 	{
-		// Start compiling the shader in the background
-		// TODO proper threading / threadpool.
-		// We should have some control over the number and priority of threads
-		EmuLog(LOG_LEVEL::DEBUG, "Creating vertex shader %llx size %d", key, *pXboxFunctionSize);
-		newShader.compileResult = std::async(std::launch::async, AsyncCreateVertexShader, intermediateShader, key);
+		// Queue the shader for compilation in the background
+		EmuLog(LOG_LEVEL::DEBUG, "Creating vertex shader %llx size %d", key, xboxFunctionSize);
+		job->queueTime = std::chrono::steady_clock::now();
+		newShader.compileJob = job;
+		queuedJobs++;
+		_QueueJob(job);
 	}
 	else {
 		// We can't do anything with this shader
@@ -79,40 +111,66 @@ ShaderKey VertexShaderSource::CreateShader(const xbox::dword_xt* pXboxFunction,
 		newShader.pHostVertexShader = nullptr;
 	}
 
-	// Put the shader into the cache
-	cache[key] = std::move(newShader);
+	return &newShader;
+}
+
+ // Create a new shader
+ // If the shader was already created, just increase its reference count
+ShaderKey VertexShaderSource::CreateShader(const xbox::dword_xt* pXboxFunction, DWORD *pXboxFunctionSize) {
+	*pXboxFunctionSize = GetVshFunctionSize(pXboxFunction);
+
+	ShaderKey key = ComputeHash((void*)pXboxFunction, *pXboxFunctionSize);
+
+	std::lock_guard<std::mutex> lck(cacheMutex);
+
+	// Check if we need to create the shader
+	auto it = cache.find(key);
+	if (it != cache.end()) {
+		EmuLog(LOG_LEVEL::DEBUG, "Vertex shader %llx has been created already", key);
+		// If this shader was only queued for pre-warming, it's needed now
+		auto& job = it->second.compileJob;
+		if (job && job->state == CompileJob::State::Queued && job->priority == ShaderCompilePriority::Prewarm) {
+			job->priority = ShaderCompilePriority::Draw;
+			_QueueJob(job);
+			boostedShaders++;
+		}
+
+		// Increment reference count
+		it->second.referenceCount++;
+		EmuLog(LOG_LEVEL::DEBUG, "Incremented ref count for shader %llx (%d)", key, it->second.referenceCount);
+		return key;
+	}
+
+	auto pLazyShader = _InsertShader(pXboxFunction, *pXboxFunctionSize, key, ShaderCompilePriority::Draw);
+	pLazyShader->referenceCount = 1;
 
 	return key;
 }
 
-// Get a shader using the given key
-IDirect3DVertexShader* VertexShaderSource::GetShader(ShaderKey key)
+// Start compiling a shader that will probably be drawn with soon
+void VertexShaderSource::PrewarmShader(const xbox::dword_xt* pXboxFunction)
 {
-	LazyVertexShader* pLazyShader = nullptr;
+	DWORD xboxFunctionSize = GetVshFunctionSize(pXboxFunction);
+	ShaderKey key = ComputeHash((void*)pXboxFunction, xboxFunctionSize);
 
-	// Look for the shader in the cache
-	if (!_FindShader(key, &pLazyShader)) {
-		return nullptr; // we didn't find anything
-	}
+	std::lock_guard<std::mutex> lck(cacheMutex);
 
-	// If the shader is ready, return it
-	if (pLazyShader->isReady) {
-		return pLazyShader->pHostVertexShader;
+	// Requests for shaders that are known already (or in flight) are dropped
+	if (cache.find(key) != cache.end()) {
+		return;
 	}
 
-	// If there's no D3DDevice set, return nullptr
-	if (pD3DDevice == nullptr) {
-		EmuLog(LOG_LEVEL::WARNING, "Can't create shader - no D3D device is set!");
-		return nullptr;
-	}
+	_InsertShader(pXboxFunction, xboxFunctionSize, key, ShaderCompilePriority::Prewarm);
+	prewarmedShaders++;
+}
 
-	// We need to get the compiled HLSL and create a shader from it
-	ID3DBlob* pCompiledShader = nullptr;
-	try {
-		// TODO one day, check is_ready before logging this (non-standard..?)
-		EmuLog(LOG_LEVEL::DEBUG, "Waiting for shader %llx...", key);
-		pCompiledShader = pLazyShader->compileResult.get();
+// Called with cacheMutex held, once the compile job is done
+void VertexShaderSource::_CreateHostShader(ShaderKey key, LazyVertexShader* pLazyShader)
+{
+	ID3DBlob* pCompiledShader = pLazyShader->compileJob->pCompiledShader;
+	pLazyShader->compileJob.reset();
 
+	if (pCompiledShader) {
 		// Create the shader
 		auto hRet = pD3DDevice->CreateVertexShader
 		(
@@ -127,19 +185,62 @@ IDirect3DVertexShader* VertexShaderSource::GetShader(ShaderKey key)
 		else {
 			EmuLog(LOG_LEVEL::ERROR2, "Failed creating new vertex shader instance for %llx", key);
 		}
-	}
-	catch (const std::exception & e) {
-		EmuLog(LOG_LEVEL::ERROR2, "Failed compiling shader %llx: %s", e.what());
-	}
 
-	if (pCompiledShader) {
 		pCompiledShader->Release();
 
 		// TODO compile the shader at a higher optimization level in a background thread?
 	}
+	else {
+		EmuLog(LOG_LEVEL::ERROR2, "Failed compiling shader %llx", key);
+	}
 
 	// The shader is ready
 	pLazyShader->isReady = true;
+}
+
+// Get a shader using the given key
+IDirect3DVertexShader* VertexShaderSource::GetShader(ShaderKey key, bool* pIsPending)
+{
+	if (pIsPending) {
+		*pIsPending = false;
+	}
+
+
+	std::unique_lock<std::mutex> lck(cacheMutex);
+
+	LazyVertexShader* pLazyShader = nullptr;
+
+	// Look for the shader in the cache
+	if (!_FindShader(key, &pLazyShader)) {
+		return nullptr; // we didn't find anything
+	}
+
+	// If the shader is ready, return it
+	if (pLazyShader->isReady) {
+		return pLazyShader->pHostVertexShader;
+	}
+
+	// If there's no D3DDevice set, return nullptr
+	if (pD3DDevice == nullptr) {
+		EmuLog(LOG_LEVEL::WARNING, "Can't create shader - no D3D device is set!");
+		return nullptr;
+	}
+
+	auto job = pLazyShader->compileJob;
+	if (job->state != CompileJob::State::Done) {
+		if (pIsPending) {
+			*pIsPending = true;
+			skippedWaits++;
+			return nullptr;
+		}
+
+		EmuLog(LOG_LEVEL::DEBUG, "Waiting for shader %llx...", key);
+		auto waitStart = std::chrono::steady_clock::now();
+		jobDone.wait(lck, [&job] { return job->state == CompileJob::State::Done; });
+		blockedMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - waitStart).count();
+	}
+
+	_CreateHostShader(key, pLazyShader);
 
 	return pLazyShader->pHostVertexShader;
 }
@@ -147,6 +248,8 @@ IDirect3DVertexShader* VertexShaderSource::GetShader(ShaderKey key)
 // Release a shader. Doesn't actually release any resources for now
 void VertexShaderSource::ReleaseShader(ShaderKey key)
 {
+	std::lock_guard<std::mutex> lck(cacheMutex);
+
 	// For now, don't bother releasing any shaders
 	LazyVertexShader* pLazyShader;
 	if (_FindShader(key, &pLazyShader)) {
@@ -170,3 +273,26 @@ void VertexShaderSource::ResetD3DDevice(IDirect3DDevice9* newDevice)
 	EmuLog(LOG_LEVEL::DEBUG, "Resetting D3D device");
 	this->pD3DDevice = newDevice;
 }
+
+void VertexShaderSource::DrawCompilerStats()
+{
+	std::lock_guard<std::mutex> lck(cacheMutex);
+
+	ImGui::Text("Threads: %u", g_WorkerPool.GetWorkerCount());
+	ImGui::Text("Cache Size: %u", cache.size());
+	ImGui::Text("Queued: %u", queuedJobs);
+	ImGui::Text("Running: %u", runningJobs);
+	ImGui::Separator();
+	ULONG compiled = std::exchange(compiledShaders, 0);
+	double averageCompileMs = compiled ? std::exchange(totalCompileMs, 0) / compiled : 0;
+	double averageLatencyMs = compiled ? std::exchange(totalLatencyMs, 0) / compiled : 0;
+	ImGui::Text("Compiled: %u", compiled);
+	ImGui::Text("Compile avg: %.2f ms", averageCompileMs);
+	ImGui::Text("Compile max: %.2f ms", std::exchange(maxCompileMs, 0));
+	ImGui::Text("Latency avg: %.2f ms", averageLatencyMs);
+	ImGui::Text("Blocked: %.2f ms", std::exchange(blockedMs, 0));
+	ImGui::Separator();
+	ImGui::Text("Prewarmed: %u", std::exchange(prewarmedShaders, 0));
+	ImGui::Text("Boosted: %u", std::exchange(boostedShaders, 0));
+	ImGui::Text("Skipped: %u", std::exchange(skippedWaits, 0));
+}
@@ -1,30 +1,56 @@
-
 #ifndef DIRECT3D9SHADERCACHE_H
 #define DIRECT3D9SHADERCACHE_H
 
 #include "VertexShader.h"
 #include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 
 typedef uint64_t ShaderKey;
 
+// Order in which queued vertex shaders are picked up by the worker threads
+enum class ShaderCompilePriority {
+	Draw = 0, // Needed by the current (or an upcoming) draw
+	Prewarm,  // Speculatively compiled ahead of use
+};
+
 // Manages creation and caching of vertex shaders
 class VertexShaderSource {
 
 public:
 	ShaderKey CreateShader(const xbox::dword_xt* pXboxFunction, DWORD* pXboxFunctionSize);
-	IDirect3DVertexShader *GetShader(ShaderKey key);
+	// Queue a shader for compilation at low priority, without taking a reference
+	void PrewarmShader(const xbox::dword_xt* pXboxFunction);
+	// Blocks until the shader is compiled, unless pIsPending is given;
+	// In that case, returns nullptr and sets *pIsPending while the shader is still compiling
+	IDirect3DVertexShader *GetShader(ShaderKey key, bool* pIsPending = nullptr);
 	void ReleaseShader(ShaderKey key);
 
 	void ResetD3DDevice(IDirect3DDevice9* pD3DDevice);
 
+	void DrawCompilerStats();
+
 	// TODO
 	// WriteCacheToDisk
 	// LoadCacheFromDisk
 
 private:
+	struct CompileJob {
+		enum class State { Queued, Running, Done };
+
+		ShaderKey key;
+		IntermediateVertexShader intermediateShader;
+		ShaderCompilePriority priority;
+		State state = State::Queued;
+		ID3DBlob* pCompiledShader = nullptr;
+		std::chrono::steady_clock::time_point queueTime;
+	};
+
 	struct LazyVertexShader {
 		bool isReady = false;
-		std::future<ID3DBlob*> compileResult;
+		std::shared_ptr<CompileJob> compileJob;
 		IDirect3DVertexShader* pHostVertexShader = nullptr;
 
 		// TODO when is it a good idea to releas eshaders?
@@ -36,10 +62,30 @@ private:
 	};
 
 	IDirect3DDevice9* pD3DDevice;
+	// Guards the cache, the compile queues and the statistics below
 	std::mutex cacheMutex;
 	std::map<ShaderKey, LazyVertexShader> cache;
 
+	// Signalled whenever a compile job is done
+	std::condition_variable jobDone;
+
+	// Statistics
+	unsigned queuedJobs = 0;
+	unsigned runningJobs = 0;
+	ULONG compiledShaders = 0;
+	ULONG prewarmedShaders = 0;
+	ULONG boostedShaders = 0;
+	ULONG skippedWaits = 0;
+	double totalCompileMs = 0;
+	double maxCompileMs = 0;
+	double totalLatencyMs = 0;
+	double blockedMs = 0;
+
 	bool _FindShader(ShaderKey key, LazyVertexShader** ppLazyShader);
+	LazyVertexShader* _InsertShader(const xbox::dword_xt* pXboxFunction, DWORD xboxFunctionSize, ShaderKey key, ShaderCompilePriority priority);
+	void _QueueJob(const std::shared_ptr<CompileJob>& job);
+	void _CompileJob(const std::shared_ptr<CompileJob>& job);
+	void _CreateHostShader(ShaderKey key, LazyVertexShader* pLazyShader);
 };
 
 extern VertexShaderSource g_VertexShaderSource;
@@ -5,7 +5,11 @@
 #include <smmintrin.h> // SSE4.1
 //#include <nmmintrin.h> // SSE4.2
 //#include <immintrin.h> // AVX
+#include <algorithm>
+#include <cstring>
 #include "common\util\CPUID.h"
+#include "common\util\hasher.h" // For ComputeHash
+#include "core\hle\D3D8\XbConvert.h" // For VERTICES_PER_QUAD
 #include "WalkIndexBuffer.h"
 
 // Walk an index buffer to find the minimum and maximum indices
@@ -85,3 +89,109 @@ void(*WalkIndexBuffer)(INDEX16 &, INDEX16 &, INDEX16 *, DWORD) =
 
 	WalkIndexBuffer(LowIndex, HighIndex, pIndexData, dwIndexCount);
 };
+
+// Convert quad list indices to triangle list indices, ABCD becomes ABC+CDA
+// (or ADC+CBA when drawing in counter-clockwise winding order)
+
+extern bool bUseClockWiseWindingOrder; // Defined in Direct3D9.cpp
+
+// Default implementation
+void ConvertQuadListToTriangleList_NoSIMD(INDEX16 *pTriangleIndexData, INDEX16 *pQuadIndexData, DWORD dwQuadIndexCount)
+{
+	const unsigned B = bUseClockWiseWindingOrder ? 1 : 3;
+	const unsigned D = bUseClockWiseWindingOrder ? 3 : 1;
+	for (DWORD j = 0; j + VERTICES_PER_QUAD <= dwQuadIndexCount; j += VERTICES_PER_QUAD) {
+		*pTriangleIndexData++ = pQuadIndexData[j + 0]; // A
+		*pTriangleIndexData++ = pQuadIndexData[j + B]; // B (or D)
+		*pTriangleIndexData++ = pQuadIndexData[j + 2]; // C
+		*pTriangleIndexData++ = pQuadIndexData[j + 2]; // C
+		*pTriangleIndexData++ = pQuadIndexData[j + D]; // D (or B)
+		*pTriangleIndexData++ = pQuadIndexData[j + 0]; // A
+	}
+}
+
+//SSE 4.1 implementation (only uses SSSE3's pshufb, which all SSE 4.1 capable CPUs have)
+void ConvertQuadListToTriangleList_SSE41(INDEX16 *pTriangleIndexData, INDEX16 *pQuadIndexData, DWORD dwQuadIndexCount)
+{
+	// Shuffle two quads (8 indices) into four triangles (12 indices) at a time.
+	// Masks select the bytes of each output index; -1 (high bit set) zeroes the unused upper half
+	const __m128i first8 = bUseClockWiseWindingOrder
+		? _mm_setr_epi8(0, 1, 2, 3, 4, 5, 4, 5, 6, 7, 0, 1, 8, 9, 10, 11) // A B C C D A A' B'
+		: _mm_setr_epi8(0, 1, 6, 7, 4, 5, 4, 5, 2, 3, 0, 1, 8, 9, 14, 15); // A D C C B A A' D'
+	const __m128i last4 = bUseClockWiseWindingOrder
+		? _mm_setr_epi8(12, 13, 12, 13, 14, 15, 8, 9, -1, -1, -1, -1, -1, -1, -1, -1) // C' C' D' A'
+		: _mm_setr_epi8(12, 13, 12, 13, 10, 11, 8, 9, -1, -1, -1, -1, -1, -1, -1, -1); // C' C' B' A'
+
+	DWORD j = 0;
+	for (; j + 8 <= dwQuadIndexCount; j += 8) {
+		__m128i quads = _mm_loadu_si128((__m128i*)&pQuadIndexData[j]);
+		_mm_storeu_si128((__m128i*)pTriangleIndexData, _mm_shuffle_epi8(quads, first8));
+		_mm_storel_epi64((__m128i*)&pTriangleIndexData[8], _mm_shuffle_epi8(quads, last4));
+		pTriangleIndexData += 12;
+	}
+
+	// Convert the last quad (if any) and drop incomplete ones, like the default implementation
+	ConvertQuadListToTriangleList_NoSIMD(pTriangleIndexData, &pQuadIndexData[j], dwQuadIndexCount - j);
+}
+
+// Detect SSE support to select real implementation on first call
+void(*ConvertQuadListToTriangleList)(INDEX16 *, INDEX16 *, DWORD) =
+[](INDEX16 *pTriangleIndexData, INDEX16 *pQuadIndexData, DWORD dwQuadIndexCount)
+{
+	SimdCaps supports;
+	if (supports.SSE41())
+		ConvertQuadListToTriangleList = ConvertQuadListToTriangleList_SSE41;
+	else
+		ConvertQuadListToTriangleList = ConvertQuadListToTriangleList_NoSIMD;
+
+	ConvertQuadListToTriangleList(pTriangleIndexData, pQuadIndexData, dwQuadIndexCount);
+};
+
+static constexpr DWORD HashBlockIndexCount = 2048; // 4 KiB of indices per block (whole quads, so none straddle two blocks)
+
+// Chain the block hashes in an order-dependant way
+static inline uint64_t ChainIndexBlockHash(uint64_t Hash, INDEX16 *pBlockData, DWORD dwBlockIndexCount)
+{
+	return (Hash ^ ComputeHash(pBlockData, dwBlockIndexCount * sizeof(INDEX16))) * 0x9E3779B97F4A7C15ull;
+}
+
+uint64_t HashIndexBuffer(INDEX16 *pIndexData, DWORD dwIndexCount)
+{
+	uint64_t Hash = 0;
+	for (DWORD i = 0; i < dwIndexCount; i += HashBlockIndexCount) {
+		Hash = ChainIndexBlockHash(Hash, &pIndexData[i], std::min(HashBlockIndexCount, dwIndexCount - i));
+	}
+
+	return Hash;
+}
+
+// Walk and hash the index buffer one block at a time, so that hashing (and writing
+// any output) reads each block from cache right after the walk fetched it from memory
+void WalkIndexBufferAndHash(INDEX16 &LowIndex, INDEX16 &HighIndex, uint64_t &Hash, INDEX16 *pIndexData, DWORD dwIndexCount, INDEX16 *pOutputData, bool bConvertQuadListToTriangleList)
+{
+	LowIndex = 0;
+	HighIndex = 0;
+	Hash = 0;
+	for (DWORD i = 0; i < dwIndexCount; i += HashBlockIndexCount) {
+		DWORD dwBlockIndexCount = std::min(HashBlockIndexCount, dwIndexCount - i);
+		INDEX16 BlockLowIndex, BlockHighIndex;
+		WalkIndexBuffer(BlockLowIndex, BlockHighIndex, &pIndexData[i], dwBlockIndexCount);
+		if (i == 0 || LowIndex > BlockLowIndex)
+			LowIndex = BlockLowIndex;
+		if (i == 0 || HighIndex < BlockHighIndex)
+			HighIndex = BlockHighIndex;
+
+		Hash = ChainIndexBlockHash(Hash, &pIndexData[i], dwBlockIndexCount);
+
+		if (pOutputData == nullptr)
+			continue;
+
+		if (bConvertQuadListToTriangleList) {
+			ConvertQuadListToTriangleList(pOutputData, &pIndexData[i], dwBlockIndexCount);
+			pOutputData += (dwBlockIndexCount / VERTICES_PER_QUAD) * 6; // 4 > 6
+		} else {
+			memcpy(pOutputData, &pIndexData[i], dwBlockIndexCount * sizeof(INDEX16));
+			pOutputData += dwBlockIndexCount;
+		}
+	}
+}
@@ -11,4 +11,33 @@ extern void(*WalkIndexBuffer)
 	DWORD dwIndexCount
 );
 
+// Expands quad list indices into triangle list indices (6 for every 4 quad indices)
+extern void(*ConvertQuadListToTriangleList)
+(
+	INDEX16 *pTriangleIndexData,
+	INDEX16 *pQuadIndexData,
+	DWORD dwQuadIndexCount
+);
+
+// Hashes the index data exactly like WalkIndexBufferAndHash does, without determining the index range
+extern uint64_t HashIndexBuffer
+(
+	INDEX16 *pIndexData,
+	DWORD dwIndexCount
+);
+
+// Combines WalkIndexBuffer with hashing the index data in a single pass.
+// When pOutputData is given, the same pass also copies the index data into it,
+// or expands it through ConvertQuadListToTriangleList if so requested
+extern void WalkIndexBufferAndHash
+(
+	INDEX16 &LowIndex,
+	INDEX16 &HighIndex,
+	uint64_t &Hash,
+	INDEX16 *pIndexData,
+	DWORD dwIndexCount,
+	INDEX16 *pOutputData = nullptr,
+	bool bConvertQuadListToTriangleList = false
+);
+
 #endif
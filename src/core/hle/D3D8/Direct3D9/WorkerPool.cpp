@@ -0,0 +1,75 @@
+#define LOG_PREFIX CXBXR_MODULE::D3D8
+
+#include "WorkerPool.h"
+
+#include "core/kernel/init/CxbxKrnl.h"
+#include "core/kernel/support/Emu.h"
+#include "common/win32/Threads.h"
+#include "Cxbx.h"
+
+#include <thread>
+#include <algorithm>
+#include <utility>
+
+WorkerPool g_WorkerPool;
+
+// Upper bound on the number of worker threads
+static const unsigned MAX_WORKER_THREADS = 4;
+
+// Called with poolMutex held. Starts the worker threads on first use, leaving one host core free
+// for the emulation and render threads. The threads are detached and live as long as the process
+void WorkerPool::_StartWorkers()
+{
+	if (workerCount > 0) {
+		return;
+	}
+
+	unsigned hostThreads = std::thread::hardware_concurrency();
+	workerCount = std::min(std::max(hostThreads, 2u) - 1, MAX_WORKER_THREADS);
+	for (unsigned i = 0; i < workerCount; i++) {
+		std::thread(&WorkerPool::_WorkerThread, this).detach();
+	}
+
+	EmuLog(LOG_LEVEL::DEBUG, "Started %u worker threads", workerCount);
+}
+
+void WorkerPool::_WorkerThread()
+{
+	CxbxSetThreadName("Cxbx Worker");
+	g_AffinityPolicy->SetAffinityOther();
+
+	while (true) {
+		WorkerJob job;
+		{
+			std::unique_lock<std::mutex> lck(poolMutex);
+			jobQueued.wait(lck, [this] { return !highQueue.empty() || !lowQueue.empty(); });
+
+			auto& queue = highQueue.empty() ? lowQueue : highQueue;
+			job = std::move(queue.front());
+			queue.pop_front();
+		}
+
+		job();
+	}
+}
+
+void WorkerPool::Submit(WorkerJob job, WorkerPriority priority)
+{
+	std::lock_guard<std::mutex> lck(poolMutex);
+	_StartWorkers();
+
+	if (priority == WorkerPriority::High) {
+		highQueue.push_back(std::move(job));
+	}
+	else {
+		lowQueue.push_back(std::move(job));
+	}
+
+	jobQueued.notify_one();
+}
+
+unsigned WorkerPool::GetWorkerCount()
+{
+	std::lock_guard<std::mutex> lck(poolMutex);
+	return workerCount;
+}
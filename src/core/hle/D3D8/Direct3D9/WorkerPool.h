@@ -0,0 +1,41 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+
+// Order in which queued jobs are picked up by the worker threads
+enum class WorkerPriority {
+	High = 0, // Needed by the current (or an upcoming) draw
+	Low,      // Speculative work, done ahead of use
+};
+
+typedef std::function<void()> WorkerJob;
+
+// A small pool of detached worker threads, shared by the D3D backend for work that
+// doesn't touch the host D3D device (like shader compilation and texture conversion)
+class WorkerPool {
+
+public:
+	// Queues a job; High priority jobs always go before Low priority ones
+	void Submit(WorkerJob job, WorkerPriority priority = WorkerPriority::High);
+
+	// The number of worker threads (zero until the first job was submitted)
+	unsigned GetWorkerCount();
+
+private:
+	std::mutex poolMutex;
+	std::deque<WorkerJob> highQueue;
+	std::deque<WorkerJob> lowQueue;
+	std::condition_variable jobQueued;
+	unsigned workerCount = 0;
+
+	void _StartWorkers();
+	void _WorkerThread();
+};
+
+extern WorkerPool g_WorkerPool;
+
+#endif
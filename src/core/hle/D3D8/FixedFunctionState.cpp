@@ -44,7 +44,20 @@ D3D8LightState::D3D8LightState() {
     EnabledLights.fill(-1);
 }
 
+void D3D8LightState::SetLight(uint32_t index, const xbox::X_D3DLIGHT8* pLight) {
+    Lights[index] = *pLight;
+
+    // Disabled lights don't contribute to the shader state until they're enabled
+    auto enabledEnd = std::begin(EnabledLights) + EnabledLightCount;
+    if (std::find(std::begin(EnabledLights), enabledEnd, (int)index) != enabledEnd) {
+        bLightsDirty = true;
+    }
+}
+
 void D3D8LightState::EnableLight(uint32_t index, bool enable) {
+    // Enabling a light also moves it, so any call can change the shader light slots
+    bLightsDirty = true;
+
     // Since Xbox only supports 8 lights, we keep track of the 8 most recently enabled lights
     // Lights are ordered oldest to newest, with disabled lights at the end
 
@@ -95,6 +108,7 @@ D3D8TransformState::D3D8TransformState() {
 	this->WorldView.fill(identity);
 	this->WorldViewInverseTranspose.fill(identity);
 	bWorldViewDirty.fill(true);
+	DirtyTransforms = (1 << xbox::X_D3DTS_MAX) - 1;
 }
 
 void D3D8TransformState::SetTransform(xbox::X_D3DTRANSFORMSTATETYPE state, const D3DMATRIX* pMatrix)
@@ -110,6 +124,7 @@ void D3D8TransformState::SetTransform(xbox::X_D3DTRANSFORMSTATETYPE state, const
 
 	// Update transform state
 	this->Transforms[state] = *pMatrix;
+	DirtyTransforms |= 1 << state;
 
 	if (state == X_D3DTS_VIEW) {
 		bWorldViewDirty.fill(true);
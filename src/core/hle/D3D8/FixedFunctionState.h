@@ -17,8 +17,14 @@ public:
     // The number of enabled lights
     uint32_t EnabledLightCount = 0;
 
+    // Set when enabled lights changed since the fixed function shader state was last updated
+    bool bLightsDirty = true;
+
     D3D8LightState();
 
+    // Set light properties
+    void SetLight(uint32_t index, const xbox::X_D3DLIGHT8* pLight);
+
     // Enable a light
     void EnableLight(uint32_t index, bool enable);
 };
@@ -33,6 +39,10 @@ public:
 	// The transforms set by the Xbox title
 	std::array<D3DMATRIX, xbox::X_D3DTS_MAX> Transforms;
 
+	// Transforms set since the fixed function shader state was last updated,
+	// one bit per X_D3DTRANSFORMSTATETYPE
+	uint32_t DirtyTransforms;
+
 private:
 	void RecalculateDependentMatrices(unsigned i);
 
@@ -28,8 +28,11 @@
 
 #define LOG_PREFIX CXBXR_MODULE::D3DCVT
 
+#include <emmintrin.h> // SSE2
 #include "common\Settings.hpp" // for g_LibVersion_D3D8
+#include "common\util\CPUID.h"
 #include "core\kernel\support\Emu.h"
+#include "devices\video\swizzle.h"
 
 #include "XbConvert.h"
 
@@ -813,6 +816,318 @@ void ____UYVYToARGBRow_C(const uint8_t* src_uyvy,
 	}
 }
 
+// SSE2 implementations
+// These convert 8 (or 16) pixels at a time, and leave the remaining pixels to the C versions above.
+// All computations are done in 16 bit lanes in such a way that the results are bit-exact with those.
+
+// Expands each 16 bit lane containing a 5 bit value into 8 bits (x << 3 | x >> 2)
+static __inline __m128i Expand5_SSE2(__m128i x) {
+	return _mm_or_si128(_mm_slli_epi16(x, 3), _mm_srli_epi16(x, 2));
+}
+
+// Expands each 16 bit lane containing a 6 bit value into 8 bits (x << 2 | x >> 4)
+static __inline __m128i Expand6_SSE2(__m128i x) {
+	return _mm_or_si128(_mm_slli_epi16(x, 2), _mm_srli_epi16(x, 4));
+}
+
+// Writes 8 pixels, given 16 bit lanes with their 8 bit blue, green, red and alpha values
+static __inline void StoreBGRA_SSE2(uint8_t* dst_argb, __m128i b, __m128i g, __m128i r, __m128i a) {
+	__m128i bg = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+	__m128i ra = _mm_or_si128(r, _mm_slli_epi16(a, 8));
+	_mm_storeu_si128((__m128i*)dst_argb, _mm_unpacklo_epi16(bg, ra));
+	_mm_storeu_si128((__m128i*)dst_argb + 1, _mm_unpackhi_epi16(bg, ra));
+}
+
+void RGB565ToARGBRow_SSE2(const uint8_t* src_rgb565, uint8_t* dst_argb, int width) {
+	const __m128i mask5 = _mm_set1_epi16(0x1f);
+	const __m128i mask6 = _mm_set1_epi16(0x3f);
+	const __m128i alpha = _mm_set1_epi16(0xff);
+	int x;
+	for (x = 0; x < width - 7; x += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i*)src_rgb565);
+		__m128i b = Expand5_SSE2(_mm_and_si128(v, mask5));
+		__m128i g = Expand6_SSE2(_mm_and_si128(_mm_srli_epi16(v, 5), mask6));
+		__m128i r = Expand5_SSE2(_mm_srli_epi16(v, 11));
+		StoreBGRA_SSE2(dst_argb, b, g, r, alpha);
+		dst_argb += 32;
+		src_rgb565 += 16;
+	}
+	RGB565ToARGBRow_C(src_rgb565, dst_argb, width - x);
+}
+
+void ARGB1555ToARGBRow_SSE2(const uint8_t* src_argb1555, uint8_t* dst_argb, int width) {
+	const __m128i mask5 = _mm_set1_epi16(0x1f);
+	int x;
+	for (x = 0; x < width - 7; x += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i*)src_argb1555);
+		__m128i b = Expand5_SSE2(_mm_and_si128(v, mask5));
+		__m128i g = Expand5_SSE2(_mm_and_si128(_mm_srli_epi16(v, 5), mask5));
+		__m128i r = Expand5_SSE2(_mm_and_si128(_mm_srli_epi16(v, 10), mask5));
+		__m128i a = _mm_srli_epi16(_mm_srai_epi16(v, 15), 8); // 0 or 255
+		StoreBGRA_SSE2(dst_argb, b, g, r, a);
+		dst_argb += 32;
+		src_argb1555 += 16;
+	}
+	ARGB1555ToARGBRow_C(src_argb1555, dst_argb, width - x);
+}
+
+void ARGB4444ToARGBRow_SSE2(const uint8_t* src_argb4444, uint8_t* dst_argb, int width) {
+	const __m128i mask4 = _mm_set1_epi8(0x0f);
+	int x;
+	for (x = 0; x < width - 7; x += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i*)src_argb4444);
+		__m128i lo = _mm_and_si128(v, mask4); // b and r
+		__m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask4); // g and a
+		lo = _mm_or_si128(lo, _mm_slli_epi16(lo, 4));
+		hi = _mm_or_si128(hi, _mm_slli_epi16(hi, 4));
+		_mm_storeu_si128((__m128i*)dst_argb, _mm_unpacklo_epi8(lo, hi));
+		_mm_storeu_si128((__m128i*)dst_argb + 1, _mm_unpackhi_epi8(lo, hi));
+		dst_argb += 32;
+		src_argb4444 += 16;
+	}
+	ARGB4444ToARGBRow_C(src_argb4444, dst_argb, width - x);
+}
+
+void X1R5G5B5ToARGBRow_SSE2(const uint8_t* src_x1r5g5b5, uint8_t* dst_argb, int width) {
+	const __m128i mask5 = _mm_set1_epi16(0x1f);
+	const __m128i alpha = _mm_set1_epi16(0xff);
+	int x;
+	for (x = 0; x < width - 7; x += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i*)src_x1r5g5b5);
+		__m128i b = Expand5_SSE2(_mm_and_si128(v, mask5));
+		__m128i g = Expand5_SSE2(_mm_and_si128(_mm_srli_epi16(v, 5), mask5));
+		__m128i r = Expand5_SSE2(_mm_and_si128(_mm_srli_epi16(v, 10), mask5));
+		StoreBGRA_SSE2(dst_argb, b, g, r, alpha);
+		dst_argb += 32;
+		src_x1r5g5b5 += 16;
+	}
+	X1R5G5B5ToARGBRow_C(src_x1r5g5b5, dst_argb, width - x);
+}
+
+void X8R8G8B8ToARGBRow_SSE2(const uint8_t* src_x8r8g8b8, uint8_t* dst_argb, int width) {
+	const __m128i alpha = _mm_set1_epi32(0xff000000);
+	int x;
+	for (x = 0; x < width - 3; x += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i*)src_x8r8g8b8);
+		_mm_storeu_si128((__m128i*)dst_argb, _mm_or_si128(v, alpha));
+		dst_argb += 16;
+		src_x8r8g8b8 += 16;
+	}
+	X8R8G8B8ToARGBRow_C(src_x8r8g8b8, dst_argb, width - x);
+}
+
+void ____R8B8ToARGBRow_SSE2(const uint8_t* src_r8b8, uint8_t* dst_argb, int width) {
+	int x;
+	for (x = 0; x < width - 7; x += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i*)src_r8b8);
+		_mm_storeu_si128((__m128i*)dst_argb, _mm_unpacklo_epi8(v, v)); // b, b, r, r
+		_mm_storeu_si128((__m128i*)dst_argb + 1, _mm_unpackhi_epi8(v, v));
+		dst_argb += 32;
+		src_r8b8 += 16;
+	}
+	____R8B8ToARGBRow_C(src_r8b8, dst_argb, width - x);
+}
+
+void ____G8B8ToARGBRow_SSE2(const uint8_t* src_g8b8, uint8_t* dst_argb, int width) {
+	int x;
+	for (x = 0; x < width - 7; x += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i*)src_g8b8);
+		_mm_storeu_si128((__m128i*)dst_argb, _mm_unpacklo_epi16(v, v)); // b, g, b, g
+		_mm_storeu_si128((__m128i*)dst_argb + 1, _mm_unpackhi_epi16(v, v));
+		dst_argb += 32;
+		src_g8b8 += 16;
+	}
+	____G8B8ToARGBRow_C(src_g8b8, dst_argb, width - x);
+}
+
+// Writes 16 pixels, given two registers with 16 pixels of byte pairs (for the blue and green, and red and alpha bytes)
+static __inline void StoreBGRA16_SSE2(uint8_t* dst_argb, __m128i bg_lo, __m128i bg_hi, __m128i ra_lo, __m128i ra_hi) {
+	_mm_storeu_si128((__m128i*)dst_argb, _mm_unpacklo_epi16(bg_lo, ra_lo));
+	_mm_storeu_si128((__m128i*)dst_argb + 1, _mm_unpackhi_epi16(bg_lo, ra_lo));
+	_mm_storeu_si128((__m128i*)dst_argb + 2, _mm_unpacklo_epi16(bg_hi, ra_hi));
+	_mm_storeu_si128((__m128i*)dst_argb + 3, _mm_unpackhi_epi16(bg_hi, ra_hi));
+}
+
+void ______A8ToARGBRow_SSE2(const uint8_t* src_a8, uint8_t* dst_argb, int width) {
+	const __m128i ones = _mm_set1_epi8(-1);
+	int x;
+	for (x = 0; x < width - 15; x += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)src_a8);
+		StoreBGRA16_SSE2(dst_argb, ones, ones, _mm_unpacklo_epi8(ones, v), _mm_unpackhi_epi8(ones, v));
+		dst_argb += 64;
+		src_a8 += 16;
+	}
+	______A8ToARGBRow_C(src_a8, dst_argb, width - x);
+}
+
+void ______L8ToARGBRow_SSE2(const uint8_t* src_l8, uint8_t* dst_argb, int width) {
+	const __m128i ones = _mm_set1_epi8(-1);
+	int x;
+	for (x = 0; x < width - 15; x += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)src_l8);
+		StoreBGRA16_SSE2(dst_argb,
+			_mm_unpacklo_epi8(v, v), _mm_unpackhi_epi8(v, v),
+			_mm_unpacklo_epi8(v, ones), _mm_unpackhi_epi8(v, ones));
+		dst_argb += 64;
+		src_l8 += 16;
+	}
+	______L8ToARGBRow_C(src_l8, dst_argb, width - x);
+}
+
+void _____AL8ToARGBRow_SSE2(const uint8_t* src_al8, uint8_t* dst_argb, int width) {
+	int x;
+	for (x = 0; x < width - 15; x += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)src_al8);
+		__m128i lo = _mm_unpacklo_epi8(v, v);
+		__m128i hi = _mm_unpackhi_epi8(v, v);
+		StoreBGRA16_SSE2(dst_argb, lo, hi, lo, hi);
+		dst_argb += 64;
+		src_al8 += 16;
+	}
+	_____AL8ToARGBRow_C(src_al8, dst_argb, width - x);
+}
+
+void _____L16ToARGBRow_SSE2(const uint8_t* src_l16, uint8_t* dst_argb, int width) {
+	const __m128i ones = _mm_set1_epi8(-1);
+	int x;
+	for (x = 0; x < width - 7; x += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i*)src_l16);
+		_mm_storeu_si128((__m128i*)dst_argb, _mm_unpacklo_epi16(v, ones)); // b, g, 255, 255
+		_mm_storeu_si128((__m128i*)dst_argb + 1, _mm_unpackhi_epi16(v, ones));
+		dst_argb += 32;
+		src_l16 += 16;
+	}
+	_____L16ToARGBRow_C(src_l16, dst_argb, width - x);
+}
+
+void ____A8L8ToARGBRow_SSE2(const uint8_t* src_a8l8, uint8_t* dst_argb, int width) {
+	const __m128i mask8 = _mm_set1_epi16(0xff);
+	int x;
+	for (x = 0; x < width - 7; x += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i*)src_a8l8); // l, a
+		__m128i l = _mm_and_si128(v, mask8);
+		__m128i ll = _mm_or_si128(l, _mm_slli_epi16(l, 8));
+		_mm_storeu_si128((__m128i*)dst_argb, _mm_unpacklo_epi16(ll, v)); // l, l, l, a
+		_mm_storeu_si128((__m128i*)dst_argb + 1, _mm_unpackhi_epi16(ll, v));
+		dst_argb += 32;
+		src_a8l8 += 16;
+	}
+	____A8L8ToARGBRow_C(src_a8l8, dst_argb, width - x);
+}
+
+void R5G5B5A1ToARGBRow_SSE2(const uint8_t* src_r5g5b5a1, uint8_t* dst_argb, int width) {
+	const __m128i mask5 = _mm_set1_epi16(0x1f);
+	const __m128i mask1 = _mm_set1_epi16(0x01);
+	int x;
+	for (x = 0; x < width - 7; x += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i*)src_r5g5b5a1);
+		__m128i b = Expand5_SSE2(_mm_and_si128(_mm_srli_epi16(v, 1), mask5));
+		__m128i g = Expand5_SSE2(_mm_and_si128(_mm_srli_epi16(v, 6), mask5));
+		__m128i r = Expand5_SSE2(_mm_srli_epi16(v, 11));
+		__m128i a = _mm_mullo_epi16(_mm_and_si128(v, mask1), _mm_set1_epi16(0xff)); // 0 or 255
+		StoreBGRA_SSE2(dst_argb, b, g, r, a);
+		dst_argb += 32;
+		src_r5g5b5a1 += 16;
+	}
+	R5G5B5A1ToARGBRow_C(src_r5g5b5a1, dst_argb, width - x);
+}
+
+void R4G4B4A4ToARGBRow_SSE2(const uint8_t* src_r4g4b4a4, uint8_t* dst_argb, int width) {
+	const __m128i mask4 = _mm_set1_epi8(0x0f);
+	int x;
+	for (x = 0; x < width - 7; x += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i*)src_r4g4b4a4);
+		__m128i lo = _mm_and_si128(v, mask4); // a and g
+		__m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask4); // b and r
+		lo = _mm_or_si128(lo, _mm_slli_epi16(lo, 4));
+		hi = _mm_or_si128(hi, _mm_slli_epi16(hi, 4));
+		// Interleaving gives a, b, g, r; Rotate each pixel to b, g, r, a
+		__m128i abgr0 = _mm_unpacklo_epi8(lo, hi);
+		__m128i abgr1 = _mm_unpackhi_epi8(lo, hi);
+		_mm_storeu_si128((__m128i*)dst_argb, _mm_or_si128(_mm_srli_epi32(abgr0, 8), _mm_slli_epi32(abgr0, 24)));
+		_mm_storeu_si128((__m128i*)dst_argb + 1, _mm_or_si128(_mm_srli_epi32(abgr1, 8), _mm_slli_epi32(abgr1, 24)));
+		dst_argb += 32;
+		src_r4g4b4a4 += 16;
+	}
+	R4G4B4A4ToARGBRow_C(src_r4g4b4a4, dst_argb, width - x);
+}
+
+void __R6G5B5ToARGBRow_SSE2(const uint8_t* src_r6g5b5, uint8_t* dst_argb, int width) {
+	const __m128i mask5 = _mm_set1_epi16(0x1f);
+	const __m128i alpha = _mm_set1_epi16(0xff);
+	int x;
+	for (x = 0; x < width - 7; x += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i*)src_r6g5b5);
+		__m128i b = Expand5_SSE2(_mm_and_si128(v, mask5));
+		__m128i g = Expand5_SSE2(_mm_and_si128(_mm_srli_epi16(v, 5), mask5));
+		__m128i r = Expand6_SSE2(_mm_srli_epi16(v, 10));
+		StoreBGRA_SSE2(dst_argb, b, g, r, alpha);
+		dst_argb += 32;
+		src_r6g5b5 += 16;
+	}
+	__R6G5B5ToARGBRow_C(src_r6g5b5, dst_argb, width - x);
+}
+
+// Converts 8 pixels, given 16 bit lanes with their y and (per pixel duplicated) u and v values.
+// Mimics YuvPixel; Saturation only happens on sums that YuvPixel clamps to 255 anyway.
+static __inline void YuvPixels_SSE2(__m128i y, __m128i u, __m128i v, uint8_t* rgb_buf,
+	const struct YuvConstants* yuvconstants) {
+	const __m128i ub = _mm_set1_epi16(yuvconstants->kUVToB[0]);
+	const __m128i ug = _mm_set1_epi16(yuvconstants->kUVToG[0]);
+	const __m128i vg = _mm_set1_epi16(yuvconstants->kUVToG[1]);
+	const __m128i vr = _mm_set1_epi16(yuvconstants->kUVToR[1]);
+	const __m128i bb = _mm_set1_epi16(yuvconstants->kUVBiasB[0]);
+	const __m128i bg = _mm_set1_epi16(yuvconstants->kUVBiasG[0]);
+	const __m128i br = _mm_set1_epi16(yuvconstants->kUVBiasR[0]);
+	const __m128i yg = _mm_set1_epi16(yuvconstants->kYToRgb[0]);
+
+	__m128i y1 = _mm_mulhi_epu16(_mm_or_si128(y, _mm_slli_epi16(y, 8)), yg);
+	__m128i b = _mm_adds_epi16(y1, _mm_sub_epi16(bb, _mm_mullo_epi16(u, ub)));
+	__m128i g = _mm_adds_epi16(y1, _mm_sub_epi16(bg, _mm_add_epi16(_mm_mullo_epi16(u, ug), _mm_mullo_epi16(v, vg))));
+	__m128i r = _mm_adds_epi16(y1, _mm_sub_epi16(br, _mm_mullo_epi16(v, vr)));
+	// Shift and clamp to bytes
+	__m128i b8r8 = _mm_packus_epi16(_mm_srai_epi16(b, 6), _mm_srai_epi16(r, 6));
+	__m128i g8a8 = _mm_packus_epi16(_mm_srai_epi16(g, 6), _mm_set1_epi16(0xff));
+	__m128i bg8 = _mm_unpacklo_epi8(b8r8, g8a8);
+	__m128i ra8 = _mm_unpackhi_epi8(b8r8, g8a8);
+	_mm_storeu_si128((__m128i*)rgb_buf, _mm_unpacklo_epi16(bg8, ra8));
+	_mm_storeu_si128((__m128i*)rgb_buf + 1, _mm_unpackhi_epi16(bg8, ra8));
+}
+
+void ____YUY2ToARGBRow_SSE2(const uint8_t* src_yuy2, uint8_t* rgb_buf, int width) {
+	const struct YuvConstants* yuvconstants = &kYuvIConstants;
+	const __m128i mask8 = _mm_set1_epi16(0xff);
+	int x;
+	for (x = 0; x < width - 7; x += 8) {
+		__m128i yuyv = _mm_loadu_si128((const __m128i*)src_yuy2);
+		__m128i y = _mm_and_si128(yuyv, mask8);
+		__m128i uv = _mm_srli_epi16(yuyv, 8); // u0, v0, u1, v1, ...
+		__m128i u = _mm_shufflehi_epi16(_mm_shufflelo_epi16(uv, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+		__m128i v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(uv, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1));
+		YuvPixels_SSE2(y, u, v, rgb_buf, yuvconstants);
+		src_yuy2 += 16;
+		rgb_buf += 32;
+	}
+	____YUY2ToARGBRow_C(src_yuy2, rgb_buf, width - x);
+}
+
+void ____UYVYToARGBRow_SSE2(const uint8_t* src_uyvy, uint8_t* rgb_buf, int width) {
+	const struct YuvConstants* yuvconstants = &kYuvIConstants;
+	const __m128i mask8 = _mm_set1_epi16(0xff);
+	int x;
+	for (x = 0; x < width - 7; x += 8) {
+		__m128i uyvy = _mm_loadu_si128((const __m128i*)src_uyvy);
+		__m128i y = _mm_srli_epi16(uyvy, 8);
+		__m128i uv = _mm_and_si128(uyvy, mask8); // u0, v0, u1, v1, ...
+		__m128i u = _mm_shufflehi_epi16(_mm_shufflelo_epi16(uv, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+		__m128i v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(uv, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1));
+		YuvPixels_SSE2(y, u, v, rgb_buf, yuvconstants);
+		src_uyvy += 16;
+		rgb_buf += 32;
+	}
+	____UYVYToARGBRow_C(src_uyvy, rgb_buf, width - x);
+}
+
 static const FormatToARGBRow ComponentConverters[] = {
 	nullptr, // NoCmpnts,
 	ARGB1555ToARGBRow_C, // A1R5G5B5,
@@ -842,6 +1157,35 @@ static const FormatToARGBRow ComponentConverters[] = {
 	____UYVYToARGBRow_C, // ____UYVY
 };
 
+static const FormatToARGBRow ComponentConverters_SSE2[] = {
+	nullptr, // NoCmpnts,
+	ARGB1555ToARGBRow_SSE2, // A1R5G5B5,
+	X1R5G5B5ToARGBRow_SSE2, // X1R5G5B5, // Test : Convert X into 255
+	ARGB4444ToARGBRow_SSE2, // A4R4G4B4,
+	  RGB565ToARGBRow_SSE2, // __R5G6B5, // NOTE : A=255
+	A8R8G8B8ToARGBRow_C, // A8R8G8B8,
+	X8R8G8B8ToARGBRow_SSE2, // X8R8G8B8, // Test : Convert X into 255
+	____R8B8ToARGBRow_SSE2, // ____R8B8, // NOTE : A takes R, G takes B
+	____G8B8ToARGBRow_SSE2, // ____G8B8, // NOTE : A takes G, R takes B
+	______A8ToARGBRow_SSE2, // ______A8,
+	__R6G5B5ToARGBRow_SSE2, // __R6G5B5,
+	R5G5B5A1ToARGBRow_SSE2, // R5G5B5A1,
+	R4G4B4A4ToARGBRow_SSE2, // R4G4B4A4,
+	A8B8G8R8ToARGBRow_C, // A8B8G8R8,
+	B8G8R8A8ToARGBRow_C, // B8G8R8A8,
+	R8G8B8A8ToARGBRow_C, // R8G8B8A8,
+	______L8ToARGBRow_SSE2, // ______L8, // NOTE : A=255, R=G=B= L
+	_____AL8ToARGBRow_SSE2, // _____AL8, // NOTE : A=R=G=B= L
+	_____L16ToARGBRow_SSE2, // _____L16, // NOTE : Actually G8B8, with A=R=255
+	____A8L8ToARGBRow_SSE2, // ____A8L8, // NOTE : R=G=B= L
+	____DXT1ToARGBRow_C, // ____DXT1
+	____DXT3ToARGBRow_C, // ____DXT3
+	____DXT5ToARGBRow_C, // ____DXT5
+	______P8ToARGBRow_C, // ______P8
+	____YUY2ToARGBRow_SSE2, // ____YUY2
+	____UYVYToARGBRow_SSE2, // ____UYVY
+};
+
 enum _FormatStorage {
 	Undfnd = 0, // Undefined
 	Linear,
@@ -948,11 +1292,23 @@ static const FormatInfo FormatInfos[] = {
 #endif
 };
 
+// Detect SSE support to select the converters table once
+static const FormatToARGBRow *SelectComponentConverters()
+{
+	SimdCaps supports;
+	if (supports.SSE2())
+		return ComponentConverters_SSE2;
+	else
+		return ComponentConverters;
+}
+
 const FormatToARGBRow EmuXBFormatComponentConverter(xbox::X_D3DFORMAT Format)
 {
+	static const FormatToARGBRow *SelectedComponentConverters = SelectComponentConverters();
+
 	if (Format <= xbox::X_D3DFMT_LIN_R8G8B8A8)
 		if (FormatInfos[Format].components != NoCmpnts)
-			return ComponentConverters[FormatInfos[Format].components];
+			return SelectedComponentConverters[FormatInfos[Format].components];
 
 	return nullptr;
 }
@@ -1236,106 +1592,16 @@ void EmuUnswizzleBox
 	CONST DWORD dwDstSlicePitch
 ) // Source : Dxbx
 {
-	DWORD dwMaskX = 0, dwMaskY = 0, dwMaskZ = 0;
-	for (unsigned int i=1, j=1; (i < dwWidth) || (i < dwHeight) || (i < dwDepth); i <<= 1) {
-		if (i < dwWidth) {
-			dwMaskX |= j;
-			j <<= 1;
-		}
-
-		if (i < dwHeight) {
-			dwMaskY |= j;
-			j <<= 1;
-		}
-
-		if (i < dwDepth) {
-			dwMaskZ |= j;
-			j <<= 1;
-		}
-	}
-
-	const DWORD dwStartX = 0;
-	const DWORD dwStartY = 0;
-	const DWORD dwStartZ = 0;
-
-	DWORD dwZ = dwStartZ;
-	switch (dwBytesPerPixel) {
-	case 1: {
-		const uint8_t *pSrc = (uint8_t *)pSrcBuff;
-		uint8_t *pDestSlice = (uint8_t *)pDstBuff;
-
-		for (unsigned int z = 0; z < dwDepth; z++) {
-			uint8_t *pDestRow = pDestSlice;
-			DWORD dwY = dwStartY;
-			for (unsigned int y = 0; y < dwHeight; y++) {
-				DWORD dwYZ = dwY | dwZ;
-				DWORD dwX = dwStartX;
-				for (unsigned int x = 0; x < dwWidth; x++) {
-					unsigned int delta = dwX | dwYZ;
-					pDestRow[x] = pSrc[delta]; // copy one pixel
-					dwX = (dwX - dwMaskX) & dwMaskX; // step to next pixel in source
-				}
-
-				pDestRow += dwDstRowPitch; // / 1; // = / dwBPP; // step to next line in destination
-				dwY = (dwY - dwMaskY) & dwMaskY; // step to next line in source
-			}
-
-			pDestSlice += dwDstSlicePitch; // / 1; // = / dwBPP; // step to next level in destination
-			dwZ = (dwZ - dwMaskZ) & dwMaskZ; // step to next level in source
-		}
-		break;
-	}
-	case 2: {
-		const uint16_t *pSrc = (uint16_t *)pSrcBuff;
-		uint16_t *pDestSlice = (uint16_t *)pDstBuff;
-
-		for (unsigned int z = 0; z < dwDepth; z++) {
-			uint16_t *pDestRow = pDestSlice;
-			DWORD dwY = dwStartY;
-			for (unsigned int y = 0; y < dwHeight; y++) {
-				DWORD dwYZ = dwY | dwZ;
-				DWORD dwX = dwStartX;
-				for (unsigned int x = 0; x < dwWidth; x++) {
-					unsigned int delta = dwX | dwYZ;
-					pDestRow[x] = pSrc[delta]; // copy one pixel
-					dwX = (dwX - dwMaskX) & dwMaskX; // step to next pixel in source
-				}
-
-				pDestRow += dwDstRowPitch / 2; // = dwBPP; // step to next line in destination
-				dwY = (dwY - dwMaskY) & dwMaskY; // step to next line in source
-			}
-
-			pDestSlice += dwDstSlicePitch / 2; // = dwBPP; // step to next level in destination
-			dwZ = (dwZ - dwMaskZ) & dwMaskZ; // step to next level in source
-		}
-		break;
-	}
-	case 4: {
-		const uint32_t *pSrc = (uint32_t *)pSrcBuff;
-		uint32_t *pDestSlice = (uint32_t *)pDstBuff;
-
-		for (unsigned int z = 0; z < dwDepth; z++) {
-			uint32_t *pDestRow = pDestSlice;
-			DWORD dwY = dwStartY;
-			for (unsigned int y = 0; y < dwHeight; y++) {
-				DWORD dwYZ = dwY | dwZ;
-				DWORD dwX = dwStartX;
-				for (unsigned int x = 0; x < dwWidth; x++) {
-					unsigned int delta = dwX | dwYZ;
-					pDestRow[x] = pSrc[delta]; // copy one pixel
-					dwX = (dwX - dwMaskX) & dwMaskX; // step to next pixel in source
-				}
-
-				pDestRow += dwDstRowPitch / 4; // = dwBPP; // step to next line in destination
-				dwY = (dwY - dwMaskY) & dwMaskY; // step to next line in source
-			}
-
-			pDestSlice += dwDstSlicePitch / 4; // = dwBPP; // step to next level in destination
-			dwZ = (dwZ - dwMaskZ) & dwMaskZ; // step to next level in source
-		}
-		break;
-	}
-	}
+	// Shares the tiled (and SIMD) unswizzle implementation with the LLE path
+	unswizzle_box(
+		(const uint8_t *)pSrcBuff,
+		dwWidth,
+		dwHeight,
+		dwDepth,
+		(uint8_t *)pDstBuff,
+		dwDstRowPitch,
+		dwDstSlicePitch,
+		dwBytesPerPixel);
 } // EmuUnswizzleBox NOPATCH
 
 // Notes :
@@ -52,6 +52,10 @@
 #include <locale.h>
 #include <fstream>
 #include <sstream>
+#include <chrono>
+#include <list>
+#include <unordered_map>
+#include <imgui.h>
 
 #include "Direct3D9\RenderStates.h" // For XboxRenderStateConverter
 #include "Direct3D9\TextureStates.h" // For XboxTextureStateConverter
@@ -455,6 +459,28 @@ typedef struct s_CxbxPSDef {
 		return true;
 	}
 
+	uint64_t ComputeIdentifyingHash() const
+	{
+		// Hash exactly the members that IsEquivalent compares, so that equivalent declarations hash equally
+		DWORD Identifying[10 + 17 + 12 + 1 + 4 + xbox::X_D3DTS_STAGECOUNT + 3];
+		unsigned i = 0;
+		memcpy(&Identifying[i], &(PSDef.PSAlphaInputs[0]), (8 + 1 + 1) * sizeof(DWORD)); i += 8 + 1 + 1;
+		memcpy(&Identifying[i], &(PSDef.PSAlphaOutputs[0]), (8 + 8 + 1) * sizeof(DWORD)); i += 8 + 8 + 1;
+		memcpy(&Identifying[i], &(PSDef.PSRGBOutputs[0]), (8 + 1 + 1 + 1 + 1) * sizeof(DWORD)); i += 8 + 1 + 1 + 1 + 1;
+		Identifying[i++] = DecodedTexModeAdjust;
+		for (unsigned stage = 0; stage < 4; stage++)
+			Identifying[i++] = AlphaKill[stage];
+		for (unsigned stage = 0; stage < xbox::X_D3DTS_STAGECOUNT; stage++)
+			Identifying[i++] = (DWORD)ActiveTextureTypes[stage];
+		Identifying[i++] = DecodedHasFinalCombiner;
+		// The render states below are ignored by IsEquivalent when the final combiner is used
+		Identifying[i++] = DecodedHasFinalCombiner ? false : RenderStateFogEnable;
+		Identifying[i++] = DecodedHasFinalCombiner ? false : RenderStateSpecularEnable;
+		assert(i == std::size(Identifying));
+
+		return ComputeHash(Identifying, sizeof(Identifying));
+	}
+
 	void SnapshotRuntimeVariables()
 	{
 		// These values are checked in IsEquivalent to see if a cached pixel shader matches this declaration
@@ -608,6 +634,7 @@ CxbxPSDef;
 typedef struct _PSH_RECOMPILED_SHADER {
 	CxbxPSDef CompletePSDef;
 	IDirect3DPixelShader* ConvertedPixelShader;
+	uint64_t IdentifyingHash; // Key into g_RecompiledPixelShaders
 } PSH_RECOMPILED_SHADER;
 
 PSH_RECOMPILED_SHADER CxbxRecompilePixelShader(CxbxPSDef &CompletePSDef)
@@ -622,6 +649,7 @@ PSH_RECOMPILED_SHADER CxbxRecompilePixelShader(CxbxPSDef &CompletePSDef)
 	PSH_RECOMPILED_SHADER Result;
 	Result.CompletePSDef = CompletePSDef;
 	Result.ConvertedPixelShader = nullptr;
+	Result.IdentifyingHash = 0;
 	if (pShader) {
 		DWORD *pFunction = (DWORD*)pShader->GetBufferPointer();
 		if (pFunction) {
@@ -636,7 +664,69 @@ PSH_RECOMPILED_SHADER CxbxRecompilePixelShader(CxbxPSDef &CompletePSDef)
 	return Result;
 } // CxbxRecompilePixelShader
 
-std::vector<PSH_RECOMPILED_SHADER> g_RecompiledPixelShaders;
+// Recompiled pixel shaders, keyed on CxbxPSDef::ComputeIdentifyingHash
+static constexpr size_t PIXEL_SHADER_CACHE_SIZE = 512; // Maximum number of host pixel shaders kept around
+std::unordered_map<uint64_t, std::list<PSH_RECOMPILED_SHADER>::iterator> g_RecompiledPixelShaders;
+std::list<PSH_RECOMPILED_SHADER> g_RecompiledPixelShaderUsageList; // Least recently used is last in the list
+static ULONG g_PixelShaderCacheHits = 0;
+static ULONG g_PixelShaderCacheMisses = 0;
+static ULONG g_PixelShaderCacheEvictions = 0;
+static std::chrono::microseconds g_PixelShaderCompileTime = {};
+
+static void ReleaseRecompiledPixelShader(PSH_RECOMPILED_SHADER& RecompiledPixelShader)
+{
+	if (RecompiledPixelShader.ConvertedPixelShader != nullptr) {
+		RecompiledPixelShader.ConvertedPixelShader->Release();
+		RecompiledPixelShader.ConvertedPixelShader = nullptr;
+	}
+}
+
+static const PSH_RECOMPILED_SHADER* GetRecompiledPixelShader(CxbxPSDef &CompletePSDef)
+{
+	uint64_t Hash = CompletePSDef.ComputeIdentifyingHash();
+	auto it = g_RecompiledPixelShaders.find(Hash);
+	if (it != g_RecompiledPixelShaders.end()) {
+		// Guard against hash collisions, by still doing the full comparison
+		if (CompletePSDef.IsEquivalent(it->second->CompletePSDef)) {
+			g_PixelShaderCacheHits++;
+			g_RecompiledPixelShaderUsageList.splice(g_RecompiledPixelShaderUsageList.begin(), g_RecompiledPixelShaderUsageList, it->second);
+			return &*it->second;
+		}
+
+		EmuLog(LOG_LEVEL::DEBUG, "Pixel shader hash collision, replacing the cached shader");
+		ReleaseRecompiledPixelShader(*it->second);
+		g_RecompiledPixelShaderUsageList.erase(it->second);
+		g_RecompiledPixelShaders.erase(it);
+	}
+
+	// Recompile this pixel shader and remember it :
+	g_PixelShaderCacheMisses++;
+	auto CompileStart = std::chrono::steady_clock::now();
+	g_RecompiledPixelShaderUsageList.push_front(CxbxRecompilePixelShader(CompletePSDef));
+	g_PixelShaderCompileTime += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - CompileStart);
+	g_RecompiledPixelShaderUsageList.front().IdentifyingHash = Hash;
+	g_RecompiledPixelShaders[Hash] = g_RecompiledPixelShaderUsageList.begin();
+
+	// Evict the least recently used shaders (clearing their host resources) once the cache is full
+	while (g_RecompiledPixelShaders.size() > PIXEL_SHADER_CACHE_SIZE) {
+		PSH_RECOMPILED_SHADER& ShaderToDelete = g_RecompiledPixelShaderUsageList.back();
+		g_RecompiledPixelShaders.erase(ShaderToDelete.IdentifyingHash);
+		ReleaseRecompiledPixelShader(ShaderToDelete);
+		g_RecompiledPixelShaderUsageList.pop_back();
+		g_PixelShaderCacheEvictions++;
+	}
+
+	return &g_RecompiledPixelShaderUsageList.front();
+}
+
+void DxbxDrawPixelShaderCacheStats()
+{
+	ImGui::Text("Cache Size: %u", g_RecompiledPixelShaders.size());
+	ImGui::Text("Hits: %u", std::exchange(g_PixelShaderCacheHits, 0));
+	ImGui::Text("Misses: %u", std::exchange(g_PixelShaderCacheMisses, 0));
+	ImGui::Text("Evictions: %u", std::exchange(g_PixelShaderCacheEvictions, 0));
+	ImGui::Text("Compile time: %.2f ms", std::exchange(g_PixelShaderCompileTime, {}).count() / 1000.0f);
+}
 
 // Mapping indices of Xbox register combiner constants to host pixel shader constants;
 // The first 16 are identity-mapped (C0_1 .. C0_7 are C0 .. C7 on host, C1_0 .. C1_7 are C8 .. C15 on host) :
@@ -1022,22 +1112,8 @@ void DxbxUpdateActivePixelShader() // NOPATCH
   // Fetch all other values that are used in the IsEquivalent check :
   CompletePSDef.SnapshotRuntimeVariables();
 
-  // Now, see if we already have a shader compiled for this definition :
-  // TODO : Change g_RecompiledPixelShaders into an unordered_map, hash just the identifying PSDef members, and add cache eviction (clearing host resources when pruning)
-  const PSH_RECOMPILED_SHADER* RecompiledPixelShader = nullptr;
-  for (const auto& it : g_RecompiledPixelShaders) {
-    if (CompletePSDef.IsEquivalent(it.CompletePSDef)) {
-      RecompiledPixelShader = &it;
-      break;
-    }
-  }
-
-  // If none was found, recompile this shader and remember it :
-  if (RecompiledPixelShader == nullptr) {
-    // Recompile this pixel shader :
-    g_RecompiledPixelShaders.push_back(CxbxRecompilePixelShader(CompletePSDef));
-    RecompiledPixelShader = &g_RecompiledPixelShaders.back();
-  }
+  // Now, see if we already have a shader compiled for this definition (if not, it gets recompiled) :
+  const PSH_RECOMPILED_SHADER* RecompiledPixelShader = GetRecompiledPixelShader(CompletePSDef);
 
   // Switch to the converted pixel shader (if it's any different from our currently active
   // pixel shader, to avoid many unnecessary state changes on the local side).
@@ -528,4 +528,7 @@ extern bool g_UseFixedFunctionPixelShader;
 // PatrickvL's Dxbx pixel shader translation
 void DxbxUpdateActivePixelShader(); // NOPATCH
 
+// Render the recompiled pixel shader cache statistics in the ImGui overlay
+void DxbxDrawPixelShaderCacheStats();
+
 #endif // PIXELSHADER_H
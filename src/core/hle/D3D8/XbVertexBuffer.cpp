@@ -37,15 +37,24 @@
 #include "core\hle\D3D8\XbPushBuffer.h" // For CxbxDrawPrimitiveUP
 #include "core\hle\D3D8\XbVertexBuffer.h"
 #include "core\hle\D3D8\XbConvert.h"
+#include "core\hle\D3D8\Direct3D9\RenderStates.h" // For XboxRenderStateConverter
+#include "core\hle\D3D8\Direct3D9\TextureStates.h" // For XboxTextureStateConverter
 
 #include <imgui.h>
 
 #include <ctime>
 #include <chrono>
 #include <algorithm>
+#include <bit>
 
 #define MAX_STREAM_NOT_USED_TIME (2 * CLOCKS_PER_SEC) // TODO: Trim the not used time
 
+// Vertex data under write tracking is hashed again after this long regardless,
+// in case it got modified in a way the write tracker can't see
+static constexpr auto TRACKED_STREAM_REHASH_INTERVAL = std::chrono::seconds(1);
+// Vertex data that keeps getting modified is no longer watched, as the write faults would cost more than hashing it
+static constexpr UINT MAX_TRACKED_STREAM_REWRITES = 4;
+
 CxbxVertexBufferConverter VertexBufferConverter = {};
 
 // Inline vertex buffer emulation
@@ -56,10 +65,26 @@ std::vector<D3DIVB>           g_InlineVertexBuffer_Table;
 UINT                          g_InlineVertexBuffer_TableLength = 0;
 UINT                          g_InlineVertexBuffer_TableOffset = 0;
 
+// Begin/End blocks aren't drawn right away, but kept pending at the start of g_InlineVertexBuffer_Table,
+// so that following blocks with the same primitive type and state can be drawn along with them
+static constexpr UINT MAX_INLINE_VERTEX_BATCH = 8192; // Keeps converted quad list indices well within 16 bit
+static xbox::X_D3DPRIMITIVETYPE g_InlineVertexBuffer_PendingPrimitiveType = xbox::X_D3DPT_INVALID;
+static UINT     g_InlineVertexBuffer_PendingVertexCount = 0;
+static UINT     g_InlineVertexBuffer_BlockStart = 0; // Table offset of the first vertex of the current block
+static UINT     g_InlineVertexBuffer_Stride = 0;
+static bool     g_InlineVertexBuffer_InBlock = false;
+static uint32_t g_InlineVertexBuffer_DirtyAttributes = 0; // Vertex attributes set since D3DDevice_Begin, one bit per register
+static ULONG    g_InlineVertexBuffer_Blocks = 0;
+static ULONG    g_InlineVertexBuffer_MergedBlocks = 0;
+static ULONG    g_InlineVertexBuffer_Draws = 0;
+static ULONG    g_InlineVertexBuffer_DrawnVertices = 0;
+
 // Copy of active Xbox D3D Vertex Streams (and strides), set by [D3DDevice|CxbxImpl]_SetStreamSource*
 xbox::X_STREAMINPUT g_Xbox_SetStreamSource[X_VSH_MAX_STREAMS] = { 0 }; // Note : .Offset member is never set (so always 0)
 
 extern float *HLE_get_NV2A_vertex_attribute_value_pointer(unsigned VertexSlot); // Declared in PushBuffer.cpp
+extern XboxRenderStateConverter XboxRenderStates; // Declared in Direct3D9.cpp
+extern XboxTextureStateConverter XboxTextureStates; // Declared in Direct3D9.cpp
 
 void *GetDataFromXboxResource(xbox::X_D3DResource *pXboxResource);
 bool GetHostRenderTargetDimensions(DWORD* pHostWidth, DWORD* pHostHeight, IDirect3DSurface* pHostRenderTarget = nullptr);
@@ -103,6 +128,9 @@ void CxbxPatchedStream::Clear()
         pCachedHostVertexBuffer->Release();
         pCachedHostVertexBuffer = nullptr;
     }
+
+    CxbxWriteTrackerUnwatch(writeWatch);
+    writeWatch = CXBX_INVALID_WRITE_WATCH;
 }
 
 CxbxPatchedStream::~CxbxPatchedStream()
@@ -143,26 +171,6 @@ UINT CxbxVertexBufferConverter::GetNbrStreams(CxbxDrawContext *pDrawContext) con
     return 0;
 }
 
-inline FLOAT PackedIntToFloat(const int value, const FLOAT PosFactor, const FLOAT NegFactor)
-{
-	if (value >= 0) {
-		return ((FLOAT)value) / PosFactor;
-	}
-	else {
-		return ((FLOAT)value) / NegFactor;
-	}
-}
-
-inline FLOAT NormShortToFloat(const SHORT value)
-{
-	return PackedIntToFloat((int)value, 32767.0f, 32768.0f);
-}
-
-inline FLOAT ByteToFloat(const BYTE value)
-{
-	return ((FLOAT)value) / 255.0f;
-}
-
 CxbxPatchedStream& CxbxVertexBufferConverter::GetPatchedStream(uint64_t dataKey, uint64_t streamInfoKey)
 {
     // First, attempt to fetch an existing patched stream
@@ -185,8 +193,9 @@ CxbxPatchedStream& CxbxVertexBufferConverter::GetPatchedStream(uint64_t dataKey,
     // If the cache has exceeded it's upper bound, discard the oldest entries in the cache
     if (m_PatchedStreams.size() > (m_MaxCacheSize + m_CacheElasticity)) {
         while (m_PatchedStreams.size() > m_MaxCacheSize) {
-            const CxbxPatchedStream& streamToDelete = m_PatchedStreamUsageList.back();
+            CxbxPatchedStream& streamToDelete = m_PatchedStreamUsageList.back();
 
+            UntrackStream(streamToDelete);
             m_PatchedStreams.erase({ streamToDelete.uiVertexDataHash, streamToDelete.uiVertexStreamInformationHash });
             m_PatchedStreamUsageList.pop_back();
         }
@@ -195,6 +204,61 @@ CxbxPatchedStream& CxbxVertexBufferConverter::GetPatchedStream(uint64_t dataKey,
     return stream;
 }
 
+CxbxPatchedStream* CxbxVertexBufferConverter::FindTrackedStream(PVOID pXboxVertexData, UINT uiXboxVertexDataSize, uint64_t streamInfoKey)
+{
+    auto it = m_TrackedStreams.find({ pXboxVertexData, uiXboxVertexDataSize, streamInfoKey });
+    if (it == m_TrackedStreams.end()) {
+        return nullptr;
+    }
+
+    return &*it->second;
+}
+
+void CxbxVertexBufferConverter::TrackStream(std::list<CxbxPatchedStream>::iterator it, UINT uiTrackedRewrites, CxbxWriteWatch armedWatch)
+{
+    CxbxPatchedStream& stream = *it;
+    const TrackedStreamKey key{ stream.pCachedXboxVertexData, stream.uiCachedXboxVertexDataSize, stream.uiVertexStreamInformationHash };
+
+    // Only one stream can be tracked per address; Replace the one that held this address before (which
+    // might be this same stream), taking over its write watch, as that was re-armed before hashing
+    auto trackedIt = m_TrackedStreams.find(key);
+    if (trackedIt != m_TrackedStreams.end()) {
+        CxbxPatchedStream& previousStream = *trackedIt->second;
+        if (armedWatch == CXBX_INVALID_WRITE_WATCH) {
+            armedWatch = std::exchange(previousStream.writeWatch, CXBX_INVALID_WRITE_WATCH);
+        }
+
+        UntrackStream(previousStream);
+    }
+
+    stream.uiTrackedRewrites = uiTrackedRewrites;
+    if (uiTrackedRewrites < MAX_TRACKED_STREAM_REWRITES) {
+        if (armedWatch == CXBX_INVALID_WRITE_WATCH) {
+            armedWatch = CxbxWriteTrackerWatch(stream.pCachedXboxVertexData, stream.uiCachedXboxVertexDataSize);
+        }
+
+        stream.writeWatch = armedWatch;
+    } else {
+        CxbxWriteTrackerUnwatch(armedWatch);
+    }
+
+    // Note : Without a write watch, the stream is still tracked (to remember its rewrite count), but always reports dirty
+    stream.bIsTracked = true;
+    m_TrackedStreams[key] = it;
+}
+
+void CxbxVertexBufferConverter::UntrackStream(CxbxPatchedStream& stream)
+{
+    if (!stream.bIsTracked) {
+        return;
+    }
+
+    m_TrackedStreams.erase({ stream.pCachedXboxVertexData, stream.uiCachedXboxVertexDataSize, stream.uiVertexStreamInformationHash });
+    stream.bIsTracked = false;
+    CxbxWriteTrackerUnwatch(stream.writeWatch);
+    stream.writeWatch = CXBX_INVALID_WRITE_WATCH;
+}
+
 void CxbxVertexBufferConverter::DrawCacheStats()
 {
 	const ULONG falsePositives = std::exchange(m_TotalLookupSuccesses, 0) - m_TotalCacheHits;
@@ -202,7 +266,9 @@ void CxbxVertexBufferConverter::DrawCacheStats()
 
 	ImGui::Text("Cache Size: %u", m_PatchedStreams.size());
 	ImGui::Text("Hits: %u", std::exchange(m_TotalCacheHits, 0));
+	ImGui::Text("Write tracked hits: %u", std::exchange(m_WriteTrackedHits, 0));
 	ImGui::Text("Total misses: %u", totalMisses);
+	ImGui::Text("Hashed: %u KB", std::exchange(m_HashedBytes, 0) / 1024);
 	ImGui::Separator();
 	ImGui::TextUnformatted("Cache miss details:");
 	ImGui::TextWrapped("Vertex stream hash miss: %u", std::exchange(m_VertexStreamHashMisses, 0));
@@ -216,7 +282,6 @@ void CxbxVertexBufferConverter::ConvertStream
     UINT             uiStream
 )
 {
-	extern D3DCAPS g_D3DCaps;
 		//X_D3DBaseTexture *pLinearBaseTexture[xbox::X_D3DTS_STAGECOUNT];
 
 	CxbxVertexShaderStreamInfo *pVertexShaderStreamInfo = nullptr;
@@ -307,10 +372,40 @@ void CxbxVertexBufferConverter::ConvertStream
     const UINT uiVertexCount = pDrawContext->NumVerticesToUse;
     const DWORD dwHostVertexDataSize = uiVertexCount * uiHostVertexStride;
     const DWORD xboxVertexDataSize = uiVertexCount * uiXboxVertexStride;
-    const uint64_t vertexDataHash = ComputeHash(pXboxVertexData, xboxVertexDataSize);
     const uint64_t pVertexShaderSteamInfoHash = pVertexShaderStreamInfo != nullptr ? ComputeHash(pVertexShaderStreamInfo->VertexElements,
             sizeof(pVertexShaderStreamInfo->VertexElements[0]) * pVertexShaderStreamInfo->NumberOfVertexElements) : 0;
 
+    // Vertex buffers in contiguous memory (so not the user memory of Draw..UP calls) are tracked for writes;
+    // As long as they're not written to, their cached stream can be found by address, without hashing the data
+    const bool bTrackWrites = (pDrawContext->pXboxVertexStreamZeroData == xbox::zeroptr) && IS_PHYSICAL_ADDRESS(pXboxVertexData);
+    const auto now = std::chrono::steady_clock::now();
+    UINT uiTrackedRewrites = 0;
+    CxbxWriteWatch armedWatch = CXBX_INVALID_WRITE_WATCH; // Handed to TrackStream, or unwatched
+    if (bTrackWrites) {
+        CxbxPatchedStream* pTrackedStream = FindTrackedStream(pXboxVertexData, xboxVertexDataSize, pVertexShaderSteamInfoHash);
+        if (pTrackedStream != nullptr && pTrackedStream->uiCachedXboxVertexStride == uiXboxVertexStride) {
+            bool bIsDirty = CxbxWriteTrackerIsDirty(pTrackedStream->writeWatch);
+            if (!bIsDirty && (now - pTrackedStream->lastHashTime) < TRACKED_STREAM_REHASH_INTERVAL) {
+                m_TotalCacheHits++;
+                m_WriteTrackedHits++;
+                // Look it up by hash as well, which marks it as most recently used
+                GetPatchedStream(pTrackedStream->uiVertexDataHash, pTrackedStream->uiVertexStreamInformationHash);
+                pTrackedStream->Activate(pDrawContext, HostStreamNumber);
+                return;
+            }
+
+            // Re-arm before hashing, so that writes that happen during hashing aren't missed
+            CxbxWriteTrackerRearm(pTrackedStream->writeWatch);
+            uiTrackedRewrites = pTrackedStream->uiTrackedRewrites + (bIsDirty ? 1 : 0);
+        } else {
+            // Likewise, start watching new data before hashing and converting it
+            armedWatch = CxbxWriteTrackerWatch(pXboxVertexData, xboxVertexDataSize);
+        }
+    }
+
+    const uint64_t vertexDataHash = ComputeHash(pXboxVertexData, xboxVertexDataSize);
+    m_HashedBytes += xboxVertexDataSize;
+
     // Lookup implicity inserts a new entry if not exists, so this always works
     CxbxPatchedStream& patchedStream = GetPatchedStream(vertexDataHash, pVertexShaderSteamInfoHash);
 
@@ -321,6 +416,13 @@ void CxbxVertexBufferConverter::ConvertStream
         patchedStream.uiCachedXboxVertexStride == uiXboxVertexStride && // Make sure the Xbox Stride didn't change
         patchedStream.uiCachedXboxVertexDataSize == xboxVertexDataSize ) { // Make sure the Xbox Data Size also didn't change
         m_TotalCacheHits++;
+        if (bTrackWrites && patchedStream.pCachedXboxVertexData == pXboxVertexData) {
+            patchedStream.lastHashTime = now;
+            TrackStream(m_PatchedStreams[{ vertexDataHash, pVertexShaderSteamInfoHash }], uiTrackedRewrites, armedWatch);
+        } else {
+            CxbxWriteTrackerUnwatch(armedWatch);
+        }
+
         patchedStream.Activate(pDrawContext, HostStreamNumber);
         return;
     }
@@ -333,6 +435,7 @@ void CxbxVertexBufferConverter::ConvertStream
 
     // If execution reaches here, the cached vertex buffer was not valid and we must reconvert the data
     // Free the existing buffers
+	UntrackStream(patchedStream);
 	patchedStream.Clear();
     assert(pHostVertexData == nullptr);
 	assert(pNewHostVertexBuffer == nullptr);
@@ -342,6 +445,7 @@ void CxbxVertexBufferConverter::ConvertStream
 	// Test Case :SSX series of games
 	if (dwHostVertexDataSize == 0) {
 		LOG_TEST_CASE("Attempted to use a 0 sized vertex stream");
+		CxbxWriteTrackerUnwatch(armedWatch);
 		return;
 	}
 
@@ -376,206 +480,21 @@ void CxbxVertexBufferConverter::ConvertStream
 	
 	if (bNeedVertexPatching) {
 	    // assert(bNeedStreamCopy || "bNeedVertexPatching implies bNeedStreamCopy (but copies via conversions");
+		// Each element's converter was selected when the vertex declaration got created,
+		// so all that's left here is calling them in order, for each vertex
+		const UINT uiElementCount = pVertexShaderStreamInfo->NumberOfVertexElements;
+		const CxbxVertexShaderStreamElement *pElements = pVertexShaderStreamInfo->VertexElements;
 		for (uint32_t uiVertex = 0; uiVertex < uiVertexCount; uiVertex++) {
-			uint8_t *pXboxVertexAsByte = &pXboxVertexData[uiVertex * uiXboxVertexStride];
+			const uint8_t *pXboxVertexAsByte = &pXboxVertexData[uiVertex * uiXboxVertexStride];
 			uint8_t *pHostVertexAsByte = &pHostVertexData[uiVertex * uiHostVertexStride];
-			for (UINT uiElement = 0; uiElement < pVertexShaderStreamInfo->NumberOfVertexElements; uiElement++) {
-				FLOAT *pXboxVertexAsFloat = (FLOAT*)pXboxVertexAsByte;
-				SHORT *pXboxVertexAsShort = (SHORT*)pXboxVertexAsByte;
-				const int XboxElementByteSize = pVertexShaderStreamInfo->VertexElements[uiElement].XboxByteSize;
-				FLOAT *pHostVertexAsFloat = (FLOAT*)pHostVertexAsByte;
-				SHORT *pHostVertexAsShort = (SHORT*)pHostVertexAsByte;
-				// Dxbx note : The following code handles only the D3DVSDT enums that need conversion;
-				// All other cases are catched by the memcpy in the default-block.
-				switch (pVertexShaderStreamInfo->VertexElements[uiElement].XboxType) {
-				case xbox::X_D3DVSDT_NORMSHORT1: { // 0x11:
-					// Test-cases : Halo - Combat Evolved
-					if (g_D3DCaps.DeclTypes & D3DDTCAPS_SHORT2N) {
-						// Make it SHORT2N
-						pHostVertexAsShort[0] = pXboxVertexAsShort[0];
-						pHostVertexAsShort[1] = 0;
-					} else {
-						// Make it FLOAT1
-						pHostVertexAsFloat[0] = NormShortToFloat(pXboxVertexAsShort[0]);
-						//pHostVertexAsFloat[1] = 0.0f; // Would be needed for FLOAT2
-					}
-					break;
-				}
-				case xbox::X_D3DVSDT_NORMSHORT2: { // 0x21:
-					// Test-cases : Baldur's Gate: Dark Alliance 2, F1 2002, Gun, Halo - Combat Evolved, Scrapland 
-					if (g_D3DCaps.DeclTypes & D3DDTCAPS_SHORT2N) {
-						// No need for patching when D3D9 supports D3DDECLTYPE_SHORT2N
-						// TODO : goto default; // ??
-						//memcpy(pHostVertexAsByte, pXboxVertexAsByte, XboxElementByteSize);
-						// Make it SHORT2N
-						pHostVertexAsShort[0] = pXboxVertexAsShort[0];
-						pHostVertexAsShort[1] = pXboxVertexAsShort[1];
-					} else {
-						// Make it FLOAT2
-						pHostVertexAsFloat[0] = NormShortToFloat(pXboxVertexAsShort[0]);
-						pHostVertexAsFloat[1] = NormShortToFloat(pXboxVertexAsShort[1]);
-					}
-					break;
-				}
-				case xbox::X_D3DVSDT_NORMSHORT3: { // 0x31:
-					// Test-cases : Cel Damage, Constantine, Destroy All Humans!
-					if (g_D3DCaps.DeclTypes & D3DDTCAPS_SHORT4N) {
-						// Make it SHORT4N
-						pHostVertexAsShort[0] = pXboxVertexAsShort[0];
-						pHostVertexAsShort[1] = pXboxVertexAsShort[1];
-						pHostVertexAsShort[2] = pXboxVertexAsShort[2];
-						pHostVertexAsShort[3] = 32767; // TODO : verify
-					} else {
-						// Make it FLOAT3
-						pHostVertexAsFloat[0] = NormShortToFloat(pXboxVertexAsShort[0]);
-						pHostVertexAsFloat[1] = NormShortToFloat(pXboxVertexAsShort[1]);
-						pHostVertexAsFloat[2] = NormShortToFloat(pXboxVertexAsShort[2]);
-					}
-					break;
-				}
-				case xbox::X_D3DVSDT_NORMSHORT4: { // 0x41:
-					// Test-cases : Judge Dredd: Dredd vs Death, NHL Hitz 2002, Silent Hill 2, Sneakers, Tony Hawk Pro Skater 4
-					if (g_D3DCaps.DeclTypes & D3DDTCAPS_SHORT4N) {
-						// No need for patching when D3D9 supports D3DDECLTYPE_SHORT4N
-						// TODO : goto default; // ??
-						//memcpy(pHostVertexAsByte, pXboxVertexAsByte, XboxElementByteSize);
-						// Make it SHORT4N
-						pHostVertexAsShort[0] = pXboxVertexAsShort[0];
-						pHostVertexAsShort[1] = pXboxVertexAsShort[1];
-						pHostVertexAsShort[2] = pXboxVertexAsShort[2];
-						pHostVertexAsShort[3] = pXboxVertexAsShort[3];
-					} else {
-						// Make it FLOAT4
-						pHostVertexAsFloat[0] = NormShortToFloat(pXboxVertexAsShort[0]);
-						pHostVertexAsFloat[1] = NormShortToFloat(pXboxVertexAsShort[1]);
-						pHostVertexAsFloat[2] = NormShortToFloat(pXboxVertexAsShort[2]);
-						pHostVertexAsFloat[3] = NormShortToFloat(pXboxVertexAsShort[3]);
-					}
-					break;
-				}
-				case xbox::X_D3DVSDT_NORMPACKED3: { // 0x16:
-					// Test-cases : Dashboard
-					// Make it FLOAT3
-					union {
-                        int32_t value;
-						struct {
-							int x : 11;
-							int y : 11;
-							int z : 10;
-						};
-					} NormPacked3;
-
-					NormPacked3.value = ((int32_t*)pXboxVertexAsByte)[0];
-
-					pHostVertexAsFloat[0] = PackedIntToFloat(NormPacked3.x, 1023.0f, 1024.f);
-					pHostVertexAsFloat[1] = PackedIntToFloat(NormPacked3.y, 1023.0f, 1024.f);
-					pHostVertexAsFloat[2] = PackedIntToFloat(NormPacked3.z, 511.0f, 512.f);
-					break;
-				}
-				case xbox::X_D3DVSDT_SHORT1: { // 0x15:
-					// Make it SHORT2 and set the second short to 0
-					pHostVertexAsShort[0] = pXboxVertexAsShort[0];
-					pHostVertexAsShort[1] = 0;
-					break;
-				}
-				case xbox::X_D3DVSDT_SHORT3: { // 0x35:
-					// Test-cases : Turok
-					// Make it a SHORT4 and set the fourth short to 1
-					pHostVertexAsShort[0] = pXboxVertexAsShort[0];
-					pHostVertexAsShort[1] = pXboxVertexAsShort[1];
-					pHostVertexAsShort[2] = pXboxVertexAsShort[2];
-					pHostVertexAsShort[3] = 1; // Turok verified (character disappears when this is 32767)
-					break;
-				}
-				case xbox::X_D3DVSDT_PBYTE1: { // 0x14:
-					if (g_D3DCaps.DeclTypes & D3DDTCAPS_UBYTE4N) {
-						// Make it UBYTE4N
-						pHostVertexAsByte[0] = pXboxVertexAsByte[0];
-						pHostVertexAsByte[1] = 0;
-						pHostVertexAsByte[2] = 0;
-						pHostVertexAsByte[3] = 255; // TODO : Verify
-					} else {
-						// Make it FLOAT1
-						pHostVertexAsFloat[0] = ByteToFloat(pXboxVertexAsByte[0]);
-					}
-					break;
-				}
-				case xbox::X_D3DVSDT_PBYTE2: { // 0x24:
-					if (g_D3DCaps.DeclTypes & D3DDTCAPS_UBYTE4N) {
-						// Make it UBYTE4N
-						pHostVertexAsByte[0] = pXboxVertexAsByte[0];
-						pHostVertexAsByte[1] = pXboxVertexAsByte[1];
-						pHostVertexAsByte[2] = 0;
-						pHostVertexAsByte[3] = 255; // TODO : Verify
-					} else {
-						// Make it FLOAT2
-						pHostVertexAsFloat[0] = ByteToFloat(pXboxVertexAsByte[0]);
-						pHostVertexAsFloat[1] = ByteToFloat(pXboxVertexAsByte[1]);
-					}
-					break;
-				}
-				case xbox::X_D3DVSDT_PBYTE3: { // 0x34:
-					// Test-cases : Turok
-					if (g_D3DCaps.DeclTypes & D3DDTCAPS_UBYTE4N) {
-						// Make it UBYTE4N
-						pHostVertexAsByte[0] = pXboxVertexAsByte[0];
-						pHostVertexAsByte[1] = pXboxVertexAsByte[1];
-						pHostVertexAsByte[2] = pXboxVertexAsByte[2];
-						pHostVertexAsByte[3] = 255; // TODO : Verify
-					} else {
-						// Make it FLOAT3
-						pHostVertexAsFloat[0] = ByteToFloat(pXboxVertexAsByte[0]);
-						pHostVertexAsFloat[1] = ByteToFloat(pXboxVertexAsByte[1]);
-						pHostVertexAsFloat[2] = ByteToFloat(pXboxVertexAsByte[2]);
-					}
-					break;
-				}
-				case xbox::X_D3DVSDT_PBYTE4: { // 0x44:
-					// Test-case : Jet Set Radio Future
-					if (g_D3DCaps.DeclTypes & D3DDTCAPS_UBYTE4N) {
-						// No need for patching when D3D9 supports D3DDECLTYPE_UBYTE4N
-						// TODO : goto default; // ??
-						//memcpy(pHostVertexAsByte, pXboxVertexAsByte, XboxElementByteSize);
-						// Make it UBYTE4N
-						pHostVertexAsByte[0] = pXboxVertexAsByte[0];
-						pHostVertexAsByte[1] = pXboxVertexAsByte[1];
-						pHostVertexAsByte[2] = pXboxVertexAsByte[2];
-						pHostVertexAsByte[3] = pXboxVertexAsByte[3];
-					} else {
-						// Make it FLOAT4
-						pHostVertexAsFloat[0] = ByteToFloat(pXboxVertexAsByte[0]);
-						pHostVertexAsFloat[1] = ByteToFloat(pXboxVertexAsByte[1]);
-						pHostVertexAsFloat[2] = ByteToFloat(pXboxVertexAsByte[2]);
-						pHostVertexAsFloat[3] = ByteToFloat(pXboxVertexAsByte[3]);
-					}
-					break;
-				}
-				case xbox::X_D3DVSDT_FLOAT2H: { // 0x72:
-					// Make it FLOAT4 and set the third float to 0.0
-					pHostVertexAsFloat[0] = pXboxVertexAsFloat[0];
-					pHostVertexAsFloat[1] = pXboxVertexAsFloat[1];
-					pHostVertexAsFloat[2] = 0.0f;
-					pHostVertexAsFloat[3] = pXboxVertexAsFloat[2];
-					break;
-				}
-				case xbox::X_D3DVSDT_NONE: { // 0x02:
-					// Test-case : WWE RAW2
-					// Test-case : PetitCopter 
-					LOG_TEST_CASE("X_D3DVSDT_NONE");
-					// No host element data (but Xbox size can be above zero, when used for X_D3DVSD_MASK_SKIP*
-					break;
-				}
-				default: {
-					// Generic 'conversion' - just make a copy :
-					memcpy(pHostVertexAsByte, pXboxVertexAsByte, XboxElementByteSize);
-					break;
-				}
-				} // switch
+			for (UINT uiElement = 0; uiElement < uiElementCount; uiElement++) {
+				const CxbxVertexShaderStreamElement &Element = pElements[uiElement];
+				Element.Convert(pHostVertexAsByte, pXboxVertexAsByte, Element.XboxByteSize);
 
 				// Increment the Xbox pointer :
-				pXboxVertexAsByte += XboxElementByteSize;
+				pXboxVertexAsByte += Element.XboxByteSize;
 				// Increment the host pointer :
-				pHostVertexAsByte += pVertexShaderStreamInfo->VertexElements[uiElement].HostByteSize;
+				pHostVertexAsByte += Element.HostByteSize;
 			} // for NumberOfVertexElements
 		} // for uiVertexCount
     }
@@ -603,6 +522,11 @@ void CxbxVertexBufferConverter::ConvertStream
         patchedStream.pCachedHostVertexBuffer = pNewHostVertexBuffer;
     }
 
+    if (bTrackWrites) {
+        patchedStream.lastHashTime = now;
+        TrackStream(m_PatchedStreams[{ vertexDataHash, pVertexShaderSteamInfoHash }], uiTrackedRewrites, armedWatch);
+    }
+
 	patchedStream.Activate(pDrawContext, HostStreamNumber);
 }
 
@@ -677,6 +601,10 @@ void CxbxSetVertexAttribute(int Register, FLOAT a, FLOAT b, FLOAT c, FLOAT d)
 		return;
 	}
 
+	// A held back draw must still use the current attribute values
+	// Note : Held back Begin/End blocks pass all attributes through their vertices
+	CxbxFlushMergedDraw();
+
 	// Write these values to the NV2A registers, so that we read them back when needed
 	float* attribute_floats = HLE_get_NV2A_vertex_attribute_value_pointer(Register);
 	attribute_floats[0] = a;
@@ -691,29 +619,141 @@ void CxbxSetVertexAttribute(int Register, FLOAT a, FLOAT b, FLOAT c, FLOAT d)
 	g_pD3DDevice->SetVertexShaderConstantF(CXBX_D3DVS_CONSTREG_VREGDEFAULTS_BASE + Register, attribute_floats, 1);
 }
 
+// Returns whether vertices of consecutive Begin/End blocks of this type can be drawn as one primitive
+static bool IsInlineVertexBatchable(xbox::X_D3DPRIMITIVETYPE PrimitiveType)
+{
+	// Strips, fans, loops and polygons connect to the previous vertex, so can't be concatenated
+	switch (PrimitiveType) {
+	case xbox::X_D3DPT_POINTLIST:
+	case xbox::X_D3DPT_LINELIST:
+	case xbox::X_D3DPT_TRIANGLELIST:
+	case xbox::X_D3DPT_QUADLIST:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Sends the vertex attributes set within the current Begin/End block to the host, in one call
+static void CxbxUpdateHostInlineVertexAttributes()
+{
+	if (g_InlineVertexBuffer_DirtyAttributes == 0) {
+		return;
+	}
+
+	int first = std::countr_zero(g_InlineVertexBuffer_DirtyAttributes);
+	int count = std::bit_width(g_InlineVertexBuffer_DirtyAttributes) - first;
+	g_InlineVertexBuffer_DirtyAttributes = 0;
+
+	D3DXVECTOR4 attributes[X_VSH_MAX_ATTRIBUTES];
+	for (int i = 0; i < count; i++) {
+		attributes[i] = D3DXVECTOR4(HLE_get_NV2A_vertex_attribute_value_pointer(first + i));
+	}
+
+	// See CxbxSetVertexAttribute
+	g_pD3DDevice->SetVertexShaderConstantF(CXBX_D3DVS_CONSTREG_VREGDEFAULTS_BASE + first, (float*)attributes, count);
+}
+
+void CxbxFlushInlineVertexBuffer()
+{
+	if (g_InlineVertexBuffer_PendingVertexCount == 0) {
+		return;
+	}
+
+	// The host state for these vertices was already set by CxbxImpl_End, all that's left is the draw.
+	// Arrange for g_InlineVertexBuffer_AttributeFormat to be returned in CxbxGetVertexDeclaration :
+	g_InlineVertexBuffer_DeclarationOverride = true;
+
+	CxbxDrawContext DrawContext = {};
+
+	DrawContext.XboxPrimitiveType = g_InlineVertexBuffer_PendingPrimitiveType;
+	DrawContext.dwVertexCount = g_InlineVertexBuffer_PendingVertexCount;
+	DrawContext.pXboxVertexStreamZeroData = g_InlineVertexBuffer_Table.data();
+	DrawContext.uiXboxVertexStreamZeroStride = g_InlineVertexBuffer_Stride;
+
+	CxbxDrawPrimitiveUP(DrawContext);
+
+	// Now that we've drawn, stop our override in CxbxGetVertexDeclaration :
+	g_InlineVertexBuffer_DeclarationOverride = false;
+
+	g_InlineVertexBuffer_Draws++;
+	g_InlineVertexBuffer_DrawnVertices += g_InlineVertexBuffer_PendingVertexCount;
+	g_InlineVertexBuffer_PendingVertexCount = 0;
+}
+
+void CxbxDrawInlineVertexBufferStats()
+{
+	const ULONG draws = std::exchange(g_InlineVertexBuffer_Draws, 0);
+	const ULONG vertices = std::exchange(g_InlineVertexBuffer_DrawnVertices, 0);
+
+	ImGui::Text("Begin/End blocks: %u", std::exchange(g_InlineVertexBuffer_Blocks, 0));
+	ImGui::Text("Merged blocks: %u", std::exchange(g_InlineVertexBuffer_MergedBlocks, 0));
+	ImGui::Text("Host draws: %u", draws);
+	ImGui::Text("Vertices per draw: %.1f", draws ? (float)vertices / draws : 0.0f);
+}
+
 void CxbxImpl_Begin(xbox::X_D3DPRIMITIVETYPE PrimitiveType)
 {
+	// Ending this block changes host state, which a held back draw still relies on
+	CxbxFlushMergedDraw();
+
 	g_InlineVertexBuffer_PrimitiveType = PrimitiveType;
-	g_InlineVertexBuffer_TableOffset = 0;
+	// Record this block after the pending vertices, in case it can be drawn together with them
+	g_InlineVertexBuffer_BlockStart = g_InlineVertexBuffer_PendingVertexCount;
+	g_InlineVertexBuffer_TableOffset = g_InlineVertexBuffer_BlockStart;
+	g_InlineVertexBuffer_InBlock = true;
 }
 
 void CxbxImpl_End()
 {
 	using namespace xbox;
 
-	if (g_InlineVertexBuffer_TableOffset <= 0) {
+	g_InlineVertexBuffer_InBlock = false;
+	CxbxUpdateHostInlineVertexAttributes();
+
+	UINT BlockVertexCount = g_InlineVertexBuffer_TableOffset - g_InlineVertexBuffer_BlockStart;
+	g_InlineVertexBuffer_TableOffset = g_InlineVertexBuffer_BlockStart;
+	if (BlockVertexCount == 0) {
 		return;
 	}
 
+	g_InlineVertexBuffer_Blocks++;
+
+	// Append this block to the pending vertices when nothing changed in between. Any other
+	// draw, or a patch that changes state outside of the render and texture states, draws
+	// the pending vertices first (see CxbxFlushPendingDraws), so checking those is enough.
+	// Note : The render and texture states are compared last, as that's the most work
+	if (g_InlineVertexBuffer_PendingVertexCount > 0
+		&& IsDrawMergingEnabled()
+		&& g_InlineVertexBuffer_PrimitiveType == g_InlineVertexBuffer_PendingPrimitiveType
+		&& IsInlineVertexBatchable(g_InlineVertexBuffer_PrimitiveType)
+		&& (g_InlineVertexBuffer_PendingVertexCount % g_XboxPrimitiveTypeInfo[g_InlineVertexBuffer_PrimitiveType][1]) == 0
+		&& g_InlineVertexBuffer_PendingVertexCount + BlockVertexCount <= MAX_INLINE_VERTEX_BATCH
+		&& !XboxRenderStates.HasPendingChanges()
+		&& !XboxTextureStates.HasPendingChanges()) {
+		g_InlineVertexBuffer_PendingVertexCount += BlockVertexCount;
+		g_InlineVertexBuffer_TableOffset = g_InlineVertexBuffer_PendingVertexCount;
+		g_InlineVertexBuffer_MergedBlocks++;
+		return;
+	}
+
+	// Draw the pending vertices while the host state still matches them
+	CxbxFlushInlineVertexBuffer();
+
+	// Move this block to the start of the table, where pending vertices are kept
+	if (g_InlineVertexBuffer_BlockStart > 0) {
+		std::copy_n(&g_InlineVertexBuffer_Table[g_InlineVertexBuffer_BlockStart], BlockVertexCount, &g_InlineVertexBuffer_Table[0]);
+		g_InlineVertexBuffer_BlockStart = 0;
+	}
+
 	// Compose an Xbox vertex attribute format to pass through all registers
-	static UINT uiStride = 0;
 	static bool isIvbFormatInitialized = false;
 	if (!isIvbFormatInitialized) {
 		isIvbFormatInitialized = true;
 		for (int reg = 0; reg < X_VSH_MAX_ATTRIBUTES; reg++) {
 			g_InlineVertexBuffer_AttributeFormat.Slots[reg].Format = X_D3DVSDT_FLOAT4;
-			g_InlineVertexBuffer_AttributeFormat.Slots[reg].Offset = uiStride;
-			uiStride += sizeof(float) * 4;
+			g_InlineVertexBuffer_AttributeFormat.Slots[reg].Offset = g_InlineVertexBuffer_Stride;
+			g_InlineVertexBuffer_Stride += sizeof(float) * 4;
 		}
 	}
 
@@ -726,41 +766,31 @@ void CxbxImpl_End()
 
 	CxbxUpdateNativeD3DResources();
 
-	CxbxDrawContext DrawContext = {};
-
-	DrawContext.XboxPrimitiveType = g_InlineVertexBuffer_PrimitiveType;
-	DrawContext.dwVertexCount = g_InlineVertexBuffer_TableOffset;
-	DrawContext.pXboxVertexStreamZeroData = g_InlineVertexBuffer_Table.data();
-	DrawContext.uiXboxVertexStreamZeroStride = uiStride;
-
-	CxbxDrawPrimitiveUP(DrawContext);
-
-	// Now that we've drawn, stop our override in CxbxGetVertexDeclaration :
 	g_InlineVertexBuffer_DeclarationOverride = false;
 
-	// TODO: Should technically clean this up at some point..but on XP doesnt matter much
-	//	ExFreePool(g_InlineVertexBuffer_pData);
-	//	ExFreePool(g_InlineVertexBuffer_Table);
+	// Keep the vertices pending, the draw is done by CxbxFlushInlineVertexBuffer
+	g_InlineVertexBuffer_PendingPrimitiveType = g_InlineVertexBuffer_PrimitiveType;
+	g_InlineVertexBuffer_PendingVertexCount = BlockVertexCount;
+	g_InlineVertexBuffer_TableOffset = BlockVertexCount;
+	if (!IsDrawMergingEnabled()) {
+		CxbxFlushInlineVertexBuffer();
+	}
 }
 
 void CxbxImpl_SetVertexData4f(int Register, FLOAT a, FLOAT b, FLOAT c, FLOAT d)
 {
 	using namespace xbox;
 
-	HRESULT hRet = D3D_OK;
-
 	// Grow g_InlineVertexBuffer_Table to contain at least current, and a potentially next vertex
 	if (g_InlineVertexBuffer_TableLength <= g_InlineVertexBuffer_TableOffset + 1) {
-		UINT InlineVertexBuffer_TableLength_Original = g_InlineVertexBuffer_TableLength;
 		if (g_InlineVertexBuffer_TableLength == 0) {
-			g_InlineVertexBuffer_TableLength = PAGE_SIZE / sizeof(D3DIVB);
+			// Start out big enough to hold a full batch, so it won't need to grow during regular use
+			g_InlineVertexBuffer_TableLength = MAX_INLINE_VERTEX_BATCH;
 		} else {
 			g_InlineVertexBuffer_TableLength *= 2;
 		}
 
-		for (unsigned i = 0; i < (g_InlineVertexBuffer_TableLength - InlineVertexBuffer_TableLength_Original); ++i) {
-			g_InlineVertexBuffer_Table.emplace_back();
-		}
+		g_InlineVertexBuffer_Table.resize(g_InlineVertexBuffer_TableLength);
 
 		EmuLog(LOG_LEVEL::DEBUG, "Expanded g_InlineVertexBuffer_Table to %u entries", g_InlineVertexBuffer_TableLength);
 
@@ -772,16 +802,17 @@ void CxbxImpl_SetVertexData4f(int Register, FLOAT a, FLOAT b, FLOAT c, FLOAT d)
 	}
 
 	// Is this the initial call after D3DDevice_Begin() ?
-	if (g_InlineVertexBuffer_TableOffset == 0) {
+	unsigned o = g_InlineVertexBuffer_TableOffset;
+	if (o == g_InlineVertexBuffer_BlockStart) {
 		// Read starting values for all inline vertex attributes from HLE NV2A pgraph (converting them to required types) :
 		for (int i = 0; i < X_VSH_MAX_ATTRIBUTES; i++) {
-			g_InlineVertexBuffer_Table[0].Slots[i] = D3DXVECTOR4(HLE_get_NV2A_vertex_attribute_value_pointer(i));
+			g_InlineVertexBuffer_Table[o].Slots[i] = D3DXVECTOR4(HLE_get_NV2A_vertex_attribute_value_pointer(i));
 		}
 		// Note : Because all members are assigned an initial value, there's no need for a clearing constructor for _D3DIVB!
 	}
 
 	// Write vertex data to the IVB table
-	if (Register >= X_D3DVSDE_VERTEX && Register <= X_VSH_MAX_ATTRIBUTES) {
+	if (Register >= X_D3DVSDE_VERTEX && Register < X_VSH_MAX_ATTRIBUTES) {
 		// The slot index is usually the register value, but
 		// VERTEX (-1) maps to POSITION (0)
 		int index = Register;
@@ -789,9 +820,19 @@ void CxbxImpl_SetVertexData4f(int Register, FLOAT a, FLOAT b, FLOAT c, FLOAT d)
 			index = X_D3DVSDE_POSITION;
 
 		// Always update our attribute storage with the most recently set register value
-		CxbxSetVertexAttribute(index, a, b, c, d);
+		if (g_InlineVertexBuffer_InBlock) {
+			// Within a Begin/End block, the host copy is written once, by CxbxImpl_End
+			float* attribute_floats = HLE_get_NV2A_vertex_attribute_value_pointer(index);
+			attribute_floats[0] = a;
+			attribute_floats[1] = b;
+			attribute_floats[2] = c;
+			attribute_floats[3] = d;
+			g_InlineVertexBuffer_DirtyAttributes |= 1 << index;
+		}
+		else {
+			CxbxSetVertexAttribute(index, a, b, c, d);
+		}
 
-		unsigned o = g_InlineVertexBuffer_TableOffset;
 		g_InlineVertexBuffer_Table[o].Slots[index] = D3DXVECTOR4(a, b, c, d);
 
 		// Writing to the POSITION slot completes the current vertex
@@ -815,6 +856,11 @@ void CxbxImpl_SetStreamSource(UINT StreamNumber, xbox::X_D3DVertexBuffer* pStrea
 
 	assert(StreamNumber < X_VSH_MAX_STREAMS);
 
+	// Held back draws read from the streams as they are set now
+	if (g_Xbox_SetStreamSource[StreamNumber].VertexBuffer != pStreamData || g_Xbox_SetStreamSource[StreamNumber].Stride != Stride) {
+		CxbxFlushPendingDraws();
+	}
+
 	g_Xbox_SetStreamSource[StreamNumber].VertexBuffer = pStreamData;
 	g_Xbox_SetStreamSource[StreamNumber].Stride = Stride;
 }
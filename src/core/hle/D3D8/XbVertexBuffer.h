@@ -28,11 +28,13 @@
 #include <unordered_map>
 #include <list>
 #include <array>
+#include <chrono>
 
 #include "Cxbx.h"
 
 #include "core\hle\D3D8\XbVertexShader.h"
 #include "common\util\hasher.h" // For ComputeHash
+#include "core\kernel\support\WriteTracker.h" // For CxbxWriteWatch
 
 typedef struct _CxbxDrawContext
 {
@@ -40,6 +42,7 @@ typedef struct _CxbxDrawContext
     IN     DWORD                 dwVertexCount;
     IN     DWORD                 dwStartVertex; // Only D3DDevice_DrawVertices sets this (potentially higher than default 0)
 	IN	   PWORD				 pXboxIndexData; // Set by D3DDevice_DrawIndexedVertices, D3DDevice_DrawIndexedVerticesUP and HLE_draw_inline_elements
+	IN	   PWORD				 pXboxIndexDataKey; // When set, keys the index buffer cache instead of pXboxIndexData (set by CxbxFlushMergedDraw, which draws from a copy)
 	IN	   DWORD				 dwBaseVertexIndex; // Set to g_Xbox_BaseVertexIndex in D3DDevice_DrawIndexedVertices
 	IN	   INDEX16               LowIndex, HighIndex; // Set when pXboxIndexData is set
 	IN	   UINT 				 NumVerticesToUse; // Set by CxbxVertexBufferConverter::Apply
@@ -72,6 +75,10 @@ public:
     void                   *pCachedHostVertexStreamZeroData = nullptr;
     bool                    bCachedHostVertexStreamZeroDataIsAllocated = false;
     IDirect3DVertexBuffer  *pCachedHostVertexBuffer = nullptr;
+    CxbxWriteWatch          writeWatch = CXBX_INVALID_WRITE_WATCH; // Set when the Xbox vertex data is under write tracking
+    bool                    bIsTracked = false; // Set when this stream can be found by address (see m_TrackedStreams)
+    UINT                    uiTrackedRewrites = 0; // How often the Xbox vertex data got modified while under write tracking
+    std::chrono::steady_clock::time_point lastHashTime; // When the Xbox vertex data was last hashed
 };
 
 class CxbxVertexBufferConverter
@@ -98,11 +105,33 @@ class CxbxVertexBufferConverter
             }
         };
 
+        // Patched streams of Xbox vertex data under write tracking can be found by
+        // address, so that they don't need to be hashed as long as they're not written to
+        struct TrackedStreamKey
+        {
+            PVOID pXboxVertexData;
+            UINT uiXboxVertexDataSize;
+            uint64_t streamInfoKey;
+
+            bool operator==(const TrackedStreamKey& rhs) const {
+                return this->pXboxVertexData == rhs.pXboxVertexData && this->uiXboxVertexDataSize == rhs.uiXboxVertexDataSize && this->streamInfoKey == rhs.streamInfoKey;
+            }
+        };
+
+        struct TrackedStreamKeyHash
+        {
+            std::size_t operator()(const TrackedStreamKey& k) const {
+                return static_cast<std::size_t>(k.streamInfoKey ^ ((uint64_t)(uintptr_t)k.pXboxVertexData * 0x9E3779B97F4A7C15ull) ^ k.uiXboxVertexDataSize);
+            }
+        };
+
         // Stack tracking
         ULONG m_TotalCacheHits = 0;
         ULONG m_TotalLookupSuccesses = 0;
         ULONG m_VertexStreamHashMisses = 0;
         ULONG m_DataNotInCacheMisses = 0;
+        ULONG m_WriteTrackedHits = 0;
+        ULONG m_HashedBytes = 0;
 
         const UINT m_MaxCacheSize = 10000;                                        // Maximum number of entries in the cache
         const UINT m_CacheElasticity = 200;                                      // Cache is allowed to grow this much more than maximum before being purged to maximum
@@ -110,6 +139,11 @@ class CxbxVertexBufferConverter
         std::list<CxbxPatchedStream> m_PatchedStreamUsageList;             // Linked list of vertex streams, least recently used is last in the list
         CxbxPatchedStream& GetPatchedStream(uint64_t dataKey, uint64_t streamInfoKey); // Fetches (or inserts) a patched stream associated with the given key
 
+        std::unordered_map<TrackedStreamKey, std::list<CxbxPatchedStream>::iterator, TrackedStreamKeyHash> m_TrackedStreams; // Patched streams under write tracking, by Xbox address
+        CxbxPatchedStream* FindTrackedStream(PVOID pXboxVertexData, UINT uiXboxVertexDataSize, uint64_t streamInfoKey);
+        void TrackStream(std::list<CxbxPatchedStream>::iterator it, UINT uiTrackedRewrites, CxbxWriteWatch armedWatch); // Watches the Xbox data of a patched stream for writes, using armedWatch when given
+        void UntrackStream(CxbxPatchedStream& stream);
+
         // Returns the number of streams of a patch
         UINT GetNbrStreams(CxbxDrawContext *pPatchDesc) const;
 
@@ -136,6 +170,10 @@ extern void EmuUpdateActiveTexture();
 
 extern void CxbxSetVertexAttribute(int Register, FLOAT a, FLOAT b, FLOAT c, FLOAT d);
 
+// Draws the vertices of Begin/End blocks that were held back for batching (see CxbxFlushPendingDraws)
+extern void CxbxFlushInlineVertexBuffer();
+extern void CxbxDrawInlineVertexBufferStats();
+
 extern void CxbxImpl_Begin(xbox::X_D3DPRIMITIVETYPE PrimitiveType);
 extern void CxbxImpl_End();
 extern void CxbxImpl_SetStreamSource(UINT StreamNumber, xbox::X_D3DVertexBuffer* pStreamData, UINT Stride);
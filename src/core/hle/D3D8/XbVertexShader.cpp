@@ -941,6 +941,7 @@ private:
 		pCurrentVertexShaderStreamElementInfo->XboxByteSize = XboxVertexElementByteSize;
 		pCurrentVertexShaderStreamElementInfo->HostDataType = HostVertexElementDataType;
 		pCurrentVertexShaderStreamElementInfo->HostByteSize = HostVertexElementByteSize;
+		pCurrentVertexShaderStreamElementInfo->Convert = GetVertexElementConverter(XboxVertexElementDataType, HostVertexElementDataType);
 
 		// Convert to host vertex element
 		pCurrentHostVertexElement->Stream = pCurrentVertexShaderStreamInfo->XboxStreamIndex; // Use Xbox stream index on host
@@ -1141,7 +1142,9 @@ IDirect3DVertexDeclaration* CxbxCreateHostVertexDeclaration(D3DVERTEXELEMENT *pD
 }
 
 static IDirect3DVertexShader* passthroughshader;
-void CxbxUpdateHostVertexShader()
+// Returns false when bWaitForShader is false and the Xbox shader program is still
+// being compiled; In that case the previous host shader stays set and the draw should be skipped
+bool CxbxUpdateHostVertexShader(bool bWaitForShader)
 {
 	extern bool g_bUsePassthroughHLSL; // TMP glue
 
@@ -1187,10 +1190,17 @@ void CxbxUpdateHostVertexShader()
 		// Create a vertex shader from the tokens
 		DWORD shaderSize;
 		auto VertexShaderKey = g_VertexShaderSource.CreateShader(pTokens, &shaderSize);
-		IDirect3DVertexShader* pHostVertexShader = g_VertexShaderSource.GetShader(VertexShaderKey);
+		bool bIsPending = false;
+		IDirect3DVertexShader* pHostVertexShader = g_VertexShaderSource.GetShader(VertexShaderKey, bWaitForShader ? nullptr : &bIsPending);
+		if (bIsPending) {
+			return false;
+		}
+
 		HRESULT hRet = g_pD3DDevice->SetVertexShader(pHostVertexShader);
 		DEBUG_D3DRESULT(hRet, "g_pD3DDevice->SetVertexShader");
 	}
+
+	return true;
 }
 
 void CxbxSetVertexShaderSlots(DWORD* pTokens, DWORD Address, DWORD NrInstructions)
@@ -1317,6 +1327,8 @@ void CxbxUpdateHostVertexDeclaration()
 
 void CxbxImpl_SetScreenSpaceOffset(float x, float y)
 {
+	CxbxFlushPendingDraws();
+
 	// See https://microsoft.github.io/DirectX-Specs/d3d/archive/D3D11_3_FunctionalSpec.htm#3.3.1%20Pixel%20Coordinate%20System
 	static float PixelOffset = 0.53125f; // 0.5 for pixel center + 1/16?
 
@@ -1330,6 +1342,8 @@ void CxbxImpl_SetVertexShaderInput(DWORD Handle, UINT StreamCount, xbox::X_STREA
 {
 	using namespace xbox;
 
+	CxbxFlushPendingDraws();
+
 	// If Handle is NULL, all VertexShader input state is cleared.
 	// Otherwise, Handle is the address of an Xbox VertexShader struct, or-ed with 1 (X_D3DFVF_RESERVED0)
 	// (Thus, a FVF handle is an invalid argument.)
@@ -1366,6 +1380,8 @@ void CxbxImpl_SelectVertexShader(DWORD Handle, DWORD Address)
 {
 	LOG_INIT; // Allows use of DEBUG_D3DRESULT
 
+	CxbxFlushPendingDraws();
+
 	// Address always indicates a previously loaded vertex shader slot (from where the program is used).
 	// Handle can be null if the current Xbox VertexShader is assigned
 	// Handle can be an address of an Xbox VertexShader struct, or-ed with 1 (X_D3DFVF_RESERVED0)
@@ -1376,6 +1392,12 @@ void CxbxImpl_SelectVertexShader(DWORD Handle, DWORD Address)
 
 	g_Xbox_VertexShaderMode = VertexShaderMode::ShaderProgram;
 
+	// Start compiling the selected program now, so it's likely ready by the time it's drawn with
+	auto pTokens = GetCxbxVertexShaderSlotPtr(Address);
+	if (pTokens) {
+		g_VertexShaderSource.PrewarmShader(pTokens);
+	}
+
 	if (Handle) {
 		if (!VshHandleIsVertexShader(Handle))
 			LOG_TEST_CASE("Non-zero handle must be a VertexShader!");
@@ -1389,6 +1411,8 @@ void CxbxImpl_SelectVertexShader(DWORD Handle, DWORD Address)
 
 void CxbxImpl_LoadVertexShaderProgram(CONST DWORD* pFunction, DWORD Address)
 {
+	CxbxFlushPendingDraws();
+
 	// pFunction is a X_VSH_SHADER_HEADER pointer
 	// D3DDevice_LoadVertexShaderProgram splits the given function buffer into batch-wise pushes to the NV2A
 	// However, we can suffice by copying the program into our slots (and make sure these slots get converted into a vertex shader)
@@ -1404,6 +1428,8 @@ void CxbxImpl_LoadVertexShaderProgram(CONST DWORD* pFunction, DWORD Address)
 
 void CxbxImpl_LoadVertexShader(DWORD Handle, DWORD Address)
 {
+	CxbxFlushPendingDraws();
+
 	// Handle is always address of an X_D3DVertexShader struct, thus always or-ed with 1 (X_D3DFVF_RESERVED0)
 	// Address is the slot (offset) from which the program must be written onwards (as whole DWORDS)
 	// D3DDevice_LoadVertexShader pushes the program contained in the Xbox VertexShader struct to the NV2A
@@ -1489,6 +1515,8 @@ void CxbxImpl_SetVertexShader(DWORD Handle)
 {
 	LOG_INIT; // Allows use of DEBUG_D3DRESULT
 
+	CxbxFlushPendingDraws();
+
 	// Checks if the Handle has bit 0 set - if not, it's a FVF
 	// which is converted to a global Xbox Vertex Shader struct
 	// Otherwise bit 0 is cleared and the resulting address is
@@ -1559,6 +1587,8 @@ void CxbxImpl_DeleteVertexShader(DWORD Handle)
 {
 	LOG_INIT; // Allows use of DEBUG_D3DRESULT
 
+	CxbxFlushPendingDraws();
+
 	// Handle is always address of an Xbox VertexShader struct, or-ed with 1 (X_D3DFVF_RESERVED0)
 	// It's reference count is lowered. If it reaches zero (0), the struct is freed.
 
@@ -1585,6 +1615,8 @@ void CxbxImpl_SetVertexShaderConstant(INT Register, PVOID pConstantData, DWORD C
 {
 	LOG_INIT; // Allows use of DEBUG_D3DRESULT
 
+	CxbxFlushPendingDraws();
+
 	// Xbox vertex shader constants range from -96 to 95
 	// The host does not support negative, so we adjust to 0..191
 	Register += X_D3DSCM_CORRECTION;
@@ -30,6 +30,7 @@
 #include <future>
 
 #include "core\hle\D3D8\XbD3D8Types.h" // for X_VSH_MAX_ATTRIBUTES
+#include "core\hle\D3D8\Direct3D9\ConvertVertexElement.h" // for VertexElementConverter
 
 // Host vertex shader counts
 #define VSH_VS11_MAX_INSTRUCTION_COUNT 128
@@ -44,6 +45,7 @@ typedef struct _CxbxVertexShaderStreamElement
 	UINT XboxByteSize; // The stream element data size (xbox)
 	BYTE HostDataType; // The stream element data type (pc)
 	UINT HostByteSize; // The stream element data size (pc)
+	VertexElementConverter Convert; // Converts the element from xbox to pc, selected once per declaration
 }
 CxbxVertexShaderStreamElement;
 
@@ -70,6 +70,7 @@ typedef void* LPSECURITY_ATTRIBUTES;
 // * NTSTATUS codes
 // ******************************************************************
 #define X_NT_SUCCESS(Status) (((xbox::ntstatus_xt)(Status)) >= 0)
+#define X_NT_ERROR(Status) ((((xbox::ulong_xt)(Status)) >> 30) == 3)
 #define X_STATUS_SUCCESS 0x00000000L
 #define X_STATUS_ABANDONED 0x00000080L
 #define X_STATUS_MUTANT_LIMIT_EXCEEDED 0xC0000191L
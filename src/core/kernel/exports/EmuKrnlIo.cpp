@@ -35,6 +35,7 @@
 #include "core\kernel\init\CxbxKrnl.h" // For CxbxrKrnlAbort
 #include "core\kernel\support\Emu.h" // For EmuLog(LOG_LEVEL::WARNING, )
 #include "core\kernel\support\EmuFile.h" // For CxbxCreateSymbolicLink(), etc.
+#include "core\kernel\support\WriteTracker.h"
 #include "CxbxDebugger.h"
 
 // ******************************************************************
@@ -271,6 +272,8 @@ XBSYSAPI EXPORTNUM(66) xbox::ntstatus_xt NTAPI xbox::IoCreateFile
     if (SUCCEEDED(ret))
     {
         // redirect to NtCreateFile
+        CxbxWriteTrackerScope HandleWrite(FileHandle, sizeof(*FileHandle));
+        CxbxWriteTrackerScope StatusWrite(IoStatusBlock, sizeof(*IoStatusBlock));
         ret = NtDll::NtCreateFile(
             FileHandle,
             DesiredAccess | GENERIC_READ,
@@ -288,6 +291,16 @@ XBSYSAPI EXPORTNUM(66) xbox::ntstatus_xt NTAPI xbox::IoCreateFile
         {
             CxbxDebugger::ReportFileOpened(*FileHandle, nativeObjectAttributes.NtUnicodeString.Buffer, SUCCEEDED(ret));
         }
+
+        // Anything but a plain open may add or replace a directory entry
+        if (SUCCEEDED(ret) && Disposition != FILE_OPEN) {
+            CxbxInvalidateDirectoryCache();
+        }
+
+        // The entry only disappears once the file is closed
+        if (SUCCEEDED(ret) && (CreateOptions & FILE_DELETE_ON_CLOSE) != 0) {
+            CxbxTrackDeleteOnCloseHandle(*FileHandle);
+        }
     }
 
 	if (FAILED(ret))
@@ -47,6 +47,7 @@ namespace NtDll
 #include "core\kernel\support\EmuFile.h" // For EmuNtSymbolicLinkObject, NtStatusToString(), etc.
 #include "core\kernel\memory-manager\VMManager.h" // For g_VMManager
 #include "core\kernel\support\NativeHandle.h"
+#include "core\kernel\support\WriteTracker.h"
 #include "CxbxDebugger.h"
 
 #pragma warning(disable:4005) // Ignore redefined status values
@@ -60,6 +61,14 @@ namespace NtDll
 // Prevent setting the system time from multiple threads at the same time
 std::mutex NtSystemTimeMtx;
 
+// Returns the status through which the write tracker can see an asynchronous request complete.
+// This is only possible when the title preset it to STATUS_PENDING (as XAPI does for overlapped
+// requests, like Win32 does), since the host only writes it once the request completes.
+static const volatile long* CxbxGetIoCompletionStatus(xbox::PIO_STATUS_BLOCK IoStatusBlock)
+{
+	return (IoStatusBlock->Status == X_STATUS_PENDING) ? (const volatile long*)&IoStatusBlock->Status : nullptr;
+}
+
 // ******************************************************************
 // * 0x00B8 - NtAllocateVirtualMemory()
 // ******************************************************************
@@ -102,6 +111,7 @@ XBSYSAPI EXPORTNUM(185) xbox::ntstatus_xt NTAPI xbox::NtCancelTimer
 
 	// redirect to Windows NT
 	// TODO : Untested
+	CxbxWriteTrackerScope StateWrite(CurrentState, sizeof(*CurrentState));
 	NTSTATUS ret = NtDll::NtCancelTimer(
 		TimerHandle,
 		/*OUT*/CurrentState);
@@ -171,6 +181,7 @@ XBSYSAPI EXPORTNUM(187) xbox::ntstatus_xt NTAPI xbox::NtClose
 		DWORD flags = 0;
 		if (GetHandleInformation(Handle, &flags) != 0) {
 			// This was a native handle, call NtDll::NtClose
+			CxbxReleaseDirectoryCacheHandle(Handle);
 			ret = NtDll::NtClose(Handle);
 		}
     }
@@ -251,6 +262,7 @@ XBSYSAPI EXPORTNUM(189) xbox::ntstatus_xt NTAPI xbox::NtCreateEvent
 	const ACCESS_MASK DesiredAccess = EVENT_ALL_ACCESS;
 
 	// redirect to Win2k/XP
+	CxbxWriteTrackerScope HandleWrite(EventHandle, sizeof(*EventHandle));
 	result = NtDll::NtCreateEvent(
 		/*OUT*/EventHandle,
 		DesiredAccess,
@@ -386,6 +398,7 @@ XBSYSAPI EXPORTNUM(192) xbox::ntstatus_xt NTAPI xbox::NtCreateMutant
 	const ACCESS_MASK DesiredAccess = MUTANT_ALL_ACCESS;
 
 	// redirect to Windows Nt
+	CxbxWriteTrackerScope HandleWrite(MutantHandle, sizeof(*MutantHandle));
 	NTSTATUS ret = NtDll::NtCreateMutant(
 		/*OUT*/MutantHandle, 
 		DesiredAccess,
@@ -459,6 +472,7 @@ XBSYSAPI EXPORTNUM(193) xbox::ntstatus_xt NTAPI xbox::NtCreateSemaphore
 	CxbxObjectAttributesToNT(ObjectAttributes, nativeObjectAttributes);
 
 	// redirect to Win2k/XP
+	CxbxWriteTrackerScope HandleWrite(SemaphoreHandle, sizeof(*SemaphoreHandle));
 	NTSTATUS ret = NtDll::NtCreateSemaphore(
 		/*OUT*/SemaphoreHandle,
 		DesiredAccess,
@@ -533,6 +547,7 @@ XBSYSAPI EXPORTNUM(194) xbox::ntstatus_xt NTAPI xbox::NtCreateTimer
 
 	// redirect to Windows NT
 	// TODO : Untested
+	CxbxWriteTrackerScope HandleWrite(TimerHandle, sizeof(*TimerHandle));
 	NTSTATUS ret = NtDll::NtCreateTimer
 	(
 		/*OUT*/TimerHandle,
@@ -569,6 +584,8 @@ XBSYSAPI EXPORTNUM(195) xbox::ntstatus_xt NTAPI xbox::NtDeleteFile
 	{
 		ret = NtDll::NtDeleteFile(
 			nativeObjectAttributes.NtObjAttrPtr);
+
+		CxbxInvalidateDirectoryCache();
 	}
 
 	if (FAILED(ret))
@@ -748,6 +765,7 @@ XBSYSAPI EXPORTNUM(197) xbox::ntstatus_xt NTAPI xbox::NtDuplicateObject
 			}
 		}
 		else {
+			CxbxWriteTrackerScope HandleWrite(TargetHandle, sizeof(*TargetHandle));
 			status = NtDll::NtDuplicateObject(
 				/*SourceProcessHandle=*/g_CurrentProcessHandle,
 				SourceHandle,
@@ -783,8 +801,10 @@ XBSYSAPI EXPORTNUM(198) xbox::ntstatus_xt NTAPI xbox::NtFlushBuffersFile
 	
 	if (EmuHandle::IsEmuHandle(FileHandle))
 		LOG_UNIMPLEMENTED();
-	else
+	else {
+		CxbxWriteTrackerScope StatusWrite(IoStatusBlock, sizeof(*IoStatusBlock));
 		ret = NtDll::NtFlushBuffersFile(FileHandle, (NtDll::IO_STATUS_BLOCK*)IoStatusBlock);
+	}
 
 	RETURN(ret);
 }
@@ -999,6 +1019,7 @@ XBSYSAPI EXPORTNUM(205) xbox::ntstatus_xt NTAPI xbox::NtPulseEvent
 
 	// redirect to Windows NT
 	// TODO : Untested
+	CxbxWriteTrackerScope StateWrite(PreviousState, sizeof(*PreviousState));
 	NTSTATUS ret = NtDll::NtPulseEvent(
 		EventHandle, 
 		/*OUT*/(::PLONG)(PreviousState));
@@ -1109,6 +1130,13 @@ XBSYSAPI EXPORTNUM(207) xbox::ntstatus_xt NTAPI xbox::NtQueryDirectoryFile
 		NtDll::RtlInitUnicodeString(&NtFileMask, wszObjectName);
 	}
 
+	// Synchronous requests can be served from a snapshot of the directory, without a host round-trip per entry
+	if (Event == NULL && ApcRoutine == nullptr) {
+		if (CxbxQueryDirectoryCached(FileHandle, IoStatusBlock, FileInformation, Length, wszObjectName, RestartScan, /*OUT*/ret)) {
+			RETURN(ret);
+		}
+	}
+
 	NtDll::FILE_DIRECTORY_INFORMATION *NtFileDirInfo = 
 		(NtDll::FILE_DIRECTORY_INFORMATION *) malloc(NtFileDirectoryInformationSize + NtPathBufferSize);
 
@@ -1116,6 +1144,10 @@ XBSYSAPI EXPORTNUM(207) xbox::ntstatus_xt NTAPI xbox::NtQueryDirectoryFile
 	wchar_t *wcstr = NtFileDirInfo->FileName;
 	char    *mbstr = FileInformation->FileName;
 
+	// The host writes the status into guest memory, even after returning STATUS_PENDING
+	const volatile long* pCompletionStatus = CxbxGetIoCompletionStatus(IoStatusBlock);
+	CxbxWriteTrackerScope StatusWrite(IoStatusBlock, sizeof(*IoStatusBlock));
+
 	// Go, query that directory :
 	do
 	{
@@ -1140,6 +1172,10 @@ XBSYSAPI EXPORTNUM(207) xbox::ntstatus_xt NTAPI xbox::NtQueryDirectoryFile
 	// Xbox does not return . and ..
 	while (wcscmp(wcstr, L".") == 0 || wcscmp(wcstr, L"..") == 0);
 
+	if (ret == X_STATUS_PENDING) {
+		StatusWrite.SetPending(pCompletionStatus);
+	}
+
 	// convert from PC to Xbox
 	{
 		// TODO : assert that NtDll::FILE_DIRECTORY_INFORMATION has same members and size as xbox::FILE_DIRECTORY_INFORMATION
@@ -1195,6 +1231,7 @@ XBSYSAPI EXPORTNUM(209) xbox::ntstatus_xt NTAPI xbox::NtQueryEvent
 		LOG_FUNC_ARG_OUT(EventInformation)
 		LOG_FUNC_END;
 
+	CxbxWriteTrackerScope InformationWrite(EventInformation, sizeof(EVENT_BASIC_INFORMATION));
 	NTSTATUS ret = NtDll::NtQueryEvent(
 		(NtDll::HANDLE)EventHandle,
 		/*EventInformationClass*/NtDll::EVENT_INFORMATION_CLASS::EventBasicInformation,
@@ -1271,6 +1308,9 @@ XBSYSAPI EXPORTNUM(211) xbox::ntstatus_xt NTAPI xbox::NtQueryInformationFile
 	// Start with sizeof(corresponding struct)
 	size_t bufferSize = XboxFileInfoStructSizes[FileInformationClass];
 
+	// Only the status is written by the host directly; The information gets converted below
+	CxbxWriteTrackerScope StatusWrite(IoStatusBlock, sizeof(*IoStatusBlock));
+
 	// We need to retry the operation in case the buffer is too small to fit the data
 	do
 	{
@@ -1345,6 +1385,7 @@ XBSYSAPI EXPORTNUM(213) xbox::ntstatus_xt NTAPI xbox::NtQueryMutant
 		LOG_FUNC_ARG_OUT(MutantInformation)
 		LOG_FUNC_END;
 
+	CxbxWriteTrackerScope InformationWrite(MutantInformation, sizeof(MUTANT_BASIC_INFORMATION));
 	NTSTATUS ret = NtDll::NtQueryMutant(
 		(NtDll::HANDLE)MutantHandle,
 		/*MutantInformationClass*/NtDll::MUTANT_INFORMATION_CLASS::MutantBasicInformation,
@@ -1372,6 +1413,7 @@ XBSYSAPI EXPORTNUM(214) xbox::ntstatus_xt NTAPI xbox::NtQuerySemaphore
 		LOG_FUNC_ARG_OUT(SemaphoreInformation)
 		LOG_FUNC_END;
 
+	CxbxWriteTrackerScope InformationWrite(SemaphoreInformation, sizeof(SEMAPHORE_BASIC_INFORMATION));
 	NTSTATUS ret = NtDll::NtQuerySemaphore(
 		(NtDll::HANDLE)SemaphoreHandle,
 		/*SemaphoreInformationClass*/NtDll::SEMAPHORE_INFORMATION_CLASS::SemaphoreBasicInformation,
@@ -1456,6 +1498,7 @@ XBSYSAPI EXPORTNUM(216) xbox::ntstatus_xt NTAPI xbox::NtQueryTimer
 
 	// redirect to Windows NT
 	// TODO : Untested
+	CxbxWriteTrackerScope InformationWrite(TimerInformation, sizeof(TIMER_BASIC_INFORMATION));
 	NTSTATUS ret = NtDll::NtQueryTimer(
 		TimerHandle,
 		/*TIMER_INFORMATION_CLASS*/NtDll::TimerBasicInformation,
@@ -1632,6 +1675,7 @@ XBSYSAPI EXPORTNUM(218) xbox::ntstatus_xt NTAPI xbox::NtQueryVolumeInformationFi
 
 	PVOID NativeFileInformation = _aligned_malloc(HostBufferSize, 8);
 
+	CxbxWriteTrackerScope StatusWrite(IoStatusBlock, sizeof(*IoStatusBlock));
 	NTSTATUS ret = NtDll::NtQueryVolumeInformationFile(
 		FileHandle,
 		(NtDll::PIO_STATUS_BLOCK)IoStatusBlock,
@@ -1711,13 +1755,19 @@ XBSYSAPI EXPORTNUM(219) xbox::ntstatus_xt NTAPI xbox::NtReadFile
 		CxbxDebugger::ReportFileRead(FileHandle, Length, Offset);
 	}
 
+	CxbxIoDispatcherContext *cxbxContext = nullptr;
 	if (ApcRoutine != nullptr) {
 		// Pack the original parameters to a wrapped context for a custom APC routine
-		CxbxIoDispatcherContext* cxbxContext = new CxbxIoDispatcherContext(IoStatusBlock, ApcRoutine, ApcContext);
+		cxbxContext = CxbxAcquireIoDispatcherContext(IoStatusBlock, ApcRoutine, ApcContext);
 		ApcRoutine = CxbxIoApcDispatcher;
 		ApcContext = cxbxContext;
 	}
 
+	// The host kernel can't write to pages armed by the write tracker, so release those until the read completes
+	const volatile long* pCompletionStatus = CxbxGetIoCompletionStatus(IoStatusBlock);
+	CxbxWriteTrackerScope BufferWrite(Buffer, Length);
+	CxbxWriteTrackerScope StatusWrite(IoStatusBlock, sizeof(*IoStatusBlock));
+
 	NTSTATUS ret = NtDll::NtReadFile(
 		FileHandle,
 		Event,
@@ -1729,6 +1779,18 @@ XBSYSAPI EXPORTNUM(219) xbox::ntstatus_xt NTAPI xbox::NtReadFile
 		(NtDll::LARGE_INTEGER*)ByteOffset,
 		/*Key=*/nullptr);
 
+	// No APC gets queued for requests that failed outright, so the context must be reclaimed here
+	if (cxbxContext && X_NT_ERROR(ret)) {
+		CxbxReleaseIoDispatcherContext(cxbxContext);
+	}
+
+	if (ret == X_STATUS_PENDING) {
+		BufferWrite.SetPending(pCompletionStatus);
+		StatusWrite.SetPending(pCompletionStatus);
+	}
+
+	CxbxRecordIoRequest(/*IsWrite=*/false, Length, ret);
+
     if (FAILED(ret)) {
         EmuLog(LOG_LEVEL::WARNING, "NtReadFile Failed! (0x%.08X)", ret);
     }
@@ -1782,6 +1844,7 @@ XBSYSAPI EXPORTNUM(221) xbox::ntstatus_xt NTAPI xbox::NtReleaseMutant
 		LOG_FUNC_END;
 
 	// redirect to NtCreateMutant
+	CxbxWriteTrackerScope CountWrite(PreviousCount, sizeof(*PreviousCount));
 	NTSTATUS ret = NtDll::NtReleaseMutant(MutantHandle, (::PLONG)(PreviousCount));
 
 	if (FAILED(ret))
@@ -1806,6 +1869,7 @@ XBSYSAPI EXPORTNUM(222) xbox::ntstatus_xt NTAPI xbox::NtReleaseSemaphore
 		LOG_FUNC_ARG_OUT(PreviousCount)
 		LOG_FUNC_END;
 
+	CxbxWriteTrackerScope CountWrite(PreviousCount, sizeof(*PreviousCount));
 	NTSTATUS ret = NtDll::NtReleaseSemaphore(
 		SemaphoreHandle, 
 		ReleaseCount, 
@@ -1858,6 +1922,7 @@ XBSYSAPI EXPORTNUM(224) xbox::ntstatus_xt NTAPI xbox::NtResumeThread
 
 	if (const auto &nativeHandle = GetNativeHandle(ThreadHandle)) {
 		// Thread handles are created by ob
+		CxbxWriteTrackerScope CountWrite(PreviousSuspendCount, sizeof(*PreviousSuspendCount));
 		RETURN(NtDll::NtResumeThread(*nativeHandle, (::PULONG)PreviousSuspendCount));
 	}
 	else {
@@ -1881,6 +1946,7 @@ XBSYSAPI EXPORTNUM(225) xbox::ntstatus_xt NTAPI xbox::NtSetEvent
 		LOG_FUNC_ARG_OUT(PreviousState)
 		LOG_FUNC_END;
 
+	CxbxWriteTrackerScope StateWrite(PreviousState, sizeof(*PreviousState));
 	NTSTATUS ret = NtDll::NtSetEvent(
 		EventHandle, 
 		(::PLONG)(PreviousState));
@@ -1913,6 +1979,7 @@ XBSYSAPI EXPORTNUM(226) xbox::ntstatus_xt NTAPI xbox::NtSetInformationFile
 	
 	XboxToNTFileInformation(convertedFileInfo, FileInformation, FileInformationClass, (::PULONG)&Length);
 
+	CxbxWriteTrackerScope StatusWrite(IoStatusBlock, sizeof(*IoStatusBlock));
 	NTSTATUS ret = NtDll::NtSetInformationFile(
 		FileHandle,
 		IoStatusBlock,
@@ -1920,6 +1987,11 @@ XBSYSAPI EXPORTNUM(226) xbox::ntstatus_xt NTAPI xbox::NtSetInformationFile
 		Length,
 		FileInformationClass);
 
+	// Renames, deletions, resizes and time stamp changes all show up in directory listings
+	if (SUCCEEDED(ret)) {
+		CxbxInvalidateDirectoryCache();
+	}
+
 	RETURN(ret);
 }
 
@@ -2025,6 +2097,7 @@ XBSYSAPI EXPORTNUM(229) xbox::ntstatus_xt NTAPI xbox::NtSetTimerEx
 
 	// redirect to Windows NT
 	// TODO : Untested
+	CxbxWriteTrackerScope StateWrite(PreviousState, sizeof(*PreviousState));
 	NTSTATUS ret = NtDll::NtSetTimer(
 		TimerHandle,
 		(NtDll::PLARGE_INTEGER)DueTime,
@@ -2081,6 +2154,7 @@ XBSYSAPI EXPORTNUM(231) xbox::ntstatus_xt NTAPI xbox::NtSuspendThread
 
 	if (const auto &nativeHandle = GetNativeHandle(ThreadHandle)) {
 		// Thread handles are created by ob
+		CxbxWriteTrackerScope CountWrite(PreviousSuspendCount, sizeof(*PreviousSuspendCount));
 		RETURN(NtDll::NtSuspendThread(*nativeHandle, (::PULONG)PreviousSuspendCount));
 	}
 	else {
@@ -2280,13 +2354,18 @@ XBSYSAPI EXPORTNUM(236) xbox::ntstatus_xt NTAPI xbox::NtWriteFile
 		CxbxDebugger::ReportFileWrite(FileHandle, Length, Offset);
 	}
 
+	CxbxIoDispatcherContext *cxbxContext = nullptr;
 	if (ApcRoutine != nullptr) {
 		// Pack the original parameters to a wrapped context for a custom APC routine
-		CxbxIoDispatcherContext* cxbxContext = new CxbxIoDispatcherContext(IoStatusBlock, ApcRoutine, ApcContext);
+		cxbxContext = CxbxAcquireIoDispatcherContext(IoStatusBlock, ApcRoutine, ApcContext);
 		ApcRoutine = CxbxIoApcDispatcher;
 		ApcContext = cxbxContext;
 	}
 
+	// The host writes the status into guest memory, even after returning STATUS_PENDING
+	const volatile long* pCompletionStatus = CxbxGetIoCompletionStatus(IoStatusBlock);
+	CxbxWriteTrackerScope StatusWrite(IoStatusBlock, sizeof(*IoStatusBlock));
+
 	NTSTATUS ret = NtDll::NtWriteFile(
 		FileHandle,
 		Event,
@@ -2298,6 +2377,22 @@ XBSYSAPI EXPORTNUM(236) xbox::ntstatus_xt NTAPI xbox::NtWriteFile
 		(NtDll::LARGE_INTEGER*)ByteOffset,
 		/*Key=*/nullptr);
 
+	// No APC gets queued for requests that failed outright, so the context must be reclaimed here
+	if (cxbxContext && X_NT_ERROR(ret)) {
+		CxbxReleaseIoDispatcherContext(cxbxContext);
+	}
+
+	if (ret == X_STATUS_PENDING) {
+		StatusWrite.SetPending(pCompletionStatus);
+	}
+
+	CxbxRecordIoRequest(/*IsWrite=*/true, Length, ret);
+
+	// Writes can change the size and time stamps of the file
+	if (!X_NT_ERROR(ret)) {
+		CxbxInvalidateDirectoryCache();
+	}
+
 	if (FAILED(ret))
 		EmuLog(LOG_LEVEL::WARNING, "NtWriteFile Failed! (0x%.08X)", ret);
 
@@ -143,6 +143,13 @@ void SetupPerTitleKeys()
 
 xbox::void_xt NTAPI CxbxLaunchXbe(xbox::PVOID Entry)
 {
+	std::string replayPath;
+	if (cli_config::GetValue(cli_config::nv2a_replay, &replayPath)) {
+		// Instead of running the title, feed a previously made capture through the NV2A
+		g_NV2A->ReplayCapture(replayPath);
+		CxbxKrnlShutDown();
+	}
+
 	EmuLogInit(LOG_LEVEL::DEBUG, "Calling XBE entry point...");
 	static_cast<void(*)()>(Entry)();
 	EmuLogInit(LOG_LEVEL::DEBUG, "XBE entry point returned");
@@ -719,8 +726,11 @@ static bool CxbxrKrnlXbeSystemSelector(int BootFlags, unsigned& reserved_systems
 	}
 
 	// Check the integrity of the xbe sections
+	char dataLocation[xbox::max_path];
+	g_EmuShared->GetDataLocation(dataLocation);
+	const std::vector<bool> sectionIntegrity = CxbxKrnl_Xbe->CheckSectionsIntegrity(std::string(dataLocation) + "\\XbeDigestCache.ini");
 	for (uint32_t sectionIndex = 0; sectionIndex < CxbxKrnl_Xbe->m_Header.dwSections; sectionIndex++) {
-		if (CxbxKrnl_Xbe->CheckSectionIntegrity(sectionIndex)) {
+		if (sectionIntegrity[sectionIndex]) {
 			EmuLogInit(LOG_LEVEL::INFO, "SHA hash check of section %s successful", CxbxKrnl_Xbe->m_szSectionName[sectionIndex]);
 		}
 		else {
@@ -36,6 +36,7 @@
 #define LOG_PREFIX CXBXR_MODULE::VMEM
 
 #include "common/AddressRanges.h"
+#include "core/kernel/support/WriteTracker.h" // For CxbxWriteTrackerVirtualProtect
 #include "PoolManager.h"
 #include "Logging.h"
 #include "EmuShared.h"
@@ -2312,8 +2313,9 @@ void VMManager::UpdateMemoryPermissions(VAddr addr, size_t Size, DWORD Perms)
 
 	DWORD WindowsPerms = ConvertXboxToWinPermissions(PatchXboxPermissions(Perms));
 
+	// Goes through the write tracker, which must know about protection changes of the pages it watches
 	DWORD dummy;
-	if (!VirtualProtect((void*)addr, Size, WindowsPerms & ~(PAGE_WRITECOMBINE | PAGE_NOCACHE), &dummy))
+	if (!CxbxWriteTrackerVirtualProtect((void*)addr, Size, WindowsPerms & ~(PAGE_WRITECOMBINE | PAGE_NOCACHE), &dummy))
 	{
 		EmuLog(LOG_LEVEL::DEBUG, "VirtualProtect failed. The error code was 0x%08X", GetLastError());
 	}
@@ -31,6 +31,7 @@
 #include <core\kernel\exports\xboxkrnl.h>
 #include "core\kernel\init\CxbxKrnl.h"
 #include "core/kernel/support/PatchRdtsc.hpp"
+#include "core/kernel/support/WriteTracker.h"
 #include "Emu.h"
 #include "devices\x86\EmuX86.h"
 #include "EmuShared.h"
@@ -242,6 +243,13 @@ bool lleTryHandleException(EXCEPTION_POINTERS *e)
 	// Initalize local thread variable
 	bOverrideEmuException = false;
 
+	// Writes to pages armed by the write tracker can come from both Xbox and host code
+	if (e->ExceptionRecord->ExceptionCode == EXCEPTION_ACCESS_VIOLATION
+		&& e->ExceptionRecord->ExceptionInformation[0] == 1 // write access
+		&& CxbxWriteTrackerHandleFault((const void*)e->ExceptionRecord->ExceptionInformation[1])) {
+		return true;
+	}
+
 	// Only handle exceptions which originate from Xbox code
 	if (!IsXboxCodeAddress(e->ContextRecord->Eip)) {
 		return false;
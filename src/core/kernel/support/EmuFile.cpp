@@ -45,6 +45,13 @@
 #include "EmuShared.h"
 
 #include <filesystem>
+#include <atomic>
+#include <climits>
+#include <cwctype>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <imgui.h>
 
 // partition emulation directory handles
 HANDLE g_hCurDir_hack = NULL; // HACK: We should not be depending on this variable. Instead, we should fix/implement Ob/Io objects such as IoCreateDevice.
@@ -341,15 +348,378 @@ void CxbxFormatPartitionByHandle(HANDLE hFile)
 		}
 	}
 
+	CxbxInvalidateDirectoryCache();
+
 	printf("Formatted EmuDisk Partition%d\n", CxbxGetPartitionNumberFromHandle(hFile));
 }
 
+// Number of dispatcher contexts allocated at once when the pool runs dry
+constexpr size_t IoDispatcherContextBlockSize = 64;
+
+static std::mutex g_IoDispatcherContextMtx;
+static CxbxIoDispatcherContext *g_IoDispatcherContextFreeList = nullptr;
+// Blocks are never released, so the pool only grows up to the peak number of in-flight requests
+static std::vector<std::unique_ptr<CxbxIoDispatcherContext[]>> g_IoDispatcherContextBlocks;
+
+CxbxIoDispatcherContext *CxbxAcquireIoDispatcherContext(xbox::PIO_STATUS_BLOCK IoStatusBlock, xbox::PIO_APC_ROUTINE ApcRoutine, PVOID ApcContext)
+{
+	CxbxIoDispatcherContext *cxbxContext;
+	{
+		std::lock_guard<std::mutex> lck(g_IoDispatcherContextMtx);
+		if (g_IoDispatcherContextFreeList == nullptr) {
+			auto &block = g_IoDispatcherContextBlocks.emplace_back(std::make_unique<CxbxIoDispatcherContext[]>(IoDispatcherContextBlockSize));
+			for (size_t i = 0; i < IoDispatcherContextBlockSize; i++) {
+				block[i].NextFree = g_IoDispatcherContextFreeList;
+				g_IoDispatcherContextFreeList = &block[i];
+			}
+		}
+
+		cxbxContext = g_IoDispatcherContextFreeList;
+		g_IoDispatcherContextFreeList = cxbxContext->NextFree;
+	}
+
+	cxbxContext->IoStatusBlock = IoStatusBlock;
+	cxbxContext->ApcRoutine = ApcRoutine;
+	cxbxContext->ApcContext = ApcContext;
+	cxbxContext->NextFree = nullptr;
+	return cxbxContext;
+}
+
+void CxbxReleaseIoDispatcherContext(CxbxIoDispatcherContext *cxbxContext)
+{
+	std::lock_guard<std::mutex> lck(g_IoDispatcherContextMtx);
+	cxbxContext->NextFree = g_IoDispatcherContextFreeList;
+	g_IoDispatcherContextFreeList = cxbxContext;
+}
+
 void NTAPI CxbxIoApcDispatcher(PVOID ApcContext, xbox::PIO_STATUS_BLOCK /*IoStatusBlock*/, xbox::ulong_xt Reserved)
 {
 	CxbxIoDispatcherContext* cxbxContext = reinterpret_cast<CxbxIoDispatcherContext*>(ApcContext);
-	std::get<xbox::PIO_APC_ROUTINE>(*cxbxContext)(
-		std::get<LPVOID>(*cxbxContext),std::get<xbox::PIO_STATUS_BLOCK>(*cxbxContext), Reserved);
-	delete cxbxContext;
+
+	// Copy the original parameters out first, so the context can go back to the pool before the title's routine runs
+	// (the routine is allowed to issue new requests which would otherwise have to grow the pool)
+	const xbox::PIO_APC_ROUTINE ApcRoutine = cxbxContext->ApcRoutine;
+	const PVOID OriginalApcContext = cxbxContext->ApcContext;
+	const xbox::PIO_STATUS_BLOCK IoStatusBlock = cxbxContext->IoStatusBlock;
+	CxbxReleaseIoDispatcherContext(cxbxContext);
+
+	ApcRoutine(OriginalApcContext, IoStatusBlock, Reserved);
+}
+
+// NtReadFile/NtWriteFile throughput, shown in the debugging stats
+static std::atomic<unsigned int> g_IoReadRequests = 0;
+static std::atomic<uint64_t> g_IoReadBytes = 0;
+static std::atomic<unsigned int> g_IoWriteRequests = 0;
+static std::atomic<uint64_t> g_IoWriteBytes = 0;
+static std::atomic<unsigned int> g_IoPendingRequests = 0; // Requests which didn't complete synchronously
+
+void CxbxRecordIoRequest(bool IsWrite, xbox::ulong_xt Length, NTSTATUS Status)
+{
+	if (X_NT_ERROR(Status)) {
+		return;
+	}
+
+	if (IsWrite) {
+		g_IoWriteRequests.fetch_add(1, std::memory_order_relaxed);
+		g_IoWriteBytes.fetch_add(Length, std::memory_order_relaxed);
+	}
+	else {
+		g_IoReadRequests.fetch_add(1, std::memory_order_relaxed);
+		g_IoReadBytes.fetch_add(Length, std::memory_order_relaxed);
+	}
+
+	if (Status == STATUS_PENDING) {
+		g_IoPendingRequests.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void CxbxDrawFileIoStats()
+{
+	ImGui::Text("Reads: %u (%llu KB)", g_IoReadRequests.exchange(0), g_IoReadBytes.exchange(0) / ONE_KB);
+	ImGui::Text("Writes: %u (%llu KB)", g_IoWriteRequests.exchange(0), g_IoWriteBytes.exchange(0) / ONE_KB);
+	ImGui::Text("Pending: %u", g_IoPendingRequests.exchange(0));
+
+	uint64_t path_cache_hits, path_cache_misses;
+	CxbxGetFilePathCacheStats(path_cache_hits, path_cache_misses);
+	ImGui::Separator();
+	ImGui::Text("Path cache hits: %llu", path_cache_hits);
+	ImGui::Text("Path cache misses: %llu", path_cache_misses);
+}
+
+// Longest file name a FATX directory entry can hold; the Xbox never returns anything longer
+constexpr size_t FatxMaxFileNameLength = 42;
+// Bound on the number of directory snapshots kept around
+constexpr size_t DirectoryCacheMaxSize = 256;
+
+struct CxbxDirectoryEntry {
+	std::vector<uint8_t> Record; // Xbox FILE_DIRECTORY_INFORMATION, including the (not null-terminated) name
+	std::wstring UpperCaseName;  // Used for mask matching
+};
+
+struct CxbxDirectorySnapshot {
+	uint64_t Generation;
+	std::vector<CxbxDirectoryEntry> Entries;
+};
+
+struct CxbxDirectoryQueryState {
+	std::shared_ptr<const CxbxDirectorySnapshot> Snapshot; // nullptr when the handle must be serviced by the host
+	std::wstring UpperCaseMask;
+	size_t Cursor = 0;
+	bool ReturnedAny = false;
+};
+
+// Bumped on every operation which may change the contents of a directory, which makes all snapshots stale
+static std::atomic<uint64_t> g_DirectoryCacheGeneration = 0;
+static std::mutex g_DirectoryCacheMtx;
+static std::unordered_map<std::wstring, std::shared_ptr<const CxbxDirectorySnapshot>> g_DirectorySnapshots;
+static std::unordered_map<HANDLE, CxbxDirectoryQueryState> g_DirectoryQueryStates;
+// Files opened with FILE_DELETE_ON_CLOSE, whose directory entry disappears once they're closed
+static std::unordered_set<HANDLE> g_DeleteOnCloseHandles;
+
+void CxbxInvalidateDirectoryCache()
+{
+	g_DirectoryCacheGeneration++;
+}
+
+static std::wstring to_upper_wstring(std::wstring_view src)
+{
+	std::wstring result(src);
+	for (auto &c : result) {
+		c = towupper(c);
+	}
+
+	return result;
+}
+
+// Wildcard match the way FsRtlIsNameInExpression does for the '*' and '?' wildcards, both arguments must be upper case
+static bool CxbxMatchFileMask(std::wstring_view mask, std::wstring_view name)
+{
+	size_t m = 0, n = 0;
+	size_t starMask = std::wstring_view::npos, starName = 0;
+	while (n < name.length()) {
+		if (m < mask.length() && (mask[m] == L'?' || mask[m] == name[n])) {
+			m++;
+			n++;
+		}
+		else if (m < mask.length() && mask[m] == L'*') {
+			starMask = m++;
+			starName = n;
+		}
+		else if (starMask != std::wstring_view::npos) {
+			m = starMask + 1;
+			n = ++starName;
+		}
+		else {
+			return false;
+		}
+	}
+
+	while (m < mask.length() && mask[m] == L'*') {
+		m++;
+	}
+
+	return m == mask.length();
+}
+
+// Lists the whole directory once through a private handle, so the title's own handle keeps its host state untouched
+static std::shared_ptr<const CxbxDirectorySnapshot> CxbxCreateDirectorySnapshot(const std::wstring &path, uint64_t generation)
+{
+	HANDLE hDir = CreateFileW(path.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+	if (hDir == INVALID_HANDLE_VALUE) {
+		return nullptr;
+	}
+
+	auto snapshot = std::make_shared<CxbxDirectorySnapshot>();
+	snapshot->Generation = generation;
+
+	// NT requires the directory information to be 8-byte aligned
+	std::vector<uint64_t> buffer(X64KB / sizeof(uint64_t));
+	constexpr size_t RecordHeaderSize = offsetof(xbox::FILE_DIRECTORY_INFORMATION, FileName);
+	bool succeeded = true;
+	BOOLEAN RestartScan = TRUE;
+	while (true) {
+		NtDll::IO_STATUS_BLOCK IoStatusBlock;
+		NTSTATUS ret = NtDll::NtQueryDirectoryFile(hDir, NULL, nullptr, nullptr, &IoStatusBlock, buffer.data(), X64KB,
+			(NtDll::FILE_INFORMATION_CLASS)xbox::FileDirectoryInformation, /*ReturnSingleEntry=*/FALSE, /*FileMask=*/nullptr, RestartScan);
+		RestartScan = FALSE;
+		if (ret == STATUS_NO_MORE_FILES) {
+			break;
+		}
+
+		if (FAILED(ret)) {
+			succeeded = false;
+			break;
+		}
+
+		auto NtFileDirInfo = reinterpret_cast<NtDll::FILE_DIRECTORY_INFORMATION *>(buffer.data());
+		while (true) {
+			std::wstring_view name(NtFileDirInfo->FileName, NtFileDirInfo->FileNameLength / sizeof(wchar_t));
+
+			// Xbox does not return . and .., nor any name FATX couldn't store
+			if (name != L"." && name != L".." && name.length() <= FatxMaxFileNameLength) {
+				char mbstr[FatxMaxFileNameLength * MB_LEN_MAX + 1];
+				const std::wstring wname(name);
+				const size_t mblen = wcstombs(mbstr, wname.c_str(), sizeof(mbstr));
+				if (mblen != static_cast<size_t>(-1)) {
+					CxbxDirectoryEntry &entry = snapshot->Entries.emplace_back();
+					entry.Record.resize(RecordHeaderSize + mblen);
+					auto XboxFileDirInfo = reinterpret_cast<xbox::FILE_DIRECTORY_INFORMATION *>(entry.Record.data());
+					// TODO : assert that NtDll::FILE_DIRECTORY_INFORMATION has same members and size as xbox::FILE_DIRECTORY_INFORMATION
+					memcpy(XboxFileDirInfo, NtFileDirInfo, RecordHeaderSize);
+					XboxFileDirInfo->NextEntryOffset = 0;
+					XboxFileDirInfo->FileNameLength = mblen;
+					memcpy(entry.Record.data() + RecordHeaderSize, mbstr, mblen);
+					entry.UpperCaseName = to_upper_wstring(name);
+				}
+			}
+
+			if (NtFileDirInfo->NextEntryOffset == 0) {
+				break;
+			}
+
+			NtFileDirInfo = reinterpret_cast<NtDll::FILE_DIRECTORY_INFORMATION *>(reinterpret_cast<uint8_t *>(NtFileDirInfo) + NtFileDirInfo->NextEntryOffset);
+		}
+	}
+
+	CloseHandle(hDir);
+
+	return succeeded ? snapshot : nullptr;
+}
+
+static std::shared_ptr<const CxbxDirectorySnapshot> CxbxGetDirectorySnapshot(HANDLE FileHandle)
+{
+	std::wstring path(MAX_PATH, L'\0');
+	DWORD size = GetFinalPathNameByHandleW(FileHandle, path.data(), MAX_PATH, VOLUME_NAME_DOS);
+	if (size >= MAX_PATH) {
+		path.resize(size);
+		size = GetFinalPathNameByHandleW(FileHandle, path.data(), size, VOLUME_NAME_DOS);
+	}
+
+	if (size == 0 || size >= path.size()) {
+		return nullptr;
+	}
+
+	path.resize(size);
+	const uint64_t generation = g_DirectoryCacheGeneration;
+	{
+		std::lock_guard<std::mutex> lck(g_DirectoryCacheMtx);
+		auto it = g_DirectorySnapshots.find(path);
+		if (it != g_DirectorySnapshots.end() && it->second->Generation == generation) {
+			return it->second;
+		}
+	}
+
+	auto snapshot = CxbxCreateDirectorySnapshot(path, generation);
+	if (snapshot != nullptr) {
+		std::lock_guard<std::mutex> lck(g_DirectoryCacheMtx);
+		if (g_DirectorySnapshots.size() >= DirectoryCacheMaxSize) {
+			g_DirectorySnapshots.clear();
+		}
+
+		g_DirectorySnapshots[path] = snapshot;
+	}
+
+	return snapshot;
+}
+
+bool CxbxQueryDirectoryCached
+(
+	HANDLE                            FileHandle,
+	xbox::PIO_STATUS_BLOCK            IoStatusBlock,
+	xbox::FILE_DIRECTORY_INFORMATION *FileInformation,
+	xbox::ulong_xt                    Length,
+	const std::wstring_view           FileMask,
+	bool                              RestartScan,
+	OUT NTSTATUS                     &Status
+)
+{
+	std::unique_lock<std::mutex> lck(g_DirectoryCacheMtx);
+	auto it = g_DirectoryQueryStates.find(FileHandle);
+	const bool isFirstQuery = (it == g_DirectoryQueryStates.end());
+	if (isFirstQuery) {
+		it = g_DirectoryQueryStates.try_emplace(FileHandle).first;
+		// An empty mask means the same as '*'
+		it->second.UpperCaseMask = FileMask.empty() ? L"*" : to_upper_wstring(FileMask);
+	}
+	else if (it->second.Snapshot == nullptr) {
+		// The first query couldn't be cached, the host keeps track of this handle
+		return false;
+	}
+	else if (RestartScan && !FileMask.empty()) {
+		it->second.UpperCaseMask = to_upper_wstring(FileMask);
+	}
+
+	CxbxDirectoryQueryState &state = it->second;
+	if (isFirstQuery || RestartScan) {
+		lck.unlock();
+		auto snapshot = CxbxGetDirectorySnapshot(FileHandle);
+		lck.lock();
+		if (isFirstQuery && snapshot == nullptr) {
+			return false;
+		}
+
+		if (snapshot != nullptr) {
+			state.Snapshot = std::move(snapshot);
+		}
+
+		state.Cursor = 0;
+		state.ReturnedAny = false;
+	}
+
+	const auto &entries = state.Snapshot->Entries;
+	while (state.Cursor < entries.size() && !CxbxMatchFileMask(state.UpperCaseMask, entries[state.Cursor].UpperCaseName)) {
+		state.Cursor++;
+	}
+
+	if (state.Cursor >= entries.size()) {
+		Status = state.ReturnedAny ? STATUS_NO_MORE_FILES : STATUS_NO_SUCH_FILE;
+		IoStatusBlock->Status = Status;
+		IoStatusBlock->Information = 0;
+		return true;
+	}
+
+	// Without room for the fixed part of the entry, it isn't consumed (nor anything written)
+	if (Length < offsetof(xbox::FILE_DIRECTORY_INFORMATION, FileName)) {
+		Status = STATUS_BUFFER_TOO_SMALL;
+		IoStatusBlock->Status = Status;
+		IoStatusBlock->Information = 0;
+		return true;
+	}
+
+	const auto &record = entries[state.Cursor++].Record;
+	state.ReturnedAny = true;
+	Status = STATUS_SUCCESS;
+	size_t copySize = record.size();
+	if (copySize > Length) {
+		// The entry is still consumed, like the host file systems do
+		copySize = Length;
+		Status = STATUS_BUFFER_OVERFLOW;
+	}
+
+	memcpy(FileInformation, record.data(), copySize);
+	// Keep the name null-terminated when there's room for it, as the host based path always did
+	if (copySize < Length) {
+		reinterpret_cast<char *>(FileInformation)[copySize] = '\0';
+	}
+
+	IoStatusBlock->Status = Status;
+	IoStatusBlock->Information = copySize;
+	return true;
+}
+
+void CxbxTrackDeleteOnCloseHandle(HANDLE hFile)
+{
+	std::lock_guard<std::mutex> lck(g_DirectoryCacheMtx);
+	g_DeleteOnCloseHandles.insert(hFile);
+}
+
+void CxbxReleaseDirectoryCacheHandle(HANDLE hFile)
+{
+	std::lock_guard<std::mutex> lck(g_DirectoryCacheMtx);
+	g_DirectoryQueryStates.erase(hFile);
+	if (g_DeleteOnCloseHandles.erase(hFile) != 0) {
+		CxbxInvalidateDirectoryCache();
+	}
 }
 
 const std::string MediaBoardRomFile = "Chihiro\\fpr21042_m29w160et.bin";
@@ -533,7 +903,7 @@ void replace_all(std::string& str, const std::string& from, const std::string& t
 	}
 }
 
-NTSTATUS CxbxConvertFilePath(
+static NTSTATUS CxbxConvertFilePathUncached(
 	std::string RelativeXboxPath,
 	OUT std::wstring &RelativeHostPath,
 	IN OUT NtDll::HANDLE *RootDirectory,
@@ -701,6 +1071,91 @@ NTSTATUS CxbxConvertFilePath(
 	return STATUS_SUCCESS;
 }
 
+// Caches the outcome of CxbxConvertFilePathUncached for file-handling APIs. The translation only depends
+// on the path, the passed-in RootDirectory handle value, the registered devices and the symbolic links,
+// so entries stay valid until one of the latter two changes (see CxbxInvalidateFilePathCache)
+struct FilePathCacheKey {
+	std::string RelativeXboxPath;
+	HANDLE RootDirectory;
+	bool partitionHeader;
+
+	bool operator==(const FilePathCacheKey& rhs) const {
+		return RootDirectory == rhs.RootDirectory && partitionHeader == rhs.partitionHeader && RelativeXboxPath == rhs.RelativeXboxPath;
+	}
+};
+
+struct FilePathCacheKeyHash {
+	std::size_t operator()(const FilePathCacheKey& k) const {
+		return std::hash<std::string>()(k.RelativeXboxPath) ^ (std::hash<HANDLE>()(k.RootDirectory) << 1) ^ k.partitionHeader;
+	}
+};
+
+struct FilePathCacheEntry {
+	NTSTATUS Status;
+	std::wstring RelativeHostPath;
+	HANDLE RootDirectory;
+};
+
+// Titles only ever touch a limited set of asset paths, this just guards against unbounded growth
+constexpr size_t FilePathCacheMaxSize = 4096;
+
+static std::shared_mutex g_FilePathCacheLock;
+static std::unordered_map<FilePathCacheKey, FilePathCacheEntry, FilePathCacheKeyHash> g_FilePathCache;
+static std::atomic<uint64_t> g_FilePathCacheHits = 0;
+static std::atomic<uint64_t> g_FilePathCacheMisses = 0;
+
+void CxbxInvalidateFilePathCache()
+{
+	std::unique_lock scopedLock(g_FilePathCacheLock);
+	g_FilePathCache.clear();
+}
+
+void CxbxGetFilePathCacheStats(uint64_t &hits, uint64_t &misses)
+{
+	hits = g_FilePathCacheHits.exchange(0);
+	misses = g_FilePathCacheMisses.exchange(0);
+}
+
+NTSTATUS CxbxConvertFilePath(
+	std::string RelativeXboxPath,
+	OUT std::wstring &RelativeHostPath,
+	IN OUT NtDll::HANDLE *RootDirectory,
+	std::string aFileAPIName,
+	bool partitionHeader)
+{
+	// Non file-handling APIs only get a prefix added, that's not worth caching
+	if (aFileAPIName.empty()) {
+		return CxbxConvertFilePathUncached(RelativeXboxPath, RelativeHostPath, RootDirectory, aFileAPIName, partitionHeader);
+	}
+
+	FilePathCacheKey key{ RelativeXboxPath, *RootDirectory, partitionHeader };
+	{
+		std::shared_lock scopedLock(g_FilePathCacheLock);
+		auto it = g_FilePathCache.find(key);
+		if (it != g_FilePathCache.end()) {
+			g_FilePathCacheHits++;
+			if (it->second.Status == STATUS_SUCCESS) {
+				RelativeHostPath = it->second.RelativeHostPath;
+				*RootDirectory = it->second.RootDirectory;
+			}
+
+			return it->second.Status;
+		}
+	}
+
+	g_FilePathCacheMisses++;
+	NTSTATUS result = CxbxConvertFilePathUncached(std::move(RelativeXboxPath), RelativeHostPath, RootDirectory, aFileAPIName, partitionHeader);
+
+	std::unique_lock scopedLock(g_FilePathCacheLock);
+	if (g_FilePathCache.size() >= FilePathCacheMaxSize) {
+		g_FilePathCache.clear();
+	}
+
+	g_FilePathCache.try_emplace(std::move(key), FilePathCacheEntry{ result, RelativeHostPath, *RootDirectory });
+
+	return result;
+}
+
 NTSTATUS CxbxObjectAttributesToNT(
 	xbox::POBJECT_ATTRIBUTES ObjectAttributes, 
 	OUT NativeObjectAttributes& nativeObjectAttributes, 
@@ -837,6 +1292,7 @@ int CxbxRegisterDeviceHostPath(const std::string_view XboxDevicePath, std::strin
 	if (succeeded) {
 		newDevice.HostRootHandle = CreateFile(newDevice.HostDevicePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
 		Devices.push_back(newDevice);
+		CxbxInvalidateFilePathCache();
 		return static_cast<int>(Devices.size()) - 1;
 	}
 
@@ -866,6 +1322,7 @@ xbox::ntstatus_xt CxbxCreateSymbolicLink(std::string SymbolicLinkName, std::stri
 	// TODO: Remove whole else if statement below, see g_hCurDir_hack's comment for remark.
 	else if (SymbolicLinkObject->DriveLetter == CxbxAutoMountDriveLetter) {
 		g_hCurDir_hack = SymbolicLinkObject->RootDirectoryHandle;
+		CxbxInvalidateFilePathCache();
 	}
 
 	return result;
@@ -943,6 +1400,7 @@ NTSTATUS EmuNtSymbolicLinkObject::Init(std::string aSymbolicLinkName, std::strin
 				else
 				{
 					NtSymbolicLinkObjects[DriveLetter - 'A'] = this;
+					CxbxInvalidateFilePathCache();
 					EmuLog(LOG_LEVEL::DEBUG, "Linked \"%s\" to \"%s\" (residing at \"%s\")", aSymbolicLinkName.c_str(), aFullPath.c_str(), HostSymbolicLinkPath.c_str());
 				}
 			}
@@ -961,6 +1419,8 @@ NTSTATUS EmuNtSymbolicLinkObject::Init(std::string aSymbolicLinkName, std::strin
 		if (DriveLetter == CxbxAutoMountDriveLetter) {
 			g_hCurDir_hack = NULL;
 		}
+
+		CxbxInvalidateFilePathCache();
 	}
 }
 
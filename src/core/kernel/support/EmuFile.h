@@ -181,6 +181,10 @@ struct NativeObjectAttributes {
 
 NTSTATUS CxbxObjectAttributesToNT(xbox::POBJECT_ATTRIBUTES ObjectAttributes, NativeObjectAttributes& nativeObjectAttributes, std::string aFileAPIName = "", bool partitionHeader = false);
 NTSTATUS CxbxConvertFilePath(std::string RelativeXboxPath, OUT std::wstring &RelativeHostPath, IN OUT NtDll::HANDLE *RootDirectory, std::string aFileAPIName = "", bool partitionHeader = false);
+// Must be called whenever a device gets registered or a symbolic link gets (un)linked
+void CxbxInvalidateFilePathCache();
+// Returns (and resets) the hit and miss counts of CxbxConvertFilePath's cache
+void CxbxGetFilePathCacheStats(uint64_t &hits, uint64_t &misses);
 
 // ******************************************************************
 // * Wrapper of a handle object
@@ -381,7 +385,16 @@ void CxbxFormatPartitionByHandle(HANDLE hFile);
 
 // Ensures that an original IoStatusBlock gets passed to the completion callback
 // Used by NtReadFile and NtWriteFile
-using CxbxIoDispatcherContext = std::tuple<xbox::PIO_STATUS_BLOCK, xbox::PIO_APC_ROUTINE, PVOID>;
+struct CxbxIoDispatcherContext {
+	xbox::PIO_STATUS_BLOCK IoStatusBlock;
+	xbox::PIO_APC_ROUTINE ApcRoutine;
+	PVOID ApcContext;
+	CxbxIoDispatcherContext *NextFree; // Only valid while the context sits in the pool
+};
+
+// Contexts are recycled through a pool, since streaming titles can have thousands of overlapped requests per second
+CxbxIoDispatcherContext *CxbxAcquireIoDispatcherContext(xbox::PIO_STATUS_BLOCK IoStatusBlock, xbox::PIO_APC_ROUTINE ApcRoutine, PVOID ApcContext);
+void CxbxReleaseIoDispatcherContext(CxbxIoDispatcherContext *cxbxContext);
 
 void NTAPI CxbxIoApcDispatcher
 (
@@ -390,6 +403,29 @@ void NTAPI CxbxIoApcDispatcher
 	xbox::ulong_xt         Reserved
 );
 
+// Counts NtReadFile/NtWriteFile requests for the debugging stats
+void CxbxRecordIoRequest(bool IsWrite, xbox::ulong_xt Length, NTSTATUS Status);
+void CxbxDrawFileIoStats();
+
+// Serves synchronous NtQueryDirectoryFile requests from an in-memory snapshot of the directory.
+// Returns false when the request must go to the host instead.
+bool CxbxQueryDirectoryCached
+(
+	HANDLE                            FileHandle,
+	xbox::PIO_STATUS_BLOCK            IoStatusBlock,
+	xbox::FILE_DIRECTORY_INFORMATION *FileInformation,
+	xbox::ulong_xt                    Length,
+	const std::wstring_view           FileMask,
+	bool                              RestartScan,
+	OUT NTSTATUS                     &Status
+);
+// Must be called after anything that may create, delete, rename or resize a file
+void CxbxInvalidateDirectoryCache();
+// Handles opened with FILE_DELETE_ON_CLOSE invalidate the directory cache once released
+void CxbxTrackDeleteOnCloseHandle(HANDLE hFile);
+// Must be called right before closing a host file handle
+void CxbxReleaseDirectoryCacheHandle(HANDLE hFile);
+
 void CxbxLaunchNewXbe(const std::string& XbePath);
 
 #endif
@@ -0,0 +1,604 @@
+// Copyright 2021 Cxbx-Reloaded Project
+// Licensed under GPLv2+
+// Refer to the COPYING file included.
+
+#define LOG_PREFIX CXBXR_MODULE::VMEM
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "Windows.h"
+#include "assert.h"
+#include "WriteTracker.h"
+#include "common\AddressRanges.h" // For PAGE_SHIFT, PAGE_MASK, PHYSICAL_MAP1_BASE, TILED_MEMORY_BASE
+#include "Logging.h"
+
+struct WriteTrackerPage {
+	DWORD OriginalProtect = 0;
+	DWORD AliasOriginalProtect = 0; // Protection of the tiled memory alias of this page, if it has one
+	std::vector<CxbxWriteWatch> Watches;
+};
+
+struct WriteTrackerWatch {
+	uintptr_t FirstPage;
+	uintptr_t LastPage;
+	bool Dirty;
+};
+
+// A host write into guest memory, started by CxbxWriteTrackerBeginWrite
+struct WriteTrackerPendingWrite {
+	uintptr_t FirstPage;
+	uintptr_t LastPage;
+	bool InProgress; // Until CxbxWriteTrackerEndWrite or CxbxWriteTrackerEndPendingWrite is called
+	const volatile long* pCompletionStatus; // Set when an asynchronous write signals its completion through this
+	ULONGLONG Deadline; // Otherwise, an asynchronous write is assumed to have completed by then
+};
+
+// Asynchronous host writes that don't signal their completion are assumed to be done after this long
+constexpr ULONGLONG WRITE_TRACKER_PENDING_WRITE_TIMEOUT_MS = 2000;
+
+// Armed pages (of both views, see GetAliasPage) are also kept in a bitmap, so that the exception
+// handler can find (and disarm) them without taking g_WriteTrackerMtx. Watched pages it disarmed
+// get flagged in a second bitmap, from which ApplyFaults marks their watches dirty.
+constexpr size_t WRITE_TRACKER_BITMAP_SIZE = ((size_t)1 << (32 - PAGE_SHIFT)) / 32;
+static std::atomic<uint32_t> g_WriteTrackerArmedPages[WRITE_TRACKER_BITMAP_SIZE];
+static std::atomic<uint32_t> g_WriteTrackerFaultedPages[WRITE_TRACKER_BITMAP_SIZE];
+static std::atomic_bool g_WriteTrackerHasFaults = false;
+
+static std::unordered_map<uintptr_t, WriteTrackerPage> g_WriteTrackerPages; // Keyed on page number
+static std::unordered_map<CxbxWriteWatch, WriteTrackerWatch> g_WriteTrackerWatches;
+static std::vector<WriteTrackerPendingWrite> g_WriteTrackerPendingWrites;
+static CxbxWriteWatch g_WriteTrackerNextWatch = 1;
+static std::atomic_uint g_WriteTrackerFaults = 0;
+static std::mutex g_WriteTrackerMtx;
+
+static bool TestPageBit(const std::atomic<uint32_t>* Bitmap, uintptr_t PageNumber)
+{
+	return (Bitmap[PageNumber / 32].load() & (1u << (PageNumber % 32))) != 0;
+}
+
+static void SetPageBit(std::atomic<uint32_t>* Bitmap, uintptr_t PageNumber)
+{
+	Bitmap[PageNumber / 32].fetch_or(1u << (PageNumber % 32));
+}
+
+// Returns whether the bit was set
+static bool ClearPageBit(std::atomic<uint32_t>* Bitmap, uintptr_t PageNumber)
+{
+	uint32_t Bit = 1u << (PageNumber % 32);
+	return (Bitmap[PageNumber / 32].fetch_and(~Bit) & Bit) != 0;
+}
+
+static DWORD GetReadOnlyProtect(DWORD Protect)
+{
+	// Keep the modifier flags (like PAGE_NOCACHE and PAGE_WRITECOMBINE) as-is
+	// Note : Copy-on-write pages aren't armed, as the exception handler restores the protection of
+	// armed pages from their current one, which wouldn't tell those apart from PAGE_READWRITE ones
+	DWORD Modifiers = Protect & ~0xFF;
+	switch (Protect & 0xFF) {
+	case PAGE_READWRITE:
+		return Modifiers | PAGE_READONLY;
+	case PAGE_EXECUTE_READWRITE:
+		return Modifiers | PAGE_EXECUTE_READ;
+	}
+
+	// Not (plainly) writable, so there's nothing to protect
+	return 0;
+}
+
+// The inverse of GetReadOnlyProtect
+static DWORD GetWritableProtect(DWORD Protect)
+{
+	DWORD Modifiers = Protect & ~0xFF;
+	switch (Protect & 0xFF) {
+	case PAGE_READONLY:
+		return Modifiers | PAGE_READWRITE;
+	case PAGE_EXECUTE_READ:
+		return Modifiers | PAGE_EXECUTE_READWRITE;
+	}
+
+	return 0;
+}
+
+static bool IsPageWritable(uintptr_t PageNumber)
+{
+	MEMORY_BASIC_INFORMATION mbi;
+	if (VirtualQuery((LPCVOID)(PageNumber << PAGE_SHIFT), &mbi, sizeof(mbi)) != sizeof(mbi) || mbi.State != MEM_COMMIT) {
+		return false;
+	}
+
+	switch (mbi.Protect & 0xFF) {
+	case PAGE_READWRITE:
+	case PAGE_WRITECOPY:
+	case PAGE_EXECUTE_READWRITE:
+	case PAGE_EXECUTE_WRITECOPY:
+		return true;
+	}
+
+	return false;
+}
+
+// The first 64 MiB of physical memory is mapped twice; At PHYSICAL_MAP1_BASE (where all
+// watches are placed) and at TILED_MEMORY_BASE. Both views must be armed, or writes through
+// the tiled view would go unnoticed.
+static uintptr_t GetAliasPage(uintptr_t PageNumber)
+{
+	uintptr_t Address = PageNumber << PAGE_SHIFT;
+	if (Address - PHYSICAL_MAP1_BASE > PHYSICAL_MAP1_END - PHYSICAL_MAP1_BASE) {
+		return 0;
+	}
+
+	return (Address - PHYSICAL_MAP1_BASE + TILED_MEMORY_BASE) >> PAGE_SHIFT;
+}
+
+// Returns the page that watches are placed on for the given (possibly aliased) page
+static uintptr_t GetWatchedPage(uintptr_t PageNumber)
+{
+	uintptr_t Address = PageNumber << PAGE_SHIFT;
+	if (Address - TILED_MEMORY_BASE > TILED_MEMORY_END - TILED_MEMORY_BASE) {
+		return PageNumber;
+	}
+
+	return (Address - TILED_MEMORY_BASE + PHYSICAL_MAP1_BASE) >> PAGE_SHIFT;
+}
+
+static bool IsPendingWriteCompleted(const WriteTrackerPendingWrite& Write)
+{
+	if (Write.InProgress) {
+		return false;
+	}
+
+	if (Write.pCompletionStatus == nullptr) {
+		return GetTickCount64() >= Write.Deadline;
+	}
+
+	// The status belongs to the title, which may release it once the request completed
+	MEMORY_BASIC_INFORMATION mbi;
+	if (VirtualQuery((LPCVOID)Write.pCompletionStatus, &mbi, sizeof(mbi)) != sizeof(mbi)
+		|| mbi.State != MEM_COMMIT
+		|| (mbi.Protect & (PAGE_NOACCESS | PAGE_GUARD))) {
+		return true;
+	}
+
+	return *Write.pCompletionStatus != STATUS_PENDING;
+}
+
+static void RemoveCompletedWrites()
+{
+	g_WriteTrackerPendingWrites.erase(
+		std::remove_if(g_WriteTrackerPendingWrites.begin(), g_WriteTrackerPendingWrites.end(), IsPendingWriteCompleted),
+		g_WriteTrackerPendingWrites.end());
+}
+
+static bool IsWritePending(uintptr_t PageNumber)
+{
+	for (const WriteTrackerPendingWrite& Write : g_WriteTrackerPendingWrites) {
+		if (PageNumber >= Write.FirstPage && PageNumber <= Write.LastPage) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Marks the watches of pages that the exception handler disarmed dirty
+static void ApplyFaults()
+{
+	if (!g_WriteTrackerHasFaults.exchange(false)) {
+		return;
+	}
+
+	for (auto& it : g_WriteTrackerPages) {
+		if (ClearPageBit(g_WriteTrackerFaultedPages, it.first)) {
+			for (CxbxWriteWatch Watch : it.second.Watches) {
+				g_WriteTrackerWatches[Watch].Dirty = true;
+			}
+		}
+	}
+}
+
+static bool ArmPage(uintptr_t PageNumber, WriteTrackerPage& Page)
+{
+	if (TestPageBit(g_WriteTrackerArmedPages, PageNumber)) {
+		return true;
+	}
+
+	DWORD ReadOnlyProtect = GetReadOnlyProtect(Page.OriginalProtect);
+	if (ReadOnlyProtect == 0) {
+		return false;
+	}
+
+	// The host is still writing into this page, and would fail doing so when it's protected
+	if (IsWritePending(PageNumber)) {
+		return false;
+	}
+
+	// Flag the page armed before protecting it, so that the exception handler recognizes the very first write
+	uintptr_t AliasPage = (Page.AliasOriginalProtect != 0) ? GetAliasPage(PageNumber) : 0;
+	SetPageBit(g_WriteTrackerArmedPages, PageNumber);
+	if (AliasPage != 0) {
+		SetPageBit(g_WriteTrackerArmedPages, AliasPage);
+	}
+
+	DWORD OldProtect;
+	if (!VirtualProtect((LPVOID)(PageNumber << PAGE_SHIFT), PAGE_SIZE, ReadOnlyProtect, &OldProtect)) {
+		EmuLog(LOG_LEVEL::WARNING, "Failed to arm write tracking of page 0x%.8X", PageNumber << PAGE_SHIFT);
+		ClearPageBit(g_WriteTrackerArmedPages, PageNumber);
+		if (AliasPage != 0) {
+			ClearPageBit(g_WriteTrackerArmedPages, AliasPage);
+		}
+
+		return false;
+	}
+
+	if (AliasPage != 0) {
+		if (!VirtualProtect((LPVOID)(AliasPage << PAGE_SHIFT), PAGE_SIZE, GetReadOnlyProtect(Page.AliasOriginalProtect), &OldProtect)) {
+			EmuLog(LOG_LEVEL::WARNING, "Failed to arm write tracking of page 0x%.8X", AliasPage << PAGE_SHIFT);
+			VirtualProtect((LPVOID)(PageNumber << PAGE_SHIFT), PAGE_SIZE, Page.OriginalProtect, &OldProtect);
+			ClearPageBit(g_WriteTrackerArmedPages, PageNumber);
+			ClearPageBit(g_WriteTrackerArmedPages, AliasPage);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void DisarmPage(uintptr_t PageNumber, WriteTrackerPage& Page)
+{
+	// Lift the protection before clearing the armed flags, so that a write faulting meanwhile
+	// either still finds the page armed (and lifts the protection itself) or can simply be retried
+	bool Disarmed = false;
+	DWORD OldProtect;
+	if (TestPageBit(g_WriteTrackerArmedPages, PageNumber)) {
+		VirtualProtect((LPVOID)(PageNumber << PAGE_SHIFT), PAGE_SIZE, Page.OriginalProtect, &OldProtect);
+		Disarmed |= ClearPageBit(g_WriteTrackerArmedPages, PageNumber);
+	}
+
+	uintptr_t AliasPage = GetAliasPage(PageNumber);
+	if (AliasPage != 0 && TestPageBit(g_WriteTrackerArmedPages, AliasPage)) {
+		if (Page.AliasOriginalProtect != 0) {
+			VirtualProtect((LPVOID)(AliasPage << PAGE_SHIFT), PAGE_SIZE, Page.AliasOriginalProtect, &OldProtect);
+		}
+
+		Disarmed |= ClearPageBit(g_WriteTrackerArmedPages, AliasPage);
+	}
+
+	// The exception handler may have disarmed the page already
+	Disarmed |= ClearPageBit(g_WriteTrackerFaultedPages, PageNumber);
+
+	// Everyone watching this page must now assume it got written to
+	if (Disarmed) {
+		for (CxbxWriteWatch Watch : Page.Watches) {
+			g_WriteTrackerWatches[Watch].Dirty = true;
+		}
+	}
+}
+
+// Restores the writable protection of a page armed by ArmPage, without needing its WriteTrackerPage
+static void LiftPageProtection(uintptr_t PageNumber)
+{
+	MEMORY_BASIC_INFORMATION mbi;
+	if (VirtualQuery((LPCVOID)(PageNumber << PAGE_SHIFT), &mbi, sizeof(mbi)) != sizeof(mbi)) {
+		return;
+	}
+
+	// Another thread may have lifted the protection already
+	DWORD WritableProtect = GetWritableProtect(mbi.Protect);
+	if (WritableProtect != 0) {
+		DWORD OldProtect;
+		VirtualProtect((LPVOID)(PageNumber << PAGE_SHIFT), PAGE_SIZE, WritableProtect, &OldProtect);
+	}
+}
+
+CxbxWriteWatch CxbxWriteTrackerWatch(const void* Address, size_t Size)
+{
+	if (Address == nullptr || Size == 0) {
+		return CXBX_INVALID_WRITE_WATCH;
+	}
+
+	uintptr_t FirstPage = GetWatchedPage((uintptr_t)Address >> PAGE_SHIFT);
+	uintptr_t LastPage = GetWatchedPage(((uintptr_t)Address + Size - 1) >> PAGE_SHIFT);
+
+	std::lock_guard<std::mutex> lck(g_WriteTrackerMtx);
+
+	// Query the protection of pages we don't track yet
+	for (uintptr_t PageNumber = FirstPage; PageNumber <= LastPage; PageNumber++) {
+		if (g_WriteTrackerPages.find(PageNumber) != g_WriteTrackerPages.end()) {
+			continue;
+		}
+
+		MEMORY_BASIC_INFORMATION mbi;
+		if (VirtualQuery((LPCVOID)(PageNumber << PAGE_SHIFT), &mbi, sizeof(mbi)) != sizeof(mbi)
+			|| mbi.State != MEM_COMMIT
+			|| GetReadOnlyProtect(mbi.Protect) == 0) {
+			return CXBX_INVALID_WRITE_WATCH;
+		}
+	}
+
+	CxbxWriteWatch Watch = g_WriteTrackerNextWatch++;
+	if (g_WriteTrackerNextWatch == CXBX_INVALID_WRITE_WATCH) {
+		g_WriteTrackerNextWatch++;
+	}
+
+	ApplyFaults();
+	RemoveCompletedWrites();
+
+	g_WriteTrackerWatches[Watch] = { FirstPage, LastPage, /*Dirty=*/false };
+	for (uintptr_t PageNumber = FirstPage; PageNumber <= LastPage; PageNumber++) {
+		auto it = g_WriteTrackerPages.find(PageNumber);
+		if (it == g_WriteTrackerPages.end()) {
+			MEMORY_BASIC_INFORMATION mbi;
+			VirtualQuery((LPCVOID)(PageNumber << PAGE_SHIFT), &mbi, sizeof(mbi));
+			it = g_WriteTrackerPages.emplace(PageNumber, WriteTrackerPage()).first;
+			it->second.OriginalProtect = mbi.Protect;
+
+			uintptr_t AliasPage = GetAliasPage(PageNumber);
+			if (AliasPage != 0
+				&& VirtualQuery((LPCVOID)(AliasPage << PAGE_SHIFT), &mbi, sizeof(mbi)) == sizeof(mbi)
+				&& mbi.State == MEM_COMMIT) {
+				it->second.AliasOriginalProtect = GetReadOnlyProtect(mbi.Protect) != 0 ? mbi.Protect : 0;
+			}
+		}
+
+		it->second.Watches.push_back(Watch);
+		if (!ArmPage(PageNumber, it->second)) {
+			// Without protection, writes can't be detected; Report this watch as dirty until it can be armed
+			g_WriteTrackerWatches[Watch].Dirty = true;
+		}
+	}
+
+	return Watch;
+}
+
+void CxbxWriteTrackerUnwatch(CxbxWriteWatch Watch)
+{
+	if (Watch == CXBX_INVALID_WRITE_WATCH) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lck(g_WriteTrackerMtx);
+
+	auto watchIt = g_WriteTrackerWatches.find(Watch);
+	if (watchIt == g_WriteTrackerWatches.end()) {
+		return;
+	}
+
+	ApplyFaults();
+	for (uintptr_t PageNumber = watchIt->second.FirstPage; PageNumber <= watchIt->second.LastPage; PageNumber++) {
+		auto it = g_WriteTrackerPages.find(PageNumber);
+		assert(it != g_WriteTrackerPages.end());
+		auto& Watches = it->second.Watches;
+		Watches.erase(std::find(Watches.begin(), Watches.end(), Watch));
+		if (Watches.empty()) {
+			DisarmPage(PageNumber, it->second);
+			g_WriteTrackerPages.erase(it);
+		}
+	}
+
+	g_WriteTrackerWatches.erase(watchIt);
+}
+
+bool CxbxWriteTrackerIsDirty(CxbxWriteWatch Watch)
+{
+	if (Watch == CXBX_INVALID_WRITE_WATCH) {
+		return true;
+	}
+
+	std::lock_guard<std::mutex> lck(g_WriteTrackerMtx);
+
+	ApplyFaults();
+	auto it = g_WriteTrackerWatches.find(Watch);
+	return (it == g_WriteTrackerWatches.end()) || it->second.Dirty;
+}
+
+void CxbxWriteTrackerRearm(CxbxWriteWatch Watch)
+{
+	if (Watch == CXBX_INVALID_WRITE_WATCH) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lck(g_WriteTrackerMtx);
+
+	auto watchIt = g_WriteTrackerWatches.find(Watch);
+	if (watchIt == g_WriteTrackerWatches.end()) {
+		return;
+	}
+
+	ApplyFaults();
+	RemoveCompletedWrites();
+
+	bool Armed = true;
+	for (uintptr_t PageNumber = watchIt->second.FirstPage; PageNumber <= watchIt->second.LastPage; PageNumber++) {
+		Armed &= ArmPage(PageNumber, g_WriteTrackerPages[PageNumber]);
+	}
+
+	watchIt->second.Dirty = !Armed;
+}
+
+void CxbxWriteTrackerBeginWrite(const void* Address, size_t Size)
+{
+	if (Address == nullptr || Size == 0) {
+		return;
+	}
+
+	uintptr_t FirstPage = GetWatchedPage((uintptr_t)Address >> PAGE_SHIFT);
+	uintptr_t LastPage = GetWatchedPage(((uintptr_t)Address + Size - 1) >> PAGE_SHIFT);
+
+	std::lock_guard<std::mutex> lck(g_WriteTrackerMtx);
+
+	// Writes are registered even when nothing is watched yet, as a watch could be armed before the write ends
+	RemoveCompletedWrites();
+	g_WriteTrackerPendingWrites.push_back({ FirstPage, LastPage, /*InProgress=*/true, nullptr, 0 });
+
+	if (g_WriteTrackerPages.empty()) {
+		return;
+	}
+
+	ApplyFaults();
+
+	for (uintptr_t PageNumber = FirstPage; PageNumber <= LastPage; PageNumber++) {
+		auto it = g_WriteTrackerPages.find(PageNumber);
+		if (it != g_WriteTrackerPages.end()) {
+			DisarmPage(PageNumber, it->second);
+		}
+	}
+}
+
+// Returns the most recent write started for the given pages that is still in progress
+static std::vector<WriteTrackerPendingWrite>::iterator FindWriteInProgress(uintptr_t FirstPage, uintptr_t LastPage)
+{
+	for (auto it = g_WriteTrackerPendingWrites.rbegin(); it != g_WriteTrackerPendingWrites.rend(); ++it) {
+		if (it->FirstPage == FirstPage && it->LastPage == LastPage && it->InProgress) {
+			return std::next(it).base();
+		}
+	}
+
+	return g_WriteTrackerPendingWrites.end();
+}
+
+void CxbxWriteTrackerEndWrite(const void* Address, size_t Size)
+{
+	if (Address == nullptr || Size == 0) {
+		return;
+	}
+
+	uintptr_t FirstPage = GetWatchedPage((uintptr_t)Address >> PAGE_SHIFT);
+	uintptr_t LastPage = GetWatchedPage(((uintptr_t)Address + Size - 1) >> PAGE_SHIFT);
+
+	std::lock_guard<std::mutex> lck(g_WriteTrackerMtx);
+
+	// Pages written to were disarmed when the write began, and couldn't be armed again since,
+	// so all watches covering them are still dirty; Only the pending write needs to go
+	auto it = FindWriteInProgress(FirstPage, LastPage);
+	if (it != g_WriteTrackerPendingWrites.end()) {
+		g_WriteTrackerPendingWrites.erase(it);
+	}
+}
+
+void CxbxWriteTrackerEndPendingWrite(const void* Address, size_t Size, const volatile long* pCompletionStatus)
+{
+	if (Address == nullptr || Size == 0) {
+		return;
+	}
+
+	uintptr_t FirstPage = GetWatchedPage((uintptr_t)Address >> PAGE_SHIFT);
+	uintptr_t LastPage = GetWatchedPage(((uintptr_t)Address + Size - 1) >> PAGE_SHIFT);
+
+	std::lock_guard<std::mutex> lck(g_WriteTrackerMtx);
+
+	auto it = FindWriteInProgress(FirstPage, LastPage);
+	if (it != g_WriteTrackerPendingWrites.end()) {
+		it->InProgress = false;
+		it->pCompletionStatus = pCompletionStatus;
+		it->Deadline = GetTickCount64() + WRITE_TRACKER_PENDING_WRITE_TIMEOUT_MS;
+	}
+}
+
+CxbxWriteTrackerScope::CxbxWriteTrackerScope(const void* Address, size_t Size)
+	: m_Address(Address), m_Size(Size)
+{
+	CxbxWriteTrackerBeginWrite(Address, Size);
+}
+
+CxbxWriteTrackerScope::~CxbxWriteTrackerScope()
+{
+	if (m_bPending) {
+		CxbxWriteTrackerEndPendingWrite(m_Address, m_Size, m_pCompletionStatus);
+	}
+	else {
+		CxbxWriteTrackerEndWrite(m_Address, m_Size);
+	}
+}
+
+void CxbxWriteTrackerScope::SetPending(const volatile long* pCompletionStatus)
+{
+	m_bPending = true;
+	m_pCompletionStatus = pCompletionStatus;
+}
+
+bool CxbxWriteTrackerVirtualProtect(void* Address, size_t Size, DWORD NewProtect, DWORD* OldProtect)
+{
+	// Hold the lock while changing the protection, so that pages can't get (re)armed meanwhile
+	std::lock_guard<std::mutex> lck(g_WriteTrackerMtx);
+
+	if (!VirtualProtect(Address, Size, NewProtect, OldProtect)) {
+		return false;
+	}
+
+	if (g_WriteTrackerPages.empty()) {
+		return true;
+	}
+
+	ApplyFaults();
+	uintptr_t FirstPage = (uintptr_t)Address >> PAGE_SHIFT;
+	uintptr_t LastPage = ((uintptr_t)Address + Size - 1) >> PAGE_SHIFT;
+	for (uintptr_t PageNumber = FirstPage; PageNumber <= LastPage; PageNumber++) {
+		uintptr_t WatchedPage = GetWatchedPage(PageNumber);
+		auto it = g_WriteTrackerPages.find(WatchedPage);
+		if (it == g_WriteTrackerPages.end()) {
+			continue;
+		}
+
+		// Report the protection the title set, instead of the one we armed the page with
+		DWORD TrackedProtect = (WatchedPage == PageNumber) ? it->second.OriginalProtect : it->second.AliasOriginalProtect;
+		if (PageNumber == FirstPage && TestPageBit(g_WriteTrackerArmedPages, PageNumber) && TrackedProtect != 0) {
+			*OldProtect = TrackedProtect;
+		}
+
+		if (WatchedPage == PageNumber) {
+			it->second.OriginalProtect = NewProtect;
+		}
+		else {
+			it->second.AliasOriginalProtect = GetReadOnlyProtect(NewProtect) != 0 ? NewProtect : 0;
+		}
+
+		// Our read-only protection got replaced, so disarm the page (which applies the new protection);
+		// Its watches stay dirty until the next rearm protects it again
+		DisarmPage(WatchedPage, it->second);
+	}
+
+	return true;
+}
+
+bool CxbxWriteTrackerHandleFault(const void* Address)
+{
+	// Note : This runs in the exception handler, possibly on a thread that already holds g_WriteTrackerMtx
+	// (or that another thread holding it waits on), so only the lock-free bitmaps are used here
+	uintptr_t FaultPage = (uintptr_t)Address >> PAGE_SHIFT;
+	if (!TestPageBit(g_WriteTrackerArmedPages, FaultPage)) {
+		// Either not ours, or another thread disarmed the page meanwhile (which lifts the protection first),
+		// in which case the write can simply be retried
+		return IsPageWritable(FaultPage);
+	}
+
+	// Lift the protection of both views before clearing their armed flags (see DisarmPage)
+	uintptr_t PageNumber = GetWatchedPage(FaultPage);
+	uintptr_t AliasPage = GetAliasPage(PageNumber);
+	bool Disarmed = false;
+	if (TestPageBit(g_WriteTrackerArmedPages, PageNumber)) {
+		LiftPageProtection(PageNumber);
+		Disarmed |= ClearPageBit(g_WriteTrackerArmedPages, PageNumber);
+	}
+
+	if (AliasPage != 0 && TestPageBit(g_WriteTrackerArmedPages, AliasPage)) {
+		LiftPageProtection(AliasPage);
+		Disarmed |= ClearPageBit(g_WriteTrackerArmedPages, AliasPage);
+	}
+
+	// Leave marking the watches of this page dirty to the next tracker call (see ApplyFaults)
+	if (Disarmed) {
+		SetPageBit(g_WriteTrackerFaultedPages, PageNumber);
+		g_WriteTrackerHasFaults = true;
+		g_WriteTrackerFaults++;
+	}
+
+	return true;
+}
+
+unsigned int CxbxWriteTrackerGetFaultCount()
+{
+	return g_WriteTrackerFaults.exchange(0);
+}
@@ -0,0 +1,62 @@
+// Copyright 2021 Cxbx-Reloaded Project
+// Licensed under GPLv2+
+// Refer to the COPYING file included.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// The write tracker detects guest writes to watched memory ranges, without having to
+// compare (or hash) their contents. Pages backing a watched range are protected read-only,
+// and the first write to such a page is caught by our exception handler, which marks all
+// watches covering that page dirty and lifts the protection again (without taking any locks,
+// as the faulting thread may hold one already).
+
+typedef uint32_t CxbxWriteWatch;
+constexpr CxbxWriteWatch CXBX_INVALID_WRITE_WATCH = 0;
+
+// Start watching the given range; Returns CXBX_INVALID_WRITE_WATCH when the range can't be protected
+CxbxWriteWatch CxbxWriteTrackerWatch(const void* Address, size_t Size);
+// Stop watching, restoring the original protection of pages that are no longer watched
+void CxbxWriteTrackerUnwatch(CxbxWriteWatch Watch);
+// Returns true when the watched range was written to since it was last (re)armed
+bool CxbxWriteTrackerIsDirty(CxbxWriteWatch Watch);
+// Clear the dirty state and protect the watched range again
+void CxbxWriteTrackerRearm(CxbxWriteWatch Watch);
+// Must be called before the host kernel writes into guest memory (for example in NtReadFile),
+// since such writes fail with an error instead of raising an exception we can handle.
+// Watches covering the range stay dirty (and its pages unprotected) until the write ends.
+void CxbxWriteTrackerBeginWrite(const void* Address, size_t Size);
+// Ends a write started by CxbxWriteTrackerBeginWrite
+void CxbxWriteTrackerEndWrite(const void* Address, size_t Size);
+// Ends a write started by CxbxWriteTrackerBeginWrite that the host still completes asynchronously.
+// When given, the write ends once the status the host sets upon completion is no longer STATUS_PENDING;
+// Otherwise (or when that status never changes), it's assumed to have ended after a timeout.
+void CxbxWriteTrackerEndPendingWrite(const void* Address, size_t Size, const volatile long* pCompletionStatus);
+
+// Brackets a host kernel call that writes into guest memory with CxbxWriteTrackerBeginWrite/EndWrite
+class CxbxWriteTrackerScope
+{
+public:
+	CxbxWriteTrackerScope(const void* Address, size_t Size);
+	~CxbxWriteTrackerScope();
+	CxbxWriteTrackerScope(const CxbxWriteTrackerScope&) = delete;
+	CxbxWriteTrackerScope& operator=(const CxbxWriteTrackerScope&) = delete;
+
+	// For host calls that returned STATUS_PENDING; Ends the write with CxbxWriteTrackerEndPendingWrite instead
+	void SetPending(const volatile long* pCompletionStatus);
+
+private:
+	const void* m_Address;
+	size_t m_Size;
+	bool m_bPending = false;
+	const volatile long* m_pCompletionStatus = nullptr;
+};
+// Replaces VirtualProtect for guest memory, so that protection changes don't silently disarm
+// watched pages, nor get undone when those pages are disarmed later on
+bool CxbxWriteTrackerVirtualProtect(void* Address, size_t Size, unsigned long NewProtect, unsigned long* OldProtect);
+// Called from the exception handler; Returns true when the faulting write hit a watched page
+bool CxbxWriteTrackerHandleFault(const void* Address);
+// Returns the number of write faults handled since the previous call
+unsigned int CxbxWriteTrackerGetFaultCount();
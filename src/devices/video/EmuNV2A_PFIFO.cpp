@@ -33,16 +33,17 @@
 // *
 // ******************************************************************
 
-typedef struct RAMHTEntry {
-	uint32_t handle;
-	xbox::addr_xt instance;
-	enum FIFOEngine engine;
-	unsigned int channel_id : 5;
-	bool valid;
-} RAMHTEntry;
-
+static void ramht_cache_validate(NV2AState *d); // forward declaration
 static RAMHTEntry ramht_lookup(NV2AState *d, uint32_t handle); // forward declaration
 
+// A method pulled from CACHE1, waiting to be handed to PGRAPH
+typedef struct CacheEntry {
+	unsigned int subchannel;
+	uint32_t method;
+	uint32_t parameter;
+	unsigned int channel_id; // Only used for object binds (method 0)
+} CacheEntry;
+
 /* PFIFO - MMIO and DMA FIFO submission to PGRAPH and VPE */
 DEVICE_READ32(PFIFO)
 {
@@ -110,12 +111,11 @@ static void pfifo_run_puller(NV2AState *d)
     uint32_t *get_reg = &d->pfifo.regs[NV_PFIFO_CACHE1_GET];
     uint32_t *put_reg = &d->pfifo.regs[NV_PFIFO_CACHE1_PUT];
 
-    // TODO
-    // CacheEntry working_cache[NV2A_CACHE1_SIZE];
-    // int working_cache_size = 0;
-    // pull everything into our own queue
-
-    // TODO think more about locking
+    // Methods are pulled from CACHE1 into a batch under pfifo_lock, after which the
+    // whole batch is handed to PGRAPH under pgraph_lock, instead of bouncing both
+    // locks for every single method. While pulling a batch, the CACHE1 state is kept
+    // in locals and only written back once the batch is complete.
+    CacheEntry working_cache[NV2A_CACHE1_SIZE];
 
     while (true) {
         if (!GET_MASK(*pull0, NV_PFIFO_CACHE1_PULL0_ACCESS)) return;
@@ -125,94 +125,165 @@ static void pfifo_run_puller(NV2AState *d)
 
         uint32_t get = *get_reg;
         uint32_t put = *put_reg;
+        uint32_t engines = *engine_reg;
+        enum FIFOEngine pull_engine = (enum FIFOEngine)GET_MASK(*pull1, NV_PFIFO_CACHE1_PULL1_ENGINE);
+
+        // The pusher can't add methods while we hold pfifo_lock, so the run is known up front
+        int available = ((put - get) & 0x1fc) / 4;
+        if (available == 0) {
+            /* full cache1 */
+            available = NV2A_CACHE1_SIZE;
+        }
 
-        assert(get < 128*4 && (get % 4) == 0);
-        uint32_t method_entry = d->pfifo.regs[NV_PFIFO_CACHE1_METHOD + get*2];
-        uint32_t parameter = d->pfifo.regs[NV_PFIFO_CACHE1_DATA + get*2];
+        ramht_cache_validate(d);
 
-        uint32_t new_get = (get+4) & 0x1fc;
-        *get_reg = new_get;
+        int working_cache_size = 0;
+        while (working_cache_size < available) {
+            assert(get < 128*4 && (get % 4) == 0);
+            uint32_t method_entry = d->pfifo.regs[NV_PFIFO_CACHE1_METHOD + get*2];
+            uint32_t parameter = d->pfifo.regs[NV_PFIFO_CACHE1_DATA + get*2];
+            get = (get+4) & 0x1fc;
 
-        if (new_get == put) {
-            // set low mark
-            *status |= NV_PFIFO_CACHE1_STATUS_LOW_MARK;
-        }
-        if (*status & NV_PFIFO_CACHE1_STATUS_HIGH_MARK) {
-            // unset high mark
-            *status &= ~NV_PFIFO_CACHE1_STATUS_HIGH_MARK;
-            // signal pusher
-            qemu_cond_signal(&d->pfifo.pusher_cond);            
-        }
+            uint32_t method = method_entry & 0x1FFC;
+            uint32_t subchannel = GET_MASK(method_entry, NV_PFIFO_CACHE1_METHOD_SUBCHANNEL);
 
+            // NV2A_DPRINTF("pull %d 0x%08X 0x%08X - subch %d\n", get/4, method_entry, parameter, subchannel);
 
-        uint32_t method = method_entry & 0x1FFC;
-        uint32_t subchannel = GET_MASK(method_entry, NV_PFIFO_CACHE1_METHOD_SUBCHANNEL);
+            if (method == 0) {
+                RAMHTEntry entry = ramht_lookup(d, parameter);
+                assert(entry.valid);
 
-        // NV2A_DPRINTF("pull %d 0x%08X 0x%08X - subch %d\n", get/4, method_entry, parameter, subchannel);
+                // assert(entry.channel_id == state->channel_id);
 
-        if (method == 0) {
-            RAMHTEntry entry = ramht_lookup(d, parameter);
-            assert(entry.valid);
+                assert(entry.engine == ENGINE_GRAPHICS);
 
-            // assert(entry.channel_id == state->channel_id);
 
-            assert(entry.engine == ENGINE_GRAPHICS);
+                /* the engine is bound to the subchannel */
+                assert(subchannel < 8);
+                SET_MASK(engines, 3 << (4*subchannel), entry.engine);
+                pull_engine = entry.engine;
+                // NV2A_DPRINTF("engine_reg1 %d 0x%08X\n", subchannel, engines);
 
+                working_cache[working_cache_size++] = { subchannel, method, entry.instance, entry.channel_id };
 
-            /* the engine is bound to the subchannel */
-            assert(subchannel < 8);
-            SET_MASK(*engine_reg, 3 << (4*subchannel), entry.engine);
-            SET_MASK(*pull1, NV_PFIFO_CACHE1_PULL1_ENGINE, entry.engine);
-            // NV2A_DPRINTF("engine_reg1 %d 0x%08X\n", subchannel, *engine_reg);
+                // Binding an object may switch the PGRAPH context, which raises an interrupt
+                // that can change PFIFO state, so end the batch here
+                break;
+            } else if (method >= 0x100) {
+                // method passed to engine
 
+                /* methods that take objects.
+                 * TODO: Check this range is correct for the nv2a */
+                if (method >= 0x180 && method < 0x200) {
+                    //qemu_mutex_lock_iothread();
+                    RAMHTEntry entry = ramht_lookup(d, parameter);
+                    assert(entry.valid);
+                    // assert(entry.channel_id == state->channel_id);
+                    parameter = entry.instance;
+                    //qemu_mutex_unlock_iothread();
+                }
 
-            // TODO: this is fucked
-            qemu_mutex_lock(&d->pgraph.pgraph_lock);
-            //make pgraph busy
-            qemu_mutex_unlock(&d->pfifo.pfifo_lock);
+                enum FIFOEngine engine = (enum FIFOEngine)GET_MASK(engines, 3 << (4*subchannel));
+                // NV2A_DPRINTF("engine_reg2 %d 0x%08X\n", subchannel, engines);
+                assert(engine == ENGINE_GRAPHICS);
+                pull_engine = engine;
 
-            pgraph_switch_context(d, entry.channel_id);
-            pgraph_wait_fifo_access(d);
-            pgraph_handle_method(d, subchannel, 0, entry.instance);
+                working_cache[working_cache_size++] = { subchannel, method, parameter, 0 };
 
-            // make pgraph not busy
-            qemu_mutex_unlock(&d->pgraph.pgraph_lock);
-            qemu_mutex_lock(&d->pfifo.pfifo_lock);
+                // Notifies raise an interrupt, and the guest may be waiting on a semaphore
+                // release; Either way, let it see their effects before pulling more methods
+                if ((method == NV097_NO_OPERATION && parameter != 0) || method == NV097_BACK_END_WRITE_SEMAPHORE_RELEASE) {
+                    break;
+                }
+            } else {
+                assert(false);
+            }
+        }
 
-        } else if (method >= 0x100) {
-            // method passed to engine
+        if (working_cache_size == 0) break;
 
-            /* methods that take objects.
-             * TODO: Check this range is correct for the nv2a */
-            if (method >= 0x180 && method < 0x200) {
-                //qemu_mutex_lock_iothread();
-                RAMHTEntry entry = ramht_lookup(d, parameter);
-                assert(entry.valid);
-                // assert(entry.channel_id == state->channel_id);
-                parameter = entry.instance;
-                //qemu_mutex_unlock_iothread();
-            }
+        // Write back the CACHE1 state
+        *get_reg = get;
+        *engine_reg = engines;
+        SET_MASK(*pull1, NV_PFIFO_CACHE1_PULL1_ENGINE, pull_engine);
+        if (get == put) {
+            // set low mark
+            *status |= NV_PFIFO_CACHE1_STATUS_LOW_MARK;
+        }
+        if (*status & NV_PFIFO_CACHE1_STATUS_HIGH_MARK) {
+            // unset high mark
+            *status &= ~NV_PFIFO_CACHE1_STATUS_HIGH_MARK;
+            // signal pusher
+            qemu_cond_signal(&d->pfifo.pusher_cond);
+        }
+
+        d->pfifo.puller_batches++;
+        d->pfifo.pulled_methods += working_cache_size;
 
-            enum FIFOEngine engine = (enum FIFOEngine)GET_MASK(*engine_reg, 3 << (4*subchannel));
-            // NV2A_DPRINTF("engine_reg2 %d 0x%08X\n", subchannel, *engine_reg);
-            assert(engine == ENGINE_GRAPHICS);
-            SET_MASK(*pull1, NV_PFIFO_CACHE1_PULL1_ENGINE, engine);
+        qemu_mutex_lock(&d->pgraph.pgraph_lock);
+        //make pgraph busy
+        d->pfifo.puller_busy = true;
+        qemu_mutex_unlock(&d->pfifo.pfifo_lock);
 
-            // TODO: this is fucked
-            qemu_mutex_lock(&d->pgraph.pgraph_lock);
-            //make pgraph busy
-            qemu_mutex_unlock(&d->pfifo.pfifo_lock);
+        for (int i = 0; i < working_cache_size; i++) {
+            CacheEntry *entry = &working_cache[i];
+            if (entry->method == 0) {
+                pgraph_switch_context(d, entry->channel_id);
+            }
 
             pgraph_wait_fifo_access(d);
-            pgraph_handle_method(d, subchannel, method, parameter);
+            if (d->pgraph.profile_methods) {
+                auto start = std::chrono::steady_clock::now();
+                pgraph_handle_method(d, entry->subchannel, entry->method, entry->parameter);
+                auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+                MethodProfile &profile = d->pgraph.method_profile[(entry->subchannel << 16) | entry->method];
+                profile.calls++;
+                profile.total_ns += elapsed.count();
+            } else {
+                pgraph_handle_method(d, entry->subchannel, entry->method, entry->parameter);
+            }
+        }
 
-            // make pgraph not busy
-            qemu_mutex_unlock(&d->pgraph.pgraph_lock);
-            qemu_mutex_lock(&d->pfifo.pfifo_lock);
-        } else {
-            assert(false);
+        // make pgraph not busy
+        qemu_mutex_unlock(&d->pgraph.pgraph_lock);
+        qemu_mutex_lock(&d->pfifo.pfifo_lock);
+        d->pfifo.puller_busy = false;
+    }
+}
+
+// Waits until PFIFO has handed everything it was given to PGRAPH, or stops making progress
+// (for instance because PGRAPH waits for the guest to acknowledge an interrupt)
+static void pfifo_wait_idle(NV2AState *d)
+{
+    const auto timeout = std::chrono::milliseconds(100);
+
+    uint32_t last_dma_get = UINT32_MAX;
+    uint32_t last_get = UINT32_MAX;
+    auto last_progress = std::chrono::steady_clock::now();
+    while (!d->exiting) {
+        qemu_mutex_lock(&d->pfifo.pfifo_lock);
+        uint32_t dma_get = d->pfifo.regs[NV_PFIFO_CACHE1_DMA_GET];
+        uint32_t dma_put = d->pfifo.regs[NV_PFIFO_CACHE1_DMA_PUT];
+        uint32_t get = d->pfifo.regs[NV_PFIFO_CACHE1_GET];
+        uint32_t put = d->pfifo.regs[NV_PFIFO_CACHE1_PUT];
+        bool puller_busy = d->pfifo.puller_busy;
+        qemu_mutex_unlock(&d->pfifo.pfifo_lock);
+
+        if (dma_get == dma_put && get == put && !puller_busy) {
+            return;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (dma_get != last_dma_get || get != last_get) {
+            last_dma_get = dma_get;
+            last_get = get;
+            last_progress = now;
+        } else if (now - last_progress > timeout) {
+            return;
         }
 
+        std::this_thread::yield();
     }
 }
 
@@ -284,6 +355,7 @@ static void pfifo_run_pusher(NV2AState *d)
 
     hwaddr dma_len;
     uint8_t *dma = (uint8_t*)nv_dma_map(d, dma_instance, &dma_len);
+    uint32_t captured_page = UINT32_MAX;
 
 	/* based on the convenient pseudocode in envytools */
     while (true) {
@@ -297,6 +369,11 @@ static void pfifo_run_pusher(NV2AState *d)
             break;
         }
 
+        if (g_nv2a_capture_active && (dma_get_v & TARGET_PAGE_MASK) != captured_page) {
+            captured_page = dma_get_v & TARGET_PAGE_MASK;
+            nv2a_capture_memory(NV2A_CAPTURE_VRAM, d->vram_ptr, (uint32_t)(dma - d->vram_ptr) + dma_get_v, sizeof(uint32_t));
+        }
+
         uint32_t word = ldl_le_p((uint32_t*)(dma + dma_get_v));
         dma_get_v += 4;
 
@@ -494,7 +571,34 @@ static uint32_t ramht_hash(NV2AState *d, uint32_t handle)
 	return hash;
 }
 
-static RAMHTEntry ramht_lookup(NV2AState *d, uint32_t handle)
+static void ramht_cache_flush(NV2AState *d)
+{
+	for (int i = 0; i < NV2A_RAMHT_CACHE_SIZE; i++) {
+		d->pfifo.ramht_cache[i].cached = false;
+	}
+}
+
+// Makes sure the RAMHT cache matches RAMHT; Called by the puller before pulling a batch.
+// RAMHT is watched by the write tracker, so writes to it (from the guest, or through
+// PRAMIN) are noticed without having to compare its contents.
+static void ramht_cache_validate(NV2AState *d)
+{
+	uint32_t ramht_reg = d->pfifo.regs[NV_PFIFO_RAMHT];
+	if (d->pfifo.ramht_watch == CXBX_INVALID_WRITE_WATCH || ramht_reg != d->pfifo.ramht_cache_reg) {
+		// RAMHT moved (or isn't watched yet), so watch its new location
+		ramht_cache_flush(d);
+		CxbxWriteTrackerUnwatch(d->pfifo.ramht_watch);
+		xbox::addr_xt ramht_address =
+			GET_MASK(ramht_reg, NV_PFIFO_RAMHT_BASE_ADDRESS_MASK) << 12;
+		d->pfifo.ramht_watch = CxbxWriteTrackerWatch(d->pramin.ramin_ptr + ramht_address, ramht_size(d));
+		d->pfifo.ramht_cache_reg = ramht_reg;
+	} else if (CxbxWriteTrackerIsDirty(d->pfifo.ramht_watch)) {
+		ramht_cache_flush(d);
+		CxbxWriteTrackerRearm(d->pfifo.ramht_watch);
+	}
+}
+
+static RAMHTEntry ramht_read(NV2AState *d, uint32_t handle)
 {
 	uint32_t hash = ramht_hash(d, handle);
 	assert(hash * 8 < ramht_size(d));
@@ -504,6 +608,9 @@ static RAMHTEntry ramht_lookup(NV2AState *d, uint32_t handle)
 			NV_PFIFO_RAMHT_BASE_ADDRESS_MASK) << 12;
 
 	uint8_t *entry_ptr = d->pramin.ramin_ptr + ramht_address + hash * 8;
+	if (g_nv2a_capture_active) {
+		nv2a_capture_memory(NV2A_CAPTURE_RAMIN, d->pramin.ramin_ptr, ramht_address + hash * 8, 8);
+	}
 
 	uint32_t entry_handle = ldl_le_p((uint32_t*)entry_ptr);
 	uint32_t entry_context = ldl_le_p((uint32_t*)(entry_ptr + 4));
@@ -517,3 +624,28 @@ static RAMHTEntry ramht_lookup(NV2AState *d, uint32_t handle)
 
 	return entry;
 }
+
+static RAMHTEntry ramht_lookup(NV2AState *d, uint32_t handle)
+{
+	d->pfifo.ramht_lookups++;
+
+	// Without a write watch, changes to RAMHT would go unnoticed, so don't cache then
+	if (d->pfifo.ramht_watch == CXBX_INVALID_WRITE_WATCH) {
+		return ramht_read(d, handle);
+	}
+
+	unsigned int channel_id = GET_MASK(d->pfifo.regs[NV_PFIFO_CACHE1_PUSH1],
+	                                   NV_PFIFO_CACHE1_PUSH1_CHID);
+	RAMHTCacheEntry *cache_entry =
+		&d->pfifo.ramht_cache[(handle ^ (handle >> 8) ^ (handle >> 16) ^ channel_id) & (NV2A_RAMHT_CACHE_SIZE - 1)];
+	if (cache_entry->cached && cache_entry->handle == handle && cache_entry->channel_id == channel_id) {
+		d->pfifo.ramht_cache_hits++;
+		return cache_entry->entry;
+	}
+
+	cache_entry->entry = ramht_read(d, handle);
+	cache_entry->handle = handle;
+	cache_entry->channel_id = channel_id;
+	cache_entry->cached = true;
+	return cache_entry->entry;
+}
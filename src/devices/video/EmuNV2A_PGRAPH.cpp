@@ -526,6 +526,9 @@ DEVICE_WRITE32(PGRAPH)
 
 	qemu_mutex_lock(&pg->pgraph_lock);
 
+	// The guest may change the object context, so the next method has to look it up again
+	pg->inline_vertex_subchannel = NV2A_INVALID_SUBCHANNEL;
+
 	switch (addr) {
 	case NV_PGRAPH_INTR:
 		pg->pending_interrupts &= ~value;
@@ -573,6 +576,9 @@ DEVICE_WRITE32(PGRAPH)
 				pgraph_channel_id, context_address);
 
 			uint8_t *context_ptr = d->pramin.ramin_ptr + context_address;
+			if (g_nv2a_capture_active) {
+				nv2a_capture_memory(NV2A_CAPTURE_RAMIN, d->pramin.ramin_ptr, context_address, 4);
+			}
 			uint32_t context_user = ldl_le_p((uint32_t*)context_ptr);
 
 			NV2A_DPRINTF("    - CTX_USER = 0x%08X\n", context_user);
@@ -1136,1730 +1142,1998 @@ void OpenGL_init_pgraph_plugins()
 	pgraph_draw_clear = OpenGL_draw_clear;
 }
 
-void pgraph_handle_method(NV2AState *d,
+static void pgraph_context_pattern_method(NV2AState *d,
 							unsigned int subchannel,
 							unsigned int method,
 							uint32_t parameter)
 {
-	unsigned int i;
-	unsigned int slot;
-
     PGRAPHState *pg = &d->pgraph;
 
-    bool channel_valid =
-        d->pgraph.regs[NV_PGRAPH_CTX_CONTROL] & NV_PGRAPH_CTX_CONTROL_CHID;
-    assert(channel_valid);
+	switch (method) {
+	case NV044_SET_MONOCHROME_COLOR0:
+		pg->regs[NV_PGRAPH_PATT_COLOR0] = parameter;
+		break;
+	}
+}
 
-    unsigned channel_id = GET_MASK(pg->regs[NV_PGRAPH_CTX_USER], NV_PGRAPH_CTX_USER_CHID);
+static void pgraph_context_surfaces_2d_method(NV2AState *d,
+							unsigned int subchannel,
+							unsigned int method,
+							uint32_t parameter)
+{
+	ContextSurfaces2DState *context_surfaces_2d = &d->pgraph.context_surfaces_2d;
+
+	switch (method) {
+	case NV062_SET_OBJECT:
+		context_surfaces_2d->object_instance = parameter;
+		break;
+	case NV062_SET_CONTEXT_DMA_IMAGE_SOURCE:
+		context_surfaces_2d->dma_image_source = parameter;
+		break;
+	case NV062_SET_CONTEXT_DMA_IMAGE_DESTIN:
+		context_surfaces_2d->dma_image_dest = parameter;
+		break;
+	case NV062_SET_COLOR_FORMAT:
+		context_surfaces_2d->color_format = parameter;
+		break;
+	case NV062_SET_PITCH:
+		context_surfaces_2d->source_pitch = parameter & 0xFFFF;
+		context_surfaces_2d->dest_pitch = parameter >> 16;
+		break;
+	case NV062_SET_OFFSET_SOURCE:
+		context_surfaces_2d->source_offset = parameter & 0x07FFFFFF;
+		break;
+	case NV062_SET_OFFSET_DESTIN:
+		context_surfaces_2d->dest_offset = parameter & 0x07FFFFFF;
+		break;
+	default:
+		EmuLog(LOG_LEVEL::WARNING, "Unknown NV_CONTEXT_SURFACES_2D Method: 0x%08X", method);
+	}
+}
 
+static void pgraph_image_blit_method(NV2AState *d,
+							unsigned int subchannel,
+							unsigned int method,
+							uint32_t parameter)
+{
+    PGRAPHState *pg = &d->pgraph;
 	ContextSurfaces2DState *context_surfaces_2d = &pg->context_surfaces_2d;
 	ImageBlitState *image_blit = &pg->image_blit;
-	KelvinState *kelvin = &pg->kelvin;
-
-    assert(subchannel < 8);
 
-	if (method == NV_SET_OBJECT) {
-        assert(parameter < d->pramin.ramin_size);
-        uint8_t *obj_ptr = d->pramin.ramin_ptr + parameter;
+	switch (method) {
+	case NV09F_SET_OBJECT:
+		image_blit->object_instance = parameter;
+		break;
+	case NV09F_SET_CONTEXT_SURFACES:
+		image_blit->context_surfaces = parameter;
+		break;
+	case NV09F_SET_OPERATION:
+		image_blit->operation = parameter;
+		break;
+	case NV09F_CONTROL_POINT_IN:
+		image_blit->in_x = parameter & 0xFFFF;
+		image_blit->in_y = parameter >> 16;
+		break;
+	case NV09F_CONTROL_POINT_OUT:
+		image_blit->out_x = parameter & 0xFFFF;
+		image_blit->out_y = parameter >> 16;
+		break;
+	case NV09F_SIZE:
+		image_blit->width = parameter & 0xFFFF;
+		image_blit->height = parameter >> 16;
 
-        uint32_t ctx_1 = ldl_le_p((uint32_t*)obj_ptr);
-        uint32_t ctx_2 = ldl_le_p((uint32_t*)(obj_ptr+4));
-        uint32_t ctx_3 = ldl_le_p((uint32_t*)(obj_ptr+8));
-        uint32_t ctx_4 = ldl_le_p((uint32_t*)(obj_ptr+12));
-        uint32_t ctx_5 = parameter;
+		/* I guess this kicks it off? */
+		if (image_blit->operation == NV09F_SET_OPERATION_SRCCOPY) {
 
-        pg->regs[NV_PGRAPH_CTX_CACHE1 + subchannel * 4] = ctx_1;
-        pg->regs[NV_PGRAPH_CTX_CACHE2 + subchannel * 4] = ctx_2;
-        pg->regs[NV_PGRAPH_CTX_CACHE3 + subchannel * 4] = ctx_3;
-        pg->regs[NV_PGRAPH_CTX_CACHE4 + subchannel * 4] = ctx_4;
-        pg->regs[NV_PGRAPH_CTX_CACHE5 + subchannel * 4] = ctx_5;
-    }
+			NV2A_GL_DPRINTF(true, "NV09F_SET_OPERATION_SRCCOPY");
 
-    // is this right?
-    pg->regs[NV_PGRAPH_CTX_SWITCH1] = pg->regs[NV_PGRAPH_CTX_CACHE1 + subchannel * 4];
-    pg->regs[NV_PGRAPH_CTX_SWITCH2] = pg->regs[NV_PGRAPH_CTX_CACHE2 + subchannel * 4];
-    pg->regs[NV_PGRAPH_CTX_SWITCH3] = pg->regs[NV_PGRAPH_CTX_CACHE3 + subchannel * 4];
-    pg->regs[NV_PGRAPH_CTX_SWITCH4] = pg->regs[NV_PGRAPH_CTX_CACHE4 + subchannel * 4];
-    pg->regs[NV_PGRAPH_CTX_SWITCH5] = pg->regs[NV_PGRAPH_CTX_CACHE5 + subchannel * 4];
+			ContextSurfaces2DState *context_surfaces = context_surfaces_2d;
+			assert(context_surfaces->object_instance
+				== image_blit->context_surfaces);
 
-    uint32_t graphics_class = GET_MASK(pg->regs[NV_PGRAPH_CTX_SWITCH1],
-                                       NV_PGRAPH_CTX_SWITCH1_GRCLASS);
+			unsigned int bytes_per_pixel;
+			switch (context_surfaces->color_format) {
+			case NV062_SET_COLOR_FORMAT_LE_Y8:
+				bytes_per_pixel = 1;
+				break;
+			case NV062_SET_COLOR_FORMAT_LE_R5G6B5:
+				bytes_per_pixel = 2;
+				break;
+			case NV062_SET_COLOR_FORMAT_LE_A8R8G8B8:
+				bytes_per_pixel = 4;
+				break;
+			default:
+				printf("Unknown blit surface format: 0x%x\n", context_surfaces->color_format);
+				assert(false);
+				break;
+			}
 
-	// Logging is slow.. disable for now..
-	//pgraph_log_method(subchannel, graphics_class, method, parameter);
+			xbox::addr_xt source_dma_len, dest_dma_len;
+			uint8_t *source, *dest;
 
-    if (subchannel != 0) {
-        // catches context switching issues on xbox d3d
-        assert(graphics_class != 0x97);
-    }
+			source = (uint8_t*)nv_dma_map(d, context_surfaces->dma_image_source,
+											&source_dma_len);
+			assert(context_surfaces->source_offset < source_dma_len);
+			source += context_surfaces->source_offset;
 
-    /* ugly switch for now */
-    switch (graphics_class) {
+			dest = (uint8_t*)nv_dma_map(d, context_surfaces->dma_image_dest,
+											&dest_dma_len);
+			assert(context_surfaces->dest_offset < dest_dma_len);
+			dest += context_surfaces->dest_offset;
 
-    case NV_CONTEXT_PATTERN: {
-		switch (method) {
-		case NV044_SET_MONOCHROME_COLOR0:
-			pg->regs[NV_PGRAPH_PATT_COLOR0] = parameter;
-			break;
-		}
-		
-		break;
-	}
+			NV2A_DPRINTF("  - 0x%tx -> 0x%tx\n", source - d->vram_ptr,
+													dest - d->vram_ptr);
 
-    case NV_CONTEXT_SURFACES_2D: {
-		switch (method) {
-		case NV062_SET_OBJECT:
-			context_surfaces_2d->object_instance = parameter;
-			break;
-		case NV062_SET_CONTEXT_DMA_IMAGE_SOURCE:
-			context_surfaces_2d->dma_image_source = parameter;
-			break;
-		case NV062_SET_CONTEXT_DMA_IMAGE_DESTIN:
-			context_surfaces_2d->dma_image_dest = parameter;
-			break;
-		case NV062_SET_COLOR_FORMAT:
-			context_surfaces_2d->color_format = parameter;
-			break;
-		case NV062_SET_PITCH:
-			context_surfaces_2d->source_pitch = parameter & 0xFFFF;
-			context_surfaces_2d->dest_pitch = parameter >> 16;
-			break;
-		case NV062_SET_OFFSET_SOURCE:
-			context_surfaces_2d->source_offset = parameter & 0x07FFFFFF;
-			break;
-		case NV062_SET_OFFSET_DESTIN:
-			context_surfaces_2d->dest_offset = parameter & 0x07FFFFFF;
-			break;
-		default:
-			EmuLog(LOG_LEVEL::WARNING, "Unknown NV_CONTEXT_SURFACES_2D Method: 0x%08X", method);
-		}
-	
-		break; 
-	}
-	
-	case NV_IMAGE_BLIT: {
-		switch (method) {
-		case NV09F_SET_OBJECT:
-			image_blit->object_instance = parameter;
-			break;
-		case NV09F_SET_CONTEXT_SURFACES:
-			image_blit->context_surfaces = parameter;
-			break;
-		case NV09F_SET_OPERATION:
-			image_blit->operation = parameter;
-			break;
-		case NV09F_CONTROL_POINT_IN:
-			image_blit->in_x = parameter & 0xFFFF;
-			image_blit->in_y = parameter >> 16;
-			break;
-		case NV09F_CONTROL_POINT_OUT:
-			image_blit->out_x = parameter & 0xFFFF;
-			image_blit->out_y = parameter >> 16;
-			break;
-		case NV09F_SIZE:
-			image_blit->width = parameter & 0xFFFF;
-			image_blit->height = parameter >> 16;
-
-			/* I guess this kicks it off? */
-			if (image_blit->operation == NV09F_SET_OPERATION_SRCCOPY) {
-
-				NV2A_GL_DPRINTF(true, "NV09F_SET_OPERATION_SRCCOPY");
-
-				ContextSurfaces2DState *context_surfaces = context_surfaces_2d;
-				assert(context_surfaces->object_instance
-					== image_blit->context_surfaces);
-
-				unsigned int bytes_per_pixel;
-				switch (context_surfaces->color_format) {
-				case NV062_SET_COLOR_FORMAT_LE_Y8:
-					bytes_per_pixel = 1;
-					break;
-				case NV062_SET_COLOR_FORMAT_LE_R5G6B5:
-					bytes_per_pixel = 2;
-					break;
-				case NV062_SET_COLOR_FORMAT_LE_A8R8G8B8:
-					bytes_per_pixel = 4;
-					break;
-				default:
-					printf("Unknown blit surface format: 0x%x\n", context_surfaces->color_format);
-					assert(false);
-					break;
-				}
+			unsigned int y;
+			for (y = 0; y<image_blit->height; y++) {
+				uint8_t *source_row = source
+					+ (image_blit->in_y + y) * context_surfaces->source_pitch
+					+ image_blit->in_x * bytes_per_pixel;
 
-				xbox::addr_xt source_dma_len, dest_dma_len;
-				uint8_t *source, *dest;
+				uint8_t *dest_row = dest
+					+ (image_blit->out_y + y) * context_surfaces->dest_pitch
+					+ image_blit->out_x * bytes_per_pixel;
 
-				source = (uint8_t*)nv_dma_map(d, context_surfaces->dma_image_source,
-												&source_dma_len);
-				assert(context_surfaces->source_offset < source_dma_len);
-				source += context_surfaces->source_offset;
+				memmove(dest_row, source_row,
+					image_blit->width * bytes_per_pixel);
+			}
 
-				dest = (uint8_t*)nv_dma_map(d, context_surfaces->dma_image_dest,
-												&dest_dma_len);
-				assert(context_surfaces->dest_offset < dest_dma_len);
-				dest += context_surfaces->dest_offset;
+		} else {
+			assert(false);
+		}
 
-				NV2A_DPRINTF("  - 0x%tx -> 0x%tx\n", source - d->vram_ptr,
-														dest - d->vram_ptr);
+		break;
+	default:
+		EmuLog(LOG_LEVEL::WARNING, "Unknown NV_IMAGE_BLIT Method: 0x%08X", method);
+	}
+}
 
-				unsigned int y;
-				for (y = 0; y<image_blit->height; y++) {
-					uint8_t *source_row = source
-						+ (image_blit->in_y + y) * context_surfaces->source_pitch
-						+ image_blit->in_x * bytes_per_pixel;
+static void pgraph_kelvin_method(NV2AState *d,
+							unsigned int subchannel,
+							unsigned int method,
+							uint32_t parameter)
+{
+	unsigned int i;
+	unsigned int slot;
 
-					uint8_t *dest_row = dest
-						+ (image_blit->out_y + y) * context_surfaces->dest_pitch
-						+ image_blit->out_x * bytes_per_pixel;
+    PGRAPHState *pg = &d->pgraph;
 
-					memmove(dest_row, source_row,
-						image_blit->width * bytes_per_pixel);
-				}
+    unsigned channel_id = GET_MASK(pg->regs[NV_PGRAPH_CTX_USER], NV_PGRAPH_CTX_USER_CHID);
 
-			} else {
-				assert(false);
-			}
+	KelvinState *kelvin = &pg->kelvin;
 
-			break;
-		default:
-			EmuLog(LOG_LEVEL::WARNING, "Unknown NV_IMAGE_BLIT Method: 0x%08X", method);
-		}
+	switch (method) {
+	case NV097_SET_OBJECT:
+		kelvin->object_instance = parameter;
 		break;
-	}
-
-	case NV_KELVIN_PRIMITIVE: {
-		switch (method) {
-		case NV097_SET_OBJECT:
-			kelvin->object_instance = parameter;
-			break;
 
-		case NV097_NO_OPERATION:
-			/* The bios uses nop as a software method call -
-			 * it seems to expect a notify interrupt if the parameter isn't 0.
-			 * According to a nouveau guy it should still be a nop regardless
-			 * of the parameter. It's possible a debug register enables this,
-			 * but nothing obvious sticks out. Weird.
-			 */
-			if (parameter != 0) {
-				assert(!(pg->pending_interrupts & NV_PGRAPH_INTR_ERROR));
-
-				SET_MASK(pg->regs[NV_PGRAPH_TRAPPED_ADDR],
-					NV_PGRAPH_TRAPPED_ADDR_CHID, channel_id);
-				SET_MASK(pg->regs[NV_PGRAPH_TRAPPED_ADDR],
-					NV_PGRAPH_TRAPPED_ADDR_SUBCH, subchannel);
-				SET_MASK(pg->regs[NV_PGRAPH_TRAPPED_ADDR],
-					NV_PGRAPH_TRAPPED_ADDR_MTHD, method);
-				pg->regs[NV_PGRAPH_TRAPPED_DATA_LOW] = parameter;
-				pg->regs[NV_PGRAPH_NSOURCE] = NV_PGRAPH_NSOURCE_NOTIFICATION; /* TODO: check this */
-				pg->pending_interrupts |= NV_PGRAPH_INTR_ERROR;
-
-				qemu_mutex_unlock(&pg->pgraph_lock);
-				qemu_mutex_lock_iothread();
-				update_irq(d);
-				qemu_mutex_lock(&pg->pgraph_lock);
-				qemu_mutex_unlock_iothread();
-
-				while (pg->pending_interrupts & NV_PGRAPH_INTR_ERROR) {
-					qemu_cond_wait(&pg->interrupt_cond, &pg->pgraph_lock);
-				}
+	case NV097_NO_OPERATION:
+		/* The bios uses nop as a software method call -
+		 * it seems to expect a notify interrupt if the parameter isn't 0.
+		 * According to a nouveau guy it should still be a nop regardless
+		 * of the parameter. It's possible a debug register enables this,
+		 * but nothing obvious sticks out. Weird.
+		 */
+		if (parameter != 0) {
+			assert(!(pg->pending_interrupts & NV_PGRAPH_INTR_ERROR));
+
+			SET_MASK(pg->regs[NV_PGRAPH_TRAPPED_ADDR],
+				NV_PGRAPH_TRAPPED_ADDR_CHID, channel_id);
+			SET_MASK(pg->regs[NV_PGRAPH_TRAPPED_ADDR],
+				NV_PGRAPH_TRAPPED_ADDR_SUBCH, subchannel);
+			SET_MASK(pg->regs[NV_PGRAPH_TRAPPED_ADDR],
+				NV_PGRAPH_TRAPPED_ADDR_MTHD, method);
+			pg->regs[NV_PGRAPH_TRAPPED_DATA_LOW] = parameter;
+			pg->regs[NV_PGRAPH_NSOURCE] = NV_PGRAPH_NSOURCE_NOTIFICATION; /* TODO: check this */
+			pg->pending_interrupts |= NV_PGRAPH_INTR_ERROR;
+
+			qemu_mutex_unlock(&pg->pgraph_lock);
+			qemu_mutex_lock_iothread();
+			update_irq(d);
+			qemu_mutex_lock(&pg->pgraph_lock);
+			qemu_mutex_unlock_iothread();
+
+			while (pg->pending_interrupts & NV_PGRAPH_INTR_ERROR) {
+				qemu_cond_wait(&pg->interrupt_cond, &pg->pgraph_lock);
 			}
-			break;
+		}
+		break;
 
-		case NV097_WAIT_FOR_IDLE:
-			pgraph_update_surface(d, false, true, true);
-			break;
+	case NV097_WAIT_FOR_IDLE:
+		pgraph_update_surface(d, false, true, true);
+		break;
 
 
-		case NV097_SET_FLIP_READ:
-			SET_MASK(pg->regs[NV_PGRAPH_SURFACE], NV_PGRAPH_SURFACE_READ_3D,
-				parameter);
-			break;
-		case NV097_SET_FLIP_WRITE:
-			SET_MASK(pg->regs[NV_PGRAPH_SURFACE], NV_PGRAPH_SURFACE_WRITE_3D,
-				parameter);
-			break;
-		case NV097_SET_FLIP_MODULO:
-			SET_MASK(pg->regs[NV_PGRAPH_SURFACE], NV_PGRAPH_SURFACE_MODULO_3D,
-				parameter);
-			break;
-		case NV097_FLIP_INCREMENT_WRITE: {
-			NV2A_DPRINTF("flip increment write %d -> ",
-				GET_MASK(pg->regs[NV_PGRAPH_SURFACE],
-					NV_PGRAPH_SURFACE_WRITE_3D));
-			SET_MASK(pg->regs[NV_PGRAPH_SURFACE],
-				NV_PGRAPH_SURFACE_WRITE_3D,
-				(GET_MASK(pg->regs[NV_PGRAPH_SURFACE],
-					NV_PGRAPH_SURFACE_WRITE_3D) + 1)
-				% GET_MASK(pg->regs[NV_PGRAPH_SURFACE],
-					NV_PGRAPH_SURFACE_MODULO_3D));
-			NV2A_DPRINTF("%d\n",
-				GET_MASK(pg->regs[NV_PGRAPH_SURFACE],
-					NV_PGRAPH_SURFACE_WRITE_3D));
+	case NV097_SET_FLIP_READ:
+		SET_MASK(pg->regs[NV_PGRAPH_SURFACE], NV_PGRAPH_SURFACE_READ_3D,
+			parameter);
+		break;
+	case NV097_SET_FLIP_WRITE:
+		SET_MASK(pg->regs[NV_PGRAPH_SURFACE], NV_PGRAPH_SURFACE_WRITE_3D,
+			parameter);
+		break;
+	case NV097_SET_FLIP_MODULO:
+		SET_MASK(pg->regs[NV_PGRAPH_SURFACE], NV_PGRAPH_SURFACE_MODULO_3D,
+			parameter);
+		break;
+	case NV097_FLIP_INCREMENT_WRITE: {
+		NV2A_DPRINTF("flip increment write %d -> ",
+			GET_MASK(pg->regs[NV_PGRAPH_SURFACE],
+				NV_PGRAPH_SURFACE_WRITE_3D));
+		SET_MASK(pg->regs[NV_PGRAPH_SURFACE],
+			NV_PGRAPH_SURFACE_WRITE_3D,
+			(GET_MASK(pg->regs[NV_PGRAPH_SURFACE],
+				NV_PGRAPH_SURFACE_WRITE_3D) + 1)
+			% GET_MASK(pg->regs[NV_PGRAPH_SURFACE],
+				NV_PGRAPH_SURFACE_MODULO_3D));
+		NV2A_DPRINTF("%d\n",
+			GET_MASK(pg->regs[NV_PGRAPH_SURFACE],
+				NV_PGRAPH_SURFACE_WRITE_3D));
 
 #ifdef __APPLE__
-			if (glFrameTerminatorGREMEDY) {
-				glFrameTerminatorGREMEDY();
-			}
-#endif // __APPLE__
-			break;
+		if (glFrameTerminatorGREMEDY) {
+			glFrameTerminatorGREMEDY();
 		}
-		case NV097_FLIP_STALL:
-			pgraph_update_surface(d, false, true, true);
-
+#endif // __APPLE__
+		break;
+	}
+	case NV097_FLIP_STALL:
+		pgraph_update_surface(d, false, true, true);
 
-			// TODO: Fix this (why does it hang?)
-			/* while (true) */ {
-				uint32_t surface = pg->regs[NV_PGRAPH_SURFACE];
-				NV2A_DPRINTF("flip stall read: %d, write: %d, modulo: %d\n",
-					GET_MASK(surface, NV_PGRAPH_SURFACE_READ_3D),
-					GET_MASK(surface, NV_PGRAPH_SURFACE_WRITE_3D),
-					GET_MASK(surface, NV_PGRAPH_SURFACE_MODULO_3D));
 
-				if (GET_MASK(surface, NV_PGRAPH_SURFACE_READ_3D)
-					!= GET_MASK(surface, NV_PGRAPH_SURFACE_WRITE_3D)) {
-					break;
-				}
+		// TODO: Fix this (why does it hang?)
+		/* while (true) */ {
+			uint32_t surface = pg->regs[NV_PGRAPH_SURFACE];
+			NV2A_DPRINTF("flip stall read: %d, write: %d, modulo: %d\n",
+				GET_MASK(surface, NV_PGRAPH_SURFACE_READ_3D),
+				GET_MASK(surface, NV_PGRAPH_SURFACE_WRITE_3D),
+				GET_MASK(surface, NV_PGRAPH_SURFACE_MODULO_3D));
 
-				//qemu_cond_wait(&pg->flip_3d, &pg->lock);
+			if (GET_MASK(surface, NV_PGRAPH_SURFACE_READ_3D)
+				!= GET_MASK(surface, NV_PGRAPH_SURFACE_WRITE_3D)) {
+				break;
 			}
 
-			// TODO: Remove this when the AMD crash is solved in vblank_thread
-			NV2ADevice::UpdateHostDisplay(d);
-			NV2A_DPRINTF("flip stall done\n");
-			break;
+			//qemu_cond_wait(&pg->flip_3d, &pg->lock);
+		}
 
-		case NV097_SET_CONTEXT_DMA_NOTIFIES:
-			pg->dma_notifies = parameter;
-			break;
-		case NV097_SET_CONTEXT_DMA_A:
-			pg->dma_a = parameter;
-			break;
-		case NV097_SET_CONTEXT_DMA_B:
-			pg->dma_b = parameter;
-			break;
-		case NV097_SET_CONTEXT_DMA_STATE:
-			pg->dma_state = parameter;
-			break;
-		case NV097_SET_CONTEXT_DMA_COLOR:
-			/* try to get any straggling draws in before the surface's changed :/ */
-			pgraph_update_surface(d, false, true, true);
+		// TODO: Remove this when the AMD crash is solved in vblank_thread
+		NV2ADevice::UpdateHostDisplay(d);
+		NV2A_DPRINTF("flip stall done\n");
+		break;
 
-			pg->dma_color = parameter;
-			break;
-		case NV097_SET_CONTEXT_DMA_ZETA:
-			pg->dma_zeta = parameter;
-			break;
-		case NV097_SET_CONTEXT_DMA_VERTEX_A:
-			pg->dma_vertex_a = parameter;
-			break;
-		case NV097_SET_CONTEXT_DMA_VERTEX_B:
-			pg->dma_vertex_b = parameter;
-			break;
-		case NV097_SET_CONTEXT_DMA_SEMAPHORE:
-			pg->dma_semaphore = parameter;
-			break;
-		case NV097_SET_CONTEXT_DMA_REPORT:
-			pg->dma_report = parameter;
-			break;
+	case NV097_SET_CONTEXT_DMA_NOTIFIES:
+		pg->dma_notifies = parameter;
+		break;
+	case NV097_SET_CONTEXT_DMA_A:
+		pg->dma_a = parameter;
+		break;
+	case NV097_SET_CONTEXT_DMA_B:
+		pg->dma_b = parameter;
+		break;
+	case NV097_SET_CONTEXT_DMA_STATE:
+		pg->dma_state = parameter;
+		break;
+	case NV097_SET_CONTEXT_DMA_COLOR:
+		/* try to get any straggling draws in before the surface's changed :/ */
+		pgraph_update_surface(d, false, true, true);
 
-		case NV097_SET_SURFACE_CLIP_HORIZONTAL:
-			pgraph_update_surface(d, false, true, true);
+		pg->dma_color = parameter;
+		break;
+	case NV097_SET_CONTEXT_DMA_ZETA:
+		pg->dma_zeta = parameter;
+		break;
+	case NV097_SET_CONTEXT_DMA_VERTEX_A:
+		pg->dma_vertex_a = parameter;
+		break;
+	case NV097_SET_CONTEXT_DMA_VERTEX_B:
+		pg->dma_vertex_b = parameter;
+		break;
+	case NV097_SET_CONTEXT_DMA_SEMAPHORE:
+		pg->dma_semaphore = parameter;
+		break;
+	case NV097_SET_CONTEXT_DMA_REPORT:
+		pg->dma_report = parameter;
+		break;
 
-			pg->surface_shape.clip_x =
-				GET_MASK(parameter, NV097_SET_SURFACE_CLIP_HORIZONTAL_X);
-			pg->surface_shape.clip_width =
-				GET_MASK(parameter, NV097_SET_SURFACE_CLIP_HORIZONTAL_WIDTH);
-			break;
-		case NV097_SET_SURFACE_CLIP_VERTICAL:
-			pgraph_update_surface(d, false, true, true);
-			
-			pg->surface_shape.clip_y =
-				GET_MASK(parameter, NV097_SET_SURFACE_CLIP_VERTICAL_Y);
-			pg->surface_shape.clip_height =
-				GET_MASK(parameter, NV097_SET_SURFACE_CLIP_VERTICAL_HEIGHT);
-			break;
-		case NV097_SET_SURFACE_FORMAT:
-			pgraph_update_surface(d, false, true, true);
-
-			pg->surface_shape.color_format =
-				GET_MASK(parameter, NV097_SET_SURFACE_FORMAT_COLOR);
-			pg->surface_shape.zeta_format =
-				GET_MASK(parameter, NV097_SET_SURFACE_FORMAT_ZETA);
-			pg->surface_type =
-				GET_MASK(parameter, NV097_SET_SURFACE_FORMAT_TYPE);
-			pg->surface_shape.anti_aliasing =
-				GET_MASK(parameter, NV097_SET_SURFACE_FORMAT_ANTI_ALIASING);
-			pg->surface_shape.log_width =
-				GET_MASK(parameter, NV097_SET_SURFACE_FORMAT_WIDTH);
-			pg->surface_shape.log_height =
-				GET_MASK(parameter, NV097_SET_SURFACE_FORMAT_HEIGHT);
-			break;
-		case NV097_SET_SURFACE_PITCH:
-			pgraph_update_surface(d, false, true, true);
+	case NV097_SET_SURFACE_CLIP_HORIZONTAL:
+		pgraph_update_surface(d, false, true, true);
+
+		pg->surface_shape.clip_x =
+			GET_MASK(parameter, NV097_SET_SURFACE_CLIP_HORIZONTAL_X);
+		pg->surface_shape.clip_width =
+			GET_MASK(parameter, NV097_SET_SURFACE_CLIP_HORIZONTAL_WIDTH);
+		break;
+	case NV097_SET_SURFACE_CLIP_VERTICAL:
+		pgraph_update_surface(d, false, true, true);
+		
+		pg->surface_shape.clip_y =
+			GET_MASK(parameter, NV097_SET_SURFACE_CLIP_VERTICAL_Y);
+		pg->surface_shape.clip_height =
+			GET_MASK(parameter, NV097_SET_SURFACE_CLIP_VERTICAL_HEIGHT);
+		break;
+	case NV097_SET_SURFACE_FORMAT:
+		pgraph_update_surface(d, false, true, true);
+
+		pg->surface_shape.color_format =
+			GET_MASK(parameter, NV097_SET_SURFACE_FORMAT_COLOR);
+		pg->surface_shape.zeta_format =
+			GET_MASK(parameter, NV097_SET_SURFACE_FORMAT_ZETA);
+		pg->surface_type =
+			GET_MASK(parameter, NV097_SET_SURFACE_FORMAT_TYPE);
+		pg->surface_shape.anti_aliasing =
+			GET_MASK(parameter, NV097_SET_SURFACE_FORMAT_ANTI_ALIASING);
+		pg->surface_shape.log_width =
+			GET_MASK(parameter, NV097_SET_SURFACE_FORMAT_WIDTH);
+		pg->surface_shape.log_height =
+			GET_MASK(parameter, NV097_SET_SURFACE_FORMAT_HEIGHT);
+		break;
+	case NV097_SET_SURFACE_PITCH:
+		pgraph_update_surface(d, false, true, true);
 
-			pg->surface_color.pitch =
-				GET_MASK(parameter, NV097_SET_SURFACE_PITCH_COLOR);
-			pg->surface_zeta.pitch =
-				GET_MASK(parameter, NV097_SET_SURFACE_PITCH_ZETA);
+		pg->surface_color.pitch =
+			GET_MASK(parameter, NV097_SET_SURFACE_PITCH_COLOR);
+		pg->surface_zeta.pitch =
+			GET_MASK(parameter, NV097_SET_SURFACE_PITCH_ZETA);
         pg->surface_color.buffer_dirty = true;
         pg->surface_zeta.buffer_dirty = true;
-			break;
-		case NV097_SET_SURFACE_COLOR_OFFSET:
-			pgraph_update_surface(d, false, true, true);
+		break;
+	case NV097_SET_SURFACE_COLOR_OFFSET:
+		pgraph_update_surface(d, false, true, true);
 
-			pg->surface_color.offset = parameter;
+		pg->surface_color.offset = parameter;
         pg->surface_color.buffer_dirty = true;
-			break;
-		case NV097_SET_SURFACE_ZETA_OFFSET:
-			pgraph_update_surface(d, false, true, true);
+		break;
+	case NV097_SET_SURFACE_ZETA_OFFSET:
+		pgraph_update_surface(d, false, true, true);
 
-			pg->surface_zeta.offset = parameter;
+		pg->surface_zeta.offset = parameter;
         pg->surface_zeta.buffer_dirty = true;
-			break;
+		break;
 
-		CASE_8(NV097_SET_COMBINER_ALPHA_ICW, 4) :
-			slot = (method - NV097_SET_COMBINER_ALPHA_ICW) / 4;
-			pg->regs[NV_PGRAPH_COMBINEALPHAI0 + slot * 4] = parameter;
-			break;
+	CASE_8(NV097_SET_COMBINER_ALPHA_ICW, 4) :
+		slot = (method - NV097_SET_COMBINER_ALPHA_ICW) / 4;
+		pg->regs[NV_PGRAPH_COMBINEALPHAI0 + slot * 4] = parameter;
+		break;
 
-		case NV097_SET_COMBINER_SPECULAR_FOG_CW0:
-			pg->regs[NV_PGRAPH_COMBINESPECFOG0] = parameter;
-			break;
+	case NV097_SET_COMBINER_SPECULAR_FOG_CW0:
+		pg->regs[NV_PGRAPH_COMBINESPECFOG0] = parameter;
+		break;
 
-		case NV097_SET_COMBINER_SPECULAR_FOG_CW1:
-			pg->regs[NV_PGRAPH_COMBINESPECFOG1] = parameter;
-			break;
+	case NV097_SET_COMBINER_SPECULAR_FOG_CW1:
+		pg->regs[NV_PGRAPH_COMBINESPECFOG1] = parameter;
+		break;
 
-		CASE_4(NV097_SET_TEXTURE_ADDRESS, 64):
-			slot = (method - NV097_SET_TEXTURE_ADDRESS) / 64;
-			pg->regs[NV_PGRAPH_TEXADDRESS0 + slot * 4] = parameter;
-			break;
-		case NV097_SET_CONTROL0: {
-			pgraph_update_surface(d, false, true, true);
-
-			bool stencil_write_enable =
-				parameter & NV097_SET_CONTROL0_STENCIL_WRITE_ENABLE;
-			SET_MASK(pg->regs[NV_PGRAPH_CONTROL_0],
-				NV_PGRAPH_CONTROL_0_STENCIL_WRITE_ENABLE,
-				stencil_write_enable);
-
-			uint32_t z_format = GET_MASK(parameter, NV097_SET_CONTROL0_Z_FORMAT);
-			SET_MASK(pg->regs[NV_PGRAPH_SETUPRASTER],
-				NV_PGRAPH_SETUPRASTER_Z_FORMAT, z_format);
-
-			bool z_perspective =
-				parameter & NV097_SET_CONTROL0_Z_PERSPECTIVE_ENABLE;
-			SET_MASK(pg->regs[NV_PGRAPH_CONTROL_0],
-				NV_PGRAPH_CONTROL_0_Z_PERSPECTIVE_ENABLE,
-				z_perspective);
-
-			int color_space_convert =
-				GET_MASK(parameter, NV097_SET_CONTROL0_COLOR_SPACE_CONVERT);
-			SET_MASK(pg->regs[NV_PGRAPH_CONTROL_0],
-				NV_PGRAPH_CONTROL_0_CSCONVERT,
-				color_space_convert);
-			break;
-		}
+	case NV097_SET_CONTROL0: {
+		pgraph_update_surface(d, false, true, true);
+
+		bool stencil_write_enable =
+			parameter & NV097_SET_CONTROL0_STENCIL_WRITE_ENABLE;
+		SET_MASK(pg->regs[NV_PGRAPH_CONTROL_0],
+			NV_PGRAPH_CONTROL_0_STENCIL_WRITE_ENABLE,
+			stencil_write_enable);
+
+		uint32_t z_format = GET_MASK(parameter, NV097_SET_CONTROL0_Z_FORMAT);
+		SET_MASK(pg->regs[NV_PGRAPH_SETUPRASTER],
+			NV_PGRAPH_SETUPRASTER_Z_FORMAT, z_format);
+
+		bool z_perspective =
+			parameter & NV097_SET_CONTROL0_Z_PERSPECTIVE_ENABLE;
+		SET_MASK(pg->regs[NV_PGRAPH_CONTROL_0],
+			NV_PGRAPH_CONTROL_0_Z_PERSPECTIVE_ENABLE,
+			z_perspective);
+
+		int color_space_convert =
+			GET_MASK(parameter, NV097_SET_CONTROL0_COLOR_SPACE_CONVERT);
+		SET_MASK(pg->regs[NV_PGRAPH_CONTROL_0],
+			NV_PGRAPH_CONTROL_0_CSCONVERT,
+			color_space_convert);
+		break;
+	}
 
-		case NV097_SET_FOG_MODE: {
-			/* FIXME: There is also NV_PGRAPH_CSV0_D_FOG_MODE */
-			unsigned int mode;
-			switch (parameter) {
-			case NV097_SET_FOG_MODE_V_LINEAR:
-				mode = NV_PGRAPH_CONTROL_3_FOG_MODE_LINEAR; break;
-			case NV097_SET_FOG_MODE_V_EXP:
-				mode = NV_PGRAPH_CONTROL_3_FOG_MODE_EXP; break;
-			case NV097_SET_FOG_MODE_V_EXP2:
-				mode = NV_PGRAPH_CONTROL_3_FOG_MODE_EXP2; break;
-			case NV097_SET_FOG_MODE_V_EXP_ABS:
-				mode = NV_PGRAPH_CONTROL_3_FOG_MODE_EXP_ABS; break;
-			case NV097_SET_FOG_MODE_V_EXP2_ABS:
-				mode = NV_PGRAPH_CONTROL_3_FOG_MODE_EXP2_ABS; break;
-			case NV097_SET_FOG_MODE_V_LINEAR_ABS:
-				mode = NV_PGRAPH_CONTROL_3_FOG_MODE_LINEAR_ABS; break;
-			default:
-				assert(false);
-				break;
-			}
-			SET_MASK(pg->regs[NV_PGRAPH_CONTROL_3], NV_PGRAPH_CONTROL_3_FOG_MODE,
-				mode);
+	case NV097_SET_FOG_MODE: {
+		/* FIXME: There is also NV_PGRAPH_CSV0_D_FOG_MODE */
+		unsigned int mode;
+		switch (parameter) {
+		case NV097_SET_FOG_MODE_V_LINEAR:
+			mode = NV_PGRAPH_CONTROL_3_FOG_MODE_LINEAR; break;
+		case NV097_SET_FOG_MODE_V_EXP:
+			mode = NV_PGRAPH_CONTROL_3_FOG_MODE_EXP; break;
+		case NV097_SET_FOG_MODE_V_EXP2:
+			mode = NV_PGRAPH_CONTROL_3_FOG_MODE_EXP2; break;
+		case NV097_SET_FOG_MODE_V_EXP_ABS:
+			mode = NV_PGRAPH_CONTROL_3_FOG_MODE_EXP_ABS; break;
+		case NV097_SET_FOG_MODE_V_EXP2_ABS:
+			mode = NV_PGRAPH_CONTROL_3_FOG_MODE_EXP2_ABS; break;
+		case NV097_SET_FOG_MODE_V_LINEAR_ABS:
+			mode = NV_PGRAPH_CONTROL_3_FOG_MODE_LINEAR_ABS; break;
+		default:
+			assert(false);
 			break;
 		}
-		case NV097_SET_FOG_GEN_MODE: {
-			unsigned int mode;
-			switch (parameter) {
-			case NV097_SET_FOG_GEN_MODE_V_SPEC_ALPHA:
-				mode = NV_PGRAPH_CSV0_D_FOGGENMODE_SPEC_ALPHA; break;
-			case NV097_SET_FOG_GEN_MODE_V_RADIAL:
-				mode = NV_PGRAPH_CSV0_D_FOGGENMODE_RADIAL; break;
-			case NV097_SET_FOG_GEN_MODE_V_PLANAR:
-				mode = NV_PGRAPH_CSV0_D_FOGGENMODE_PLANAR; break;
-			case NV097_SET_FOG_GEN_MODE_V_ABS_PLANAR:
-				mode = NV_PGRAPH_CSV0_D_FOGGENMODE_ABS_PLANAR; break;
-			case NV097_SET_FOG_GEN_MODE_V_FOG_X:
-				mode = NV_PGRAPH_CSV0_D_FOGGENMODE_FOG_X; break;
-			default:
-				assert(false);
-				break;
-			}
-			SET_MASK(pg->regs[NV_PGRAPH_CSV0_D], NV_PGRAPH_CSV0_D_FOGGENMODE, mode);
+		SET_MASK(pg->regs[NV_PGRAPH_CONTROL_3], NV_PGRAPH_CONTROL_3_FOG_MODE,
+			mode);
+		break;
+	}
+	case NV097_SET_FOG_GEN_MODE: {
+		unsigned int mode;
+		switch (parameter) {
+		case NV097_SET_FOG_GEN_MODE_V_SPEC_ALPHA:
+			mode = NV_PGRAPH_CSV0_D_FOGGENMODE_SPEC_ALPHA; break;
+		case NV097_SET_FOG_GEN_MODE_V_RADIAL:
+			mode = NV_PGRAPH_CSV0_D_FOGGENMODE_RADIAL; break;
+		case NV097_SET_FOG_GEN_MODE_V_PLANAR:
+			mode = NV_PGRAPH_CSV0_D_FOGGENMODE_PLANAR; break;
+		case NV097_SET_FOG_GEN_MODE_V_ABS_PLANAR:
+			mode = NV_PGRAPH_CSV0_D_FOGGENMODE_ABS_PLANAR; break;
+		case NV097_SET_FOG_GEN_MODE_V_FOG_X:
+			mode = NV_PGRAPH_CSV0_D_FOGGENMODE_FOG_X; break;
+		default:
+			assert(false);
 			break;
 		}
-		case NV097_SET_FOG_ENABLE:
-			/*
-			FIXME: There is also:
-			SET_MASK(pg->regs[NV_PGRAPH_CSV0_D], NV_PGRAPH_CSV0_D_FOGENABLE,
+		SET_MASK(pg->regs[NV_PGRAPH_CSV0_D], NV_PGRAPH_CSV0_D_FOGGENMODE, mode);
+		break;
+	}
+	case NV097_SET_FOG_ENABLE:
+		/*
+		FIXME: There is also:
+		SET_MASK(pg->regs[NV_PGRAPH_CSV0_D], NV_PGRAPH_CSV0_D_FOGENABLE,
+		parameter);
+		*/
+		SET_MASK(pg->regs[NV_PGRAPH_CONTROL_3], NV_PGRAPH_CONTROL_3_FOGENABLE,
 			parameter);
-			*/
-			SET_MASK(pg->regs[NV_PGRAPH_CONTROL_3], NV_PGRAPH_CONTROL_3_FOGENABLE,
-				parameter);
-			break;
-		case NV097_SET_FOG_COLOR: {
-			/* parameter channels are ABGR, PGRAPH channels are ARGB */
-			uint8_t alpha = GET_MASK(parameter, NV097_SET_FOG_COLOR_ALPHA);
-			uint8_t blue = GET_MASK(parameter, NV097_SET_FOG_COLOR_BLUE);
-			uint8_t green = GET_MASK(parameter, NV097_SET_FOG_COLOR_GREEN);
-			uint8_t red = GET_MASK(parameter, NV097_SET_FOG_COLOR_RED);
-			SET_MASK(pg->regs[NV_PGRAPH_FOGCOLOR], NV_PGRAPH_FOGCOLOR_ALPHA, alpha);
-			SET_MASK(pg->regs[NV_PGRAPH_FOGCOLOR], NV_PGRAPH_FOGCOLOR_RED, red);
-			SET_MASK(pg->regs[NV_PGRAPH_FOGCOLOR], NV_PGRAPH_FOGCOLOR_GREEN, green);
-			SET_MASK(pg->regs[NV_PGRAPH_FOGCOLOR], NV_PGRAPH_FOGCOLOR_BLUE, blue);
+		break;
+	case NV097_SET_FOG_COLOR: {
+		/* parameter channels are ABGR, PGRAPH channels are ARGB */
+		uint8_t alpha = GET_MASK(parameter, NV097_SET_FOG_COLOR_ALPHA);
+		uint8_t blue = GET_MASK(parameter, NV097_SET_FOG_COLOR_BLUE);
+		uint8_t green = GET_MASK(parameter, NV097_SET_FOG_COLOR_GREEN);
+		uint8_t red = GET_MASK(parameter, NV097_SET_FOG_COLOR_RED);
+		SET_MASK(pg->regs[NV_PGRAPH_FOGCOLOR], NV_PGRAPH_FOGCOLOR_ALPHA, alpha);
+		SET_MASK(pg->regs[NV_PGRAPH_FOGCOLOR], NV_PGRAPH_FOGCOLOR_RED, red);
+		SET_MASK(pg->regs[NV_PGRAPH_FOGCOLOR], NV_PGRAPH_FOGCOLOR_GREEN, green);
+		SET_MASK(pg->regs[NV_PGRAPH_FOGCOLOR], NV_PGRAPH_FOGCOLOR_BLUE, blue);
+		break;
+	}
+	case NV097_SET_WINDOW_CLIP_TYPE:
+		SET_MASK(pg->regs[NV_PGRAPH_SETUPRASTER],
+			NV_PGRAPH_SETUPRASTER_WINDOWCLIPTYPE, parameter);
+		break;
+	CASE_8(NV097_SET_WINDOW_CLIP_HORIZONTAL, 4):
+		slot = (method - NV097_SET_WINDOW_CLIP_HORIZONTAL) / 4;
+		pg->regs[NV_PGRAPH_WINDOWCLIPX0 + slot * 4] = parameter;
+		break;
+	CASE_8(NV097_SET_WINDOW_CLIP_VERTICAL, 4):
+		slot = (method - NV097_SET_WINDOW_CLIP_VERTICAL) / 4;
+		pg->regs[NV_PGRAPH_WINDOWCLIPY0 + slot * 4] = parameter;
+		break;
+	case NV097_SET_ALPHA_TEST_ENABLE:
+		SET_MASK(pg->regs[NV_PGRAPH_CONTROL_0],
+			NV_PGRAPH_CONTROL_0_ALPHATESTENABLE, parameter);
+		break;
+	case NV097_SET_BLEND_ENABLE:
+		SET_MASK(pg->regs[NV_PGRAPH_BLEND], NV_PGRAPH_BLEND_EN, parameter);
+		break;
+	case NV097_SET_CULL_FACE_ENABLE:
+		SET_MASK(pg->regs[NV_PGRAPH_SETUPRASTER],
+			NV_PGRAPH_SETUPRASTER_CULLENABLE,
+			parameter);
+		break;
+	case NV097_SET_DEPTH_TEST_ENABLE:
+		// Test-case : Whiplash
+		SET_MASK(pg->regs[NV_PGRAPH_CONTROL_0], NV_PGRAPH_CONTROL_0_ZENABLE,
+			parameter);
+		break;
+	case NV097_SET_DITHER_ENABLE:
+		SET_MASK(pg->regs[NV_PGRAPH_CONTROL_0],
+			NV_PGRAPH_CONTROL_0_DITHERENABLE, parameter);
+		break;
+	case NV097_SET_LIGHTING_ENABLE:
+		SET_MASK(pg->regs[NV_PGRAPH_CSV0_C], NV_PGRAPH_CSV0_C_LIGHTING,
+			parameter);
+		break;
+	case NV097_SET_SKIN_MODE:
+		SET_MASK(pg->regs[NV_PGRAPH_CSV0_D], NV_PGRAPH_CSV0_D_SKIN,
+			parameter);
+		break;
+	case NV097_SET_STENCIL_TEST_ENABLE:
+		SET_MASK(pg->regs[NV_PGRAPH_CONTROL_1],
+			NV_PGRAPH_CONTROL_1_STENCIL_TEST_ENABLE, parameter);
+		break;
+	case NV097_SET_POLY_OFFSET_POINT_ENABLE:
+		SET_MASK(pg->regs[NV_PGRAPH_SETUPRASTER],
+			NV_PGRAPH_SETUPRASTER_POFFSETPOINTENABLE, parameter);
+		break;
+	case NV097_SET_POLY_OFFSET_LINE_ENABLE:
+		SET_MASK(pg->regs[NV_PGRAPH_SETUPRASTER],
+			NV_PGRAPH_SETUPRASTER_POFFSETLINEENABLE, parameter);
+		break;
+	case NV097_SET_POLY_OFFSET_FILL_ENABLE:
+		SET_MASK(pg->regs[NV_PGRAPH_SETUPRASTER],
+			NV_PGRAPH_SETUPRASTER_POFFSETFILLENABLE, parameter);
+		break;
+	case NV097_SET_ALPHA_FUNC:
+		SET_MASK(pg->regs[NV_PGRAPH_CONTROL_0],
+			NV_PGRAPH_CONTROL_0_ALPHAFUNC, parameter & 0xF);
+		break;
+	case NV097_SET_ALPHA_REF:
+		SET_MASK(pg->regs[NV_PGRAPH_CONTROL_0],
+			NV_PGRAPH_CONTROL_0_ALPHAREF, parameter);
+		break;
+	case NV097_SET_BLEND_FUNC_SFACTOR: {
+		unsigned int factor;
+		switch (parameter) {
+		case NV097_SET_BLEND_FUNC_SFACTOR_V_ZERO:
+			factor = NV_PGRAPH_BLEND_SFACTOR_ZERO; break;
+		case NV097_SET_BLEND_FUNC_SFACTOR_V_ONE:
+			factor = NV_PGRAPH_BLEND_SFACTOR_ONE; break;
+		case NV097_SET_BLEND_FUNC_SFACTOR_V_SRC_COLOR:
+			factor = NV_PGRAPH_BLEND_SFACTOR_SRC_COLOR; break;
+		case NV097_SET_BLEND_FUNC_SFACTOR_V_ONE_MINUS_SRC_COLOR:
+			factor = NV_PGRAPH_BLEND_SFACTOR_ONE_MINUS_SRC_COLOR; break;
+		case NV097_SET_BLEND_FUNC_SFACTOR_V_SRC_ALPHA:
+			factor = NV_PGRAPH_BLEND_SFACTOR_SRC_ALPHA; break;
+		case NV097_SET_BLEND_FUNC_SFACTOR_V_ONE_MINUS_SRC_ALPHA:
+			factor = NV_PGRAPH_BLEND_SFACTOR_ONE_MINUS_SRC_ALPHA; break;
+		case NV097_SET_BLEND_FUNC_SFACTOR_V_DST_ALPHA:
+			factor = NV_PGRAPH_BLEND_SFACTOR_DST_ALPHA; break;
+		case NV097_SET_BLEND_FUNC_SFACTOR_V_ONE_MINUS_DST_ALPHA:
+			factor = NV_PGRAPH_BLEND_SFACTOR_ONE_MINUS_DST_ALPHA; break;
+		case NV097_SET_BLEND_FUNC_SFACTOR_V_DST_COLOR:
+			factor = NV_PGRAPH_BLEND_SFACTOR_DST_COLOR; break;
+		case NV097_SET_BLEND_FUNC_SFACTOR_V_ONE_MINUS_DST_COLOR:
+			factor = NV_PGRAPH_BLEND_SFACTOR_ONE_MINUS_DST_COLOR; break;
+		case NV097_SET_BLEND_FUNC_SFACTOR_V_SRC_ALPHA_SATURATE:
+			factor = NV_PGRAPH_BLEND_SFACTOR_SRC_ALPHA_SATURATE; break;
+		case NV097_SET_BLEND_FUNC_SFACTOR_V_CONSTANT_COLOR:
+			factor = NV_PGRAPH_BLEND_SFACTOR_CONSTANT_COLOR; break;
+		case NV097_SET_BLEND_FUNC_SFACTOR_V_ONE_MINUS_CONSTANT_COLOR:
+			factor = NV_PGRAPH_BLEND_SFACTOR_ONE_MINUS_CONSTANT_COLOR; break;
+		case NV097_SET_BLEND_FUNC_SFACTOR_V_CONSTANT_ALPHA:
+			factor = NV_PGRAPH_BLEND_SFACTOR_CONSTANT_ALPHA; break;
+		case NV097_SET_BLEND_FUNC_SFACTOR_V_ONE_MINUS_CONSTANT_ALPHA:
+			factor = NV_PGRAPH_BLEND_SFACTOR_ONE_MINUS_CONSTANT_ALPHA; break;
+		default:
+			fprintf(stderr, "Unknown blend source factor: 0x%x\n", parameter);
+			assert(false);
 			break;
 		}
-		case NV097_SET_WINDOW_CLIP_TYPE:
-			SET_MASK(pg->regs[NV_PGRAPH_SETUPRASTER],
-				NV_PGRAPH_SETUPRASTER_WINDOWCLIPTYPE, parameter);
-			break;
-		CASE_8(NV097_SET_WINDOW_CLIP_HORIZONTAL, 4):
-			slot = (method - NV097_SET_WINDOW_CLIP_HORIZONTAL) / 4;
-			pg->regs[NV_PGRAPH_WINDOWCLIPX0 + slot * 4] = parameter;
-			break;
-		CASE_8(NV097_SET_WINDOW_CLIP_VERTICAL, 4):
-			slot = (method - NV097_SET_WINDOW_CLIP_VERTICAL) / 4;
-			pg->regs[NV_PGRAPH_WINDOWCLIPY0 + slot * 4] = parameter;
-			break;
-		case NV097_SET_ALPHA_TEST_ENABLE:
-			SET_MASK(pg->regs[NV_PGRAPH_CONTROL_0],
-				NV_PGRAPH_CONTROL_0_ALPHATESTENABLE, parameter);
-			break;
-		case NV097_SET_BLEND_ENABLE:
-			SET_MASK(pg->regs[NV_PGRAPH_BLEND], NV_PGRAPH_BLEND_EN, parameter);
-			break;
-		case NV097_SET_CULL_FACE_ENABLE:
-			SET_MASK(pg->regs[NV_PGRAPH_SETUPRASTER],
-				NV_PGRAPH_SETUPRASTER_CULLENABLE,
-				parameter);
-			break;
-		case NV097_SET_DEPTH_TEST_ENABLE:
-			// Test-case : Whiplash
-			SET_MASK(pg->regs[NV_PGRAPH_CONTROL_0], NV_PGRAPH_CONTROL_0_ZENABLE,
-				parameter);
-			break;
-		case NV097_SET_DITHER_ENABLE:
-			SET_MASK(pg->regs[NV_PGRAPH_CONTROL_0],
-				NV_PGRAPH_CONTROL_0_DITHERENABLE, parameter);
-			break;
-		case NV097_SET_LIGHTING_ENABLE:
-			SET_MASK(pg->regs[NV_PGRAPH_CSV0_C], NV_PGRAPH_CSV0_C_LIGHTING,
-				parameter);
-			break;
-		case NV097_SET_SKIN_MODE:
-			SET_MASK(pg->regs[NV_PGRAPH_CSV0_D], NV_PGRAPH_CSV0_D_SKIN,
-				parameter);
-			break;
-		case NV097_SET_STENCIL_TEST_ENABLE:
-			SET_MASK(pg->regs[NV_PGRAPH_CONTROL_1],
-				NV_PGRAPH_CONTROL_1_STENCIL_TEST_ENABLE, parameter);
-			break;
-		case NV097_SET_POLY_OFFSET_POINT_ENABLE:
-			SET_MASK(pg->regs[NV_PGRAPH_SETUPRASTER],
-				NV_PGRAPH_SETUPRASTER_POFFSETPOINTENABLE, parameter);
-			break;
-		case NV097_SET_POLY_OFFSET_LINE_ENABLE:
-			SET_MASK(pg->regs[NV_PGRAPH_SETUPRASTER],
-				NV_PGRAPH_SETUPRASTER_POFFSETLINEENABLE, parameter);
-			break;
-		case NV097_SET_POLY_OFFSET_FILL_ENABLE:
-			SET_MASK(pg->regs[NV_PGRAPH_SETUPRASTER],
-				NV_PGRAPH_SETUPRASTER_POFFSETFILLENABLE, parameter);
-			break;
-		case NV097_SET_ALPHA_FUNC:
-			SET_MASK(pg->regs[NV_PGRAPH_CONTROL_0],
-				NV_PGRAPH_CONTROL_0_ALPHAFUNC, parameter & 0xF);
-			break;
-		case NV097_SET_ALPHA_REF:
-			SET_MASK(pg->regs[NV_PGRAPH_CONTROL_0],
-				NV_PGRAPH_CONTROL_0_ALPHAREF, parameter);
-			break;
-		case NV097_SET_BLEND_FUNC_SFACTOR: {
-			unsigned int factor;
-			switch (parameter) {
-			case NV097_SET_BLEND_FUNC_SFACTOR_V_ZERO:
-				factor = NV_PGRAPH_BLEND_SFACTOR_ZERO; break;
-			case NV097_SET_BLEND_FUNC_SFACTOR_V_ONE:
-				factor = NV_PGRAPH_BLEND_SFACTOR_ONE; break;
-			case NV097_SET_BLEND_FUNC_SFACTOR_V_SRC_COLOR:
-				factor = NV_PGRAPH_BLEND_SFACTOR_SRC_COLOR; break;
-			case NV097_SET_BLEND_FUNC_SFACTOR_V_ONE_MINUS_SRC_COLOR:
-				factor = NV_PGRAPH_BLEND_SFACTOR_ONE_MINUS_SRC_COLOR; break;
-			case NV097_SET_BLEND_FUNC_SFACTOR_V_SRC_ALPHA:
-				factor = NV_PGRAPH_BLEND_SFACTOR_SRC_ALPHA; break;
-			case NV097_SET_BLEND_FUNC_SFACTOR_V_ONE_MINUS_SRC_ALPHA:
-				factor = NV_PGRAPH_BLEND_SFACTOR_ONE_MINUS_SRC_ALPHA; break;
-			case NV097_SET_BLEND_FUNC_SFACTOR_V_DST_ALPHA:
-				factor = NV_PGRAPH_BLEND_SFACTOR_DST_ALPHA; break;
-			case NV097_SET_BLEND_FUNC_SFACTOR_V_ONE_MINUS_DST_ALPHA:
-				factor = NV_PGRAPH_BLEND_SFACTOR_ONE_MINUS_DST_ALPHA; break;
-			case NV097_SET_BLEND_FUNC_SFACTOR_V_DST_COLOR:
-				factor = NV_PGRAPH_BLEND_SFACTOR_DST_COLOR; break;
-			case NV097_SET_BLEND_FUNC_SFACTOR_V_ONE_MINUS_DST_COLOR:
-				factor = NV_PGRAPH_BLEND_SFACTOR_ONE_MINUS_DST_COLOR; break;
-			case NV097_SET_BLEND_FUNC_SFACTOR_V_SRC_ALPHA_SATURATE:
-				factor = NV_PGRAPH_BLEND_SFACTOR_SRC_ALPHA_SATURATE; break;
-			case NV097_SET_BLEND_FUNC_SFACTOR_V_CONSTANT_COLOR:
-				factor = NV_PGRAPH_BLEND_SFACTOR_CONSTANT_COLOR; break;
-			case NV097_SET_BLEND_FUNC_SFACTOR_V_ONE_MINUS_CONSTANT_COLOR:
-				factor = NV_PGRAPH_BLEND_SFACTOR_ONE_MINUS_CONSTANT_COLOR; break;
-			case NV097_SET_BLEND_FUNC_SFACTOR_V_CONSTANT_ALPHA:
-				factor = NV_PGRAPH_BLEND_SFACTOR_CONSTANT_ALPHA; break;
-			case NV097_SET_BLEND_FUNC_SFACTOR_V_ONE_MINUS_CONSTANT_ALPHA:
-				factor = NV_PGRAPH_BLEND_SFACTOR_ONE_MINUS_CONSTANT_ALPHA; break;
-			default:
-				fprintf(stderr, "Unknown blend source factor: 0x%x\n", parameter);
-				assert(false);
-				break;
-			}
-			SET_MASK(pg->regs[NV_PGRAPH_BLEND], NV_PGRAPH_BLEND_SFACTOR, factor);
-
-			break;
-		}
-
-		case NV097_SET_BLEND_FUNC_DFACTOR: {
-			unsigned int factor;
-			switch (parameter) {
-			case NV097_SET_BLEND_FUNC_DFACTOR_V_ZERO:
-				factor = NV_PGRAPH_BLEND_DFACTOR_ZERO; break;
-			case NV097_SET_BLEND_FUNC_DFACTOR_V_ONE:
-				factor = NV_PGRAPH_BLEND_DFACTOR_ONE; break;
-			case NV097_SET_BLEND_FUNC_DFACTOR_V_SRC_COLOR:
-				factor = NV_PGRAPH_BLEND_DFACTOR_SRC_COLOR; break;
-			case NV097_SET_BLEND_FUNC_DFACTOR_V_ONE_MINUS_SRC_COLOR:
-				factor = NV_PGRAPH_BLEND_DFACTOR_ONE_MINUS_SRC_COLOR; break;
-			case NV097_SET_BLEND_FUNC_DFACTOR_V_SRC_ALPHA:
-				factor = NV_PGRAPH_BLEND_DFACTOR_SRC_ALPHA; break;
-			case NV097_SET_BLEND_FUNC_DFACTOR_V_ONE_MINUS_SRC_ALPHA:
-				factor = NV_PGRAPH_BLEND_DFACTOR_ONE_MINUS_SRC_ALPHA; break;
-			case NV097_SET_BLEND_FUNC_DFACTOR_V_DST_ALPHA:
-				factor = NV_PGRAPH_BLEND_DFACTOR_DST_ALPHA; break;
-			case NV097_SET_BLEND_FUNC_DFACTOR_V_ONE_MINUS_DST_ALPHA:
-				factor = NV_PGRAPH_BLEND_DFACTOR_ONE_MINUS_DST_ALPHA; break;
-			case NV097_SET_BLEND_FUNC_DFACTOR_V_DST_COLOR:
-				factor = NV_PGRAPH_BLEND_DFACTOR_DST_COLOR; break;
-			case NV097_SET_BLEND_FUNC_DFACTOR_V_ONE_MINUS_DST_COLOR:
-				factor = NV_PGRAPH_BLEND_DFACTOR_ONE_MINUS_DST_COLOR; break;
-			case NV097_SET_BLEND_FUNC_DFACTOR_V_SRC_ALPHA_SATURATE:
-				factor = NV_PGRAPH_BLEND_DFACTOR_SRC_ALPHA_SATURATE; break;
-			case NV097_SET_BLEND_FUNC_DFACTOR_V_CONSTANT_COLOR:
-				factor = NV_PGRAPH_BLEND_DFACTOR_CONSTANT_COLOR; break;
-			case NV097_SET_BLEND_FUNC_DFACTOR_V_ONE_MINUS_CONSTANT_COLOR:
-				factor = NV_PGRAPH_BLEND_DFACTOR_ONE_MINUS_CONSTANT_COLOR; break;
-			case NV097_SET_BLEND_FUNC_DFACTOR_V_CONSTANT_ALPHA:
-				factor = NV_PGRAPH_BLEND_DFACTOR_CONSTANT_ALPHA; break;
-			case NV097_SET_BLEND_FUNC_DFACTOR_V_ONE_MINUS_CONSTANT_ALPHA:
-				factor = NV_PGRAPH_BLEND_DFACTOR_ONE_MINUS_CONSTANT_ALPHA; break;
-			default:
-				fprintf(stderr, "Unknown blend destination factor: 0x%x\n", parameter);
-				assert(false);
-				break;
-			}
-			SET_MASK(pg->regs[NV_PGRAPH_BLEND], NV_PGRAPH_BLEND_DFACTOR, factor);
-
+		SET_MASK(pg->regs[NV_PGRAPH_BLEND], NV_PGRAPH_BLEND_SFACTOR, factor);
+
+		break;
+	}
+
+	case NV097_SET_BLEND_FUNC_DFACTOR: {
+		unsigned int factor;
+		switch (parameter) {
+		case NV097_SET_BLEND_FUNC_DFACTOR_V_ZERO:
+			factor = NV_PGRAPH_BLEND_DFACTOR_ZERO; break;
+		case NV097_SET_BLEND_FUNC_DFACTOR_V_ONE:
+			factor = NV_PGRAPH_BLEND_DFACTOR_ONE; break;
+		case NV097_SET_BLEND_FUNC_DFACTOR_V_SRC_COLOR:
+			factor = NV_PGRAPH_BLEND_DFACTOR_SRC_COLOR; break;
+		case NV097_SET_BLEND_FUNC_DFACTOR_V_ONE_MINUS_SRC_COLOR:
+			factor = NV_PGRAPH_BLEND_DFACTOR_ONE_MINUS_SRC_COLOR; break;
+		case NV097_SET_BLEND_FUNC_DFACTOR_V_SRC_ALPHA:
+			factor = NV_PGRAPH_BLEND_DFACTOR_SRC_ALPHA; break;
+		case NV097_SET_BLEND_FUNC_DFACTOR_V_ONE_MINUS_SRC_ALPHA:
+			factor = NV_PGRAPH_BLEND_DFACTOR_ONE_MINUS_SRC_ALPHA; break;
+		case NV097_SET_BLEND_FUNC_DFACTOR_V_DST_ALPHA:
+			factor = NV_PGRAPH_BLEND_DFACTOR_DST_ALPHA; break;
+		case NV097_SET_BLEND_FUNC_DFACTOR_V_ONE_MINUS_DST_ALPHA:
+			factor = NV_PGRAPH_BLEND_DFACTOR_ONE_MINUS_DST_ALPHA; break;
+		case NV097_SET_BLEND_FUNC_DFACTOR_V_DST_COLOR:
+			factor = NV_PGRAPH_BLEND_DFACTOR_DST_COLOR; break;
+		case NV097_SET_BLEND_FUNC_DFACTOR_V_ONE_MINUS_DST_COLOR:
+			factor = NV_PGRAPH_BLEND_DFACTOR_ONE_MINUS_DST_COLOR; break;
+		case NV097_SET_BLEND_FUNC_DFACTOR_V_SRC_ALPHA_SATURATE:
+			factor = NV_PGRAPH_BLEND_DFACTOR_SRC_ALPHA_SATURATE; break;
+		case NV097_SET_BLEND_FUNC_DFACTOR_V_CONSTANT_COLOR:
+			factor = NV_PGRAPH_BLEND_DFACTOR_CONSTANT_COLOR; break;
+		case NV097_SET_BLEND_FUNC_DFACTOR_V_ONE_MINUS_CONSTANT_COLOR:
+			factor = NV_PGRAPH_BLEND_DFACTOR_ONE_MINUS_CONSTANT_COLOR; break;
+		case NV097_SET_BLEND_FUNC_DFACTOR_V_CONSTANT_ALPHA:
+			factor = NV_PGRAPH_BLEND_DFACTOR_CONSTANT_ALPHA; break;
+		case NV097_SET_BLEND_FUNC_DFACTOR_V_ONE_MINUS_CONSTANT_ALPHA:
+			factor = NV_PGRAPH_BLEND_DFACTOR_ONE_MINUS_CONSTANT_ALPHA; break;
+		default:
+			fprintf(stderr, "Unknown blend destination factor: 0x%x\n", parameter);
+			assert(false);
 			break;
 		}
+		SET_MASK(pg->regs[NV_PGRAPH_BLEND], NV_PGRAPH_BLEND_DFACTOR, factor);
 
-		case NV097_SET_BLEND_COLOR:
-			pg->regs[NV_PGRAPH_BLENDCOLOR] = parameter;
-			break;
+		break;
+	}
 
-		case NV097_SET_BLEND_EQUATION: {
-			unsigned int equation;
-			switch (parameter) {
-			case NV097_SET_BLEND_EQUATION_V_FUNC_SUBTRACT:
-				equation = 0; break;
-			case NV097_SET_BLEND_EQUATION_V_FUNC_REVERSE_SUBTRACT:
-				equation = 1; break;
-			case NV097_SET_BLEND_EQUATION_V_FUNC_ADD:
-				equation = 2; break;
-			case NV097_SET_BLEND_EQUATION_V_MIN:
-				equation = 3; break;
-			case NV097_SET_BLEND_EQUATION_V_MAX:
-				equation = 4; break;
-			case NV097_SET_BLEND_EQUATION_V_FUNC_REVERSE_SUBTRACT_SIGNED:
-				equation = 5; break;
-			case NV097_SET_BLEND_EQUATION_V_FUNC_ADD_SIGNED:
-				equation = 6; break;
-			default:
-				assert(false);
-				break;
-			}
-			SET_MASK(pg->regs[NV_PGRAPH_BLEND], NV_PGRAPH_BLEND_EQN, equation);
+	case NV097_SET_BLEND_COLOR:
+		pg->regs[NV_PGRAPH_BLENDCOLOR] = parameter;
+		break;
 
+	case NV097_SET_BLEND_EQUATION: {
+		unsigned int equation;
+		switch (parameter) {
+		case NV097_SET_BLEND_EQUATION_V_FUNC_SUBTRACT:
+			equation = 0; break;
+		case NV097_SET_BLEND_EQUATION_V_FUNC_REVERSE_SUBTRACT:
+			equation = 1; break;
+		case NV097_SET_BLEND_EQUATION_V_FUNC_ADD:
+			equation = 2; break;
+		case NV097_SET_BLEND_EQUATION_V_MIN:
+			equation = 3; break;
+		case NV097_SET_BLEND_EQUATION_V_MAX:
+			equation = 4; break;
+		case NV097_SET_BLEND_EQUATION_V_FUNC_REVERSE_SUBTRACT_SIGNED:
+			equation = 5; break;
+		case NV097_SET_BLEND_EQUATION_V_FUNC_ADD_SIGNED:
+			equation = 6; break;
+		default:
+			assert(false);
 			break;
 		}
+		SET_MASK(pg->regs[NV_PGRAPH_BLEND], NV_PGRAPH_BLEND_EQN, equation);
 
-		case NV097_SET_DEPTH_FUNC:
-			// Test-case : Whiplash
-			SET_MASK(pg->regs[NV_PGRAPH_CONTROL_0], NV_PGRAPH_CONTROL_0_ZFUNC,
-				parameter & 0xF);
-			break;
+		break;
+	}
 
-		case NV097_SET_COLOR_MASK: {
-			pg->surface_color.write_enabled_cache |= pgraph_get_color_write_enabled(pg);
-
-			bool alpha = parameter & NV097_SET_COLOR_MASK_ALPHA_WRITE_ENABLE;
-			bool red = parameter & NV097_SET_COLOR_MASK_RED_WRITE_ENABLE;
-			bool green = parameter & NV097_SET_COLOR_MASK_GREEN_WRITE_ENABLE;
-			bool blue = parameter & NV097_SET_COLOR_MASK_BLUE_WRITE_ENABLE;
-			SET_MASK(pg->regs[NV_PGRAPH_CONTROL_0],
-				NV_PGRAPH_CONTROL_0_ALPHA_WRITE_ENABLE, alpha);
-			SET_MASK(pg->regs[NV_PGRAPH_CONTROL_0],
-				NV_PGRAPH_CONTROL_0_RED_WRITE_ENABLE, red);
-			SET_MASK(pg->regs[NV_PGRAPH_CONTROL_0],
-				NV_PGRAPH_CONTROL_0_GREEN_WRITE_ENABLE, green);
-			SET_MASK(pg->regs[NV_PGRAPH_CONTROL_0],
-				NV_PGRAPH_CONTROL_0_BLUE_WRITE_ENABLE, blue);
-			break;
-		}
-		case NV097_SET_DEPTH_MASK:
-			pg->surface_zeta.write_enabled_cache |= pgraph_get_zeta_write_enabled(pg);
+	case NV097_SET_DEPTH_FUNC:
+		// Test-case : Whiplash
+		SET_MASK(pg->regs[NV_PGRAPH_CONTROL_0], NV_PGRAPH_CONTROL_0_ZFUNC,
+			parameter & 0xF);
+		break;
 
-			SET_MASK(pg->regs[NV_PGRAPH_CONTROL_0],
-				NV_PGRAPH_CONTROL_0_ZWRITEENABLE, parameter);
-			break;
-		case NV097_SET_STENCIL_MASK:
-			SET_MASK(pg->regs[NV_PGRAPH_CONTROL_1],
-				NV_PGRAPH_CONTROL_1_STENCIL_MASK_WRITE, parameter);
-			break;
-		case NV097_SET_STENCIL_FUNC:
-			SET_MASK(pg->regs[NV_PGRAPH_CONTROL_1],
-				NV_PGRAPH_CONTROL_1_STENCIL_FUNC, parameter & 0xF);
-			break;
-		case NV097_SET_STENCIL_FUNC_REF:
-			SET_MASK(pg->regs[NV_PGRAPH_CONTROL_1],
-				NV_PGRAPH_CONTROL_1_STENCIL_REF, parameter);
-			break;
-		case NV097_SET_STENCIL_FUNC_MASK:
-			SET_MASK(pg->regs[NV_PGRAPH_CONTROL_1],
-				NV_PGRAPH_CONTROL_1_STENCIL_MASK_READ, parameter);
-			break;
-		case NV097_SET_STENCIL_OP_FAIL:
-			SET_MASK(pg->regs[NV_PGRAPH_CONTROL_2],
-				NV_PGRAPH_CONTROL_2_STENCIL_OP_FAIL,
-				kelvin_map_stencil_op(parameter));
-			break;
-		case NV097_SET_STENCIL_OP_ZFAIL:
-			SET_MASK(pg->regs[NV_PGRAPH_CONTROL_2],
-				NV_PGRAPH_CONTROL_2_STENCIL_OP_ZFAIL,
-				kelvin_map_stencil_op(parameter));
-			break;
-		case NV097_SET_STENCIL_OP_ZPASS:
-			SET_MASK(pg->regs[NV_PGRAPH_CONTROL_2],
-				NV_PGRAPH_CONTROL_2_STENCIL_OP_ZPASS,
-				kelvin_map_stencil_op(parameter));
-			break;
+	case NV097_SET_COLOR_MASK: {
+		pg->surface_color.write_enabled_cache |= pgraph_get_color_write_enabled(pg);
+
+		bool alpha = parameter & NV097_SET_COLOR_MASK_ALPHA_WRITE_ENABLE;
+		bool red = parameter & NV097_SET_COLOR_MASK_RED_WRITE_ENABLE;
+		bool green = parameter & NV097_SET_COLOR_MASK_GREEN_WRITE_ENABLE;
+		bool blue = parameter & NV097_SET_COLOR_MASK_BLUE_WRITE_ENABLE;
+		SET_MASK(pg->regs[NV_PGRAPH_CONTROL_0],
+			NV_PGRAPH_CONTROL_0_ALPHA_WRITE_ENABLE, alpha);
+		SET_MASK(pg->regs[NV_PGRAPH_CONTROL_0],
+			NV_PGRAPH_CONTROL_0_RED_WRITE_ENABLE, red);
+		SET_MASK(pg->regs[NV_PGRAPH_CONTROL_0],
+			NV_PGRAPH_CONTROL_0_GREEN_WRITE_ENABLE, green);
+		SET_MASK(pg->regs[NV_PGRAPH_CONTROL_0],
+			NV_PGRAPH_CONTROL_0_BLUE_WRITE_ENABLE, blue);
+		break;
+	}
+	case NV097_SET_DEPTH_MASK:
+		pg->surface_zeta.write_enabled_cache |= pgraph_get_zeta_write_enabled(pg);
 
-		case NV097_SET_POLYGON_OFFSET_SCALE_FACTOR:
-			pg->regs[NV_PGRAPH_ZOFFSETFACTOR] = parameter;
-			break;
-		case NV097_SET_POLYGON_OFFSET_BIAS:
-			pg->regs[NV_PGRAPH_ZOFFSETBIAS] = parameter;
-			break;
-		case NV097_SET_FRONT_POLYGON_MODE:
-			SET_MASK(pg->regs[NV_PGRAPH_SETUPRASTER],
-				NV_PGRAPH_SETUPRASTER_FRONTFACEMODE,
-				kelvin_map_polygon_mode(parameter));
-			break;
-		case NV097_SET_BACK_POLYGON_MODE:
-			SET_MASK(pg->regs[NV_PGRAPH_SETUPRASTER],
-				NV_PGRAPH_SETUPRASTER_BACKFACEMODE,
-				kelvin_map_polygon_mode(parameter));
-			break;
-		case NV097_SET_CLIP_MIN:
-			pg->regs[NV_PGRAPH_ZCLIPMIN] = parameter;
-			break;
-		case NV097_SET_CLIP_MAX:
-			pg->regs[NV_PGRAPH_ZCLIPMAX] = parameter;
-			break;
-		case NV097_SET_CULL_FACE: {
-			unsigned int face;
-			switch (parameter) {
-			case NV097_SET_CULL_FACE_V_FRONT:
-				face = NV_PGRAPH_SETUPRASTER_CULLCTRL_FRONT; break;
-			case NV097_SET_CULL_FACE_V_BACK:
-				face = NV_PGRAPH_SETUPRASTER_CULLCTRL_BACK; break;
-			case NV097_SET_CULL_FACE_V_FRONT_AND_BACK:
-				face = NV_PGRAPH_SETUPRASTER_CULLCTRL_FRONT_AND_BACK; break;
-			default:
-				assert(false);
-				break;
-			}
-			SET_MASK(pg->regs[NV_PGRAPH_SETUPRASTER],
-				NV_PGRAPH_SETUPRASTER_CULLCTRL,
-				face);
+		SET_MASK(pg->regs[NV_PGRAPH_CONTROL_0],
+			NV_PGRAPH_CONTROL_0_ZWRITEENABLE, parameter);
+		break;
+	case NV097_SET_STENCIL_MASK:
+		SET_MASK(pg->regs[NV_PGRAPH_CONTROL_1],
+			NV_PGRAPH_CONTROL_1_STENCIL_MASK_WRITE, parameter);
+		break;
+	case NV097_SET_STENCIL_FUNC:
+		SET_MASK(pg->regs[NV_PGRAPH_CONTROL_1],
+			NV_PGRAPH_CONTROL_1_STENCIL_FUNC, parameter & 0xF);
+		break;
+	case NV097_SET_STENCIL_FUNC_REF:
+		SET_MASK(pg->regs[NV_PGRAPH_CONTROL_1],
+			NV_PGRAPH_CONTROL_1_STENCIL_REF, parameter);
+		break;
+	case NV097_SET_STENCIL_FUNC_MASK:
+		SET_MASK(pg->regs[NV_PGRAPH_CONTROL_1],
+			NV_PGRAPH_CONTROL_1_STENCIL_MASK_READ, parameter);
+		break;
+	case NV097_SET_STENCIL_OP_FAIL:
+		SET_MASK(pg->regs[NV_PGRAPH_CONTROL_2],
+			NV_PGRAPH_CONTROL_2_STENCIL_OP_FAIL,
+			kelvin_map_stencil_op(parameter));
+		break;
+	case NV097_SET_STENCIL_OP_ZFAIL:
+		SET_MASK(pg->regs[NV_PGRAPH_CONTROL_2],
+			NV_PGRAPH_CONTROL_2_STENCIL_OP_ZFAIL,
+			kelvin_map_stencil_op(parameter));
+		break;
+	case NV097_SET_STENCIL_OP_ZPASS:
+		SET_MASK(pg->regs[NV_PGRAPH_CONTROL_2],
+			NV_PGRAPH_CONTROL_2_STENCIL_OP_ZPASS,
+			kelvin_map_stencil_op(parameter));
+		break;
+
+	case NV097_SET_POLYGON_OFFSET_SCALE_FACTOR:
+		pg->regs[NV_PGRAPH_ZOFFSETFACTOR] = parameter;
+		break;
+	case NV097_SET_POLYGON_OFFSET_BIAS:
+		pg->regs[NV_PGRAPH_ZOFFSETBIAS] = parameter;
+		break;
+	case NV097_SET_FRONT_POLYGON_MODE:
+		SET_MASK(pg->regs[NV_PGRAPH_SETUPRASTER],
+			NV_PGRAPH_SETUPRASTER_FRONTFACEMODE,
+			kelvin_map_polygon_mode(parameter));
+		break;
+	case NV097_SET_BACK_POLYGON_MODE:
+		SET_MASK(pg->regs[NV_PGRAPH_SETUPRASTER],
+			NV_PGRAPH_SETUPRASTER_BACKFACEMODE,
+			kelvin_map_polygon_mode(parameter));
+		break;
+	case NV097_SET_CLIP_MIN:
+		pg->regs[NV_PGRAPH_ZCLIPMIN] = parameter;
+		break;
+	case NV097_SET_CLIP_MAX:
+		pg->regs[NV_PGRAPH_ZCLIPMAX] = parameter;
+		break;
+	case NV097_SET_CULL_FACE: {
+		unsigned int face;
+		switch (parameter) {
+		case NV097_SET_CULL_FACE_V_FRONT:
+			face = NV_PGRAPH_SETUPRASTER_CULLCTRL_FRONT; break;
+		case NV097_SET_CULL_FACE_V_BACK:
+			face = NV_PGRAPH_SETUPRASTER_CULLCTRL_BACK; break;
+		case NV097_SET_CULL_FACE_V_FRONT_AND_BACK:
+			face = NV_PGRAPH_SETUPRASTER_CULLCTRL_FRONT_AND_BACK; break;
+		default:
+			assert(false);
 			break;
 		}
-		case NV097_SET_FRONT_FACE: {
-			bool ccw;
-			switch (parameter) {
-			case NV097_SET_FRONT_FACE_V_CW:
-				ccw = false; break;
-			case NV097_SET_FRONT_FACE_V_CCW:
-				ccw = true; break;
-			default:
-				fprintf(stderr, "Unknown front face: 0x%x\n", parameter);
-				assert(false);
-				break;
-			}
-			SET_MASK(pg->regs[NV_PGRAPH_SETUPRASTER],
-				NV_PGRAPH_SETUPRASTER_FRONTFACE,
-				ccw ? 1 : 0);
+		SET_MASK(pg->regs[NV_PGRAPH_SETUPRASTER],
+			NV_PGRAPH_SETUPRASTER_CULLCTRL,
+			face);
+		break;
+	}
+	case NV097_SET_FRONT_FACE: {
+		bool ccw;
+		switch (parameter) {
+		case NV097_SET_FRONT_FACE_V_CW:
+			ccw = false; break;
+		case NV097_SET_FRONT_FACE_V_CCW:
+			ccw = true; break;
+		default:
+			fprintf(stderr, "Unknown front face: 0x%x\n", parameter);
+			assert(false);
 			break;
 		}
-		case NV097_SET_NORMALIZATION_ENABLE:
-			SET_MASK(pg->regs[NV_PGRAPH_CSV0_C],
-				NV_PGRAPH_CSV0_C_NORMALIZATION_ENABLE,
-				parameter);
-			break;
+		SET_MASK(pg->regs[NV_PGRAPH_SETUPRASTER],
+			NV_PGRAPH_SETUPRASTER_FRONTFACE,
+			ccw ? 1 : 0);
+		break;
+	}
+	case NV097_SET_NORMALIZATION_ENABLE:
+		SET_MASK(pg->regs[NV_PGRAPH_CSV0_C],
+			NV_PGRAPH_CSV0_C_NORMALIZATION_ENABLE,
+			parameter);
+		break;
 
-		case NV097_SET_LIGHT_ENABLE_MASK:
-			SET_MASK(pg->regs[NV_PGRAPH_CSV0_D],
-				NV_PGRAPH_CSV0_D_LIGHTS,
-				parameter);
-			break;
+	case NV097_SET_LIGHT_ENABLE_MASK:
+		SET_MASK(pg->regs[NV_PGRAPH_CSV0_D],
+			NV_PGRAPH_CSV0_D_LIGHTS,
+			parameter);
+		break;
 
-		CASE_4(NV097_SET_TEXGEN_S, 16) : {
-			slot = (method - NV097_SET_TEXGEN_S) / 16;
-			unsigned int reg = (slot < 2) ? NV_PGRAPH_CSV1_A
-				: NV_PGRAPH_CSV1_B;
-			unsigned int mask = (slot % 2) ? NV_PGRAPH_CSV1_A_T1_S
-				: NV_PGRAPH_CSV1_A_T0_S;
-			SET_MASK(pg->regs[reg], mask, kelvin_map_texgen(parameter, 0));
-			break;
-		}
-		CASE_4(NV097_SET_TEXGEN_T, 16) : {
-			slot = (method - NV097_SET_TEXGEN_T) / 16;
-			unsigned int reg = (slot < 2) ? NV_PGRAPH_CSV1_A
-				: NV_PGRAPH_CSV1_B;
-			unsigned int mask = (slot % 2) ? NV_PGRAPH_CSV1_A_T1_T
-				: NV_PGRAPH_CSV1_A_T0_T;
-			SET_MASK(pg->regs[reg], mask, kelvin_map_texgen(parameter, 1));
-			break;
+	CASE_4(NV097_SET_TEXGEN_S, 16) : {
+		slot = (method - NV097_SET_TEXGEN_S) / 16;
+		unsigned int reg = (slot < 2) ? NV_PGRAPH_CSV1_A
+			: NV_PGRAPH_CSV1_B;
+		unsigned int mask = (slot % 2) ? NV_PGRAPH_CSV1_A_T1_S
+			: NV_PGRAPH_CSV1_A_T0_S;
+		SET_MASK(pg->regs[reg], mask, kelvin_map_texgen(parameter, 0));
+		break;
+	}
+	CASE_4(NV097_SET_TEXGEN_T, 16) : {
+		slot = (method - NV097_SET_TEXGEN_T) / 16;
+		unsigned int reg = (slot < 2) ? NV_PGRAPH_CSV1_A
+			: NV_PGRAPH_CSV1_B;
+		unsigned int mask = (slot % 2) ? NV_PGRAPH_CSV1_A_T1_T
+			: NV_PGRAPH_CSV1_A_T0_T;
+		SET_MASK(pg->regs[reg], mask, kelvin_map_texgen(parameter, 1));
+		break;
+	}
+	CASE_4(NV097_SET_TEXGEN_R, 16) : {
+		slot = (method - NV097_SET_TEXGEN_R) / 16;
+		unsigned int reg = (slot < 2) ? NV_PGRAPH_CSV1_A
+			: NV_PGRAPH_CSV1_B;
+		unsigned int mask = (slot % 2) ? NV_PGRAPH_CSV1_A_T1_R
+			: NV_PGRAPH_CSV1_A_T0_R;
+		SET_MASK(pg->regs[reg], mask, kelvin_map_texgen(parameter, 2));
+		break;
+	}
+	CASE_4(NV097_SET_TEXGEN_Q, 16) : {
+		slot = (method - NV097_SET_TEXGEN_Q) / 16;
+		unsigned int reg = (slot < 2) ? NV_PGRAPH_CSV1_A
+			: NV_PGRAPH_CSV1_B;
+		unsigned int mask = (slot % 2) ? NV_PGRAPH_CSV1_A_T1_Q
+			: NV_PGRAPH_CSV1_A_T0_Q;
+		SET_MASK(pg->regs[reg], mask, kelvin_map_texgen(parameter, 3));
+		break;
+	}
+	CASE_4(NV097_SET_TEXTURE_MATRIX_ENABLE, 4) :
+		slot = (method - NV097_SET_TEXTURE_MATRIX_ENABLE) / 4;
+		pg->texture_matrix_enable[slot] = parameter;
+		break;
+
+	CASE_3(NV097_SET_FOG_PARAMS, 4) :
+		slot = (method - NV097_SET_FOG_PARAMS) / 4;
+		pg->regs[NV_PGRAPH_FOGPARAM0 + slot * 4] = parameter;
+		/* Cxbx note: slot = 2 is right after slot = 1 */
+		pg->ltctxa[NV_IGRAPH_XF_LTCTXA_FOG_K][slot] = parameter;
+		pg->ltctxa_dirty[NV_IGRAPH_XF_LTCTXA_FOG_K] = true;
+		break;
+
+	case NV097_SET_TEXGEN_VIEW_MODEL:
+		SET_MASK(pg->regs[NV_PGRAPH_CSV0_D], NV_PGRAPH_CSV0_D_TEXGEN_REF,
+			parameter);
+		break;
+
+	CASE_4(NV097_SET_FOG_PLANE, 4):
+		slot = (method - NV097_SET_FOG_PLANE) / 4;
+		pg->vsh_constants[NV_IGRAPH_XF_XFCTX_FOG][slot] = parameter;
+		pg->vsh_constants_dirty[NV_IGRAPH_XF_XFCTX_FOG] = true;
+		break;
+
+	CASE_3(NV097_SET_SCENE_AMBIENT_COLOR, 4):
+		slot = (method - NV097_SET_SCENE_AMBIENT_COLOR) / 4;
+		// ??
+		pg->ltctxa[NV_IGRAPH_XF_LTCTXA_FR_AMB][slot] = parameter;
+		pg->ltctxa_dirty[NV_IGRAPH_XF_LTCTXA_FR_AMB] = true;
+		break;
+
+	CASE_4(NV097_SET_VIEWPORT_OFFSET, 4):
+		slot = (method - NV097_SET_VIEWPORT_OFFSET) / 4;
+		pg->vsh_constants[NV_IGRAPH_XF_XFCTX_VPOFF][slot] = parameter;
+		pg->vsh_constants_dirty[NV_IGRAPH_XF_XFCTX_VPOFF] = true;
+		break;
+
+	CASE_4(NV097_SET_EYE_POSITION, 4):
+		slot = (method - NV097_SET_EYE_POSITION) / 4;
+		pg->vsh_constants[NV_IGRAPH_XF_XFCTX_EYEP][slot] = parameter;
+		pg->vsh_constants_dirty[NV_IGRAPH_XF_XFCTX_EYEP] = true;
+		break;
+
+	CASE_8(NV097_SET_COMBINER_FACTOR0, 4):
+		slot = (method - NV097_SET_COMBINER_FACTOR0) / 4;
+		pg->regs[NV_PGRAPH_COMBINEFACTOR0 + slot * 4] = parameter;
+		break;
+
+	CASE_8(NV097_SET_COMBINER_FACTOR1, 4):
+		slot = (method - NV097_SET_COMBINER_FACTOR1) / 4;
+		pg->regs[NV_PGRAPH_COMBINEFACTOR1 + slot * 4] = parameter;
+		break;
+
+	CASE_8(NV097_SET_COMBINER_ALPHA_OCW, 4):
+		slot = (method - NV097_SET_COMBINER_ALPHA_OCW) / 4;
+		pg->regs[NV_PGRAPH_COMBINEALPHAO0 + slot * 4] = parameter;
+		break;
+
+	CASE_8(NV097_SET_COMBINER_COLOR_ICW, 4):
+		slot = (method - NV097_SET_COMBINER_COLOR_ICW) / 4;
+		pg->regs[NV_PGRAPH_COMBINECOLORI0 + slot * 4] = parameter;
+		break;
+
+	CASE_4(NV097_SET_VIEWPORT_SCALE, 4):
+		slot = (method - NV097_SET_VIEWPORT_SCALE) / 4;
+		pg->vsh_constants[NV_IGRAPH_XF_XFCTX_VPSCL][slot] = parameter;
+		pg->vsh_constants_dirty[NV_IGRAPH_XF_XFCTX_VPSCL] = true;
+		break;
+
+	CASE_3(NV097_SET_VERTEX3F, 4) : {
+		slot = (method - NV097_SET_VERTEX3F) / 4;
+		VertexAttribute *vertex_attribute =
+			&pg->vertex_attributes[NV2A_VERTEX_ATTR_POSITION];
+		pgraph_allocate_inline_buffer_vertices(pg, NV2A_VERTEX_ATTR_POSITION);
+		vertex_attribute->inline_value[slot] = *(float*)&parameter;
+		vertex_attribute->inline_value[3] = 1.0f;
+		if (slot == 2) {
+			pgraph_finish_inline_buffer_vertex(pg);
 		}
-		CASE_4(NV097_SET_TEXGEN_R, 16) : {
-			slot = (method - NV097_SET_TEXGEN_R) / 16;
-			unsigned int reg = (slot < 2) ? NV_PGRAPH_CSV1_A
-				: NV_PGRAPH_CSV1_B;
-			unsigned int mask = (slot % 2) ? NV_PGRAPH_CSV1_A_T1_R
-				: NV_PGRAPH_CSV1_A_T0_R;
-			SET_MASK(pg->regs[reg], mask, kelvin_map_texgen(parameter, 2));
+		break;
+	}
+
+	/* Handles NV097_SET_BACK_LIGHT_* */
+	CASE_128(NV097_SET_BACK_LIGHT_AMBIENT_COLOR, 4): {
+		slot = (method - NV097_SET_BACK_LIGHT_AMBIENT_COLOR) / 4;
+		unsigned int part = NV097_SET_BACK_LIGHT_AMBIENT_COLOR / 4 + slot % 16;
+		slot /= 16; /* [Light index] */
+		assert(slot < 8);
+		switch(part * 4) {
+		CASE_3(NV097_SET_BACK_LIGHT_AMBIENT_COLOR, 4):
+			part -= NV097_SET_BACK_LIGHT_AMBIENT_COLOR / 4;
+			pg->ltctxb[NV_IGRAPH_XF_LTCTXB_L0_BAMB + slot*6][part] = parameter;
+			pg->ltctxb_dirty[NV_IGRAPH_XF_LTCTXB_L0_BAMB + slot*6] = true;
+			break;
+		CASE_3(NV097_SET_BACK_LIGHT_DIFFUSE_COLOR, 4):
+			part -= NV097_SET_BACK_LIGHT_DIFFUSE_COLOR / 4;
+			pg->ltctxb[NV_IGRAPH_XF_LTCTXB_L0_BDIF + slot*6][part] = parameter;
+			pg->ltctxb_dirty[NV_IGRAPH_XF_LTCTXB_L0_BDIF + slot*6] = true;
+			break;
+		CASE_3(NV097_SET_BACK_LIGHT_SPECULAR_COLOR, 4):
+			part -= NV097_SET_BACK_LIGHT_SPECULAR_COLOR / 4;
+			pg->ltctxb[NV_IGRAPH_XF_LTCTXB_L0_BSPC + slot*6][part] = parameter;
+			pg->ltctxb_dirty[NV_IGRAPH_XF_LTCTXB_L0_BSPC + slot*6] = true;
 			break;
-		}
-		CASE_4(NV097_SET_TEXGEN_Q, 16) : {
-			slot = (method - NV097_SET_TEXGEN_Q) / 16;
-			unsigned int reg = (slot < 2) ? NV_PGRAPH_CSV1_A
-				: NV_PGRAPH_CSV1_B;
-			unsigned int mask = (slot % 2) ? NV_PGRAPH_CSV1_A_T1_Q
-				: NV_PGRAPH_CSV1_A_T0_Q;
-			SET_MASK(pg->regs[reg], mask, kelvin_map_texgen(parameter, 3));
+		default:
+			assert(false);
 			break;
 		}
-		CASE_4(NV097_SET_TEXTURE_MATRIX_ENABLE, 4) :
-			slot = (method - NV097_SET_TEXTURE_MATRIX_ENABLE) / 4;
-			pg->texture_matrix_enable[slot] = parameter;
+		break;
+	}
+	/* Handles all the light source props except for NV097_SET_BACK_LIGHT_* */
+	CASE_256(NV097_SET_LIGHT_AMBIENT_COLOR, 4): {
+		slot = (method - NV097_SET_LIGHT_AMBIENT_COLOR) / 4;
+		unsigned int part = NV097_SET_LIGHT_AMBIENT_COLOR / 4 + slot % 32;
+		slot /= 32; /* [Light index] */
+		assert(slot < 8);
+		switch(part * 4) {
+		CASE_3(NV097_SET_LIGHT_AMBIENT_COLOR, 4):
+			part -= NV097_SET_LIGHT_AMBIENT_COLOR / 4;
+			pg->ltctxb[NV_IGRAPH_XF_LTCTXB_L0_AMB + slot*6][part] = parameter;
+			pg->ltctxb_dirty[NV_IGRAPH_XF_LTCTXB_L0_AMB + slot*6] = true;
+			break;
+		CASE_3(NV097_SET_LIGHT_DIFFUSE_COLOR, 4):
+			part -= NV097_SET_LIGHT_DIFFUSE_COLOR / 4;
+			pg->ltctxb[NV_IGRAPH_XF_LTCTXB_L0_DIF + slot*6][part] = parameter;
+			pg->ltctxb_dirty[NV_IGRAPH_XF_LTCTXB_L0_DIF + slot*6] = true;
+			break;
+		CASE_3(NV097_SET_LIGHT_SPECULAR_COLOR, 4):
+			part -= NV097_SET_LIGHT_SPECULAR_COLOR / 4;
+			pg->ltctxb[NV_IGRAPH_XF_LTCTXB_L0_SPC + slot*6][part] = parameter;
+			pg->ltctxb_dirty[NV_IGRAPH_XF_LTCTXB_L0_SPC + slot*6] = true;
+			break;
+		case NV097_SET_LIGHT_LOCAL_RANGE:
+			pg->ltc1[NV_IGRAPH_XF_LTC1_r0 + slot][0] = parameter;
+			pg->ltc1_dirty[NV_IGRAPH_XF_LTC1_r0 + slot] = true;
+			break;
+		CASE_3(NV097_SET_LIGHT_INFINITE_HALF_VECTOR, 4):
+			part -= NV097_SET_LIGHT_INFINITE_HALF_VECTOR / 4;
+			pg->light_infinite_half_vector[slot][part] = *(float*)&parameter;
+			break;
+		CASE_3(NV097_SET_LIGHT_INFINITE_DIRECTION, 4):
+			part -= NV097_SET_LIGHT_INFINITE_DIRECTION / 4;
+			pg->light_infinite_direction[slot][part] = *(float*)&parameter;
+			break;
+		CASE_3(NV097_SET_LIGHT_SPOT_FALLOFF, 4):
+			part -= NV097_SET_LIGHT_SPOT_FALLOFF / 4;
+			pg->ltctxa[NV_IGRAPH_XF_LTCTXA_L0_K + slot*2][part] = parameter;
+			pg->ltctxa_dirty[NV_IGRAPH_XF_LTCTXA_L0_K + slot*2] = true;
+			break;
+		CASE_4(NV097_SET_LIGHT_SPOT_DIRECTION, 4):
+			part -= NV097_SET_LIGHT_SPOT_DIRECTION / 4;
+			pg->ltctxa[NV_IGRAPH_XF_LTCTXA_L0_SPT + slot*2][part] = parameter;
+			pg->ltctxa_dirty[NV_IGRAPH_XF_LTCTXA_L0_SPT + slot*2] = true;
+			break;
+		CASE_3(NV097_SET_LIGHT_LOCAL_POSITION, 4):
+			part -= NV097_SET_LIGHT_LOCAL_POSITION / 4;
+			pg->light_local_position[slot][part] = *(float*)&parameter;
+			break;
+		CASE_3(NV097_SET_LIGHT_LOCAL_ATTENUATION, 4):
+			part -= NV097_SET_LIGHT_LOCAL_ATTENUATION / 4;
+			pg->light_local_attenuation[slot][part] = *(float*)&parameter;
 			break;
-
-		CASE_16(NV097_SET_PROJECTION_MATRIX, 4) : {
-			slot = (method - NV097_SET_PROJECTION_MATRIX) / 4;
-			// pg->projection_matrix[slot] = *(float*)&parameter;
-			unsigned int row = NV_IGRAPH_XF_XFCTX_PMAT0 + slot / 4;
-			pg->vsh_constants[row][slot % 4] = parameter;
-			pg->vsh_constants_dirty[row] = true;
+		default:
+			assert(false);
 			break;
 		}
+		break;
+	}
 
-		CASE_64(NV097_SET_MODEL_VIEW_MATRIX, 4) : {
-			slot = (method - NV097_SET_MODEL_VIEW_MATRIX) / 4;
-			unsigned int matnum = slot / 16;
-			unsigned int entry = slot % 16;
-			unsigned int row = NV_IGRAPH_XF_XFCTX_MMAT0 + matnum * 8 + entry / 4;
-			pg->vsh_constants[row][entry % 4] = parameter;
-			pg->vsh_constants_dirty[row] = true;
-			break;
+	CASE_4(NV097_SET_VERTEX4F, 4): {
+		slot = (method - NV097_SET_VERTEX4F) / 4;
+		VertexAttribute *vertex_attribute =
+			&pg->vertex_attributes[NV2A_VERTEX_ATTR_POSITION];
+		pgraph_allocate_inline_buffer_vertices(pg, NV2A_VERTEX_ATTR_POSITION);
+		vertex_attribute->inline_value[slot] = *(float*)&parameter;
+		if (slot == 3) {
+			pgraph_finish_inline_buffer_vertex(pg);
 		}
+		break;
+	}
 
-		CASE_64(NV097_SET_INVERSE_MODEL_VIEW_MATRIX, 4) : {
-			slot = (method - NV097_SET_INVERSE_MODEL_VIEW_MATRIX) / 4;
-			unsigned int matnum = slot / 16;
-			unsigned int entry = slot % 16;
-			unsigned int row = NV_IGRAPH_XF_XFCTX_IMMAT0 + matnum * 8 + entry / 4;
-			pg->vsh_constants[row][entry % 4] = parameter;
-			pg->vsh_constants_dirty[row] = true;
+	CASE_16(NV097_SET_VERTEX_DATA_ARRAY_FORMAT, 4): {
+
+		slot = (method - NV097_SET_VERTEX_DATA_ARRAY_FORMAT) / 4;
+		VertexAttribute *vertex_attribute = &pg->vertex_attributes[slot];
+
+		vertex_attribute->format =
+			GET_MASK(parameter, NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE);
+		vertex_attribute->count =
+			GET_MASK(parameter, NV097_SET_VERTEX_DATA_ARRAY_FORMAT_SIZE);
+		vertex_attribute->stride =
+			GET_MASK(parameter, NV097_SET_VERTEX_DATA_ARRAY_FORMAT_STRIDE);
+
+		NV2A_DPRINTF("vertex data array format=%d, count=%d, stride=%d\n",
+			vertex_attribute->format,
+			vertex_attribute->count,
+			vertex_attribute->stride);
+
+		vertex_attribute->gl_count = vertex_attribute->count;
+
+		switch (vertex_attribute->format) {
+		case NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE_UB_D3D:
+			vertex_attribute->gl_type = GL_UNSIGNED_BYTE;
+			vertex_attribute->gl_normalize = GL_TRUE;
+			vertex_attribute->size = 1;
+			assert(vertex_attribute->count == 4);
+			// https://www.opengl.org/registry/specs/ARB/vertex_array_bgra.txt
+			vertex_attribute->gl_count = GL_BGRA;
+			vertex_attribute->needs_conversion = false;
+			break;
+		case NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE_UB_OGL:
+			vertex_attribute->gl_type = GL_UNSIGNED_BYTE;
+			vertex_attribute->gl_normalize = GL_TRUE;
+			vertex_attribute->size = 1;
+			vertex_attribute->needs_conversion = false;
+			break;
+		case NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE_S1:
+			vertex_attribute->gl_type = GL_SHORT;
+			vertex_attribute->gl_normalize = GL_TRUE;
+			vertex_attribute->size = 2;
+			vertex_attribute->needs_conversion = false;
+			break;
+		case NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE_F:
+			vertex_attribute->gl_type = GL_FLOAT;
+			vertex_attribute->gl_normalize = GL_FALSE;
+			vertex_attribute->size = 4;
+			vertex_attribute->needs_conversion = false;
+			break;
+		case NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE_S32K:
+			vertex_attribute->gl_type = GL_SHORT;
+			vertex_attribute->gl_normalize = GL_FALSE;
+			vertex_attribute->size = 2;
+			vertex_attribute->needs_conversion = false;
+			break;
+		case NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE_CMP:
+			/* 3 signed, normalized components packed in 32-bits. (11,11,10) */
+			vertex_attribute->size = 4;
+			vertex_attribute->gl_type = GL_FLOAT;
+			vertex_attribute->gl_normalize = GL_FALSE;
+			vertex_attribute->needs_conversion = true;
+			vertex_attribute->converted_size = sizeof(float);
+			vertex_attribute->converted_count = 3 * vertex_attribute->count;
 			break;
-		}
-
-		CASE_16(NV097_SET_COMPOSITE_MATRIX, 4) : {
-			slot = (method - NV097_SET_COMPOSITE_MATRIX) / 4;
-			unsigned int row = NV_IGRAPH_XF_XFCTX_CMAT0 + slot / 4;
-			pg->vsh_constants[row][slot % 4] = parameter;
-			pg->vsh_constants_dirty[row] = true;
+		default:
+			fprintf(stderr, "Unknown vertex type: 0x%x\n", vertex_attribute->format);
+			assert(false);
 			break;
 		}
 
-		CASE_64(NV097_SET_TEXTURE_MATRIX, 4) : {
-			slot = (method - NV097_SET_TEXTURE_MATRIX) / 4;
-			unsigned int tex = slot / 16;
-			unsigned int entry = slot % 16;
-			unsigned int row = NV_IGRAPH_XF_XFCTX_T0MAT + tex * 8 + entry / 4;
-			pg->vsh_constants[row][entry % 4] = parameter;
-			pg->vsh_constants_dirty[row] = true;
-			break;
+		if (vertex_attribute->needs_conversion) {
+			vertex_attribute->converted_elements = 0;
+		} else {
+			if (vertex_attribute->converted_buffer) {
+				g_free(vertex_attribute->converted_buffer);
+				vertex_attribute->converted_buffer = NULL;
+			}
 		}
 
-		CASE_3(NV097_SET_FOG_PARAMS, 4) :
-			slot = (method - NV097_SET_FOG_PARAMS) / 4;
-			pg->regs[NV_PGRAPH_FOGPARAM0 + slot * 4] = parameter;
-			/* Cxbx note: slot = 2 is right after slot = 1 */
-			pg->ltctxa[NV_IGRAPH_XF_LTCTXA_FOG_K][slot] = parameter;
-			pg->ltctxa_dirty[NV_IGRAPH_XF_LTCTXA_FOG_K] = true;
-			break;
+		break;
+	}
 
-		/* Handles NV097_SET_TEXGEN_PLANE_S,T,R,Q */
-		CASE_64(NV097_SET_TEXGEN_PLANE_S, 4) : {
-			slot = (method - NV097_SET_TEXGEN_PLANE_S) / 4;
-			unsigned int tex = slot / 16;
-			unsigned int entry = slot % 16;
-			unsigned int row = NV_IGRAPH_XF_XFCTX_TG0MAT + tex * 8 + entry / 4;
-			pg->vsh_constants[row][entry % 4] = parameter;
-			pg->vsh_constants_dirty[row] = true;
-			break;
+	CASE_16(NV097_SET_VERTEX_DATA_ARRAY_OFFSET, 4): {
+
+		slot = (method - NV097_SET_VERTEX_DATA_ARRAY_OFFSET) / 4;
+
+		pg->vertex_attributes[slot].dma_select =
+			parameter & 0x80000000;
+		pg->vertex_attributes[slot].offset =
+			parameter & 0x7fffffff;
+
+		pg->vertex_attributes[slot].converted_elements = 0;
+
+		break;
+	}
+
+	case NV097_SET_LOGIC_OP_ENABLE:
+		SET_MASK(pg->regs[NV_PGRAPH_BLEND],
+				 NV_PGRAPH_BLEND_LOGICOP_ENABLE, parameter);
+		break;
+
+	case NV097_SET_LOGIC_OP:
+		SET_MASK(pg->regs[NV_PGRAPH_BLEND],
+				 NV_PGRAPH_BLEND_LOGICOP, parameter & 0xF);
+		break;
+
+	case NV097_CLEAR_REPORT_VALUE:
+
+		/* FIXME: Does this have a value in parameter? Also does this (also?) modify
+		 *        the report memory block?
+		 */
+		if (pg->gl_zpass_pixel_count_query_count) {
+			if (pg->opengl_enabled) {
+				glDeleteQueries(pg->gl_zpass_pixel_count_query_count,
+								pg->gl_zpass_pixel_count_queries);
+			}
+			pg->gl_zpass_pixel_count_query_count = 0;
 		}
+		pg->zpass_pixel_count_result = 0;
 
-		case NV097_SET_TEXGEN_VIEW_MODEL:
-			SET_MASK(pg->regs[NV_PGRAPH_CSV0_D], NV_PGRAPH_CSV0_D_TEXGEN_REF,
-				parameter);
-			break;
+		break;
 
-		CASE_4(NV097_SET_FOG_PLANE, 4):
-			slot = (method - NV097_SET_FOG_PLANE) / 4;
-			pg->vsh_constants[NV_IGRAPH_XF_XFCTX_FOG][slot] = parameter;
-			pg->vsh_constants_dirty[NV_IGRAPH_XF_XFCTX_FOG] = true;
-			break;
+	case NV097_SET_ZPASS_PIXEL_COUNT_ENABLE:
+		pg->zpass_pixel_count_enable = parameter;
+		break;
 
-		CASE_3(NV097_SET_SCENE_AMBIENT_COLOR, 4):
-			slot = (method - NV097_SET_SCENE_AMBIENT_COLOR) / 4;
-			// ??
-			pg->ltctxa[NV_IGRAPH_XF_LTCTXA_FR_AMB][slot] = parameter;
-			pg->ltctxa_dirty[NV_IGRAPH_XF_LTCTXA_FR_AMB] = true;
-			break;
+	case NV097_GET_REPORT: {
+		/* FIXME: This was first intended to be watchpoint-based. However,
+		 *        qemu / kvm only supports virtual-address watchpoints.
+		 *        This'll do for now, but accuracy and performance with other
+		 *        approaches could be better
+		 */
+		uint8_t type = GET_MASK(parameter, NV097_GET_REPORT_TYPE);
+		assert(type == NV097_GET_REPORT_TYPE_ZPASS_PIXEL_CNT);
+		hwaddr offset = GET_MASK(parameter, NV097_GET_REPORT_OFFSET);
 
-		CASE_4(NV097_SET_VIEWPORT_OFFSET, 4):
-			slot = (method - NV097_SET_VIEWPORT_OFFSET) / 4;
-			pg->vsh_constants[NV_IGRAPH_XF_XFCTX_VPOFF][slot] = parameter;
-			pg->vsh_constants_dirty[NV_IGRAPH_XF_XFCTX_VPOFF] = true;
-			break;
+		uint64_t timestamp = 0x0011223344556677; /* FIXME: Update timestamp?! */
+		uint32_t done = 0;
 
-		CASE_4(NV097_SET_EYE_POSITION, 4):
-			slot = (method - NV097_SET_EYE_POSITION) / 4;
-			pg->vsh_constants[NV_IGRAPH_XF_XFCTX_EYEP][slot] = parameter;
-			pg->vsh_constants_dirty[NV_IGRAPH_XF_XFCTX_EYEP] = true;
-			break;
+		if (pg->opengl_enabled) {
+			/* FIXME: Multisampling affects this (both: OGL and Xbox GPU),
+			 *        not sure if CLEARs also count
+			 */
+			/* FIXME: What about clipping regions etc? */
+			for(i = 0; i < pg->gl_zpass_pixel_count_query_count; i++) {
+				GLuint gl_query_result;
+				glGetQueryObjectuiv(pg->gl_zpass_pixel_count_queries[i],
+									GL_QUERY_RESULT,
+									&gl_query_result);
+				pg->zpass_pixel_count_result += gl_query_result;
+			}
+			if (pg->gl_zpass_pixel_count_query_count) {
+				glDeleteQueries(pg->gl_zpass_pixel_count_query_count,
+								pg->gl_zpass_pixel_count_queries);
+			}
+			pg->gl_zpass_pixel_count_query_count = 0;
 
-		CASE_8(NV097_SET_COMBINER_FACTOR0, 4):
-			slot = (method - NV097_SET_COMBINER_FACTOR0) / 4;
-			pg->regs[NV_PGRAPH_COMBINEFACTOR0 + slot * 4] = parameter;
-			break;
+			hwaddr report_dma_len;
+			uint8_t *report_data = (uint8_t*)nv_dma_map(d, pg->dma_report,
+														&report_dma_len);
+			assert(offset < report_dma_len);
+			report_data += offset;
 
-		CASE_8(NV097_SET_COMBINER_FACTOR1, 4):
-			slot = (method - NV097_SET_COMBINER_FACTOR1) / 4;
-			pg->regs[NV_PGRAPH_COMBINEFACTOR1 + slot * 4] = parameter;
-			break;
+			stq_le_p((uint64_t*)&report_data[0], timestamp);
+			stl_le_p((uint32_t*)&report_data[8], pg->zpass_pixel_count_result);
+			stl_le_p((uint32_t*)&report_data[12], done);
+		}
 
-		CASE_8(NV097_SET_COMBINER_ALPHA_OCW, 4):
-			slot = (method - NV097_SET_COMBINER_ALPHA_OCW) / 4;
-			pg->regs[NV_PGRAPH_COMBINEALPHAO0 + slot * 4] = parameter;
-			break;
+		break;
+	}
 
-		CASE_8(NV097_SET_COMBINER_COLOR_ICW, 4):
-			slot = (method - NV097_SET_COMBINER_COLOR_ICW) / 4;
-			pg->regs[NV_PGRAPH_COMBINECOLORI0 + slot * 4] = parameter;
-			break;
+	CASE_3(NV097_SET_EYE_DIRECTION, 4):
+		slot = (method - NV097_SET_EYE_DIRECTION) / 4;
+		pg->ltctxa[NV_IGRAPH_XF_LTCTXA_EYED][slot] = parameter;
+		pg->ltctxa_dirty[NV_IGRAPH_XF_LTCTXA_EYED] = true;
+		break;
 
-		CASE_4(NV097_SET_VIEWPORT_SCALE, 4):
-			slot = (method - NV097_SET_VIEWPORT_SCALE) / 4;
-			pg->vsh_constants[NV_IGRAPH_XF_XFCTX_VPSCL][slot] = parameter;
-			pg->vsh_constants_dirty[NV_IGRAPH_XF_XFCTX_VPSCL] = true;
-			break;
+	case NV097_SET_BEGIN_END: {
+		uint32_t control_0 = pg->regs[NV_PGRAPH_CONTROL_0];
+		uint32_t control_1 = pg->regs[NV_PGRAPH_CONTROL_1];
 
-		CASE_32(NV097_SET_TRANSFORM_PROGRAM, 4) : {
+		bool depth_test = control_0
+			& NV_PGRAPH_CONTROL_0_ZENABLE;
+		bool stencil_test = control_1
+			& NV_PGRAPH_CONTROL_1_STENCIL_TEST_ENABLE;
 
-			slot = (method - NV097_SET_TRANSFORM_PROGRAM) / 4;
+		if (parameter == NV097_SET_BEGIN_END_OP_END) {
 
-			int program_load = GET_MASK(pg->regs[NV_PGRAPH_CHEOPS_OFFSET],
-				NV_PGRAPH_CHEOPS_OFFSET_PROG_LD_PTR);
+			if (pg->draw_arrays_length) {
 
-			assert(program_load < NV2A_MAX_TRANSFORM_PROGRAM_LENGTH);
-			pg->program_data[program_load][slot % 4] = parameter;
+				NV2A_GL_DPRINTF(false, "Draw Arrays");
 
-			if (slot % 4 == 3) {
-				SET_MASK(pg->regs[NV_PGRAPH_CHEOPS_OFFSET],
-					NV_PGRAPH_CHEOPS_OFFSET_PROG_LD_PTR, program_load + 1);
-			}
+				assert(pg->inline_buffer_length == 0);
+				assert(pg->inline_array_length == 0);
+				assert(pg->inline_elements_length == 0);
 
-			break;
-		}
+				if (pgraph_draw_arrays != nullptr) {
+					pgraph_draw_arrays(d);
+				}
+			} else if (pg->inline_buffer_length) {
 
-		CASE_32(NV097_SET_TRANSFORM_CONSTANT, 4): {
+				NV2A_GL_DPRINTF(false, "Inline Buffer");
 
-			slot = (method - NV097_SET_TRANSFORM_CONSTANT) / 4;
+				assert(pg->draw_arrays_length == 0);
+				assert(pg->inline_array_length == 0);
+				assert(pg->inline_elements_length == 0);
 
-			int const_load = GET_MASK(pg->regs[NV_PGRAPH_CHEOPS_OFFSET],
-									  NV_PGRAPH_CHEOPS_OFFSET_CONST_LD_PTR);
+				if (pgraph_draw_inline_buffer != nullptr) {
+					pgraph_draw_inline_buffer(d);
+				}
+			} else if (pg->inline_array_length) {
 
-			assert(const_load < NV2A_VERTEXSHADER_CONSTANTS);
-			// VertexShaderConstant *vsh_constant = &pg->vsh_constants[const_load];
-			pg->vsh_constants_dirty[const_load] |=
-				(parameter != pg->vsh_constants[const_load][slot%4]);
-			pg->vsh_constants[const_load][slot%4] = parameter;
+				NV2A_GL_DPRINTF(false, "Inline Array");
 
-			if (slot % 4 == 3) {
-				SET_MASK(pg->regs[NV_PGRAPH_CHEOPS_OFFSET],
-						 NV_PGRAPH_CHEOPS_OFFSET_CONST_LD_PTR, const_load+1);
-			}
-			break;
-		}
+				assert(pg->draw_arrays_length == 0);
+				assert(pg->inline_buffer_length == 0);
+				assert(pg->inline_elements_length == 0);
 
-		CASE_3(NV097_SET_VERTEX3F, 4) : {
-			slot = (method - NV097_SET_VERTEX3F) / 4;
-			VertexAttribute *vertex_attribute =
-				&pg->vertex_attributes[NV2A_VERTEX_ATTR_POSITION];
-			pgraph_allocate_inline_buffer_vertices(pg, NV2A_VERTEX_ATTR_POSITION);
-			vertex_attribute->inline_value[slot] = *(float*)&parameter;
-			vertex_attribute->inline_value[3] = 1.0f;
-			if (slot == 2) {
-				pgraph_finish_inline_buffer_vertex(pg);
-			}
-			break;
-		}
+				if (pgraph_draw_inline_array != nullptr) {
+					pgraph_draw_inline_array(d);
+				}
+			} else if (pg->inline_elements_length) {
 
-		/* Handles NV097_SET_BACK_LIGHT_* */
-		CASE_128(NV097_SET_BACK_LIGHT_AMBIENT_COLOR, 4): {
-			slot = (method - NV097_SET_BACK_LIGHT_AMBIENT_COLOR) / 4;
-			unsigned int part = NV097_SET_BACK_LIGHT_AMBIENT_COLOR / 4 + slot % 16;
-			slot /= 16; /* [Light index] */
-			assert(slot < 8);
-			switch(part * 4) {
-			CASE_3(NV097_SET_BACK_LIGHT_AMBIENT_COLOR, 4):
-				part -= NV097_SET_BACK_LIGHT_AMBIENT_COLOR / 4;
-				pg->ltctxb[NV_IGRAPH_XF_LTCTXB_L0_BAMB + slot*6][part] = parameter;
-				pg->ltctxb_dirty[NV_IGRAPH_XF_LTCTXB_L0_BAMB + slot*6] = true;
-				break;
-			CASE_3(NV097_SET_BACK_LIGHT_DIFFUSE_COLOR, 4):
-				part -= NV097_SET_BACK_LIGHT_DIFFUSE_COLOR / 4;
-				pg->ltctxb[NV_IGRAPH_XF_LTCTXB_L0_BDIF + slot*6][part] = parameter;
-				pg->ltctxb_dirty[NV_IGRAPH_XF_LTCTXB_L0_BDIF + slot*6] = true;
-				break;
-			CASE_3(NV097_SET_BACK_LIGHT_SPECULAR_COLOR, 4):
-				part -= NV097_SET_BACK_LIGHT_SPECULAR_COLOR / 4;
-				pg->ltctxb[NV_IGRAPH_XF_LTCTXB_L0_BSPC + slot*6][part] = parameter;
-				pg->ltctxb_dirty[NV_IGRAPH_XF_LTCTXB_L0_BSPC + slot*6] = true;
-				break;
-			default:
-				assert(false);
-				break;
-			}
-			break;
-		}
-		/* Handles all the light source props except for NV097_SET_BACK_LIGHT_* */
-		CASE_256(NV097_SET_LIGHT_AMBIENT_COLOR, 4): {
-			slot = (method - NV097_SET_LIGHT_AMBIENT_COLOR) / 4;
-			unsigned int part = NV097_SET_LIGHT_AMBIENT_COLOR / 4 + slot % 32;
-			slot /= 32; /* [Light index] */
-			assert(slot < 8);
-			switch(part * 4) {
-			CASE_3(NV097_SET_LIGHT_AMBIENT_COLOR, 4):
-				part -= NV097_SET_LIGHT_AMBIENT_COLOR / 4;
-				pg->ltctxb[NV_IGRAPH_XF_LTCTXB_L0_AMB + slot*6][part] = parameter;
-				pg->ltctxb_dirty[NV_IGRAPH_XF_LTCTXB_L0_AMB + slot*6] = true;
-				break;
-			CASE_3(NV097_SET_LIGHT_DIFFUSE_COLOR, 4):
-				part -= NV097_SET_LIGHT_DIFFUSE_COLOR / 4;
-				pg->ltctxb[NV_IGRAPH_XF_LTCTXB_L0_DIF + slot*6][part] = parameter;
-				pg->ltctxb_dirty[NV_IGRAPH_XF_LTCTXB_L0_DIF + slot*6] = true;
-				break;
-			CASE_3(NV097_SET_LIGHT_SPECULAR_COLOR, 4):
-				part -= NV097_SET_LIGHT_SPECULAR_COLOR / 4;
-				pg->ltctxb[NV_IGRAPH_XF_LTCTXB_L0_SPC + slot*6][part] = parameter;
-				pg->ltctxb_dirty[NV_IGRAPH_XF_LTCTXB_L0_SPC + slot*6] = true;
-				break;
-			case NV097_SET_LIGHT_LOCAL_RANGE:
-				pg->ltc1[NV_IGRAPH_XF_LTC1_r0 + slot][0] = parameter;
-				pg->ltc1_dirty[NV_IGRAPH_XF_LTC1_r0 + slot] = true;
-				break;
-			CASE_3(NV097_SET_LIGHT_INFINITE_HALF_VECTOR, 4):
-				part -= NV097_SET_LIGHT_INFINITE_HALF_VECTOR / 4;
-				pg->light_infinite_half_vector[slot][part] = *(float*)&parameter;
-				break;
-			CASE_3(NV097_SET_LIGHT_INFINITE_DIRECTION, 4):
-				part -= NV097_SET_LIGHT_INFINITE_DIRECTION / 4;
-				pg->light_infinite_direction[slot][part] = *(float*)&parameter;
-				break;
-			CASE_3(NV097_SET_LIGHT_SPOT_FALLOFF, 4):
-				part -= NV097_SET_LIGHT_SPOT_FALLOFF / 4;
-				pg->ltctxa[NV_IGRAPH_XF_LTCTXA_L0_K + slot*2][part] = parameter;
-				pg->ltctxa_dirty[NV_IGRAPH_XF_LTCTXA_L0_K + slot*2] = true;
-				break;
-			CASE_4(NV097_SET_LIGHT_SPOT_DIRECTION, 4):
-				part -= NV097_SET_LIGHT_SPOT_DIRECTION / 4;
-				pg->ltctxa[NV_IGRAPH_XF_LTCTXA_L0_SPT + slot*2][part] = parameter;
-				pg->ltctxa_dirty[NV_IGRAPH_XF_LTCTXA_L0_SPT + slot*2] = true;
-				break;
-			CASE_3(NV097_SET_LIGHT_LOCAL_POSITION, 4):
-				part -= NV097_SET_LIGHT_LOCAL_POSITION / 4;
-				pg->light_local_position[slot][part] = *(float*)&parameter;
-				break;
-			CASE_3(NV097_SET_LIGHT_LOCAL_ATTENUATION, 4):
-				part -= NV097_SET_LIGHT_LOCAL_ATTENUATION / 4;
-				pg->light_local_attenuation[slot][part] = *(float*)&parameter;
-				break;
-			default:
+				NV2A_GL_DPRINTF(false, "Inline Elements");
+
+				assert(pg->draw_arrays_length == 0);
+				assert(pg->inline_buffer_length == 0);
+				assert(pg->inline_array_length == 0);
+
+				if (pgraph_draw_inline_elements != nullptr) {
+					pgraph_draw_inline_elements(d);
+				}
+			} else {
+				NV2A_GL_DPRINTF(true, "EMPTY NV097_SET_BEGIN_END");
 				assert(false);
-				break;
 			}
-			break;
-		}
+		} else {
+
+			assert(parameter <= NV097_SET_BEGIN_END_OP_POLYGON);
+
+			pg->primitive_mode = parameter;
 
-		CASE_4(NV097_SET_VERTEX4F, 4): {
-			slot = (method - NV097_SET_VERTEX4F) / 4;
-			VertexAttribute *vertex_attribute =
-				&pg->vertex_attributes[NV2A_VERTEX_ATTR_POSITION];
-			pgraph_allocate_inline_buffer_vertices(pg, NV2A_VERTEX_ATTR_POSITION);
-			vertex_attribute->inline_value[slot] = *(float*)&parameter;
-			if (slot == 3) {
-				pgraph_finish_inline_buffer_vertex(pg);
+			if (pgraph_draw_state_update != nullptr) {
+				pgraph_draw_state_update(d);
 			}
-			break;
+
+			pg->inline_elements_length = 0;
+			pg->inline_array_length = 0;
+			pg->inline_buffer_length = 0;
+			pg->draw_arrays_length = 0;
+			pg->draw_arrays_max_count = 0;
 		}
 
-		CASE_16(NV097_SET_VERTEX_DATA_ARRAY_FORMAT, 4): {
-
-			slot = (method - NV097_SET_VERTEX_DATA_ARRAY_FORMAT) / 4;
-			VertexAttribute *vertex_attribute = &pg->vertex_attributes[slot];
-
-			vertex_attribute->format =
-				GET_MASK(parameter, NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE);
-			vertex_attribute->count =
-				GET_MASK(parameter, NV097_SET_VERTEX_DATA_ARRAY_FORMAT_SIZE);
-			vertex_attribute->stride =
-				GET_MASK(parameter, NV097_SET_VERTEX_DATA_ARRAY_FORMAT_STRIDE);
-
-			NV2A_DPRINTF("vertex data array format=%d, count=%d, stride=%d\n",
-				vertex_attribute->format,
-				vertex_attribute->count,
-				vertex_attribute->stride);
-
-			vertex_attribute->gl_count = vertex_attribute->count;
-
-			switch (vertex_attribute->format) {
-			case NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE_UB_D3D:
-				vertex_attribute->gl_type = GL_UNSIGNED_BYTE;
-				vertex_attribute->gl_normalize = GL_TRUE;
-				vertex_attribute->size = 1;
-				assert(vertex_attribute->count == 4);
-				// https://www.opengl.org/registry/specs/ARB/vertex_array_bgra.txt
-				vertex_attribute->gl_count = GL_BGRA;
-				vertex_attribute->needs_conversion = false;
-				break;
-			case NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE_UB_OGL:
-				vertex_attribute->gl_type = GL_UNSIGNED_BYTE;
-				vertex_attribute->gl_normalize = GL_TRUE;
-				vertex_attribute->size = 1;
-				vertex_attribute->needs_conversion = false;
-				break;
-			case NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE_S1:
-				vertex_attribute->gl_type = GL_SHORT;
-				vertex_attribute->gl_normalize = GL_TRUE;
-				vertex_attribute->size = 2;
-				vertex_attribute->needs_conversion = false;
-				break;
-			case NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE_F:
-				vertex_attribute->gl_type = GL_FLOAT;
-				vertex_attribute->gl_normalize = GL_FALSE;
-				vertex_attribute->size = 4;
-				vertex_attribute->needs_conversion = false;
-				break;
-			case NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE_S32K:
-				vertex_attribute->gl_type = GL_SHORT;
-				vertex_attribute->gl_normalize = GL_FALSE;
-				vertex_attribute->size = 2;
-				vertex_attribute->needs_conversion = false;
-				break;
-			case NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE_CMP:
-				/* 3 signed, normalized components packed in 32-bits. (11,11,10) */
-				vertex_attribute->size = 4;
-				vertex_attribute->gl_type = GL_FLOAT;
-				vertex_attribute->gl_normalize = GL_FALSE;
-				vertex_attribute->needs_conversion = true;
-				vertex_attribute->converted_size = sizeof(float);
-				vertex_attribute->converted_count = 3 * vertex_attribute->count;
-				break;
-			default:
-				fprintf(stderr, "Unknown vertex type: 0x%x\n", vertex_attribute->format);
-				assert(false);
+		pgraph_set_surface_dirty(pg, true, depth_test || stencil_test);
+		break;
+	}
+	case NV097_ARRAY_ELEMENT16:
+		//LOG_TEST_CASE("NV2A_VB_ELEMENT_U16");	
+		// Test-case : Turok (in main menu)	
+		// Test-case : Hunter Redeemer	
+		// Test-case : Otogi (see https://github.com/Cxbx-Reloaded/Cxbx-Reloaded/pull/1113#issuecomment-385593814)
+		assert(pg->inline_elements_length < NV2A_MAX_BATCH_LENGTH);
+		pg->inline_elements[
+			pg->inline_elements_length++] = parameter & 0xFFFF;
+		pg->inline_elements[
+			pg->inline_elements_length++] = parameter >> 16;
+		break;
+	case NV097_ARRAY_ELEMENT32:
+		//LOG_TEST_CASE("NV2A_VB_ELEMENT_U32");	
+		// Test-case : Turok (in main menu)
+		assert(pg->inline_elements_length < NV2A_MAX_BATCH_LENGTH);
+		pg->inline_elements[
+			pg->inline_elements_length++] = parameter;
+		break;
+	case NV097_DRAW_ARRAYS: {
+
+		unsigned int start = GET_MASK(parameter, NV097_DRAW_ARRAYS_START_INDEX);
+		unsigned int count = GET_MASK(parameter, NV097_DRAW_ARRAYS_COUNT)+1;
+
+		pg->draw_arrays_max_count = MAX(pg->draw_arrays_max_count, start + count);
+
+		assert(pg->draw_arrays_length < ARRAY_SIZE(pg->gl_draw_arrays_start));
+
+		/* Attempt to connect primitives */
+		if (pg->draw_arrays_length > 0) {
+			unsigned int last_start =
+				pg->gl_draw_arrays_start[pg->draw_arrays_length - 1];
+			GLsizei* last_count =
+				&pg->gl_draw_arrays_count[pg->draw_arrays_length - 1];
+			if (start == (last_start + *last_count)) {
+				*last_count += count;
 				break;
 			}
+		}
 
-			if (vertex_attribute->needs_conversion) {
-				vertex_attribute->converted_elements = 0;
-			} else {
-				if (vertex_attribute->converted_buffer) {
-					g_free(vertex_attribute->converted_buffer);
-					vertex_attribute->converted_buffer = NULL;
-				}
-			}
+		pg->gl_draw_arrays_start[pg->draw_arrays_length] = start;
+		pg->gl_draw_arrays_count[pg->draw_arrays_length] = count;
+		pg->draw_arrays_length++;
+		break;
+	}
+	CASE_3(NV097_SET_EYE_VECTOR, 4):
+		slot = (method - NV097_SET_EYE_VECTOR) / 4;
+		pg->regs[NV_PGRAPH_EYEVEC0 + slot * 4] = parameter;
+		break;
 
-			break;
+	case NV097_SET_SEMAPHORE_OFFSET:
+		pg->regs[NV_PGRAPH_SEMAPHOREOFFSET] = parameter;
+		break;
+	case NV097_BACK_END_WRITE_SEMAPHORE_RELEASE: {
+		pgraph_update_surface(d, false, true, true);
+
+		//qemu_mutex_unlock(&pg->pgraph_lock);
+		//qemu_mutex_lock_iothread();
+
+		uint32_t semaphore_offset = pg->regs[NV_PGRAPH_SEMAPHOREOFFSET];
+
+		xbox::addr_xt semaphore_dma_len;
+		uint8_t *semaphore_data = (uint8_t*)nv_dma_map(d, pg->dma_semaphore,
+			&semaphore_dma_len);
+		assert(semaphore_offset < semaphore_dma_len);
+		semaphore_data += semaphore_offset;
+
+		stl_le_p((uint32_t*)semaphore_data, parameter);
+
+		//qemu_mutex_lock(&pg->pgraph_lock);
+		//qemu_mutex_unlock_iothread();
+
+		break;
+	}
+	case NV097_SET_ZSTENCIL_CLEAR_VALUE:
+		pg->regs[NV_PGRAPH_ZSTENCILCLEARVALUE] = parameter;
+		break;
+
+	case NV097_SET_COLOR_CLEAR_VALUE:
+		pg->regs[NV_PGRAPH_COLORCLEARVALUE] = parameter;
+		break;
+
+	case NV097_CLEAR_SURFACE: {
+		pg->clear_surface = parameter;
+		if (pgraph_draw_clear != nullptr) {
+			pgraph_draw_clear(d);
 		}
+		break;
+	}
+
+	case NV097_SET_CLEAR_RECT_HORIZONTAL:
+		pg->regs[NV_PGRAPH_CLEARRECTX] = parameter;
+		break;
+	case NV097_SET_CLEAR_RECT_VERTICAL:
+		pg->regs[NV_PGRAPH_CLEARRECTY] = parameter;
+		break;
+
+	CASE_2(NV097_SET_SPECULAR_FOG_FACTOR, 4) :
+		slot = (method - NV097_SET_SPECULAR_FOG_FACTOR) / 4;
+		pg->regs[NV_PGRAPH_SPECFOGFACTOR0 + slot * 4] = parameter;
+		break;
+
+	case NV097_SET_SHADER_CLIP_PLANE_MODE:
+		pg->regs[NV_PGRAPH_SHADERCLIPMODE] = parameter;
+		break;
+
+	CASE_8(NV097_SET_COMBINER_COLOR_OCW, 4) :
+		slot = (method - NV097_SET_COMBINER_COLOR_OCW) / 4;
+		pg->regs[NV_PGRAPH_COMBINECOLORO0 + slot * 4] = parameter;
+		break;
+
+	case NV097_SET_COMBINER_CONTROL:
+		pg->regs[NV_PGRAPH_COMBINECTL] = parameter;
+		break;
+
+	case NV097_SET_SHADOW_ZSLOPE_THRESHOLD:
+		pg->regs[NV_PGRAPH_SHADOWZSLOPETHRESHOLD] = parameter;
+		assert(parameter == 0x7F800000); /* FIXME: Unimplemented */
+		break;
+
+	case NV097_SET_SHADER_STAGE_PROGRAM:
+		pg->regs[NV_PGRAPH_SHADERPROG] = parameter;
+		break;
+
+	case NV097_SET_SHADER_OTHER_STAGE_INPUT:
+		pg->regs[NV_PGRAPH_SHADERCTL] = parameter;
+		break;
+
+	case NV097_SET_TRANSFORM_EXECUTION_MODE:
+		// Test-case : Whiplash
+		SET_MASK(pg->regs[NV_PGRAPH_CSV0_D], NV_PGRAPH_CSV0_D_MODE,
+			GET_MASK(parameter,
+				NV097_SET_TRANSFORM_EXECUTION_MODE_MODE));
+		SET_MASK(pg->regs[NV_PGRAPH_CSV0_D], NV_PGRAPH_CSV0_D_RANGE_MODE,
+			GET_MASK(parameter,
+				NV097_SET_TRANSFORM_EXECUTION_MODE_RANGE_MODE));
+		break;
+	case NV097_SET_TRANSFORM_PROGRAM_CXT_WRITE_EN:
+		// Test-case : Whiplash
+		pg->enable_vertex_program_write = parameter;
+		break;
+	case NV097_SET_TRANSFORM_PROGRAM_LOAD:
+		assert(parameter < NV2A_MAX_TRANSFORM_PROGRAM_LENGTH);
+		SET_MASK(pg->regs[NV_PGRAPH_CHEOPS_OFFSET],
+			NV_PGRAPH_CHEOPS_OFFSET_PROG_LD_PTR, parameter);
+		break;
+	case NV097_SET_TRANSFORM_PROGRAM_START:
+		assert(parameter < NV2A_MAX_TRANSFORM_PROGRAM_LENGTH);
+		SET_MASK(pg->regs[NV_PGRAPH_CSV0_C],
+			NV_PGRAPH_CSV0_C_CHEOPS_PROGRAM_START, parameter);
+		break;
+	case NV097_SET_TRANSFORM_CONSTANT_LOAD:
+		assert(parameter < NV2A_VERTEXSHADER_CONSTANTS);
+		SET_MASK(pg->regs[NV_PGRAPH_CHEOPS_OFFSET],
+			NV_PGRAPH_CHEOPS_OFFSET_CONST_LD_PTR, parameter);
+		NV2A_DPRINTF("load to %d\n", parameter);
+		break;
+
+	case NV097_SET_FLAT_SHADE_OP: 
+		assert(parameter <= 1);
+		// TODO : value & 1 = first/last? vertex selection for glShaderMode(GL_FLAT)
+		break;
+	default:
+		NV2A_GL_DPRINTF(true, "    unhandled  (0x%02x 0x%08x)",
+				NV_KELVIN_PRIMITIVE, method);
+		break;
+	}
+}
 
-		CASE_16(NV097_SET_VERTEX_DATA_ARRAY_OFFSET, 4): {
+/* Kelvin inline vertex streams */
 
-			slot = (method - NV097_SET_VERTEX_DATA_ARRAY_OFFSET) / 4;
+static void pgraph_kelvin_inline_array(NV2AState *d,
+							unsigned int subchannel,
+							unsigned int method,
+							uint32_t parameter)
+{
+    PGRAPHState *pg = &d->pgraph;
 
-			pg->vertex_attributes[slot].dma_select =
-				parameter & 0x80000000;
-			pg->vertex_attributes[slot].offset =
-				parameter & 0x7fffffff;
+	assert(pg->inline_array_length < NV2A_MAX_BATCH_LENGTH);
+	pg->inline_array[
+		pg->inline_array_length++] = parameter;
+}
+
+static void pgraph_kelvin_set_vertex_data2f_m(NV2AState *d,
+							unsigned int subchannel,
+							unsigned int method,
+							uint32_t parameter)
+{
+    PGRAPHState *pg = &d->pgraph;
+
+	unsigned int slot = (method - NV097_SET_VERTEX_DATA2F_M) / 4;
+	unsigned int part = slot % 2;
+	slot /= 2;
+	VertexAttribute *vertex_attribute = &pg->vertex_attributes[slot];
+	pgraph_allocate_inline_buffer_vertices(pg, slot);
+	vertex_attribute->inline_value[part] = *(float*)&parameter;
+	/* FIXME: Should these really be set to 0.0 and 1.0 ? Conditions? */
+	vertex_attribute->inline_value[2] = 0.0f;
+	vertex_attribute->inline_value[3] = 1.0f;
+	if ((slot == 0) && (part == 1)) {
+		pgraph_finish_inline_buffer_vertex(pg);
+	}
+}
+
+static void pgraph_kelvin_set_vertex_data4f_m(NV2AState *d,
+							unsigned int subchannel,
+							unsigned int method,
+							uint32_t parameter)
+{
+    PGRAPHState *pg = &d->pgraph;
+
+	unsigned int slot = (method - NV097_SET_VERTEX_DATA4F_M) / 4;
+	unsigned int part = slot % 4;
+	slot /= 4;
+	VertexAttribute *vertex_attribute = &pg->vertex_attributes[slot];
+	pgraph_allocate_inline_buffer_vertices(pg, slot);
+	vertex_attribute->inline_value[part] = *(float*)&parameter;
+	if ((slot == 0) && (part == 3)) {
+		pgraph_finish_inline_buffer_vertex(pg);
+	}
+}
+
+static void pgraph_kelvin_set_vertex_data2s(NV2AState *d,
+							unsigned int subchannel,
+							unsigned int method,
+							uint32_t parameter)
+{
+    PGRAPHState *pg = &d->pgraph;
+
+	unsigned int slot = (method - NV097_SET_VERTEX_DATA2S) / 4;
+	assert(false); /* FIXME: Untested! */
+	VertexAttribute *vertex_attribute = &pg->vertex_attributes[slot];
+	pgraph_allocate_inline_buffer_vertices(pg, slot);
+	vertex_attribute->inline_value[0] = (float)(int16_t)(parameter & 0xFFFF);
+	vertex_attribute->inline_value[1] = (float)(int16_t)(parameter >> 16);
+	vertex_attribute->inline_value[2] = 0.0f;
+	vertex_attribute->inline_value[3] = 1.0f;
+	if (slot == 0) {
+		pgraph_finish_inline_buffer_vertex(pg);
+	}
+}
+
+static void pgraph_kelvin_set_vertex_data4ub(NV2AState *d,
+							unsigned int subchannel,
+							unsigned int method,
+							uint32_t parameter)
+{
+    PGRAPHState *pg = &d->pgraph;
+
+	unsigned int slot = (method - NV097_SET_VERTEX_DATA4UB) / 4;
+	VertexAttribute *vertex_attribute = &pg->vertex_attributes[slot];
+	pgraph_allocate_inline_buffer_vertices(pg, slot);
+	vertex_attribute->inline_value[0] = (parameter & 0xFF) / 255.0f;
+	vertex_attribute->inline_value[1] = ((parameter >> 8) & 0xFF) / 255.0f;
+	vertex_attribute->inline_value[2] = ((parameter >> 16) & 0xFF) / 255.0f;
+	vertex_attribute->inline_value[3] = ((parameter >> 24) & 0xFF) / 255.0f;
+	if (slot == 0) {
+		pgraph_finish_inline_buffer_vertex(pg);
+		assert(false); /* FIXME: Untested */
+	}
+}
+
+static void pgraph_kelvin_set_vertex_data4s_m(NV2AState *d,
+							unsigned int subchannel,
+							unsigned int method,
+							uint32_t parameter)
+{
+    PGRAPHState *pg = &d->pgraph;
+
+	unsigned int slot = (method - NV097_SET_VERTEX_DATA4S_M) / 4;
+	unsigned int part = slot % 2;
+	slot /= 2;
+	assert(false); /* FIXME: Untested! */
+	VertexAttribute *vertex_attribute = &pg->vertex_attributes[slot];
+	pgraph_allocate_inline_buffer_vertices(pg, slot);
+	/* FIXME: Is mapping to [-1,+1] correct? */
+	vertex_attribute->inline_value[part * 2 + 0] = ((int16_t)(parameter & 0xFFFF)
+												 * 2.0f + 1) / 65535.0f;
+	vertex_attribute->inline_value[part * 2 + 1] = ((int16_t)(parameter >> 16)
+												 * 2.0f + 1) / 65535.0f;
+	if ((slot == 0) && (part == 1)) {
+		pgraph_finish_inline_buffer_vertex(pg);
+	}
+}
+
+/* Kelvin transform state */
+
+static void pgraph_kelvin_set_projection_matrix(NV2AState *d,
+							unsigned int subchannel,
+							unsigned int method,
+							uint32_t parameter)
+{
+    PGRAPHState *pg = &d->pgraph;
+
+	unsigned int slot = (method - NV097_SET_PROJECTION_MATRIX) / 4;
+	// pg->projection_matrix[slot] = *(float*)&parameter;
+	unsigned int row = NV_IGRAPH_XF_XFCTX_PMAT0 + slot / 4;
+	pg->vsh_constants[row][slot % 4] = parameter;
+	pg->vsh_constants_dirty[row] = true;
+}
+
+static void pgraph_kelvin_set_model_view_matrix(NV2AState *d,
+							unsigned int subchannel,
+							unsigned int method,
+							uint32_t parameter)
+{
+    PGRAPHState *pg = &d->pgraph;
+
+	unsigned int slot = (method - NV097_SET_MODEL_VIEW_MATRIX) / 4;
+	unsigned int matnum = slot / 16;
+	unsigned int entry = slot % 16;
+	unsigned int row = NV_IGRAPH_XF_XFCTX_MMAT0 + matnum * 8 + entry / 4;
+	pg->vsh_constants[row][entry % 4] = parameter;
+	pg->vsh_constants_dirty[row] = true;
+}
+
+static void pgraph_kelvin_set_inverse_model_view_matrix(NV2AState *d,
+							unsigned int subchannel,
+							unsigned int method,
+							uint32_t parameter)
+{
+    PGRAPHState *pg = &d->pgraph;
 
-			pg->vertex_attributes[slot].converted_elements = 0;
+	unsigned int slot = (method - NV097_SET_INVERSE_MODEL_VIEW_MATRIX) / 4;
+	unsigned int matnum = slot / 16;
+	unsigned int entry = slot % 16;
+	unsigned int row = NV_IGRAPH_XF_XFCTX_IMMAT0 + matnum * 8 + entry / 4;
+	pg->vsh_constants[row][entry % 4] = parameter;
+	pg->vsh_constants_dirty[row] = true;
+}
 
-			break;
-		}
+static void pgraph_kelvin_set_composite_matrix(NV2AState *d,
+							unsigned int subchannel,
+							unsigned int method,
+							uint32_t parameter)
+{
+    PGRAPHState *pg = &d->pgraph;
 
-		case NV097_SET_LOGIC_OP_ENABLE:
-			SET_MASK(pg->regs[NV_PGRAPH_BLEND],
-					 NV_PGRAPH_BLEND_LOGICOP_ENABLE, parameter);
-			break;
+	unsigned int slot = (method - NV097_SET_COMPOSITE_MATRIX) / 4;
+	unsigned int row = NV_IGRAPH_XF_XFCTX_CMAT0 + slot / 4;
+	pg->vsh_constants[row][slot % 4] = parameter;
+	pg->vsh_constants_dirty[row] = true;
+}
 
-		case NV097_SET_LOGIC_OP:
-			SET_MASK(pg->regs[NV_PGRAPH_BLEND],
-					 NV_PGRAPH_BLEND_LOGICOP, parameter & 0xF);
-			break;
+static void pgraph_kelvin_set_texture_matrix(NV2AState *d,
+							unsigned int subchannel,
+							unsigned int method,
+							uint32_t parameter)
+{
+    PGRAPHState *pg = &d->pgraph;
 
-		case NV097_CLEAR_REPORT_VALUE:
+	unsigned int slot = (method - NV097_SET_TEXTURE_MATRIX) / 4;
+	unsigned int tex = slot / 16;
+	unsigned int entry = slot % 16;
+	unsigned int row = NV_IGRAPH_XF_XFCTX_T0MAT + tex * 8 + entry / 4;
+	pg->vsh_constants[row][entry % 4] = parameter;
+	pg->vsh_constants_dirty[row] = true;
+}
 
-			/* FIXME: Does this have a value in parameter? Also does this (also?) modify
-			 *        the report memory block?
-			 */
-			if (pg->gl_zpass_pixel_count_query_count) {
-				if (pg->opengl_enabled) {
-					glDeleteQueries(pg->gl_zpass_pixel_count_query_count,
-									pg->gl_zpass_pixel_count_queries);
-				}
-				pg->gl_zpass_pixel_count_query_count = 0;
-			}
-			pg->zpass_pixel_count_result = 0;
+/* Handles NV097_SET_TEXGEN_PLANE_S,T,R,Q */
+static void pgraph_kelvin_set_texgen_plane(NV2AState *d,
+							unsigned int subchannel,
+							unsigned int method,
+							uint32_t parameter)
+{
+    PGRAPHState *pg = &d->pgraph;
 
-			break;
+	unsigned int slot = (method - NV097_SET_TEXGEN_PLANE_S) / 4;
+	unsigned int tex = slot / 16;
+	unsigned int entry = slot % 16;
+	unsigned int row = NV_IGRAPH_XF_XFCTX_TG0MAT + tex * 8 + entry / 4;
+	pg->vsh_constants[row][entry % 4] = parameter;
+	pg->vsh_constants_dirty[row] = true;
+}
 
-		case NV097_SET_ZPASS_PIXEL_COUNT_ENABLE:
-			pg->zpass_pixel_count_enable = parameter;
-			break;
+static void pgraph_kelvin_set_transform_program(NV2AState *d,
+							unsigned int subchannel,
+							unsigned int method,
+							uint32_t parameter)
+{
+    PGRAPHState *pg = &d->pgraph;
 
-		case NV097_GET_REPORT: {
-			/* FIXME: This was first intended to be watchpoint-based. However,
-			 *        qemu / kvm only supports virtual-address watchpoints.
-			 *        This'll do for now, but accuracy and performance with other
-			 *        approaches could be better
-			 */
-			uint8_t type = GET_MASK(parameter, NV097_GET_REPORT_TYPE);
-			assert(type == NV097_GET_REPORT_TYPE_ZPASS_PIXEL_CNT);
-			hwaddr offset = GET_MASK(parameter, NV097_GET_REPORT_OFFSET);
+	unsigned int slot = (method - NV097_SET_TRANSFORM_PROGRAM) / 4;
 
-			uint64_t timestamp = 0x0011223344556677; /* FIXME: Update timestamp?! */
-			uint32_t done = 0;
+	int program_load = GET_MASK(pg->regs[NV_PGRAPH_CHEOPS_OFFSET],
+		NV_PGRAPH_CHEOPS_OFFSET_PROG_LD_PTR);
 
-			if (pg->opengl_enabled) {
-				/* FIXME: Multisampling affects this (both: OGL and Xbox GPU),
-				 *        not sure if CLEARs also count
-				 */
-				/* FIXME: What about clipping regions etc? */
-				for(i = 0; i < pg->gl_zpass_pixel_count_query_count; i++) {
-					GLuint gl_query_result;
-					glGetQueryObjectuiv(pg->gl_zpass_pixel_count_queries[i],
-										GL_QUERY_RESULT,
-										&gl_query_result);
-					pg->zpass_pixel_count_result += gl_query_result;
-				}
-				if (pg->gl_zpass_pixel_count_query_count) {
-					glDeleteQueries(pg->gl_zpass_pixel_count_query_count,
-									pg->gl_zpass_pixel_count_queries);
-				}
-				pg->gl_zpass_pixel_count_query_count = 0;
+	assert(program_load < NV2A_MAX_TRANSFORM_PROGRAM_LENGTH);
+	pg->program_data[program_load][slot % 4] = parameter;
 
-				hwaddr report_dma_len;
-				uint8_t *report_data = (uint8_t*)nv_dma_map(d, pg->dma_report,
-															&report_dma_len);
-				assert(offset < report_dma_len);
-				report_data += offset;
+	if (slot % 4 == 3) {
+		SET_MASK(pg->regs[NV_PGRAPH_CHEOPS_OFFSET],
+			NV_PGRAPH_CHEOPS_OFFSET_PROG_LD_PTR, program_load + 1);
+	}
+}
 
-				stq_le_p((uint64_t*)&report_data[0], timestamp);
-				stl_le_p((uint32_t*)&report_data[8], pg->zpass_pixel_count_result);
-				stl_le_p((uint32_t*)&report_data[12], done);
-			}
+static void pgraph_kelvin_set_transform_constant(NV2AState *d,
+							unsigned int subchannel,
+							unsigned int method,
+							uint32_t parameter)
+{
+    PGRAPHState *pg = &d->pgraph;
 
-			break;
-		}
+	unsigned int slot = (method - NV097_SET_TRANSFORM_CONSTANT) / 4;
 
-		CASE_3(NV097_SET_EYE_DIRECTION, 4):
-			slot = (method - NV097_SET_EYE_DIRECTION) / 4;
-			pg->ltctxa[NV_IGRAPH_XF_LTCTXA_EYED][slot] = parameter;
-			pg->ltctxa_dirty[NV_IGRAPH_XF_LTCTXA_EYED] = true;
-			break;
+	int const_load = GET_MASK(pg->regs[NV_PGRAPH_CHEOPS_OFFSET],
+							  NV_PGRAPH_CHEOPS_OFFSET_CONST_LD_PTR);
 
-		case NV097_SET_BEGIN_END: {
-			uint32_t control_0 = pg->regs[NV_PGRAPH_CONTROL_0];
-			uint32_t control_1 = pg->regs[NV_PGRAPH_CONTROL_1];
+	assert(const_load < NV2A_VERTEXSHADER_CONSTANTS);
+	// VertexShaderConstant *vsh_constant = &pg->vsh_constants[const_load];
+	pg->vsh_constants_dirty[const_load] |=
+		(parameter != pg->vsh_constants[const_load][slot%4]);
+	pg->vsh_constants[const_load][slot%4] = parameter;
 
-			bool depth_test = control_0
-				& NV_PGRAPH_CONTROL_0_ZENABLE;
-			bool stencil_test = control_1
-				& NV_PGRAPH_CONTROL_1_STENCIL_TEST_ENABLE;
+	if (slot % 4 == 3) {
+		SET_MASK(pg->regs[NV_PGRAPH_CHEOPS_OFFSET],
+				 NV_PGRAPH_CHEOPS_OFFSET_CONST_LD_PTR, const_load+1);
+	}
+}
 
-			if (parameter == NV097_SET_BEGIN_END_OP_END) {
+/* Kelvin texture stages */
 
-				if (pg->draw_arrays_length) {
+static void pgraph_kelvin_set_texture_offset(NV2AState *d,
+							unsigned int subchannel,
+							unsigned int method,
+							uint32_t parameter)
+{
+    PGRAPHState *pg = &d->pgraph;
 
-					NV2A_GL_DPRINTF(false, "Draw Arrays");
+	unsigned int slot = (method - NV097_SET_TEXTURE_OFFSET) / 64;
+	pg->regs[NV_PGRAPH_TEXOFFSET0 + slot * 4] = parameter;
+	pg->texture_dirty[slot] = true;
+}
 
-					assert(pg->inline_buffer_length == 0);
-					assert(pg->inline_array_length == 0);
-					assert(pg->inline_elements_length == 0);
+static void pgraph_kelvin_set_texture_format(NV2AState *d,
+							unsigned int subchannel,
+							unsigned int method,
+							uint32_t parameter)
+{
+    PGRAPHState *pg = &d->pgraph;
 
-					if (pgraph_draw_arrays != nullptr) {
-						pgraph_draw_arrays(d);
-					}
-				} else if (pg->inline_buffer_length) {
+	unsigned int slot = (method - NV097_SET_TEXTURE_FORMAT) / 64;
+
+	bool dma_select =
+		GET_MASK(parameter, NV097_SET_TEXTURE_FORMAT_CONTEXT_DMA) == 2;
+	bool cubemap =
+		parameter & NV097_SET_TEXTURE_FORMAT_CUBEMAP_ENABLE;
+	bool border_source =
+		parameter & NV097_SET_TEXTURE_FORMAT_BORDER_SOURCE;
+	unsigned int dimensionality =
+		GET_MASK(parameter, NV097_SET_TEXTURE_FORMAT_DIMENSIONALITY);
+	unsigned int color_format =
+		GET_MASK(parameter, NV097_SET_TEXTURE_FORMAT_COLOR);
+	unsigned int levels =
+		GET_MASK(parameter, NV097_SET_TEXTURE_FORMAT_MIPMAP_LEVELS);
+	unsigned int log_width =
+		GET_MASK(parameter, NV097_SET_TEXTURE_FORMAT_BASE_SIZE_U);
+	unsigned int log_height =
+		GET_MASK(parameter, NV097_SET_TEXTURE_FORMAT_BASE_SIZE_V);
+	unsigned int log_depth =
+		GET_MASK(parameter, NV097_SET_TEXTURE_FORMAT_BASE_SIZE_P);
+
+	uint32_t *reg = &pg->regs[NV_PGRAPH_TEXFMT0 + slot * 4];
+	SET_MASK(*reg, NV_PGRAPH_TEXFMT0_CONTEXT_DMA, dma_select);
+	SET_MASK(*reg, NV_PGRAPH_TEXFMT0_CUBEMAPENABLE, cubemap);
+	SET_MASK(*reg, NV_PGRAPH_TEXFMT0_BORDER_SOURCE, border_source);
+	SET_MASK(*reg, NV_PGRAPH_TEXFMT0_DIMENSIONALITY, dimensionality);
+	SET_MASK(*reg, NV_PGRAPH_TEXFMT0_COLOR, color_format);
+	SET_MASK(*reg, NV_PGRAPH_TEXFMT0_MIPMAP_LEVELS, levels);
+	SET_MASK(*reg, NV_PGRAPH_TEXFMT0_BASE_SIZE_U, log_width);
+	SET_MASK(*reg, NV_PGRAPH_TEXFMT0_BASE_SIZE_V, log_height);
+	SET_MASK(*reg, NV_PGRAPH_TEXFMT0_BASE_SIZE_P, log_depth);
+
+	pg->texture_dirty[slot] = true;
+}
 
-					NV2A_GL_DPRINTF(false, "Inline Buffer");
+static void pgraph_kelvin_set_texture_address(NV2AState *d,
+							unsigned int subchannel,
+							unsigned int method,
+							uint32_t parameter)
+{
+    PGRAPHState *pg = &d->pgraph;
 
-					assert(pg->draw_arrays_length == 0);
-					assert(pg->inline_array_length == 0);
-					assert(pg->inline_elements_length == 0);
+	unsigned int slot = (method - NV097_SET_TEXTURE_ADDRESS) / 64;
+	pg->regs[NV_PGRAPH_TEXADDRESS0 + slot * 4] = parameter;
+}
 
-					if (pgraph_draw_inline_buffer != nullptr) {
-						pgraph_draw_inline_buffer(d);
-					}
-				} else if (pg->inline_array_length) {
+static void pgraph_kelvin_set_texture_control0(NV2AState *d,
+							unsigned int subchannel,
+							unsigned int method,
+							uint32_t parameter)
+{
+    PGRAPHState *pg = &d->pgraph;
 
-					NV2A_GL_DPRINTF(false, "Inline Array");
+	unsigned int slot = (method - NV097_SET_TEXTURE_CONTROL0) / 64;
+	pg->regs[NV_PGRAPH_TEXCTL0_0 + slot*4] = parameter;
+}
 
-					assert(pg->draw_arrays_length == 0);
-					assert(pg->inline_buffer_length == 0);
-					assert(pg->inline_elements_length == 0);
+static void pgraph_kelvin_set_texture_control1(NV2AState *d,
+							unsigned int subchannel,
+							unsigned int method,
+							uint32_t parameter)
+{
+    PGRAPHState *pg = &d->pgraph;
 
-					if (pgraph_draw_inline_array != nullptr) {
-						pgraph_draw_inline_array(d);
-					}
-				} else if (pg->inline_elements_length) {
+	unsigned int slot = (method - NV097_SET_TEXTURE_CONTROL1) / 64;
+	pg->regs[NV_PGRAPH_TEXCTL1_0 + slot*4] = parameter;
+}
 
-					NV2A_GL_DPRINTF(false, "Inline Elements");
+static void pgraph_kelvin_set_texture_filter(NV2AState *d,
+							unsigned int subchannel,
+							unsigned int method,
+							uint32_t parameter)
+{
+    PGRAPHState *pg = &d->pgraph;
 
-					assert(pg->draw_arrays_length == 0);
-					assert(pg->inline_buffer_length == 0);
-					assert(pg->inline_array_length == 0);
+	unsigned int slot = (method - NV097_SET_TEXTURE_FILTER) / 64;
+	pg->regs[NV_PGRAPH_TEXFILTER0 + slot * 4] = parameter;
+}
 
-					if (pgraph_draw_inline_elements != nullptr) {
-						pgraph_draw_inline_elements(d);
-					}
-				} else {
-					NV2A_GL_DPRINTF(true, "EMPTY NV097_SET_BEGIN_END");
-					assert(false);
-				}
-			} else {
+static void pgraph_kelvin_set_texture_image_rect(NV2AState *d,
+							unsigned int subchannel,
+							unsigned int method,
+							uint32_t parameter)
+{
+    PGRAPHState *pg = &d->pgraph;
 
-				assert(parameter <= NV097_SET_BEGIN_END_OP_POLYGON);
+	unsigned int slot = (method - NV097_SET_TEXTURE_IMAGE_RECT) / 64;
+	pg->regs[NV_PGRAPH_TEXIMAGERECT0 + slot * 4] = parameter;
+	pg->texture_dirty[slot] = true;
+}
 
-				pg->primitive_mode = parameter;
+static void pgraph_kelvin_set_texture_palette(NV2AState *d,
+							unsigned int subchannel,
+							unsigned int method,
+							uint32_t parameter)
+{
+    PGRAPHState *pg = &d->pgraph;
 
-				if (pgraph_draw_state_update != nullptr) {
-					pgraph_draw_state_update(d);
-				}
+	unsigned int slot = (method - NV097_SET_TEXTURE_PALETTE) / 64;
 
-				pg->inline_elements_length = 0;
-				pg->inline_array_length = 0;
-				pg->inline_buffer_length = 0;
-				pg->draw_arrays_length = 0;
-				pg->draw_arrays_max_count = 0;
-			}
+	bool dma_select =
+		GET_MASK(parameter, NV097_SET_TEXTURE_PALETTE_CONTEXT_DMA) == 1;
+	unsigned int length =
+		GET_MASK(parameter, NV097_SET_TEXTURE_PALETTE_LENGTH);
+	unsigned int offset =
+		GET_MASK(parameter, NV097_SET_TEXTURE_PALETTE_OFFSET);
 
-			pgraph_set_surface_dirty(pg, true, depth_test || stencil_test);
-			break;
-		}
-		CASE_4(NV097_SET_TEXTURE_OFFSET, 64):
-			slot = (method - NV097_SET_TEXTURE_OFFSET) / 64;
-			pg->regs[NV_PGRAPH_TEXOFFSET0 + slot * 4] = parameter;
-			pg->texture_dirty[slot] = true;
-			break;
-		CASE_4(NV097_SET_TEXTURE_FORMAT, 64): {
-			slot = (method - NV097_SET_TEXTURE_FORMAT) / 64;
-
-			bool dma_select =
-				GET_MASK(parameter, NV097_SET_TEXTURE_FORMAT_CONTEXT_DMA) == 2;
-			bool cubemap =
-				parameter & NV097_SET_TEXTURE_FORMAT_CUBEMAP_ENABLE;
-			bool border_source =
-				parameter & NV097_SET_TEXTURE_FORMAT_BORDER_SOURCE;
-			unsigned int dimensionality =
-				GET_MASK(parameter, NV097_SET_TEXTURE_FORMAT_DIMENSIONALITY);
-			unsigned int color_format =
-				GET_MASK(parameter, NV097_SET_TEXTURE_FORMAT_COLOR);
-			unsigned int levels =
-				GET_MASK(parameter, NV097_SET_TEXTURE_FORMAT_MIPMAP_LEVELS);
-			unsigned int log_width =
-				GET_MASK(parameter, NV097_SET_TEXTURE_FORMAT_BASE_SIZE_U);
-			unsigned int log_height =
-				GET_MASK(parameter, NV097_SET_TEXTURE_FORMAT_BASE_SIZE_V);
-			unsigned int log_depth =
-				GET_MASK(parameter, NV097_SET_TEXTURE_FORMAT_BASE_SIZE_P);
-
-			uint32_t *reg = &pg->regs[NV_PGRAPH_TEXFMT0 + slot * 4];
-			SET_MASK(*reg, NV_PGRAPH_TEXFMT0_CONTEXT_DMA, dma_select);
-			SET_MASK(*reg, NV_PGRAPH_TEXFMT0_CUBEMAPENABLE, cubemap);
-			SET_MASK(*reg, NV_PGRAPH_TEXFMT0_BORDER_SOURCE, border_source);
-			SET_MASK(*reg, NV_PGRAPH_TEXFMT0_DIMENSIONALITY, dimensionality);
-			SET_MASK(*reg, NV_PGRAPH_TEXFMT0_COLOR, color_format);
-			SET_MASK(*reg, NV_PGRAPH_TEXFMT0_MIPMAP_LEVELS, levels);
-			SET_MASK(*reg, NV_PGRAPH_TEXFMT0_BASE_SIZE_U, log_width);
-			SET_MASK(*reg, NV_PGRAPH_TEXFMT0_BASE_SIZE_V, log_height);
-			SET_MASK(*reg, NV_PGRAPH_TEXFMT0_BASE_SIZE_P, log_depth);
-
-			pg->texture_dirty[slot] = true;
-			break;
-		}
-		CASE_4(NV097_SET_TEXTURE_CONTROL0, 64):
-			slot = (method - NV097_SET_TEXTURE_CONTROL0) / 64;
-			pg->regs[NV_PGRAPH_TEXCTL0_0 + slot*4] = parameter;
-			break;
-		CASE_4(NV097_SET_TEXTURE_CONTROL1, 64):
-			slot = (method - NV097_SET_TEXTURE_CONTROL1) / 64;
-			pg->regs[NV_PGRAPH_TEXCTL1_0 + slot*4] = parameter;
-			break;
-		CASE_4(NV097_SET_TEXTURE_FILTER, 64):
-			slot = (method - NV097_SET_TEXTURE_FILTER) / 64;
-			pg->regs[NV_PGRAPH_TEXFILTER0 + slot * 4] = parameter;
-			break;
-		CASE_4(NV097_SET_TEXTURE_IMAGE_RECT, 64):
-			slot = (method - NV097_SET_TEXTURE_IMAGE_RECT) / 64;
-			pg->regs[NV_PGRAPH_TEXIMAGERECT0 + slot * 4] = parameter;
-			pg->texture_dirty[slot] = true;
-			break;
-		CASE_4(NV097_SET_TEXTURE_PALETTE, 64): {
-			slot = (method - NV097_SET_TEXTURE_PALETTE) / 64;
-
-			bool dma_select =
-				GET_MASK(parameter, NV097_SET_TEXTURE_PALETTE_CONTEXT_DMA) == 1;
-			unsigned int length =
-				GET_MASK(parameter, NV097_SET_TEXTURE_PALETTE_LENGTH);
-			unsigned int offset =
-				GET_MASK(parameter, NV097_SET_TEXTURE_PALETTE_OFFSET);
-
-			uint32_t *reg = &pg->regs[NV_PGRAPH_TEXPALETTE0 + slot * 4];
-			SET_MASK(*reg, NV_PGRAPH_TEXPALETTE0_CONTEXT_DMA, dma_select);
-			SET_MASK(*reg, NV_PGRAPH_TEXPALETTE0_LENGTH, length);
-			SET_MASK(*reg, NV_PGRAPH_TEXPALETTE0_OFFSET, offset);
-
-			pg->texture_dirty[slot] = true;
-			break;
-		}
+	uint32_t *reg = &pg->regs[NV_PGRAPH_TEXPALETTE0 + slot * 4];
+	SET_MASK(*reg, NV_PGRAPH_TEXPALETTE0_CONTEXT_DMA, dma_select);
+	SET_MASK(*reg, NV_PGRAPH_TEXPALETTE0_LENGTH, length);
+	SET_MASK(*reg, NV_PGRAPH_TEXPALETTE0_OFFSET, offset);
 
-		CASE_4(NV097_SET_TEXTURE_BORDER_COLOR, 64):
-			slot = (method - NV097_SET_TEXTURE_BORDER_COLOR) / 64;
-			pg->regs[NV_PGRAPH_BORDERCOLOR0 + slot * 4] = parameter;
-			break;
-		CASE_4(NV097_SET_TEXTURE_SET_BUMP_ENV_MAT + 0x0, 64):
-		CASE_4(NV097_SET_TEXTURE_SET_BUMP_ENV_MAT + 0x4, 64):
-		CASE_4(NV097_SET_TEXTURE_SET_BUMP_ENV_MAT + 0x8, 64):
-		CASE_4(NV097_SET_TEXTURE_SET_BUMP_ENV_MAT + 0xc, 64):
-			slot = (method - NV097_SET_TEXTURE_SET_BUMP_ENV_MAT) / 4;
-			assert((slot / 16) > 0);
-			slot -= 16;
-			pg->bump_env_matrix[slot / 16][slot % 4] = *(float*)&parameter;
-			break;
+	pg->texture_dirty[slot] = true;
+}
 
-		CASE_4(NV097_SET_TEXTURE_SET_BUMP_ENV_SCALE, 64):
-			slot = (method - NV097_SET_TEXTURE_SET_BUMP_ENV_SCALE) / 64;
-			assert(slot > 0);
-			slot--;
-			pg->regs[NV_PGRAPH_BUMPSCALE1 + slot * 4] = parameter;
-			break;
-		CASE_4(NV097_SET_TEXTURE_SET_BUMP_ENV_OFFSET, 64):
-			slot = (method - NV097_SET_TEXTURE_SET_BUMP_ENV_OFFSET) / 64;
-			assert(slot > 0);
-			slot--;
-			pg->regs[NV_PGRAPH_BUMPOFFSET1 + slot * 4] = parameter;
-			break;
+static void pgraph_kelvin_set_texture_border_color(NV2AState *d,
+							unsigned int subchannel,
+							unsigned int method,
+							uint32_t parameter)
+{
+    PGRAPHState *pg = &d->pgraph;
 
-		case NV097_ARRAY_ELEMENT16:
-			//LOG_TEST_CASE("NV2A_VB_ELEMENT_U16");	
-			// Test-case : Turok (in main menu)	
-			// Test-case : Hunter Redeemer	
-			// Test-case : Otogi (see https://github.com/Cxbx-Reloaded/Cxbx-Reloaded/pull/1113#issuecomment-385593814)
-			assert(pg->inline_elements_length < NV2A_MAX_BATCH_LENGTH);
-			pg->inline_elements[
-				pg->inline_elements_length++] = parameter & 0xFFFF;
-			pg->inline_elements[
-				pg->inline_elements_length++] = parameter >> 16;
-			break;
-		case NV097_ARRAY_ELEMENT32:
-			//LOG_TEST_CASE("NV2A_VB_ELEMENT_U32");	
-			// Test-case : Turok (in main menu)
-			assert(pg->inline_elements_length < NV2A_MAX_BATCH_LENGTH);
-			pg->inline_elements[
-				pg->inline_elements_length++] = parameter;
-			break;
-		case NV097_DRAW_ARRAYS: {
+	unsigned int slot = (method - NV097_SET_TEXTURE_BORDER_COLOR) / 64;
+	pg->regs[NV_PGRAPH_BORDERCOLOR0 + slot * 4] = parameter;
+}
 
-			unsigned int start = GET_MASK(parameter, NV097_DRAW_ARRAYS_START_INDEX);
-			unsigned int count = GET_MASK(parameter, NV097_DRAW_ARRAYS_COUNT)+1;
+static void pgraph_kelvin_set_texture_set_bump_env_mat(NV2AState *d,
+							unsigned int subchannel,
+							unsigned int method,
+							uint32_t parameter)
+{
+    PGRAPHState *pg = &d->pgraph;
 
-			pg->draw_arrays_max_count = MAX(pg->draw_arrays_max_count, start + count);
+	unsigned int slot = (method - NV097_SET_TEXTURE_SET_BUMP_ENV_MAT) / 4;
+	assert((slot / 16) > 0);
+	slot -= 16;
+	pg->bump_env_matrix[slot / 16][slot % 4] = *(float*)&parameter;
+}
 
-			assert(pg->draw_arrays_length < ARRAY_SIZE(pg->gl_draw_arrays_start));
+static void pgraph_kelvin_set_texture_set_bump_env_scale(NV2AState *d,
+							unsigned int subchannel,
+							unsigned int method,
+							uint32_t parameter)
+{
+    PGRAPHState *pg = &d->pgraph;
 
-			/* Attempt to connect primitives */
-			if (pg->draw_arrays_length > 0) {
-				unsigned int last_start =
-					pg->gl_draw_arrays_start[pg->draw_arrays_length - 1];
-				GLsizei* last_count =
-					&pg->gl_draw_arrays_count[pg->draw_arrays_length - 1];
-				if (start == (last_start + *last_count)) {
-					*last_count += count;
-					break;
-				}
-			}
+	unsigned int slot = (method - NV097_SET_TEXTURE_SET_BUMP_ENV_SCALE) / 64;
+	assert(slot > 0);
+	slot--;
+	pg->regs[NV_PGRAPH_BUMPSCALE1 + slot * 4] = parameter;
+}
 
-			pg->gl_draw_arrays_start[pg->draw_arrays_length] = start;
-			pg->gl_draw_arrays_count[pg->draw_arrays_length] = count;
-			pg->draw_arrays_length++;
-			break;
-		}
-		case NV097_INLINE_ARRAY:
-			assert(pg->inline_array_length < NV2A_MAX_BATCH_LENGTH);
-			pg->inline_array[
-				pg->inline_array_length++] = parameter;
-			break;
-		CASE_3(NV097_SET_EYE_VECTOR, 4):
-			slot = (method - NV097_SET_EYE_VECTOR) / 4;
-			pg->regs[NV_PGRAPH_EYEVEC0 + slot * 4] = parameter;
-			break;
+static void pgraph_kelvin_set_texture_set_bump_env_offset(NV2AState *d,
+							unsigned int subchannel,
+							unsigned int method,
+							uint32_t parameter)
+{
+    PGRAPHState *pg = &d->pgraph;
 
-		CASE_32(NV097_SET_VERTEX_DATA2F_M, 4): {
-			slot = (method - NV097_SET_VERTEX_DATA2F_M) / 4;
-			unsigned int part = slot % 2;
-			slot /= 2;
-			VertexAttribute *vertex_attribute = &pg->vertex_attributes[slot];
-			pgraph_allocate_inline_buffer_vertices(pg, slot);
-			vertex_attribute->inline_value[part] = *(float*)&parameter;
-			/* FIXME: Should these really be set to 0.0 and 1.0 ? Conditions? */
-			vertex_attribute->inline_value[2] = 0.0f;
-			vertex_attribute->inline_value[3] = 1.0f;
-			if ((slot == 0) && (part == 1)) {
-				pgraph_finish_inline_buffer_vertex(pg);
-			}
-			break;
-		}
-		CASE_64(NV097_SET_VERTEX_DATA4F_M, 4): {
-			slot = (method - NV097_SET_VERTEX_DATA4F_M) / 4;
-			unsigned int part = slot % 4;
-			slot /= 4;
-			VertexAttribute *vertex_attribute = &pg->vertex_attributes[slot];
-			pgraph_allocate_inline_buffer_vertices(pg, slot);
-			vertex_attribute->inline_value[part] = *(float*)&parameter;
-			if ((slot == 0) && (part == 3)) {
-				pgraph_finish_inline_buffer_vertex(pg);
-			}
-			break;
-		}
-		CASE_16(NV097_SET_VERTEX_DATA2S, 4): {
-			slot = (method - NV097_SET_VERTEX_DATA2S) / 4;
-			assert(false); /* FIXME: Untested! */
-			VertexAttribute *vertex_attribute = &pg->vertex_attributes[slot];
-			pgraph_allocate_inline_buffer_vertices(pg, slot);
-			vertex_attribute->inline_value[0] = (float)(int16_t)(parameter & 0xFFFF);
-			vertex_attribute->inline_value[1] = (float)(int16_t)(parameter >> 16);
-			vertex_attribute->inline_value[2] = 0.0f;
-			vertex_attribute->inline_value[3] = 1.0f;
-			if (slot == 0) {
-				pgraph_finish_inline_buffer_vertex(pg);
-			}
-			break;
-		}
-		CASE_16(NV097_SET_VERTEX_DATA4UB, 4) : {
-			slot = (method - NV097_SET_VERTEX_DATA4UB) / 4;
-			VertexAttribute *vertex_attribute = &pg->vertex_attributes[slot];
-			pgraph_allocate_inline_buffer_vertices(pg, slot);
-			vertex_attribute->inline_value[0] = (parameter & 0xFF) / 255.0f;
-			vertex_attribute->inline_value[1] = ((parameter >> 8) & 0xFF) / 255.0f;
-			vertex_attribute->inline_value[2] = ((parameter >> 16) & 0xFF) / 255.0f;
-			vertex_attribute->inline_value[3] = ((parameter >> 24) & 0xFF) / 255.0f;
-			if (slot == 0) {
-				pgraph_finish_inline_buffer_vertex(pg);
-				assert(false); /* FIXME: Untested */
-			}
-			break;
-		}
-		CASE_32(NV097_SET_VERTEX_DATA4S_M, 4) : {
-			slot = (method - NV097_SET_VERTEX_DATA4S_M) / 4;
-			unsigned int part = slot % 2;
-			slot /= 2;
-			assert(false); /* FIXME: Untested! */
-			VertexAttribute *vertex_attribute = &pg->vertex_attributes[slot];
-			pgraph_allocate_inline_buffer_vertices(pg, slot);
-			/* FIXME: Is mapping to [-1,+1] correct? */
-			vertex_attribute->inline_value[part * 2 + 0] = ((int16_t)(parameter & 0xFFFF)
-														 * 2.0f + 1) / 65535.0f;
-			vertex_attribute->inline_value[part * 2 + 1] = ((int16_t)(parameter >> 16)
-														 * 2.0f + 1) / 65535.0f;
-			if ((slot == 0) && (part == 1)) {
-				pgraph_finish_inline_buffer_vertex(pg);
-			}
-			break;
-		}
-		case NV097_SET_SEMAPHORE_OFFSET:
-			pg->regs[NV_PGRAPH_SEMAPHOREOFFSET] = parameter;
-			break;
-		case NV097_BACK_END_WRITE_SEMAPHORE_RELEASE: {
-			pgraph_update_surface(d, false, true, true);
+	unsigned int slot = (method - NV097_SET_TEXTURE_SET_BUMP_ENV_OFFSET) / 64;
+	assert(slot > 0);
+	slot--;
+	pg->regs[NV_PGRAPH_BUMPOFFSET1 + slot * 4] = parameter;
+}
 
-			//qemu_mutex_unlock(&pg->pgraph_lock);
-			//qemu_mutex_lock_iothread();
+/* Method dispatch
+ * Each graphics class has a table indexed by method >> 2, filled by pgraph_init_method_table.
+ * Entries point at the switch of their class, unless a method has a handler of its own. */
 
-			uint32_t semaphore_offset = pg->regs[NV_PGRAPH_SEMAPHOREOFFSET];
+typedef void(*PGRAPHMethodHandler)(NV2AState *d, unsigned int subchannel, unsigned int method, uint32_t parameter);
 
-			xbox::addr_xt semaphore_dma_len;
-			uint8_t *semaphore_data = (uint8_t*)nv_dma_map(d, pg->dma_semaphore,
-				&semaphore_dma_len);
-			assert(semaphore_offset < semaphore_dma_len);
-			semaphore_data += semaphore_offset;
+typedef struct PGRAPHMethodEntry {
+	PGRAPHMethodHandler handler;
+	bool inline_vertex; // Part of an inline vertex stream, see USE_INLINE_VERTEX_FAST_PATH
+} PGRAPHMethodEntry;
 
-			stl_le_p((uint32_t*)semaphore_data, parameter);
+static PGRAPHMethodEntry pgraph_method_table[PGRAPH_CLASS_COUNT][NV2A_METHOD_TABLE_SIZE];
 
-			//qemu_mutex_lock(&pg->pgraph_lock);
-			//qemu_mutex_unlock_iothread();
+static void pgraph_set_method_handler(PGRAPHClass class_index,
+									  unsigned int method, unsigned int count, unsigned int step,
+									  PGRAPHMethodHandler handler, bool inline_vertex = false)
+{
+	for (unsigned int i = 0; i < count; i++) {
+		unsigned int index = (method + i * step) >> 2;
+		assert(index < NV2A_METHOD_TABLE_SIZE);
+		pgraph_method_table[class_index][index] = { handler, inline_vertex };
+	}
+}
 
-			break;
-		}
-		case NV097_SET_ZSTENCIL_CLEAR_VALUE:
-			pg->regs[NV_PGRAPH_ZSTENCILCLEARVALUE] = parameter;
-			break;
+static void pgraph_init_method_table()
+{
+	pgraph_set_method_handler(PGRAPH_CLASS_CONTEXT_PATTERN, 0, NV2A_METHOD_TABLE_SIZE, 4, pgraph_context_pattern_method);
+	pgraph_set_method_handler(PGRAPH_CLASS_CONTEXT_SURFACES_2D, 0, NV2A_METHOD_TABLE_SIZE, 4, pgraph_context_surfaces_2d_method);
+	pgraph_set_method_handler(PGRAPH_CLASS_IMAGE_BLIT, 0, NV2A_METHOD_TABLE_SIZE, 4, pgraph_image_blit_method);
+	pgraph_set_method_handler(PGRAPH_CLASS_KELVIN_PRIMITIVE, 0, NV2A_METHOD_TABLE_SIZE, 4, pgraph_kelvin_method);
+
+	// Array-style methods get an entry for each of their elements
+	pgraph_set_method_handler(PGRAPH_CLASS_KELVIN_PRIMITIVE, NV097_INLINE_ARRAY, 1, 4, pgraph_kelvin_inline_array, true);
+	pgraph_set_method_handler(PGRAPH_CLASS_KELVIN_PRIMITIVE, NV097_SET_VERTEX_DATA2F_M, 32, 4, pgraph_kelvin_set_vertex_data2f_m, true);
+	pgraph_set_method_handler(PGRAPH_CLASS_KELVIN_PRIMITIVE, NV097_SET_VERTEX_DATA4F_M, 64, 4, pgraph_kelvin_set_vertex_data4f_m, true);
+	pgraph_set_method_handler(PGRAPH_CLASS_KELVIN_PRIMITIVE, NV097_SET_VERTEX_DATA2S, 16, 4, pgraph_kelvin_set_vertex_data2s, true);
+	pgraph_set_method_handler(PGRAPH_CLASS_KELVIN_PRIMITIVE, NV097_SET_VERTEX_DATA4UB, 16, 4, pgraph_kelvin_set_vertex_data4ub, true);
+	pgraph_set_method_handler(PGRAPH_CLASS_KELVIN_PRIMITIVE, NV097_SET_VERTEX_DATA4S_M, 32, 4, pgraph_kelvin_set_vertex_data4s_m, true);
+
+	pgraph_set_method_handler(PGRAPH_CLASS_KELVIN_PRIMITIVE, NV097_SET_PROJECTION_MATRIX, 16, 4, pgraph_kelvin_set_projection_matrix);
+	pgraph_set_method_handler(PGRAPH_CLASS_KELVIN_PRIMITIVE, NV097_SET_MODEL_VIEW_MATRIX, 64, 4, pgraph_kelvin_set_model_view_matrix);
+	pgraph_set_method_handler(PGRAPH_CLASS_KELVIN_PRIMITIVE, NV097_SET_INVERSE_MODEL_VIEW_MATRIX, 64, 4, pgraph_kelvin_set_inverse_model_view_matrix);
+	pgraph_set_method_handler(PGRAPH_CLASS_KELVIN_PRIMITIVE, NV097_SET_COMPOSITE_MATRIX, 16, 4, pgraph_kelvin_set_composite_matrix);
+	pgraph_set_method_handler(PGRAPH_CLASS_KELVIN_PRIMITIVE, NV097_SET_TEXTURE_MATRIX, 64, 4, pgraph_kelvin_set_texture_matrix);
+	pgraph_set_method_handler(PGRAPH_CLASS_KELVIN_PRIMITIVE, NV097_SET_TEXGEN_PLANE_S, 64, 4, pgraph_kelvin_set_texgen_plane);
+	pgraph_set_method_handler(PGRAPH_CLASS_KELVIN_PRIMITIVE, NV097_SET_TRANSFORM_PROGRAM, 32, 4, pgraph_kelvin_set_transform_program);
+	pgraph_set_method_handler(PGRAPH_CLASS_KELVIN_PRIMITIVE, NV097_SET_TRANSFORM_CONSTANT, 32, 4, pgraph_kelvin_set_transform_constant);
+
+	// Texture stage methods repeat every 64 bytes, one set for each of the 4 stages
+	pgraph_set_method_handler(PGRAPH_CLASS_KELVIN_PRIMITIVE, NV097_SET_TEXTURE_OFFSET, 4, 64, pgraph_kelvin_set_texture_offset);
+	pgraph_set_method_handler(PGRAPH_CLASS_KELVIN_PRIMITIVE, NV097_SET_TEXTURE_FORMAT, 4, 64, pgraph_kelvin_set_texture_format);
+	pgraph_set_method_handler(PGRAPH_CLASS_KELVIN_PRIMITIVE, NV097_SET_TEXTURE_ADDRESS, 4, 64, pgraph_kelvin_set_texture_address);
+	pgraph_set_method_handler(PGRAPH_CLASS_KELVIN_PRIMITIVE, NV097_SET_TEXTURE_CONTROL0, 4, 64, pgraph_kelvin_set_texture_control0);
+	pgraph_set_method_handler(PGRAPH_CLASS_KELVIN_PRIMITIVE, NV097_SET_TEXTURE_CONTROL1, 4, 64, pgraph_kelvin_set_texture_control1);
+	pgraph_set_method_handler(PGRAPH_CLASS_KELVIN_PRIMITIVE, NV097_SET_TEXTURE_FILTER, 4, 64, pgraph_kelvin_set_texture_filter);
+	pgraph_set_method_handler(PGRAPH_CLASS_KELVIN_PRIMITIVE, NV097_SET_TEXTURE_IMAGE_RECT, 4, 64, pgraph_kelvin_set_texture_image_rect);
+	pgraph_set_method_handler(PGRAPH_CLASS_KELVIN_PRIMITIVE, NV097_SET_TEXTURE_PALETTE, 4, 64, pgraph_kelvin_set_texture_palette);
+	pgraph_set_method_handler(PGRAPH_CLASS_KELVIN_PRIMITIVE, NV097_SET_TEXTURE_BORDER_COLOR, 4, 64, pgraph_kelvin_set_texture_border_color);
+	for (unsigned int i = 0; i < 4; i++) {
+		pgraph_set_method_handler(PGRAPH_CLASS_KELVIN_PRIMITIVE, NV097_SET_TEXTURE_SET_BUMP_ENV_MAT + i * 4, 4, 64, pgraph_kelvin_set_texture_set_bump_env_mat);
+	}
+	pgraph_set_method_handler(PGRAPH_CLASS_KELVIN_PRIMITIVE, NV097_SET_TEXTURE_SET_BUMP_ENV_SCALE, 4, 64, pgraph_kelvin_set_texture_set_bump_env_scale);
+	pgraph_set_method_handler(PGRAPH_CLASS_KELVIN_PRIMITIVE, NV097_SET_TEXTURE_SET_BUMP_ENV_OFFSET, 4, 64, pgraph_kelvin_set_texture_set_bump_env_offset);
+}
 
-		case NV097_SET_COLOR_CLEAR_VALUE:
-			pg->regs[NV_PGRAPH_COLORCLEARVALUE] = parameter;
-			break;
+static PGRAPHClass pgraph_class_index(uint32_t graphics_class)
+{
+	switch (graphics_class) {
+	case NV_CONTEXT_PATTERN: return PGRAPH_CLASS_CONTEXT_PATTERN;
+	case NV_CONTEXT_SURFACES_2D: return PGRAPH_CLASS_CONTEXT_SURFACES_2D;
+	case NV_IMAGE_BLIT: return PGRAPH_CLASS_IMAGE_BLIT;
+	case NV_KELVIN_PRIMITIVE: return PGRAPH_CLASS_KELVIN_PRIMITIVE;
+	default: return PGRAPH_CLASS_UNKNOWN;
+	}
+}
 
-		case NV097_CLEAR_SURFACE: {
-			pg->clear_surface = parameter;
-			if (pgraph_draw_clear != nullptr) {
-				pgraph_draw_clear(d);
-			}
-			break;
-		}
+void pgraph_handle_method(NV2AState *d,
+							unsigned int subchannel,
+							unsigned int method,
+							uint32_t parameter)
+{
+    PGRAPHState *pg = &d->pgraph;
 
-		case NV097_SET_CLEAR_RECT_HORIZONTAL:
-			pg->regs[NV_PGRAPH_CLEARRECTX] = parameter;
-			break;
-		case NV097_SET_CLEAR_RECT_VERTICAL:
-			pg->regs[NV_PGRAPH_CLEARRECTY] = parameter;
-			break;
+    assert(subchannel < 8);
 
-		CASE_2(NV097_SET_SPECULAR_FOG_FACTOR, 4) :
-			slot = (method - NV097_SET_SPECULAR_FOG_FACTOR) / 4;
-			pg->regs[NV_PGRAPH_SPECFOGFACTOR0 + slot * 4] = parameter;
-			break;
+#ifdef USE_INLINE_VERTEX_FAST_PATH
+	// Inline vertex data arrives in long runs of methods on the Kelvin subchannel, during which
+	// the object context can't change, so these skip straight to their handler
+	const PGRAPHMethodEntry *entry = &pgraph_method_table[PGRAPH_CLASS_KELVIN_PRIMITIVE][method >> 2];
+	if (entry->inline_vertex && subchannel == pg->inline_vertex_subchannel) {
+		pg->method_calls[PGRAPH_CLASS_KELVIN_PRIMITIVE][method >> 2]++;
+		pg->inline_vertex_fast_path_methods++;
+		entry->handler(d, subchannel, method, parameter);
+		return;
+	}
+#endif
 
-		case NV097_SET_SHADER_CLIP_PLANE_MODE:
-			pg->regs[NV_PGRAPH_SHADERCLIPMODE] = parameter;
-			break;
+    bool channel_valid =
+        d->pgraph.regs[NV_PGRAPH_CTX_CONTROL] & NV_PGRAPH_CTX_CONTROL_CHID;
+    assert(channel_valid);
 
-		CASE_8(NV097_SET_COMBINER_COLOR_OCW, 4) :
-			slot = (method - NV097_SET_COMBINER_COLOR_OCW) / 4;
-			pg->regs[NV_PGRAPH_COMBINECOLORO0 + slot * 4] = parameter;
-			break;
+	if (method == NV_SET_OBJECT) {
+        assert(parameter < d->pramin.ramin_size);
+        uint8_t *obj_ptr = d->pramin.ramin_ptr + parameter;
+        if (g_nv2a_capture_active) {
+            nv2a_capture_memory(NV2A_CAPTURE_RAMIN, d->pramin.ramin_ptr, parameter, 16);
+        }
 
-		case NV097_SET_COMBINER_CONTROL:
-			pg->regs[NV_PGRAPH_COMBINECTL] = parameter;
-			break;
+        uint32_t ctx_1 = ldl_le_p((uint32_t*)obj_ptr);
+        uint32_t ctx_2 = ldl_le_p((uint32_t*)(obj_ptr+4));
+        uint32_t ctx_3 = ldl_le_p((uint32_t*)(obj_ptr+8));
+        uint32_t ctx_4 = ldl_le_p((uint32_t*)(obj_ptr+12));
+        uint32_t ctx_5 = parameter;
 
-		case NV097_SET_SHADOW_ZSLOPE_THRESHOLD:
-			pg->regs[NV_PGRAPH_SHADOWZSLOPETHRESHOLD] = parameter;
-			assert(parameter == 0x7F800000); /* FIXME: Unimplemented */
-			break;
+        pg->regs[NV_PGRAPH_CTX_CACHE1 + subchannel * 4] = ctx_1;
+        pg->regs[NV_PGRAPH_CTX_CACHE2 + subchannel * 4] = ctx_2;
+        pg->regs[NV_PGRAPH_CTX_CACHE3 + subchannel * 4] = ctx_3;
+        pg->regs[NV_PGRAPH_CTX_CACHE4 + subchannel * 4] = ctx_4;
+        pg->regs[NV_PGRAPH_CTX_CACHE5 + subchannel * 4] = ctx_5;
+    }
 
-		case NV097_SET_SHADER_STAGE_PROGRAM:
-			pg->regs[NV_PGRAPH_SHADERPROG] = parameter;
-			break;
+    // is this right?
+    pg->regs[NV_PGRAPH_CTX_SWITCH1] = pg->regs[NV_PGRAPH_CTX_CACHE1 + subchannel * 4];
+    pg->regs[NV_PGRAPH_CTX_SWITCH2] = pg->regs[NV_PGRAPH_CTX_CACHE2 + subchannel * 4];
+    pg->regs[NV_PGRAPH_CTX_SWITCH3] = pg->regs[NV_PGRAPH_CTX_CACHE3 + subchannel * 4];
+    pg->regs[NV_PGRAPH_CTX_SWITCH4] = pg->regs[NV_PGRAPH_CTX_CACHE4 + subchannel * 4];
+    pg->regs[NV_PGRAPH_CTX_SWITCH5] = pg->regs[NV_PGRAPH_CTX_CACHE5 + subchannel * 4];
 
-		case NV097_SET_SHADER_OTHER_STAGE_INPUT:
-			pg->regs[NV_PGRAPH_SHADERCTL] = parameter;
-			break;
+    uint32_t graphics_class = GET_MASK(pg->regs[NV_PGRAPH_CTX_SWITCH1],
+                                       NV_PGRAPH_CTX_SWITCH1_GRCLASS);
 
-		case NV097_SET_TRANSFORM_EXECUTION_MODE:
-			// Test-case : Whiplash
-			SET_MASK(pg->regs[NV_PGRAPH_CSV0_D], NV_PGRAPH_CSV0_D_MODE,
-				GET_MASK(parameter,
-					NV097_SET_TRANSFORM_EXECUTION_MODE_MODE));
-			SET_MASK(pg->regs[NV_PGRAPH_CSV0_D], NV_PGRAPH_CSV0_D_RANGE_MODE,
-				GET_MASK(parameter,
-					NV097_SET_TRANSFORM_EXECUTION_MODE_RANGE_MODE));
-			break;
-		case NV097_SET_TRANSFORM_PROGRAM_CXT_WRITE_EN:
-			// Test-case : Whiplash
-			pg->enable_vertex_program_write = parameter;
-			break;
-		case NV097_SET_TRANSFORM_PROGRAM_LOAD:
-			assert(parameter < NV2A_MAX_TRANSFORM_PROGRAM_LENGTH);
-			SET_MASK(pg->regs[NV_PGRAPH_CHEOPS_OFFSET],
-				NV_PGRAPH_CHEOPS_OFFSET_PROG_LD_PTR, parameter);
-			break;
-		case NV097_SET_TRANSFORM_PROGRAM_START:
-			assert(parameter < NV2A_MAX_TRANSFORM_PROGRAM_LENGTH);
-			SET_MASK(pg->regs[NV_PGRAPH_CSV0_C],
-				NV_PGRAPH_CSV0_C_CHEOPS_PROGRAM_START, parameter);
-			break;
-		case NV097_SET_TRANSFORM_CONSTANT_LOAD:
-			assert(parameter < NV2A_VERTEXSHADER_CONSTANTS);
-			SET_MASK(pg->regs[NV_PGRAPH_CHEOPS_OFFSET],
-				NV_PGRAPH_CHEOPS_OFFSET_CONST_LD_PTR, parameter);
-			NV2A_DPRINTF("load to %d\n", parameter);
-			break;
+	// Logging is slow.. disable for now..
+	//pgraph_log_method(subchannel, graphics_class, method, parameter);
 
-		case NV097_SET_FLAT_SHADE_OP: 
-			assert(parameter <= 1);
-			// TODO : value & 1 = first/last? vertex selection for glShaderMode(GL_FLAT)
-			break;
-		default:
-			NV2A_GL_DPRINTF(true, "    unhandled  (0x%02x 0x%08x)",
-					graphics_class, method);
-			break;
-		}
-		break;
-	}
+    if (subchannel != 0) {
+        // catches context switching issues on xbox d3d
+        assert(graphics_class != 0x97);
+    }
 
-	default:
+    PGRAPHClass class_index = pgraph_class_index(graphics_class);
+    if (class_index == PGRAPH_CLASS_UNKNOWN) {
 		NV2A_GL_DPRINTF(true, "Unknown Graphics Class/Method 0x%08X/0x%08X",
 						graphics_class, method);
-		break;
-	}
+		pg->inline_vertex_subchannel = NV2A_INVALID_SUBCHANNEL;
+		return;
+    }
+
+    pg->inline_vertex_subchannel = (class_index == PGRAPH_CLASS_KELVIN_PRIMITIVE) ? subchannel : NV2A_INVALID_SUBCHANNEL;
 
+    pg->method_calls[class_index][method >> 2]++;
+    pgraph_method_table[class_index][method >> 2].handler(d, subchannel, method, parameter);
 }
 
 static void pgraph_switch_context(NV2AState *d, unsigned int channel_id)
@@ -2993,6 +3267,9 @@ void pgraph_init(NV2AState *d)
 	qemu_cond_init(&pg->fifo_access_cond);
 	qemu_cond_init(&pg->flip_3d);
 
+	pgraph_init_method_table();
+	pg->inline_vertex_subchannel = NV2A_INVALID_SUBCHANNEL;
+
 	if (!(pg->opengl_enabled))
 		return;
 
@@ -3053,7 +3330,7 @@ void pgraph_init(NV2AState *d)
         texture_key_hash,
         texture_key_equal,
         texture_key_retrieve,
-        NULL,
+        pg,
         NULL
         );
 
@@ -3503,9 +3780,11 @@ static void pgraph_bind_shaders(PGRAPHState *pg)
 #ifdef USE_SHADER_CACHE
 	ShaderBinding* cached_shader = (ShaderBinding*)g_hash_table_lookup(pg->shader_cache, &state);
 
+    pg->shader_cache_lookups++;
     if (cached_shader) {
         pg->shader_binding = cached_shader;
     } else {
+        pg->shader_cache_misses++;
 #endif
         pg->shader_binding = generate_shaders(state);
 
@@ -4163,6 +4442,11 @@ static void pgraph_bind_textures(NV2AState *d)
 		state.max_mipmap_level = max_mipmap_level;
         state.pitch = pitch;
 
+		if (g_nv2a_capture_active) {
+			nv2a_capture_memory(NV2A_CAPTURE_VRAM, d->vram_ptr, (uint32_t)(texture_data - d->vram_ptr), length);
+			nv2a_capture_memory(NV2A_CAPTURE_VRAM, d->vram_ptr, (uint32_t)(palette_data - d->vram_ptr), palette_length);
+		}
+
 #ifdef USE_TEXTURE_CACHE
 		TextureKey key;
 		key.state = state;
@@ -4175,6 +4459,7 @@ static void pgraph_bind_textures(NV2AState *d)
         memcpy(cache_key, &key, sizeof(TextureKey));
 
         GError *err;
+        pg->texture_cache_lookups++;
         TextureBinding *binding = (TextureBinding *)g_lru_cache_get(pg->texture_cache, cache_key, &err);
         assert(binding);
         binding->refcnt++;
@@ -4287,6 +4572,10 @@ static void pgraph_update_memory_buffer(NV2AState *d, hwaddr addr, hwaddr size,
 
 	assert(end < d->vram_size);
 
+	if (g_nv2a_capture_active) {
+		nv2a_capture_memory(NV2A_CAPTURE_VRAM, d->vram_ptr, addr, end - addr);
+	}
+
     // if (f || memory_region_test_and_clear_dirty(d->vram,
     //                                             addr,
     //                                             end - addr,
@@ -4840,6 +5129,7 @@ static gboolean texture_key_equal(gconstpointer a, gconstpointer b)
 static gpointer texture_key_retrieve(gpointer key, gpointer user_data, GError **error)
 {
     const TextureKey *k = (const TextureKey *)key;
+    ((PGRAPHState *)user_data)->texture_cache_misses++;
     TextureBinding *v = generate_texture(k->state,
                                          k->texture_data,
                                          k->palette_data);
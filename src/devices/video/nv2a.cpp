@@ -45,7 +45,10 @@
 #  pragma comment(lib, "glew32.lib")
 #endif
 
+#include <algorithm> // For std::sort, std::partial_sort
 #include <string> // For std::string
+#include <utility> // For std::exchange
+#include <vector> // For std::vector
 #include <distorm.h> // For uint32_t
 #include <process.h> // For __beginthreadex(), etc.
 
@@ -57,11 +60,13 @@
 #include "core/common/video/RenderBase.hpp"
 #include "core\hle\Intercept.hpp"
 #include "common/win32/Threads.h"
+#include "common/util/cliConfig.hpp"
 #include "Logging.h"
 
 #include "vga.h"
 #include "nv2a.h" // For NV2AState
 #include "nv2a_int.h" // from https://github.com/espes/xqemu/tree/xbox/hw/xbox
+#include "nv2a_capture.h" // For nv2a_capture_memory, etc
 //#include <gl\glew.h>
 #include <gl\GL.h>
 #include <gl\GLU.h>
@@ -191,6 +196,9 @@ static DMAObject nv_dma_load(NV2AState *d, xbox::addr_xt dma_obj_address)
 	assert(dma_obj_address < d->pramin.ramin_size);
 
 	uint32_t *dma_obj = (uint32_t*)(d->pramin.ramin_ptr + dma_obj_address);
+	if (g_nv2a_capture_active) {
+		nv2a_capture_memory(NV2A_CAPTURE_RAMIN, d->pramin.ramin_ptr, dma_obj_address, 12);
+	}
 	uint32_t flags = ldl_le_p(dma_obj);
 	uint32_t limit = ldl_le_p(dma_obj + 1);
 	uint32_t frame = ldl_le_p(dma_obj + 2);
@@ -1210,6 +1218,11 @@ void NV2ADevice::Init()
 
     d->pfifo.regs[NV_PFIFO_CACHE1_STATUS] |= NV_PFIFO_CACHE1_STATUS_LOW_MARK;
 
+	std::string capture_path;
+	if (cli_config::GetValue(cli_config::nv2a_capture, &capture_path)) {
+		nv2a_capture_start(capture_path, d->vram_size, d->pramin.ramin_size);
+	}
+
     /* fire up puller */
 	d->pfifo.puller_thread = std::thread(pfifo_puller_thread, d);
     /* fire up pusher */
@@ -1228,12 +1241,15 @@ void NV2ADevice::Reset()
 	d->pfifo.puller_thread.join();
 	d->pfifo.pusher_thread.join();
 	qemu_mutex_destroy(&d->pfifo.pfifo_lock); // Cbxbx addition
+	CxbxWriteTrackerUnwatch(std::exchange(d->pfifo.ramht_watch, CXBX_INVALID_WRITE_WATCH));
 	if (d->pgraph.opengl_enabled) {
 		vblank_thread.join();
 		pvideo_destroy(d);
 	}
 
 	pgraph_destroy(&d->pgraph);
+
+	nv2a_capture_stop();
 }
 
 uint32_t NV2ADevice::IORead(int barIndex, uint32_t port, unsigned size)
@@ -1337,6 +1353,14 @@ void NV2ADevice::MMIOWrite(int barIndex, uint32_t addr, uint32_t value, unsigned
 		const NV2ABlockInfo* block = EmuNV2A_Block(addr);
 
 		if (block != nullptr) {
+			if (g_nv2a_capture_active) {
+				nv2a_capture_register_write(addr, value, size);
+				BlockWrite(block, addr, value, size);
+				// Let the device consume what this write started, so everything it reads is recorded after the write
+				pfifo_wait_idle(m_nv2a_state);
+				return;
+			}
+
 			BlockWrite(block, addr, value, size);
 			return;
 		}
@@ -1352,6 +1376,157 @@ void NV2ADevice::MMIOWrite(int barIndex, uint32_t addr, uint32_t value, unsigned
 	EmuLog(LOG_LEVEL::WARNING, "NV2ADevice::MMIOWrite: Unhandled barIndex %d, addr %08X, value %08X, size %d", barIndex, addr, value, size);
 }
 
+void NV2ADevice::ReplayCapture(const std::string &path)
+{
+	NV2AState *d = m_nv2a_state; // glue
+
+	if (!d->pgraph.opengl_enabled) {
+		EmuLog(LOG_LEVEL::WARNING, "Replaying an NV2A capture requires LLE GPU");
+		return;
+	}
+
+	if (g_nv2a_capture_active) {
+		EmuLog(LOG_LEVEL::WARNING, "Can't replay an NV2A capture while capturing");
+		return;
+	}
+
+	NV2ACaptureHeader header;
+	std::vector<uint8_t> records;
+	if (!nv2a_capture_load(path, &header, records)) {
+		return;
+	}
+
+	if (header.vram_size > d->vram_size || header.ramin_size > d->pramin.ramin_size) {
+		EmuLog(LOG_LEVEL::WARNING, "NV2A capture %s needs %u MiB of memory, which this system doesn't have", path.c_str(), header.vram_size / ONE_MB);
+		return;
+	}
+
+	qemu_mutex_lock(&d->pgraph.pgraph_lock);
+	d->pgraph.texture_cache_lookups = d->pgraph.texture_cache_misses = 0;
+	d->pgraph.shader_cache_lookups = d->pgraph.shader_cache_misses = 0;
+	d->pgraph.method_profile.clear();
+	d->pgraph.profile_methods = true;
+	qemu_mutex_unlock(&d->pgraph.pgraph_lock);
+
+	unsigned int register_writes = 0;
+	size_t memory_bytes = 0;
+	auto start = std::chrono::steady_clock::now();
+
+	size_t offset = 0;
+	// Applies the memory records from offset up to the next register write
+	auto apply_memory = [&]() {
+		while (offset < records.size()) {
+			const NV2ACaptureRecord *memory = (const NV2ACaptureRecord *)&records[offset];
+			if (memory->type == NV2A_CAPTURE_REGISTER_WRITE) {
+				break;
+			}
+
+			uint8_t *base = (memory->type == NV2A_CAPTURE_VRAM) ? d->vram_ptr : d->pramin.ramin_ptr;
+			memcpy(base + memory->address, &records[offset + sizeof(NV2ACaptureRecord)], memory->size);
+			memory_bytes += memory->size;
+			offset += sizeof(NV2ACaptureRecord) + memory->size;
+		}
+	};
+
+	// Memory recorded before the first register write must be in place before that write, too
+	apply_memory();
+	while (offset < records.size() && !d->exiting) {
+		// After apply_memory, a register write always comes next
+		const NV2ACaptureRecord *record = (const NV2ACaptureRecord *)&records[offset];
+		offset += sizeof(NV2ACaptureRecord);
+
+		// The memory following a write was read because of it, so it must be in place before the write
+		apply_memory();
+
+		const NV2ABlockInfo* block = EmuNV2A_Block(record->address);
+		if (block != nullptr) {
+			BlockWrite(block, record->address, record->value, record->size);
+			pfifo_wait_idle(d);
+		}
+
+		register_writes++;
+	}
+
+	double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	qemu_mutex_lock(&d->pgraph.pgraph_lock);
+	d->pgraph.profile_methods = false;
+
+	std::vector<std::pair<uint32_t, MethodProfile>> methods(d->pgraph.method_profile.begin(), d->pgraph.method_profile.end());
+	std::sort(methods.begin(), methods.end(), [](const auto &a, const auto &b) {
+		return a.second.total_ns > b.second.total_ns;
+	});
+
+	uint64_t method_calls = 0;
+	for (const auto &method : methods) {
+		method_calls += method.second.calls;
+	}
+
+	EmuLog(LOG_LEVEL::INFO, "Replayed NV2A capture %s : %u register writes, %zu KiB of memory, %llu methods in %.3f ms (%.0f methods/s)",
+		path.c_str(), register_writes, memory_bytes / ONE_KB, method_calls, elapsed_ms, method_calls * 1000.0 / std::max(elapsed_ms, 0.001));
+	EmuLog(LOG_LEVEL::INFO, "Texture cache : %u lookups, %u misses", d->pgraph.texture_cache_lookups, d->pgraph.texture_cache_misses);
+	EmuLog(LOG_LEVEL::INFO, "Shader cache : %u lookups, %u misses", d->pgraph.shader_cache_lookups, d->pgraph.shader_cache_misses);
+
+	// List the methods that took the most time in total
+	const size_t max_listed_methods = 32;
+	for (size_t i = 0; i < methods.size() && i < max_listed_methods; i++) {
+		const MethodProfile &profile = methods[i].second;
+		EmuLog(LOG_LEVEL::INFO, "  subchannel %u method 0x%04X : %u calls, %.3f ms, %.0f ns per call",
+			methods[i].first >> 16, methods[i].first & 0xFFFF, profile.calls, profile.total_ns / 1000000.0, (double)profile.total_ns / profile.calls);
+	}
+
+	qemu_mutex_unlock(&d->pgraph.pgraph_lock);
+}
+
+void NV2ADevice::DrawStats()
+{
+	PGRAPHState *pg = &m_nv2a_state->pgraph;
+
+	static const char *class_names[PGRAPH_CLASS_COUNT] = { "Pattern", "Surfaces 2D", "Image Blit", "Kelvin" };
+
+	struct MethodCalls {
+		unsigned int calls;
+		unsigned int class_index;
+		unsigned int method;
+	};
+
+	// Collect (and reset) the per-method call counters, which the puller updates under pgraph_lock
+	static unsigned int method_calls[PGRAPH_CLASS_COUNT][NV2A_METHOD_TABLE_SIZE];
+	qemu_mutex_lock(&pg->pgraph_lock);
+	memcpy(method_calls, pg->method_calls, sizeof(method_calls));
+	memset(pg->method_calls, 0, sizeof(pg->method_calls));
+	unsigned int inline_vertex_fast_path_methods = std::exchange(pg->inline_vertex_fast_path_methods, 0);
+	qemu_mutex_unlock(&pg->pgraph_lock);
+
+	std::vector<MethodCalls> methods;
+	unsigned int total_calls = 0;
+	for (unsigned int class_index = 0; class_index < PGRAPH_CLASS_COUNT; class_index++) {
+		for (unsigned int index = 0; index < NV2A_METHOD_TABLE_SIZE; index++) {
+			unsigned int calls = method_calls[class_index][index];
+			if (calls > 0) {
+				methods.push_back({ calls, class_index, index << 2 });
+				total_calls += calls;
+			}
+		}
+	}
+
+	const size_t max_listed_methods = std::min<size_t>(methods.size(), 8);
+	std::partial_sort(methods.begin(), methods.begin() + max_listed_methods, methods.end(), [](const MethodCalls &a, const MethodCalls &b) {
+		return a.calls > b.calls;
+	});
+
+	ImGui::Text("Methods: %u", total_calls);
+	ImGui::Text("Inline vertex fast path: %u", inline_vertex_fast_path_methods);
+	for (size_t i = 0; i < max_listed_methods; i++) {
+		ImGui::Text("%s 0x%04X: %u", class_names[methods[i].class_index], methods[i].method, methods[i].calls);
+	}
+
+	unsigned int puller_batches = std::exchange(m_nv2a_state->pfifo.puller_batches, 0);
+	unsigned int pulled_methods = std::exchange(m_nv2a_state->pfifo.pulled_methods, 0);
+	ImGui::Text("Puller batches: %u (%.1f methods each)", puller_batches, puller_batches ? (float)pulled_methods / puller_batches : 0.0f);
+	ImGui::Text("RAMHT lookups: %u (%u cached)", std::exchange(m_nv2a_state->pfifo.ramht_lookups, 0), std::exchange(m_nv2a_state->pfifo.ramht_cache_hits, 0));
+}
+
 int NV2ADevice::GetFrameHeight(NV2AState* d)
 {
 	// Derive frame_height from hardware registers
@@ -25,6 +25,8 @@
 // ******************************************************************
 #pragma once
 
+#include <string>
+
 #include "devices\PCIDevice.h" // For PCIDevice
 
 #include "nv2a_int.h" // For NV2AState
@@ -104,6 +106,12 @@ public:
 	void BlockWrite(const NV2ABlockInfo* block, uint32_t addr, uint32_t value, unsigned size);
 	void MMIOWrite(int barIndex, uint32_t addr, uint32_t value, unsigned size);
 
+	// Feeds an NV2A capture (see nv2a_capture.h) through PFIFO and PGRAPH, and logs how that performed
+	void ReplayCapture(const std::string &path);
+
+	// Draws method dispatch statistics, resetting them
+	void DrawStats();
+
 	static void UpdateHostDisplay(NV2AState *d);
 
 	static int GetFrameWidth(NV2AState *d);
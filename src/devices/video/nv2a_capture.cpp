@@ -0,0 +1,183 @@
+// Copyright 2021 Cxbx-Reloaded Project
+// Licensed under GPLv2+
+// Refer to the COPYING file included.
+
+#define LOG_PREFIX CXBXR_MODULE::NV2A
+
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <unordered_map>
+#include "nv2a_capture.h"
+#include "common\AddressRanges.h" // For PAGE_SHIFT, PAGE_SIZE, PAGE_MASK
+#include "common\util\hasher.h" // For ComputeHash
+#include "Logging.h"
+
+std::atomic<bool> g_nv2a_capture_active = false;
+
+static std::FILE *g_nv2a_capture_file = nullptr;
+static std::mutex g_nv2a_capture_mtx;
+static size_t g_nv2a_capture_region_size[NV2A_CAPTURE_RAMIN + 1] = {};
+// Hash of the contents each page had when it was last recorded, keyed on record type and page number
+static std::unordered_map<uint64_t, uint64_t> g_nv2a_capture_pages;
+
+static void nv2a_capture_write_record(NV2ACaptureRecordType type, uint32_t address, uint32_t size, uint32_t value, const void *data)
+{
+	NV2ACaptureRecord record = { type, address, size, value };
+	std::fwrite(&record, sizeof(record), 1, g_nv2a_capture_file);
+	if (data != nullptr) {
+		std::fwrite(data, size, 1, g_nv2a_capture_file);
+	}
+}
+
+bool nv2a_capture_start(const std::string &path, size_t vram_size, size_t ramin_size)
+{
+	std::lock_guard<std::mutex> lck(g_nv2a_capture_mtx);
+
+	g_nv2a_capture_file = std::fopen(path.c_str(), "wb");
+	if (g_nv2a_capture_file == nullptr) {
+		EmuLog(LOG_LEVEL::WARNING, "Failed to create NV2A capture %s", path.c_str());
+		return false;
+	}
+
+	std::setvbuf(g_nv2a_capture_file, nullptr, _IOFBF, 1024 * 1024);
+
+	NV2ACaptureHeader header = { NV2A_CAPTURE_MAGIC, NV2A_CAPTURE_VERSION, (uint32_t)vram_size, (uint32_t)ramin_size };
+	std::fwrite(&header, sizeof(header), 1, g_nv2a_capture_file);
+
+	g_nv2a_capture_region_size[NV2A_CAPTURE_VRAM] = vram_size;
+	g_nv2a_capture_region_size[NV2A_CAPTURE_RAMIN] = ramin_size;
+	g_nv2a_capture_pages.clear();
+	g_nv2a_capture_active = true;
+
+	EmuLog(LOG_LEVEL::INFO, "Capturing NV2A to %s", path.c_str());
+	return true;
+}
+
+void nv2a_capture_stop()
+{
+	std::lock_guard<std::mutex> lck(g_nv2a_capture_mtx);
+
+	if (!g_nv2a_capture_active) {
+		return;
+	}
+
+	g_nv2a_capture_active = false;
+	nv2a_capture_write_record(NV2A_CAPTURE_END, 0, 0, 0, nullptr);
+	std::fclose(g_nv2a_capture_file);
+	g_nv2a_capture_file = nullptr;
+
+	EmuLog(LOG_LEVEL::INFO, "Finished NV2A capture (%zu distinct pages)", g_nv2a_capture_pages.size());
+	g_nv2a_capture_pages.clear();
+}
+
+void nv2a_capture_register_write(uint32_t addr, uint32_t value, unsigned size)
+{
+	std::lock_guard<std::mutex> lck(g_nv2a_capture_mtx);
+
+	if (!g_nv2a_capture_active) {
+		return;
+	}
+
+	nv2a_capture_write_record(NV2A_CAPTURE_REGISTER_WRITE, addr, size, value, nullptr);
+}
+
+void nv2a_capture_memory(NV2ACaptureRecordType type, const uint8_t *base, uint32_t address, size_t size)
+{
+	std::lock_guard<std::mutex> lck(g_nv2a_capture_mtx);
+
+	if (!g_nv2a_capture_active || size == 0) {
+		return;
+	}
+
+	size_t region_size = g_nv2a_capture_region_size[type];
+	if (address >= region_size) {
+		return;
+	}
+
+	size_t end = std::min<size_t>(address + size, region_size);
+	for (size_t page = address >> PAGE_SHIFT; page <= (end - 1) >> PAGE_SHIFT; page++) {
+		const uint8_t *data = base + (page << PAGE_SHIFT);
+		uint64_t hash = ComputeHash(data, PAGE_SIZE);
+		auto it = g_nv2a_capture_pages.find(((uint64_t)type << 32) | page);
+		if (it != g_nv2a_capture_pages.end()) {
+			if (it->second == hash) {
+				continue;
+			}
+
+			it->second = hash;
+		}
+		else {
+			g_nv2a_capture_pages.emplace(((uint64_t)type << 32) | page, hash);
+		}
+
+		nv2a_capture_write_record(type, (uint32_t)(page << PAGE_SHIFT), PAGE_SIZE, 0, data);
+	}
+}
+
+bool nv2a_capture_load(const std::string &path, NV2ACaptureHeader *header, std::vector<uint8_t> &records)
+{
+	std::FILE *file = std::fopen(path.c_str(), "rb");
+	if (file == nullptr) {
+		EmuLog(LOG_LEVEL::WARNING, "Failed to open NV2A capture %s", path.c_str());
+		return false;
+	}
+
+	bool valid = std::fread(header, sizeof(*header), 1, file) == 1
+		&& header->magic == NV2A_CAPTURE_MAGIC
+		&& header->version == NV2A_CAPTURE_VERSION;
+	if (valid) {
+		long start = std::ftell(file);
+		std::fseek(file, 0, SEEK_END);
+		records.resize(std::ftell(file) - start);
+		std::fseek(file, start, SEEK_SET);
+		valid = records.empty() || std::fread(records.data(), records.size(), 1, file) == 1;
+	}
+
+	std::fclose(file);
+
+	// Check all records up front, so a replay doesn't have to. A capture that wasn't
+	// finished (for instance because emulation crashed) is cut off at its last whole record
+	size_t offset = 0;
+	while (valid && offset < records.size()) {
+		const NV2ACaptureRecord *record = (const NV2ACaptureRecord *)&records[offset];
+		size_t payload = 0;
+		if (offset + sizeof(NV2ACaptureRecord) <= records.size() && record->type != NV2A_CAPTURE_REGISTER_WRITE) {
+			payload = record->size;
+		}
+
+		if (offset + sizeof(NV2ACaptureRecord) > records.size()
+			|| payload > records.size() - offset - sizeof(NV2ACaptureRecord)) {
+			EmuLog(LOG_LEVEL::WARNING, "NV2A capture %s is truncated", path.c_str());
+			records.resize(offset);
+			break;
+		}
+
+		switch (record->type) {
+		case NV2A_CAPTURE_END:
+			records.resize(offset);
+			return true;
+		case NV2A_CAPTURE_REGISTER_WRITE:
+			valid = record->size == sizeof(uint8_t) || record->size == sizeof(uint16_t) || record->size == sizeof(uint32_t);
+			break;
+		case NV2A_CAPTURE_VRAM:
+		case NV2A_CAPTURE_RAMIN: {
+			uint32_t region_size = (record->type == NV2A_CAPTURE_VRAM) ? header->vram_size : header->ramin_size;
+			valid = record->address <= region_size && record->size <= region_size - record->address;
+			break;
+		}
+		default:
+			valid = false;
+			break;
+		}
+
+		offset += sizeof(NV2ACaptureRecord) + payload;
+	}
+
+	if (!valid) {
+		EmuLog(LOG_LEVEL::WARNING, "%s is not a valid NV2A capture", path.c_str());
+		records.clear();
+	}
+
+	return valid;
+}
@@ -0,0 +1,59 @@
+// Copyright 2021 Cxbx-Reloaded Project
+// Licensed under GPLv2+
+// Refer to the COPYING file included.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// An NV2A capture records everything PFIFO and PGRAPH consume from outside the device,
+// so that it can be fed through the device again without running the title that made it :
+// - Register writes, in the order the guest issued them
+// - The guest memory and RAMIN pages the device reads (pushbuffers, textures, vertex data,
+//   surfaces, RAMHT entries, DMA and graphics objects)
+// A page is recorded when it gets referenced while its contents differ from what was last
+// recorded for it. While capturing, every register write waits for PFIFO to drain, so that
+// the pages read because of a write are recorded right after that write. A replay must
+// thus apply the pages following a register write (and those preceding the first one)
+// before doing that write.
+
+constexpr uint32_t NV2A_CAPTURE_MAGIC = 0x5043324E; // "N2CP"
+constexpr uint32_t NV2A_CAPTURE_VERSION = 1;
+
+typedef struct NV2ACaptureHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vram_size;
+	uint32_t ramin_size;
+} NV2ACaptureHeader;
+
+typedef enum NV2ACaptureRecordType : uint32_t {
+	NV2A_CAPTURE_END = 0,
+	NV2A_CAPTURE_REGISTER_WRITE, // address = NV2A register, size = access size, value = written value
+	NV2A_CAPTURE_VRAM,           // address = physical address, followed by size bytes of contents
+	NV2A_CAPTURE_RAMIN,          // address = RAMIN offset, followed by size bytes of contents
+} NV2ACaptureRecordType;
+
+typedef struct NV2ACaptureRecord {
+	uint32_t type;
+	uint32_t address;
+	uint32_t size;
+	uint32_t value;
+} NV2ACaptureRecord;
+
+// Read without holding any lock by the CPU, PFIFO and PGRAPH threads
+extern std::atomic<bool> g_nv2a_capture_active;
+
+bool nv2a_capture_start(const std::string &path, size_t vram_size, size_t ramin_size);
+void nv2a_capture_stop();
+void nv2a_capture_register_write(uint32_t addr, uint32_t value, unsigned size);
+// Records the pages overlapping [address, address + size) of the given region (base points at
+// its start) whose contents changed since they were last recorded
+void nv2a_capture_memory(NV2ACaptureRecordType type, const uint8_t *base, uint32_t address, size_t size);
+
+// Reads a capture into memory, leaving only its (validated) records in the given buffer
+bool nv2a_capture_load(const std::string &path, NV2ACaptureHeader *header, std::vector<uint8_t> &records);
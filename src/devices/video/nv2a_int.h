@@ -27,6 +27,7 @@
 
 #include <queue>
 #include <thread>
+#include <unordered_map>
 #include <GL/glew.h>
 
 #include "xbox_types.h" // For xbox::addr_xt
@@ -37,6 +38,7 @@
 #include "glib_compat.h" // For GHashTable, g_hash_table_new, g_hash_table_lookup, g_hash_table_insert
 #endif
 #include "common\util\gloffscreen\gloffscreen.h" // For GloContext, etc
+#include "core\kernel\support\WriteTracker.h" // For CxbxWriteWatch
 
 #include "swizzle.h"
 
@@ -68,6 +70,9 @@ typedef uint32_t value_t; // Compatibility; Cxbx values are uint32_t (xqemu and
 
 #undef USE_TEXTURE_CACHE
 
+// Let runs of inline vertex methods bypass the object context bookkeeping of pgraph_handle_method
+#define USE_INLINE_VERTEX_FAST_PATH
+
 #if __cplusplus >= 201402L
 #  define NV2A_CONSTEXPR constexpr
 #else
@@ -124,6 +129,24 @@ enum FIFOEngine {
 	ENGINE_DVD = 2,
 };
 
+typedef struct RAMHTEntry {
+	uint32_t handle;
+	xbox::addr_xt instance;
+	enum FIFOEngine engine;
+	unsigned int channel_id : 5;
+	bool valid;
+} RAMHTEntry;
+
+#define NV2A_RAMHT_CACHE_SIZE 64 // Must be a power of two
+
+// A resolved RAMHT entry, keyed on the handle and channel it was looked up for
+typedef struct RAMHTCacheEntry {
+	bool cached;
+	uint32_t handle;
+	unsigned int channel_id;
+	RAMHTEntry entry;
+} RAMHTCacheEntry;
+
 typedef struct DMAObject {
 	unsigned int dma_class;
 	unsigned int dma_target;
@@ -205,6 +228,24 @@ typedef struct TextureBinding {
 	unsigned int refcnt;
 } TextureBinding;
 
+// The graphics classes PGRAPH has a method table for
+typedef enum PGRAPHClass {
+	PGRAPH_CLASS_CONTEXT_PATTERN = 0,
+	PGRAPH_CLASS_CONTEXT_SURFACES_2D,
+	PGRAPH_CLASS_IMAGE_BLIT,
+	PGRAPH_CLASS_KELVIN_PRIMITIVE,
+	PGRAPH_CLASS_COUNT,
+	PGRAPH_CLASS_UNKNOWN = PGRAPH_CLASS_COUNT
+} PGRAPHClass;
+
+#define NV2A_METHOD_TABLE_SIZE 2048 // Methods are 13 bit byte offsets, so a class has at most 2048 of them
+#define NV2A_INVALID_SUBCHANNEL 8
+
+typedef struct MethodProfile {
+	unsigned int calls;
+	uint64_t total_ns;
+} MethodProfile;
+
 typedef struct KelvinState {
 	xbox::addr_xt object_instance;
 } KelvinState;
@@ -330,6 +371,20 @@ typedef struct PGRAPHState {
 	GLuint gl_memory_buffer;
 	GLuint gl_vertex_array;
 
+	// Method dispatch statistics
+	unsigned int method_calls[PGRAPH_CLASS_COUNT][NV2A_METHOD_TABLE_SIZE];
+	unsigned int inline_vertex_fast_path_methods;
+	// The Kelvin subchannel whose object context is current, or NV2A_INVALID_SUBCHANNEL
+	unsigned int inline_vertex_subchannel;
+
+	// Cache statistics
+	unsigned int texture_cache_lookups, texture_cache_misses;
+	unsigned int shader_cache_lookups, shader_cache_misses;
+
+	// Per-method timings, only collected while replaying a capture
+	bool profile_methods;
+	std::unordered_map<uint32_t, MethodProfile> method_profile; // Keyed on subchannel << 16 | method
+
 	uint32_t regs[NV_PGRAPH_SIZE]; // TODO : union
 } PGRAPHState;
 
@@ -394,6 +449,16 @@ typedef struct NV2AState {
 		QemuCond puller_cond;
 		std::thread pusher_thread;
 		QemuCond pusher_cond;
+		bool puller_busy; // Set while the puller hands a batch of methods to PGRAPH
+		// Direct-mapped cache of RAMHT lookups, flushed when RAMHT is written to or moved
+		RAMHTCacheEntry ramht_cache[NV2A_RAMHT_CACHE_SIZE];
+		uint32_t ramht_cache_reg; // The NV_PFIFO_RAMHT value the cache was filled for
+		CxbxWriteWatch ramht_watch;
+		// Statistics
+		unsigned int ramht_lookups;
+		unsigned int ramht_cache_hits;
+		unsigned int puller_batches;
+		unsigned int pulled_methods;
     } pfifo;
 
     struct {
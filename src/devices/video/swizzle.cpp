@@ -22,8 +22,10 @@
  */
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <emmintrin.h> /* SSE2 */
 #include "swizzle.h"
 
 /* This should be pretty straightforward.
@@ -55,64 +57,223 @@ static void generate_swizzle_masks(unsigned int width,
     *mask_z = z;
 }
 
-/* This fills a pattern with a value if your value has bits abcd and your
- * pattern is 11010100100 this will return: 0a0b0c00d00
+/* This fills a table with the swizzled offsets of all values below count,
+ * for the given pattern. If your value has bits abcd and your pattern is
+ * 11010100100, its entry will be 0a0b0c00d00. Instead of depositing the bits
+ * of each value one at a time, this steps from one entry to the next by
+ * incrementing only the masked bits (the carries skip over unmasked bits).
  */
-static uint32_t fill_pattern(uint32_t pattern, uint32_t value)
+/* Offset tables up to this many entries are filled into the caller's stack
+ * buffer; only oversized dimensions fall back to a heap allocation.
+ */
+#define SWIZZLE_STACK_OFFSETS 1024
+
+static uint32_t *generate_swizzle_offsets(uint32_t pattern, unsigned int count,
+                                          uint32_t *stack_buf)
 {
-    uint32_t result = 0;
-    uint32_t bit = 1;
-    while(value) {
-        if (pattern & bit) {
-            /* Copy bit to result */
-            result |= value & 1 ? bit : 0;
-            value >>= 1;
-        }
-        bit <<= 1;
+    uint32_t *offsets = stack_buf;
+    if (count > SWIZZLE_STACK_OFFSETS) {
+        offsets = (uint32_t *)malloc(count * sizeof(uint32_t));
+    }
+    uint32_t offset = 0;
+    for (unsigned int i = 0; i < count; i++) {
+        offsets[i] = offset;
+        offset = (offset - pattern) & pattern;
     }
-    return result;
+    return offsets;
 }
 
-static unsigned int get_swizzled_offset(
-    unsigned int x, unsigned int y, unsigned int z,
-    uint32_t mask_x, uint32_t mask_y, uint32_t mask_z,
-    unsigned int bytes_per_pixel)
+static void free_swizzle_offsets(uint32_t *offsets, uint32_t *stack_buf)
 {
-    return bytes_per_pixel * (fill_pattern(mask_x, x)
-                           | fill_pattern(mask_y, y)
-                           | fill_pattern(mask_z, z));
+    if (offsets != stack_buf) {
+        free(offsets);
+    }
 }
 
-void swizzle_box(
-    const uint8_t *src_buf,
+/* Copies a single pixel, using a single move for the common sizes */
+static inline void copy_pixel(uint8_t *dst, const uint8_t *src,
+                              unsigned int bytes_per_pixel)
+{
+    switch (bytes_per_pixel) {
+    case 1: *dst = *src; break;
+    case 2: *(uint16_t *)dst = *(const uint16_t *)src; break;
+    case 4: *(uint32_t *)dst = *(const uint32_t *)src; break;
+    case 8: *(uint64_t *)dst = *(const uint64_t *)src; break;
+    case 16: _mm_storeu_si128((__m128i *)dst, _mm_loadu_si128((const __m128i *)src)); break;
+    default: memcpy(dst, src, bytes_per_pixel); break;
+    }
+}
+
+/* When both width and height are at least 4 (and depth is 1), the lowest
+ * four bits of a swizzled offset are x0 y0 x1 y1. Every 4x4 tile of pixels
+ * is then stored as 16 consecutive pixels, which are (un)swizzled at once by
+ * these kernels. Within a tile, pixel i is at x = (i & 1) | ((i >> 1) & 2)
+ * and y = ((i >> 1) & 1) | ((i >> 2) & 2). The shuffles used are their own
+ * inverse, so the same kernel handles both directions.
+ */
+static inline void swizzle_tile(uint8_t *tile, uint8_t *linear,
+                                unsigned int pitch,
+                                unsigned int bytes_per_pixel,
+                                bool unswizzle)
+{
+    uint8_t *row0 = linear;
+    uint8_t *row1 = linear + pitch;
+    uint8_t *row2 = linear + pitch * 2;
+    uint8_t *row3 = linear + pitch * 3;
+
+    switch (bytes_per_pixel) {
+    case 1: {
+        /* Rows are 32 bit lanes; Swizzled, each lane holds two 2-pixel halves of two rows */
+        __m128i v;
+        if (unswizzle) {
+            v = _mm_loadu_si128((const __m128i *)tile);
+        } else {
+            v = _mm_setr_epi32(*(const int32_t *)row0, *(const int32_t *)row1,
+                               *(const int32_t *)row2, *(const int32_t *)row3);
+        }
+        v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 1, 2, 0));
+        v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(3, 1, 2, 0));
+        if (unswizzle) {
+            *(int32_t *)row0 = _mm_cvtsi128_si32(v);
+            *(int32_t *)row1 = _mm_cvtsi128_si32(_mm_srli_si128(v, 4));
+            *(int32_t *)row2 = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+            *(int32_t *)row3 = _mm_cvtsi128_si32(_mm_srli_si128(v, 12));
+        } else {
+            _mm_storeu_si128((__m128i *)tile, v);
+        }
+        break;
+    }
+    case 2: {
+        /* Rows are 64 bit halves; Swizzled, each half holds 2-pixel halves of two rows */
+        __m128i v0, v1;
+        if (unswizzle) {
+            v0 = _mm_loadu_si128((const __m128i *)tile);
+            v1 = _mm_loadu_si128((const __m128i *)tile + 1);
+        } else {
+            v0 = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)row0),
+                                    _mm_loadl_epi64((const __m128i *)row1));
+            v1 = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)row2),
+                                    _mm_loadl_epi64((const __m128i *)row3));
+        }
+        v0 = _mm_shuffle_epi32(v0, _MM_SHUFFLE(3, 1, 2, 0));
+        v1 = _mm_shuffle_epi32(v1, _MM_SHUFFLE(3, 1, 2, 0));
+        if (unswizzle) {
+            _mm_storel_epi64((__m128i *)row0, v0);
+            _mm_storel_epi64((__m128i *)row1, _mm_srli_si128(v0, 8));
+            _mm_storel_epi64((__m128i *)row2, v1);
+            _mm_storel_epi64((__m128i *)row3, _mm_srli_si128(v1, 8));
+        } else {
+            _mm_storeu_si128((__m128i *)tile, v0);
+            _mm_storeu_si128((__m128i *)tile + 1, v1);
+        }
+        break;
+    }
+    case 4: {
+        /* Rows are whole registers; Swizzled, each register holds 2-pixel halves of two rows */
+        __m128i v0, v1, v2, v3;
+        if (unswizzle) {
+            v0 = _mm_loadu_si128((const __m128i *)tile);
+            v1 = _mm_loadu_si128((const __m128i *)tile + 1);
+            v2 = _mm_loadu_si128((const __m128i *)tile + 2);
+            v3 = _mm_loadu_si128((const __m128i *)tile + 3);
+        } else {
+            v0 = _mm_loadu_si128((const __m128i *)row0);
+            v1 = _mm_loadu_si128((const __m128i *)row1);
+            v2 = _mm_loadu_si128((const __m128i *)row2);
+            v3 = _mm_loadu_si128((const __m128i *)row3);
+        }
+        __m128i r0 = _mm_unpacklo_epi64(v0, v1);
+        __m128i r1 = _mm_unpackhi_epi64(v0, v1);
+        __m128i r2 = _mm_unpacklo_epi64(v2, v3);
+        __m128i r3 = _mm_unpackhi_epi64(v2, v3);
+        if (unswizzle) {
+            _mm_storeu_si128((__m128i *)row0, r0);
+            _mm_storeu_si128((__m128i *)row1, r1);
+            _mm_storeu_si128((__m128i *)row2, r2);
+            _mm_storeu_si128((__m128i *)row3, r3);
+        } else {
+            _mm_storeu_si128((__m128i *)tile, r0);
+            _mm_storeu_si128((__m128i *)tile + 1, r1);
+            _mm_storeu_si128((__m128i *)tile + 2, r2);
+            _mm_storeu_si128((__m128i *)tile + 3, r3);
+        }
+        break;
+    }
+    default: {
+        /* Pixel pairs along x are consecutive, so move those (16 bytes for 8 bpp) */
+        unsigned int pair_size = bytes_per_pixel * 2;
+        for (unsigned int i = 0; i < 8; i++) {
+            unsigned int x = (i >> 1) & 1;
+            unsigned int y = (i & 1) | ((i >> 1) & 2);
+            uint8_t *pair = linear + y * pitch + x * pair_size;
+            if (unswizzle) {
+                copy_pixel(pair, tile + i * pair_size, pair_size);
+            } else {
+                copy_pixel(tile + i * pair_size, pair, pair_size);
+            }
+        }
+        break;
+    }
+    }
+}
+
+static void swizzle_box_internal(
+    uint8_t *swizzled_buf,
     unsigned int width,
     unsigned int height,
     unsigned int depth,
-    uint8_t *dst_buf,
+    uint8_t *linear_buf,
     unsigned int row_pitch,
     unsigned int slice_pitch,
-    unsigned int bytes_per_pixel)
+    unsigned int bytes_per_pixel,
+    bool unswizzle)
 {
     uint32_t mask_x, mask_y, mask_z;
     generate_swizzle_masks(width, height, depth, &mask_x, &mask_y, &mask_z);
 
-    unsigned int x, y, z;
-    for (z = 0; z < depth; z++) {
-        for (y = 0; y < height; y++) {
-            for (x = 0; x < width; x++) {
-                const uint8_t *src = src_buf
-                                         + y * row_pitch + x * bytes_per_pixel;
-                uint8_t *dst = dst_buf + get_swizzled_offset(x, y, 0,
-                                                             mask_x, mask_y, 0,
-                                                             bytes_per_pixel);
-                memcpy(dst, src, bytes_per_pixel);
+    uint32_t stack_x[SWIZZLE_STACK_OFFSETS];
+    uint32_t stack_y[SWIZZLE_STACK_OFFSETS];
+    uint32_t stack_z[SWIZZLE_STACK_OFFSETS];
+    uint32_t *offsets_x = generate_swizzle_offsets(mask_x, width, stack_x);
+    uint32_t *offsets_y = generate_swizzle_offsets(mask_y, height, stack_y);
+    uint32_t *offsets_z = generate_swizzle_offsets(mask_z, depth, stack_z);
+
+    if (depth == 1 && width % 4 == 0 && height % 4 == 0) {
+        for (unsigned int y = 0; y < height; y += 4) {
+            uint8_t *linear = linear_buf + y * row_pitch;
+            for (unsigned int x = 0; x < width; x += 4) {
+                uint8_t *tile = swizzled_buf
+                    + (offsets_x[x] | offsets_y[y]) * bytes_per_pixel;
+                swizzle_tile(tile, linear + x * bytes_per_pixel, row_pitch,
+                             bytes_per_pixel, unswizzle);
             }
         }
-        src_buf += slice_pitch;
+    } else {
+        for (unsigned int z = 0; z < depth; z++) {
+            for (unsigned int y = 0; y < height; y++) {
+                uint32_t offset_yz = offsets_y[y] | offsets_z[z];
+                uint8_t *linear = linear_buf + y * row_pitch;
+                for (unsigned int x = 0; x < width; x++) {
+                    uint8_t *swizzled = swizzled_buf
+                        + (offsets_x[x] | offset_yz) * bytes_per_pixel;
+                    if (unswizzle) {
+                        copy_pixel(linear, swizzled, bytes_per_pixel);
+                    } else {
+                        copy_pixel(swizzled, linear, bytes_per_pixel);
+                    }
+                    linear += bytes_per_pixel;
+                }
+            }
+            linear_buf += slice_pitch;
+        }
     }
+
+    free_swizzle_offsets(offsets_x, stack_x);
+    free_swizzle_offsets(offsets_y, stack_y);
+    free_swizzle_offsets(offsets_z, stack_z);
 }
 
-void unswizzle_box(
+void swizzle_box(
     const uint8_t *src_buf,
     unsigned int width,
     unsigned int height,
@@ -122,22 +283,22 @@ void unswizzle_box(
     unsigned int slice_pitch,
     unsigned int bytes_per_pixel)
 {
-    uint32_t mask_x, mask_y, mask_z;
-    generate_swizzle_masks(width, height, depth, &mask_x, &mask_y, &mask_z);
+    swizzle_box_internal(dst_buf, width, height, depth, (uint8_t *)src_buf,
+                         row_pitch, slice_pitch, bytes_per_pixel, false);
+}
 
-	unsigned int x, y, z;
-    for (z = 0; z < depth; z++) {
-        for (y = 0; y < height; y++) {
-            for (x = 0; x < width; x++) {
-                const uint8_t *src = src_buf
-                    + get_swizzled_offset(x, y, z, mask_x, mask_y, mask_z,
-                                          bytes_per_pixel);
-                uint8_t *dst = dst_buf + y * row_pitch + x * bytes_per_pixel;
-                memcpy(dst, src, bytes_per_pixel);
-            }
-        }
-        dst_buf += slice_pitch;
-    }
+void unswizzle_box(
+    const uint8_t *src_buf,
+    unsigned int width,
+    unsigned int height,
+    unsigned int depth,
+    uint8_t *dst_buf,
+    unsigned int row_pitch,
+    unsigned int slice_pitch,
+    unsigned int bytes_per_pixel)
+{
+    swizzle_box_internal((uint8_t *)src_buf, width, height, depth, dst_buf,
+                         row_pitch, slice_pitch, bytes_per_pixel, true);
 }
 
 void unswizzle_rect(
@@ -57,6 +57,7 @@
 #include <io.h>
 #include <shlobj.h>
 
+#include <algorithm> // for std::find
 #include <sstream> // for std::stringstream
 #include <fstream>
 #include <iostream>
@@ -1971,14 +1972,9 @@ void WndMain::OpenXbe(const char *x_filename)
 	}
 
 	if (!g_Settings->m_gui.bIgnoreInvalidXbeSec) {
-		for (uint32_t sectionIndex = 0; sectionIndex < m_Xbe->m_Header.dwSections; sectionIndex++) {
-			if (!m_Xbe->CheckSectionIntegrity(sectionIndex)) {
-				errorMsg += "- One or more XBE section(s) are corrupted!\n";
-
-				// if we find a corrupted section, we won't bother checking the remaining sections since we know
-				// already at this point that the xbe is invalid
-				break;
-			}
+		const std::vector<bool> sectionIntegrity = m_Xbe->CheckSectionsIntegrity(g_Settings->GetDataLocation() + "\\XbeDigestCache.ini");
+		if (std::find(sectionIntegrity.begin(), sectionIntegrity.end(), false) != sectionIntegrity.end()) {
+			errorMsg += "- One or more XBE section(s) are corrupted!\n";
 		}
 	}
 